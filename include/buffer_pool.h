@@ -0,0 +1 @@
+/root/repo/src/buffer/buffer_pool.h
\ No newline at end of file
@@ -0,0 +1 @@
+/root/repo/src/http/compress_cache.h
\ No newline at end of file
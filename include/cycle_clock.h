@@ -0,0 +1 @@
+/root/repo/src/timer/cycle_clock.h
\ No newline at end of file
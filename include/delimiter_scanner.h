@@ -0,0 +1 @@
+/root/repo/src/http/delimiter_scanner.h
\ No newline at end of file
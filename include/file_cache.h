@@ -0,0 +1 @@
+/root/repo/src/http/file_cache.h
\ No newline at end of file
@@ -0,0 +1 @@
+/root/repo/src/epoller/io_uring_poller.h
\ No newline at end of file
@@ -0,0 +1 @@
+/root/repo/src/eventloop/loop_metrics.h
\ No newline at end of file
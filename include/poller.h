@@ -0,0 +1 @@
+/root/repo/src/epoller/poller.h
\ No newline at end of file
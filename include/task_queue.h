@@ -0,0 +1 @@
+/root/repo/src/eventloop/task_queue.h
\ No newline at end of file
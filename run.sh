@@ -6,8 +6,31 @@ IP=""                        # 监听地址. 为空时监听所有地址.
 PORT=80                      # 监听端口.
 THREAD_NUM=6                 # IO线程数量. 即subReactor数量, 为0则主线程兼做IO线程.
 ROOT_PATH="./resources"      # Web资源文件根路径.
-TIMEOUT=30                   # HttpConnection 超时时间.(为0时表示不启用定时器)
+TIMEOUT=30                   # keep-alive连接等待下一个请求的超时秒数.(为0时不限制, 下同)
+FIRST_BYTE_TIMEOUT=10        # 新连接等待首个请求第一个字节的超时秒数.
+HEADER_TIMEOUT=20            # 自请求的第一个字节起接收完请求头部的超时秒数, 防止slowloris攻击.
+MIN_BODY_RATE=500            # 接收请求消息体的最低速率(字节/秒).
+MIN_SEND_RATE=500            # 发送响应的最低速率(字节/秒).
 MAX_CONN=15000               # 限制服务器允许的最大并发连接数
+FILE_CACHE=67108864          # 静态资源文件缓存字节上限(为0时不启用). 64MB.
+FILE_CACHE_MAX=4194304       # 可被缓存的单个文件字节上限. 4MB.
+COMPRESS_CACHE=16777216      # gzip/deflate即时压缩结果缓存字节上限(为0时仅使用预压缩文件). 16MB.
+BUFFER_POOL=4194304          # 每个IO线程的Buffer缓冲池保留空闲存储的字节上限. 4MB.
+EDGE_TRIGGER=0               # 是否以边缘触发方式监听连接. 1开启, 0关闭(水平触发).
+READ_BUDGET=262144           # 边缘触发时单个连接每次可读事件的读取字节上限. 256KB.
+IO_URING=0                   # 是否以io_uring替代epoll监听就绪事件. 1开启(内核不支持时退回epoll), 0关闭.
+ACCEPTOR_MODE=0              # 0: 主线程accept后分发; 1: 每个IO线程各自监听同一端口(SO_REUSEPORT); 2: 同1, 并按CPU分配连接.
+ACCEPT_BUDGET=64             # 监听socket每次可读事件最多accept的连接数.
+PLACEMENT=0                  # 新连接的IO线程选择. 0: 轮询; 1: 连接数最少; 2: 待发送字节最少; 3: 随机取两个选近期较闲者.
+REBALANCE=0                  # 每隔多少秒从连接数偏多的IO线程关闭空闲keep-alive连接, 使其重连后重新分配. 0关闭.
+SPIN_US=0                    # IO线程在最近一次活动后持续轮询(不阻塞)的微秒数, 以CPU换取尾延迟. 0关闭.
+BUSY_POLL_US=0               # 连接与epoll的内核忙轮询微秒数(SO_BUSY_POLL). 0关闭.
+METRICS=0                    # 每隔多少秒在日志中输出各IO线程的循环延迟直方图(p50/p99/max). 0关闭.
+TSC_CLOCK=0                  # 循环延迟统计是否以TSC计时. 1开启(CPU不支持invariant TSC时仍用CLOCK_MONOTONIC), 0关闭.
+TIMER_SLACK=0                # 定时器合并窗口毫秒数, 窗口内到期的定时器一次唤醒中执行. 0关闭.
+POLL_TIMER=0                 # 是否以poll超时代替timerfd驱动定时器. 1开启, 0关闭.
+CPU_LIST=""                  # 绑定的CPU, 如"0-3". 主线程绑定第一个, 各IO线程依次绑定其后的CPU. 为空时不绑定.
+CACHE_CONTROL=()             # 按后缀覆盖Cache-Control策略, 如(".css=max-age=3600" ".html=").
 LOG_ENABLE=0                 # 是否开启日志输出. 1开启, 0关闭.
 LOG_FNAME="HttpServerLog"    # 日志文件名(为空时将输出到stdout)
 LOG_DIR="./log"              # 日志目录
@@ -24,7 +47,41 @@ ARGS+=("-p" "$PORT")
 ARGS+=("-j" "$THREAD_NUM")
 ARGS+=("-r" "$ROOT_PATH")
 ARGS+=("-t" "$TIMEOUT")
+ARGS+=("-F" "$FIRST_BYTE_TIMEOUT")
+ARGS+=("-H" "$HEADER_TIMEOUT")
+ARGS+=("-m" "$MIN_BODY_RATE")
+ARGS+=("-w" "$MIN_SEND_RATE")
 ARGS+=("-c" "$MAX_CONN")
+ARGS+=("-C" "$FILE_CACHE")
+ARGS+=("-M" "$FILE_CACHE_MAX")
+ARGS+=("-Z" "$COMPRESS_CACHE")
+ARGS+=("-B" "$BUFFER_POOL")
+if (( EDGE_TRIGGER )); then
+    ARGS+=("-T" "-b" "$READ_BUDGET")
+fi
+if (( IO_URING )); then
+    ARGS+=("-U")
+fi
+ARGS+=("-A" "$ACCEPTOR_MODE")
+ARGS+=("-a" "$ACCEPT_BUDGET")
+ARGS+=("-P" "$PLACEMENT")
+ARGS+=("-W" "$REBALANCE")
+ARGS+=("-S" "$SPIN_US")
+ARGS+=("-Y" "$BUSY_POLL_US")
+ARGS+=("-D" "$METRICS")
+if (( TSC_CLOCK )); then
+    ARGS+=("-G")
+fi
+ARGS+=("-k" "$TIMER_SLACK")
+if (( POLL_TIMER )); then
+    ARGS+=("-o")
+fi
+if [[ -n "$CPU_LIST" ]]; then
+    ARGS+=("-K" "$CPU_LIST")
+fi
+for policy in "${CACHE_CONTROL[@]}"; do
+    ARGS+=("-E" "$policy")
+done
 if (( LOG_ENABLE )); then
     ARGS+=("-L")
     ARGS+=("-f" "$LOG_FNAME")
@@ -1,23 +1,29 @@
 #include "acceptor.h"
 
 #include <sys/socket.h>
+#include <linux/filter.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <cassert>
 
 #include "eventloop.h"
 #include "logger.h"
 
 using namespace std;
 
+const int Acceptor::kDefaultAcceptBudget;
+
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listen_addr)
     : loop_(loop),
     addr_(listen_addr), 
     sockfd_(createSocketAndBind()),
     accept_channel_(loop, sockfd_),
     listening_(false),
+    accept_budget_(kDefaultAcceptBudget),
     idlefd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
     accept_channel_.setReadCallback(bind(&Acceptor::handleAccept, this));
+    accept_channel_.setKind(LoopMetrics::kAcceptor); 
 }
 
 Acceptor::~Acceptor() {
@@ -41,9 +47,13 @@ int Acceptor::createSocketAndBind() {
         LOG_SYSFATAL << "Acceptor::createSocketAndBind() socket"; 
     }
 
+    // 两个选项须分别设置(选项名不能按位或).
     int optval = 1;
-    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &optval, sizeof(optval)) < 0) {
-        LOG_SYSFATAL << "Acceptor::createSocketAndBind() setsockopt"; 
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
+        LOG_SYSFATAL << "Acceptor::createSocketAndBind() setsockopt SO_REUSEADDR"; 
+    }
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) < 0) {
+        LOG_SYSFATAL << "Acceptor::createSocketAndBind() setsockopt SO_REUSEPORT"; 
     }
 
     if (bind(listen_fd, addr_.getSockAddr(), addr_.getAddrLen()) < 0) {
@@ -53,70 +63,142 @@ int Acceptor::createSocketAndBind() {
     return listen_fd;
 }
 
+bool Acceptor::attachCpuSteeringFilter(const vector<int>& socket_cpus) {
+    assert(!socket_cpus.empty()); 
+    uint32_t num_sockets = static_cast<uint32_t>(socket_cpus.size()); 
+    // A = 当前CPU编号; 依次比较各socket的CPU, 相等时返回其序号; 均不相等时 A %= num_sockets; return A
+    vector<struct sock_filter> code; 
+    code.push_back({ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) }); 
+    for (uint32_t i = 0; i < num_sockets; ++i) {
+        if (socket_cpus[i] < 0) {
+            continue; 
+        }
+        code.push_back({ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<uint32_t>(socket_cpus[i]) }); 
+        code.push_back({ BPF_RET | BPF_K, 0, 0, i }); 
+    }
+    code.push_back({ BPF_ALU | BPF_MOD | BPF_K, 0, 0, num_sockets }); 
+    code.push_back({ BPF_RET | BPF_A, 0, 0, 0 }); 
+    struct sock_fprog prog = { static_cast<unsigned short>(code.size()), code.data() }; 
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        LOG_SYSERR << "Acceptor::attachCpuSteeringFilter() setsockopt SO_ATTACH_REUSEPORT_CBPF"; 
+        return false; 
+    }
+    return true; 
+}
+
+bool Acceptor::setIncomingCpu(int cpu) {
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) {
+        LOG_SYSERR << "Acceptor::setIncomingCpu() setsockopt SO_INCOMING_CPU"; 
+        return false; 
+    }
+    return true; 
+}
+
 void Acceptor::listen() {
     loop_->assertInLoopThread(); 
     listening_ = true; 
     if (::listen(sockfd_, SOMAXCONN) < 0) {
         LOG_SYSFATAL << "Acceptor::listen() listen"; 
     }
+    if (loop_->supportsCompletion(Poller::Completion::ACCEPT)) {
+        accept_channel_.setCompletion(Poller::Completion::ACCEPT); 
+    }
     accept_channel_.enableReading(); 
 }
 
 
 void Acceptor::handleAccept() {
-    // 处理连接
+    // 处理连接: 循环accept直至EAGAIN或达到本轮上限. 
     loop_->assertInLoopThread();
-    InetAddress peer_addr; 
-    struct sockaddr_in6 sockaddr6; 
-    socklen_t addr6len = static_cast<socklen_t>(sizeof(sockaddr6)); 
-    memset(&sockaddr6, 0, addr6len); 
-    int connfd = ::accept4(sockfd_, InetAddress::sockAddrCast(&sockaddr6),
-        &addr6len, SOCK_NONBLOCK | SOCK_CLOEXEC);
-    if (connfd >= 0) {
+    if (accept_channel_.getCompletion() == Poller::Completion::ACCEPT) {
+        return handleAcceptCompleted(); 
+    }
+    int n_accepted = 0; 
+    while (n_accepted < accept_budget_) {
+        struct sockaddr_in6 sockaddr6; 
+        socklen_t addr6len = static_cast<socklen_t>(sizeof(sockaddr6)); 
+        memset(&sockaddr6, 0, addr6len); 
+        int connfd = ::accept4(sockfd_, InetAddress::sockAddrCast(&sockaddr6),
+            &addr6len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connfd < 0) {
+            handleAcceptError(); 
+            break; 
+        }
+        ++n_accepted; 
         if (newConnCallBack_) {
-            peer_addr.setSockAddrInet6(sockaddr6); 
+            InetAddress peer_addr(sockaddr6);   // 对端地址即accept4的结果
             newConnCallBack_(connfd, peer_addr);  // 执行新连接的回调
         } else {
             ::close(connfd); 
         }
-    } else {
-        LOG_SYSERR << "Acceptor::handleAccept() accept";
-        int saved_errno = errno;
-        switch (saved_errno)
-        {
-          case EAGAIN:
-          case ECONNABORTED:
-          case EINTR:
-          case EPROTO:
-          case EPERM:
-          case EMFILE: // per-process lmit of open file desctiptor ???
-            // expected errors
-            errno = saved_errno;
-            break;
-          case EBADF:
-          case EFAULT:
-          case EINVAL:
-          case ENFILE:
-          case ENOBUFS:
-          case ENOMEM:
-          case ENOTSOCK:
-          case EOPNOTSUPP:
-            // unexpected errors
-            LOG_FATAL << "unexpected error of ::accept " << saved_errno;
-            break; 
-          default:
-            LOG_FATAL << "unknown error of ::accept " << saved_errno;
-            break;
+    }
+    if (n_accepted > 0 && acceptBatchCallBack_) {
+        acceptBatchCallBack_(); 
+    }
+}
+
+void Acceptor::handleAcceptCompleted() {
+    // 至多取出accept_budget_个, 其余由Poller留待下一轮回调. 
+    int n_accepted = 0; 
+    int connfd; 
+    while (n_accepted < accept_budget_ && loop_->takeAccepted(&accept_channel_, &connfd, 1) == 1) {
+        if (connfd < 0) {
+            errno = -connfd; 
+            handleAcceptError(); 
+            continue; 
         }
-        // Read the section named "The special problem of
-        // accept()ing when you can't" in libev's doc.
-        // By Marc Lehmann, author of libev.
-        if (errno == EMFILE)
-        {
-          ::close(idlefd_);
-          idlefd_ = ::accept(sockfd_, NULL, NULL);
-          ::close(idlefd_);
-          idlefd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        ++n_accepted; 
+        if (newConnCallBack_) {
+            InetAddress peer_addr(InetAddress::getPeerAddrBySockfd(connfd));   // multishot accept不返回对端地址
+            newConnCallBack_(connfd, peer_addr); 
+        } else {
+            ::close(connfd); 
         }
     }
+    if (n_accepted > 0 && acceptBatchCallBack_) {
+        acceptBatchCallBack_(); 
+    }
+}
+
+void Acceptor::handleAcceptError() {
+    int saved_errno = errno;
+    if (saved_errno == EAGAIN) {   // 已接受全部等待中的连接
+        return; 
+    }
+    LOG_SYSERR << "Acceptor::handleAccept() accept";
+    switch (saved_errno)
+    {
+      case ECONNABORTED:
+      case EINTR:
+      case EPROTO:
+      case EPERM:
+      case EMFILE: // per-process lmit of open file desctiptor ???
+        // expected errors
+        errno = saved_errno;
+        break;
+      case EBADF:
+      case EFAULT:
+      case EINVAL:
+      case ENFILE:
+      case ENOBUFS:
+      case ENOMEM:
+      case ENOTSOCK:
+      case EOPNOTSUPP:
+        // unexpected errors
+        LOG_FATAL << "unexpected error of ::accept " << saved_errno;
+        break; 
+      default:
+        LOG_FATAL << "unknown error of ::accept " << saved_errno;
+        break;
+    }
+    // Read the section named "The special problem of
+    // accept()ing when you can't" in libev's doc.
+    // By Marc Lehmann, author of libev.
+    if (errno == EMFILE)
+    {
+      ::close(idlefd_);
+      idlefd_ = ::accept(sockfd_, NULL, NULL);
+      ::close(idlefd_);
+      idlefd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
 }
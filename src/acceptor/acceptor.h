@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <atomic>
+#include <vector>
 
 #include "channel.h"
 #include "inet_address.h"
@@ -11,22 +13,42 @@ class EventLoop;
 class Acceptor{ 
 public:
     using NewConnectionCallBack = std::function<void(int connfd, const InetAddress& addr)>; 
+    using AcceptBatchCallBack = std::function<void()>; 
+    static const int kDefaultAcceptBudget = 64; 
     Acceptor(EventLoop* loop, const InetAddress& listen_addr);
     ~Acceptor(); 
 
 public:
     void setNewConnCallback(const NewConnectionCallBack& cb); 
+    // 每次可读事件中接受的全部连接回调完成后调用一次, 供调用方批量转交新连接. 
+    void setAcceptBatchCallback(const AcceptBatchCallBack& cb) { acceptBatchCallBack_ = cb; }
+    // 每次可读事件最多接受的连接数, 其余留待下一轮(水平触发). 
+    void setAcceptBudget(int budget) { accept_budget_ = budget > 0 ? budget : 1; }
     int createSocketAndBind(); 
     void listen(); 
     bool isListening() const; 
     void handleAccept(); 
+    // 附加SO_ATTACH_REUSEPORT_CBPF程序: 按处理该连接的CPU选择reuseport组中的监听socket. 
+    // socket_cpus[i]为组中第i个socket所属IO线程绑定的CPU(未绑定为-1), 处理CPU与之相同时选择该socket; 
+    // 多个socket绑定同一CPU时取第一个, 不属于任何socket的CPU对socket数取模. 
+    // 失败时记录错误, 内核继续按四元组哈希分配. 
+    bool attachCpuSteeringFilter(const std::vector<int>& socket_cpus); 
+    // 设置监听socket的SO_INCOMING_CPU: reuseport组中优先选择与处理该连接的CPU一致的监听socket. 须在listen()之前调用.
+    bool setIncomingCpu(int cpu); 
     
+private:
+    // io_uring完成模式: 取出内核multishot accept的结果, 不再调用accept4. 
+    void handleAcceptCompleted(); 
+    void handleAcceptError(); 
+
 private:
     EventLoop* loop_; 
     InetAddress addr_; 
     int sockfd_; 
     Channel accept_channel_; 
     NewConnectionCallBack newConnCallBack_; 
+    AcceptBatchCallBack acceptBatchCallBack_; 
     std::atomic<bool> listening_; 
+    int accept_budget_; 
     int idlefd_;       // 用于处理文件描述符耗尽
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <getopt.h>
 #include <linux/limits.h>    // for PATH_MAX
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <unistd.h>
 
@@ -18,7 +19,30 @@ void Config::parseArgs(int argc, char* argv[]) {
         {"thread", required_argument, 0, 'j'},      // --thread <num_threads>
         {"path", required_argument, 0, 'r'},        // --path <web root path>
         {"timeout", required_argument, 0, 't'},     // --timeout <seconds>
+        {"firstbyte", required_argument, 0, 'F'},   // --firstbyte <seconds>
+        {"headertimeout", required_argument, 0, 'H'},  // --headertimeout <seconds>
+        {"bodyrate", required_argument, 0, 'm'},    // --bodyrate <bytes per second>
+        {"sendrate", required_argument, 0, 'w'},    // --sendrate <bytes per second>
         {"maxconn", required_argument, 0, 'c'},     // --maxconn <num>
+        {"filecache", required_argument, 0, 'C'},   // --filecache <bytes>
+        {"filecachemax", required_argument, 0, 'M'},  // --filecachemax <bytes>
+        {"compresscache", required_argument, 0, 'Z'}, // --compresscache <bytes>
+        {"cachecontrol", required_argument, 0, 'E'},  // --cachecontrol <.ext=policy>
+        {"bufferpool", required_argument, 0, 'B'},  // --bufferpool <bytes>
+        {"edge", no_argument, 0, 'T'},              // --edge
+        {"readbudget", required_argument, 0, 'b'},  // --readbudget <bytes>
+        {"iouring", no_argument, 0, 'U'},           // --iouring
+        {"reuseport", required_argument, 0, 'A'},   // --reuseport <mode>
+        {"acceptbudget", required_argument, 0, 'a'},  // --acceptbudget <num>
+        {"placement", required_argument, 0, 'P'},   // --placement <policy>
+        {"rebalance", required_argument, 0, 'W'},   // --rebalance <seconds>
+        {"cpus", required_argument, 0, 'K'},        // --cpus <cpu list>
+        {"spin", required_argument, 0, 'S'},        // --spin <microseconds>
+        {"busypoll", required_argument, 0, 'Y'},    // --busypoll <microseconds>
+        {"metrics", required_argument, 0, 'D'},     // --metrics <seconds>
+        {"tsc", no_argument, 0, 'G'},               // --tsc
+        {"timerslack", required_argument, 0, 'k'},  // --timerslack <milliseconds>
+        {"polltimer", no_argument, 0, 'o'},         // --polltimer
         {"log", no_argument, 0, 'L'},               // --log
         {"logfname", required_argument, 0, 'f'},    // --logfname <file_name>
         {"logdir", required_argument, 0, 'R'},      // --logdir <dir path>
@@ -28,7 +52,7 @@ void Config::parseArgs(int argc, char* argv[]) {
         {0, 0, 0, 0}  // 结束标志
     };
 
-    const char* optstring = "hi:p:j:r:t:c:Lf:R:l:s:u:";
+    const char* optstring = "hi:p:j:r:t:F:H:m:w:c:C:M:Z:E:B:Tb:UA:a:P:W:K:S:Y:D:Gk:oLf:R:l:s:u:";
     int opt;
     while ((opt = getopt_long(argc, argv, optstring, long_options, nullptr)) != -1) {
         switch (opt) {
@@ -41,7 +65,30 @@ void Config::parseArgs(int argc, char* argv[]) {
             case 'j': num_thread = stoi(optarg); break;
             case 'r': root_path_ = optarg; break;
             case 't': timeout_seconds_ = stoi(optarg); break;
+            case 'F': first_byte_timeout_seconds_ = stoi(optarg); break;
+            case 'H': header_timeout_seconds_ = stoi(optarg); break;
+            case 'm': min_body_rate_ = stoul(optarg); break;
+            case 'w': min_send_rate_ = stoul(optarg); break;
             case 'c': max_connections_ = stoi(optarg); break;
+            case 'C': file_cache_bytes_ = stoul(optarg); break;
+            case 'M': file_cache_max_file_bytes_ = stoul(optarg); break;
+            case 'Z': compress_cache_bytes_ = stoul(optarg); break;
+            case 'E': setCacheControl(optarg); break;
+            case 'B': buffer_pool_bytes_ = stoul(optarg); break;
+            case 'T': edge_triggered_ = true; break;
+            case 'b': read_budget_ = stoul(optarg); break;
+            case 'U': io_uring_ = true; break;
+            case 'A': setAcceptorMode(optarg); break;
+            case 'a': accept_budget_ = stoi(optarg); break;
+            case 'P': setPlacement(optarg); break;
+            case 'W': rebalance_seconds_ = stoi(optarg); break;
+            case 'K': setCpuList(optarg); break;
+            case 'S': spin_us_ = stoi(optarg); break;
+            case 'Y': busy_poll_us_ = stoi(optarg); break;
+            case 'D': metrics_seconds_ = stoi(optarg); break;
+            case 'G': tsc_clock_ = true; break;
+            case 'k': timer_slack_ms_ = stoi(optarg); break;
+            case 'o': poll_timeout_timers_ = true; break;
             case 'L': log_enable = true; break;
             case 'f': log_file_name_ = optarg; break;
             case 'R': log_dir_ = optarg; break;
@@ -68,8 +115,35 @@ void Config::printHelp(const char* program) const {
          << "  -p, --port <num>          Set server port (default: 8080)\n"
          << "  -j, --thread <num>        Set the number of IO threads(subReactors)\n"
          << "  -r, --path <dir>          Set the root path of Web resources\n"
-         << "  -t, --timeout <num>       Set the timeout seconds of http connection\n"
+         << "  -t, --timeout <num>       Set the seconds a keep-alive connection may wait for the next request. 0 to disable\n"
+         << "  -F, --firstbyte <num>     Set the seconds a new connection may wait for the first byte of a request. 0 to disable\n"
+         << "  -H, --headertimeout <num> Set the seconds to receive a whole request header, counted from its first byte. 0 to disable\n"
+         << "  -m, --bodyrate <num>      Set the minimum bytes per second of receiving a request body. 0 to disable\n"
+         << "  -w, --sendrate <num>      Set the minimum bytes per second of sending a response. 0 to disable\n"
          << "  -c, --maxconn <num>       Set the maximum amount of concurrent connections allowed\n"
+         << "  -C, --filecache <num>     Set the byte budget of static file cache. 0 to disable\n"
+         << "  -M, --filecachemax <num>  Set the max size in bytes of a single cached file\n"
+         << "  -Z, --compresscache <num> Set the byte budget of gzip/deflate results cache. 0 to disable\n"
+         << "  -E, --cachecontrol <.ext=policy>\n"
+         << "                            Set the Cache-Control of files with the suffix, e.g. \".css=max-age=3600\".\n"
+         << "                            Repeatable. An empty policy removes the suffix\n"
+         << "  -B, --bufferpool <num>    Set the max idle bytes retained by the buffer pool of each IO thread\n"
+         << "  -T, --edge                Set edge-triggered epoll for connections\n"
+         << "  -b, --readbudget <num>    Set the max bytes read from a connection per event in edge-triggered mode\n"
+         << "  -U, --iouring             Set io_uring instead of epoll for readiness polling, falls back to epoll if unavailable\n"
+         << "  -A, --reuseport <num>     Set the acceptor mode. 0: accept in main thread and dispatch (default),\n"
+         << "                            1: one SO_REUSEPORT listener per IO thread, 2: as 1 and steer connections by CPU\n"
+         << "  -a, --acceptbudget <num>  Set the max connections accepted per readable event of the listening socket\n"
+         << "  -P, --placement <num>     Set the IO thread placement of new connections. 0: round-robin (default),\n"
+         << "                            1: least connections, 2: least pending output bytes, 3: power-of-two choices on busy time\n"
+         << "  -W, --rebalance <num>     Set the interval seconds of shedding idle keep-alive connections from overloaded IO threads. 0 to disable\n"
+         << "  -K, --cpus <list>         Pin the main loop to the first CPU and IO thread i to the (i+1)-th, cycling, e.g. \"0-3,8\"\n"
+         << "  -S, --spin <num>          Set the microseconds IO threads keep polling without blocking after activity. 0 to disable\n"
+         << "  -Y, --busypoll <num>      Set SO_BUSY_POLL/SO_PREFER_BUSY_POLL microseconds on connections and epoll. 0 to disable\n"
+         << "  -D, --metrics <num>       Set the interval seconds of logging per-loop latency histograms (p50/p99/max). 0 to disable\n"
+         << "  -G, --tsc                 Set the TSC instead of CLOCK_MONOTONIC as the clock of loop metrics, if the CPU has an invariant TSC\n"
+         << "  -k, --timerslack <num>    Set the milliseconds window in which timers fire together. 0 to disable\n"
+         << "  -o, --polltimer           Drive timers by the poll timeout instead of a timerfd\n"
          << "  -L, --log                 Set enable the log output\n"
          << "  -f, --logfname <name>     Set the name of log file. When empty, logging to stdout\n"
          << "  -R, --logdir <dir>        Set the dir of log file.\n"
@@ -90,6 +164,71 @@ void Config::setLogLevel(const char* loglevel) {
     }
 }
 
+void Config::setAcceptorMode(const char* mode) {
+    int idx = stoi(mode); 
+    if (idx < 0 || idx > 2) {
+        cerr << "Config::setAcceptorMode invalid mode: " << mode << endl; 
+        exit(1); 
+    }
+    reuse_port_ = idx >= 1; 
+    cpu_steering_ = idx == 2; 
+}
+
+void Config::setPlacement(const char* placement) {
+    int idx = stoi(placement); 
+    if (idx < 0 || idx > 3) {
+        cerr << "Config::setPlacement invalid placement: " << placement << endl; 
+        exit(1); 
+    }
+    placement_ = static_cast<EventLoopThreadPool::Placement>(idx); 
+}
+
+void Config::setCpuList(const char* list) {
+    // 格式: 以逗号分隔的CPU编号或闭区间, 如"0,2-5".
+    cpus_.clear(); 
+    string arg = list; 
+    string::size_type start = 0; 
+    while (start <= arg.size()) {
+        string::size_type end = arg.find(',', start); 
+        if (end == string::npos) {
+            end = arg.size(); 
+        }
+        string item = arg.substr(start, end - start); 
+        string::size_type dash = item.find('-'); 
+        try {
+            int first = stoi(item.substr(0, dash)); 
+            int last = dash == string::npos ? first : stoi(item.substr(dash + 1)); 
+            if (first < 0 || last < first) {
+                throw invalid_argument(item); 
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus_.push_back(cpu); 
+            }
+        } catch (const exception&) {
+            cerr << "Config::setCpuList invalid cpu list: " << arg << endl; 
+            exit(1); 
+        }
+        start = end + 1; 
+    }
+}
+
+void Config::setCacheControl(const char* policy) {
+    // 格式: ".ext=policy", policy为空时移除该后缀的策略.
+    string arg = policy; 
+    string::size_type pos = arg.find('='); 
+    if (pos == string::npos || pos == 0 || arg[0] != '.') {
+        cerr << "Config::setCacheControl invalid policy: " << arg << endl; 
+        exit(1); 
+    }
+    string suffix = arg.substr(0, pos); 
+    string value = arg.substr(pos + 1); 
+    if (value.empty()) {
+        cache_control_.erase(suffix); 
+    } else {
+        cache_control_[suffix] = value; 
+    }
+}
+
 string Config::ensureAbsoluteRootPath(string path) {
     // 若为相对路径, 则加上cwd作为前缀. 
     if (!(!path.empty() && path[0] == '/')) {
@@ -117,8 +256,41 @@ void Config::printArgs() const {
          << "  port: " << port << "\n"
          << "  the number of IO threads: "  << num_thread << "\n"
          << "  the web root path: " << root_path_ << "\n"
-         << "  the timeout seconds of http connection: " << (timeout_seconds_ > 0 ? to_string(timeout_seconds_) : "disable") << "\n"
+         << "  timeouts: keep-alive " << (timeout_seconds_ > 0 ? to_string(timeout_seconds_) + "s" : "disable")
+         << ", first byte " << (first_byte_timeout_seconds_ > 0 ? to_string(first_byte_timeout_seconds_) + "s" : "disable")
+         << ", header " << (header_timeout_seconds_ > 0 ? to_string(header_timeout_seconds_) + "s" : "disable") << "\n"
+         << "  minimum transfer rates: body " << (min_body_rate_ > 0 ? to_string(min_body_rate_) + "B/s" : "disable")
+         << ", send " << (min_send_rate_ > 0 ? to_string(min_send_rate_) + "B/s" : "disable") << "\n"
          << "  the maximum amount of concurrent connections: " << max_connections_ << "\n"
+         << "  the static file cache bytes: " << (file_cache_bytes_ > 0 ? to_string(file_cache_bytes_) : "disable") << "\n"
+         << "  the max bytes of a single cached file: " << file_cache_max_file_bytes_ << "\n"
+         << "  the compressed results cache bytes: " << (compress_cache_bytes_ > 0 ? to_string(compress_cache_bytes_) : "disable") << "\n"
+         << "  the buffer pool bytes per IO thread: " << buffer_pool_bytes_ << "\n"
+         << "  epoll trigger mode: " << (edge_triggered_ ? "edge, read budget " + to_string(read_budget_) : string("level")) << "\n"
+         << "  poller backend: " << (io_uring_ ? "io_uring" : "epoll") << "\n"
+         << "  acceptor: " << (reuse_port_ ? (cpu_steering_ ? "SO_REUSEPORT per IO thread, steered by CPU" : "SO_REUSEPORT per IO thread") : "main thread") 
+         << ", accept budget " << accept_budget_ << "\n"
+         << "  connection placement: " << EventLoopThreadPool::getPlacementName(placement_) 
+         << ", rebalance interval: " << (rebalance_seconds_ > 0 ? to_string(rebalance_seconds_) + "s" : "disable") << "\n"
+         << "  cpu affinity:";
+    if (cpus_.empty()) {
+        cout << " disable"; 
+    }
+    for (int cpu : cpus_) {
+        cout << " " << cpu; 
+    }
+    cout << "\n"
+         << "  spin after activity: " << (spin_us_ > 0 ? to_string(spin_us_) + "us" : "disable") 
+         << ", kernel busy poll: " << (busy_poll_us_ > 0 ? to_string(busy_poll_us_) + "us" : "disable") << "\n"
+         << "  loop metrics log interval: " << (metrics_seconds_ > 0 ? to_string(metrics_seconds_) + "s" : "disable") 
+         << ", clock: " << (tsc_clock_ ? "tsc" : "monotonic") << "\n"
+         << "  timer slack: " << (timer_slack_ms_ > 0 ? to_string(timer_slack_ms_) + "ms" : "disable") 
+         << ", timer source: " << (poll_timeout_timers_ ? "poll timeout" : "timerfd") << "\n"
+         << "  cache control:";
+    for (auto& policy : cache_control_) {
+        cout << " " << policy.first << "=\"" << policy.second << "\"";
+    }
+    cout << "\n"
          << "  log enable: " << log_enable << "\n";
     
     if (!log_enable) return;
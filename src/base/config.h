@@ -2,8 +2,11 @@
 
 #include <cstddef>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <logger.h>
+#include "eventloop_threadpool.h"
 
 class Config {
 public:
@@ -16,6 +19,10 @@ private:
     void printHelp(const char* program) const; 
 
     void setLogLevel(const char* loglevel);
+    void setCacheControl(const char* policy);
+    void setAcceptorMode(const char* mode);
+    void setPlacement(const char* placement);
+    void setCpuList(const char* list);
     std::string ensureAbsoluteRootPath(std::string path);
     
 public:
@@ -27,10 +34,65 @@ public:
     int num_thread = 5;
     // Web资源文件根目录
     std::string root_path_ = "./resources";
-    // HttpConnection的超时时间
+    // keep-alive连接等待下一个请求的超时秒数(为0时不限制, 下同)
     int timeout_seconds_ = 30;
+    // 新连接等待首个请求第一个字节的超时秒数
+    int first_byte_timeout_seconds_ = 10; 
+    // 自请求的第一个字节起接收完请求行与头部的超时秒数, 期间收到数据也不延长
+    int header_timeout_seconds_ = 20; 
+    // 接收请求消息体、发送响应的最低速率(字节/秒), 每个检查周期内未达到时断开连接
+    size_t min_body_rate_ = 500; 
+    size_t min_send_rate_ = 500; 
     // 允许的最大连接数量
     size_t max_connections_ = 10000; 
+    // 静态资源文件缓存的字节上限(为0时不启用缓存)
+    size_t file_cache_bytes_ = 64 * 1024 * 1024;    // 64MB
+    // 允许被缓存的单个文件的字节上限
+    size_t file_cache_max_file_bytes_ = 4 * 1024 * 1024;  // 4MB
+    // 即时压缩(gzip/deflate)结果缓存的字节上限(为0时仅使用预压缩文件)
+    size_t compress_cache_bytes_ = 16 * 1024 * 1024;  // 16MB
+    // 是否以边缘触发方式监听连接socket
+    bool edge_triggered_ = false; 
+    // 边缘触发时单个连接每次可读事件的读取字节上限
+    size_t read_budget_ = 256 * 1024;  // 256KB
+    // 是否以io_uring替代epoll监听就绪事件(内核不支持时退回epoll)
+    bool io_uring_ = false; 
+    // 是否每个IO线程各自监听同一端口(SO_REUSEPORT), 由内核分配新连接
+    bool reuse_port_ = false; 
+    // reuseport模式下是否按处理连接的CPU选择IO线程(SO_ATTACH_REUSEPORT_CBPF)
+    bool cpu_steering_ = false; 
+    // 监听socket每次可读事件最多accept的连接数
+    int accept_budget_ = 64; 
+    // 新连接的IO线程选择策略
+    EventLoopThreadPool::Placement placement_ = EventLoopThreadPool::Placement::ROUND_ROBIN; 
+    // 从连接数超出平均值的IO线程半关闭空闲keep-alive连接的间隔秒数(为0时不启用)
+    int rebalance_seconds_ = 0; 
+    // 绑定的CPU: 主线程绑定第一个, 第i个IO线程绑定第i+1个(循环使用). 为空时不绑定
+    std::vector<int> cpus_; 
+    // IO线程在最近一次活动后不阻塞、持续轮询的微秒数(为0时不自旋)
+    int spin_us_ = 0; 
+    // 连接与epoll的内核忙轮询微秒数(SO_BUSY_POLL, 为0时不启用)
+    int busy_poll_us_ = 0; 
+    // 在日志中输出各IO线程循环延迟直方图的间隔秒数(为0时不输出)
+    int metrics_seconds_ = 0; 
+    // 循环延迟统计以TSC计时(CPU不支持invariant TSC时仍使用CLOCK_MONOTONIC)
+    bool tsc_clock_ = false; 
+    // 定时器的合并窗口毫秒数, 窗口内到期的定时器一次唤醒中执行(为0时不合并)
+    int timer_slack_ms_ = 0; 
+    // 以poll超时代替timerfd驱动定时器
+    bool poll_timeout_timers_ = false; 
+    // 每个IO线程的Buffer缓冲池保留空闲存储的字节上限(为0时不保留)
+    size_t buffer_pool_bytes_ = 4 * 1024 * 1024;  // 4MB
+    // 按文件后缀设定静态资源的Cache-Control策略(未列出的后缀不发送该头部)
+    std::unordered_map<std::string, std::string> cache_control_ = {
+        {".html", "no-cache"},
+        {".css",  "public, max-age=86400"},
+        {".js",   "public, max-age=86400"},
+        {".png",  "public, max-age=604800"},
+        {".jpg",  "public, max-age=604800"},
+        {".jpeg", "public, max-age=604800"},
+        {".gif",  "public, max-age=604800"},
+    };
     // 是否输出日志
     bool log_enable = false;    // 默认不输出
     // 日志文件名
@@ -51,6 +51,13 @@ InetAddress::InetAddress(string ip, uint16_t port, bool ipv6) {
     }
 }
 
+bool InetAddress::isWildcard() const {
+    if (addr_.sin_family == AF_INET6) {
+        return addr6_.sin6_port == 0 || IN6_IS_ADDR_UNSPECIFIED(&addr6_.sin6_addr); 
+    }
+    return addr_.sin_port == 0 || addr_.sin_addr.s_addr == htonl(INADDR_ANY); 
+}
+
 string InetAddress::getIpPortString() const {
     return getIpString() + ":" + to_string(getPort()); 
 }
@@ -21,6 +21,8 @@ public:
     uint32_t ipv4NetEndian() const { return addr_.sin_addr.s_addr; }
     uint16_t portNetEndian() const { return addr_.sin_port; }
     const struct sockaddr* getSockAddr() const;
+    // IP为INADDR_ANY/in6addr_any或端口为0, 即不能代表已建立连接的本端地址.
+    bool isWildcard() const;
 
     static struct sockaddr* sockAddrCast(struct sockaddr_in* addr);
     static struct sockaddr* sockAddrCast(struct sockaddr_in6* addr);
@@ -1,7 +1,12 @@
 #include "thread.h"
 
 #include <cassert>
+#include <cerrno>
+#include <linux/mempolicy.h>   // for MPOL_LOCAL
+#include <pthread.h>
+#include <sched.h>
 #include <sys/prctl.h>   // for prctl(), 设置linux线程名. 
+#include <sys/syscall.h>
 #include <unistd.h>
 
 
@@ -26,6 +31,28 @@ void cachedTid() {
 bool isMainThread() {
     return getTid() == ::getpid();  // 主线程的gettid()即为getpid()进程id.
 }
+
+bool bindToCpu(int cpu, int* node_out) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        errno = EINVAL; 
+        return false; 
+    }
+    cpu_set_t cpuset; 
+    CPU_ZERO(&cpuset); 
+    CPU_SET(cpu, &cpuset); 
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset); 
+    if (ret != 0) {
+        errno = ret;   // 供调用方以LOG_SYSERR记录
+        return false; 
+    }
+    // 进程可能继承了其他策略(如numactl --interleave), 显式设为本地分配. 单节点或不支持时失败无影响.
+    ::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0); 
+    if (node_out) {
+        unsigned int cur_cpu = 0, node = 0; 
+        *node_out = ::getcpu(&cur_cpu, &node) == 0 ? static_cast<int>(node) : -1; 
+    }
+    return true; 
+}
     
 } // namespace CurrentThread
 
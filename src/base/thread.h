@@ -31,6 +31,10 @@ inline int tidStringLength() { return t_tid_string_len; }
 
 inline const char* name() { return t_thread_name; }
 
+// 将当前线程绑定到指定CPU, 并将内存分配策略设为本地节点(MPOL_LOCAL), 
+// 此后由该线程首次访问的内存位于该CPU所在的NUMA节点. 成功时返回true, node_out为该CPU所在节点.
+bool bindToCpu(int cpu, int* node_out = nullptr); 
+
 }  // namespace CurrentThread
 
 
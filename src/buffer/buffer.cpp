@@ -1,18 +1,25 @@
 #include "buffer.h"
 
 #include <bits/types/struct_iovec.h>
+#include <algorithm>
 #include <cassert>
 
+#include "buffer_pool.h"
+
 using namespace std; 
 
+// 无存储时begin()返回的占位地址, 使peek()/beginWrite()仍为有效指针.
+static char kEmptyStorage[Buffer::kCheapPrepent]; 
+
 
 const size_t Buffer::kInitialSize; 
 const size_t Buffer::kCheapPrepent; 
 
 Buffer::Buffer(size_t init_size) 
-    : buffer_(init_size + kCheapPrepent), 
+    : buffer_(init_size > 0 ? init_size + kCheapPrepent : 0), 
     read_pos_(kCheapPrepent), 
-    write_pos_(kCheapPrepent) 
+    write_pos_(kCheapPrepent),
+    pool_(nullptr)
 {
     assert(readableBytes() == 0);
     assert(writableBytes() == init_size);
@@ -31,7 +38,7 @@ size_t Buffer::readableBytes() const {
 }
 
 size_t Buffer::writableBytes() const {
-    return buffer_.size() - write_pos_; 
+    return buffer_.empty() ? 0 : buffer_.size() - write_pos_; 
 }
 
 size_t Buffer::prependableBytes() const {
@@ -39,11 +46,11 @@ size_t Buffer::prependableBytes() const {
 }
 
 char* Buffer::begin() {
-    return buffer_.data(); 
+    return buffer_.empty() ? kEmptyStorage : buffer_.data(); 
 }
 
 const char* Buffer::begin() const {
-    return buffer_.data(); 
+    return buffer_.empty() ? kEmptyStorage : buffer_.data(); 
 }
 
 const char* Buffer::peek() const {
@@ -127,8 +134,33 @@ void Buffer::ensureWriteable(size_t len) {
     assert(writableBytes() >= len); 
 }
 
+void Buffer::releaseStorage() {
+    assert(readableBytes() == 0); 
+    if (pool_) {
+        pool_->release(std::move(buffer_)); 
+    } else {
+        vector<char>().swap(buffer_); 
+    }
+    read_pos_ = kCheapPrepent;
+    write_pos_ = kCheapPrepent;
+}
+
 void Buffer::makeSpace(size_t len) {
-    if (writableBytes() + prependableBytes() < len + kCheapPrepent) {
+    if (pool_ && writableBytes() + prependableBytes() < len + kCheapPrepent) {
+        // 从缓冲池获取足够大的存储, 迁移可读数据后归还旧存储. 
+        size_t readable = readableBytes(); 
+        size_t min_size = kCheapPrepent + readable + len; 
+        if (min_size > BufferPool::kClassSizes[BufferPool::kNumClasses - 1]) {
+            // 超过最大级别的存储不经缓冲池, 按倍数增长, 与vector扩容一样均摊迁移数据的开销. 
+            min_size = max(min_size, 2 * buffer_.size()); 
+        }
+        vector<char> storage = pool_->acquire(min_size); 
+        std::copy(peek(), peek() + readable, storage.data() + kCheapPrepent); 
+        pool_->release(std::move(buffer_)); 
+        buffer_ = std::move(storage); 
+        read_pos_ = kCheapPrepent;
+        write_pos_ = read_pos_ + readable;
+    } else if (writableBytes() + prependableBytes() < len + kCheapPrepent) {
         buffer_.resize(write_pos_ + len);   // 扩容. 
     } else {
         // move readable data to the front, make space inside buffer. 
@@ -144,16 +176,20 @@ void Buffer::makeSpace(size_t len) {
 ssize_t Buffer::readFd(int fd, int* save_errno) {
     // scatter read. 临时利用栈空间作为一部分输入缓冲区, 使得输入缓冲区足够大, 减少系统调用. 
     char extrabuf[65536];
+    return readFd(fd, save_errno, extrabuf, sizeof(extrabuf)); 
+}
+
+ssize_t Buffer::readFd(int fd, int* save_errno, char* extrabuf, size_t extrabuf_len) {
     struct iovec iov[2]; 
     const size_t writable = writableBytes(); 
     iov[0].iov_base = beginWrite();
     iov[0].iov_len = writable;  
     iov[1].iov_base = extrabuf;
-    iov[1].iov_len = sizeof(extrabuf);  
+    iov[1].iov_len = extrabuf_len;  
 
-    // 只调用了一次read而没有反复read直至返回EAGAIN, 要求是level trigger, 否则可能丢失数据. 
-    // 如果buffer_中可写入空间>=extrabuf, 意味着已有64KB. 写一个就足够. 
-    const int iovcnt = writable < sizeof(extrabuf) ? 2 : 1; 
+    // 只调用一次readv. 水平触发下未读完的数据会再次通知; 边缘触发时由调用方反复读取直至EAGAIN. 
+    // 如果buffer_中可写入空间>=extrabuf, 写一个就足够. 
+    const int iovcnt = writable < extrabuf_len ? 2 : 1; 
     const ssize_t n = readv(fd, iov, iovcnt);  
     if (n < 0) {
         *save_errno = errno;
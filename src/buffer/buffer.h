@@ -4,6 +4,8 @@
 #include <string>
 #include <sys/uio.h>
 
+class BufferPool; 
+
 /* muduo中buffer的简化实现.
  * 
  * 使用`vector<char>`作为缓冲区, 因此支持自动扩容. 由此需要注意:
@@ -14,6 +16,11 @@
  * 注:
  * BeginStr_()重载了一个const的版本, 是在其他const成员函数中会需要被调用(例如Peek中), 这就要求const重载. 
  * 
+ * 缓冲池:
+ * 设置BufferPool后, 扩容时从缓冲池按大小级别获取新存储, 旧存储归还缓冲池; 
+ * releaseStorage()可在无可读数据时归还全部存储, 下次写入时再按需获取. 
+ * init_size为0时不预先分配存储. 
+ * 
  * FAQ:
  * 为什么需要封装Retrieve函数和HasWritten函数, 单独来移动pos, 而不是直接移动? 
  */
@@ -37,7 +44,7 @@ public:
     explicit Buffer(size_t init_size = kInitialSize); 
     ~Buffer() = default;  
 
-    void swap(Buffer& rhs); 
+    void swap(Buffer& rhs);   // 仅交换数据, 不交换所属缓冲池
 
     size_t writableBytes() const;       // 缓冲区中可写的字节数
     size_t readableBytes() const;       // 缓冲区中可读的字节数
@@ -62,7 +69,16 @@ public:
     void append(const void* data, size_t len);  
     void append(struct iovec vector[], size_t iovcnt); 
 
+    // 设置缓冲池(仅限缓冲池所属线程使用). 为nullptr时直接分配/释放存储.
+    void setPool(BufferPool* pool) { pool_ = pool; }
+    bool hasStorage() const { return !buffer_.empty(); }
+    size_t capacity() const { return buffer_.size(); }
+    // 释放底层存储(要求无可读数据), 设置了缓冲池时归还缓冲池. 
+    void releaseStorage(); 
+
     ssize_t readFd(int fd, int* save_errno);     // 从fd中读取到缓冲区
+    // 同上, 以调用方提供的extrabuf(如EventLoop共用的临时缓冲区)承接超出可写空间的数据.
+    ssize_t readFd(int fd, int* save_errno, char* extrabuf, size_t extrabuf_len); 
     // ssize_t WriteFd(int fd, int* save_errno);    // 向fd中写入缓冲区内容. 
 
 public:
@@ -77,4 +93,5 @@ private:
     std::vector<char> buffer_;
     std::size_t read_pos_;
     std::size_t write_pos_; 
+    BufferPool* pool_; 
 };
\ No newline at end of file
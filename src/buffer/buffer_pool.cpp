@@ -0,0 +1,79 @@
+#include "buffer_pool.h"
+
+using namespace std;
+
+const size_t BufferPool::kNumClasses;
+const size_t BufferPool::kClassSizes[kNumClasses] = { 1024, 4 * 1024, 16 * 1024, 64 * 1024 };
+const size_t BufferPool::kDefaultCapacity;
+
+
+BufferPool::BufferPool(size_t capacity_bytes)
+    : capacity_(capacity_bytes),
+    stats_{0, 0, 0, 0, 0}
+{
+}
+
+
+size_t BufferPool::classIndex(size_t size) {
+    size_t i = 0;
+    while (i < kNumClasses && kClassSizes[i] < size) {
+        ++i;
+    }
+    return i;
+}
+
+
+vector<char> BufferPool::acquire(size_t min_size) {
+    size_t idx = classIndex(min_size);
+    if (idx == kNumClasses) {   // 超过最大级别, 不经缓冲池
+        ++stats_.misses;
+        return vector<char>(min_size);
+    }
+    auto& list = free_[idx];
+    if (!list.empty()) {
+        vector<char> storage = std::move(list.back());
+        list.pop_back();
+        stats_.retained_bytes -= storage.size();
+        ++stats_.hits;
+        return storage;
+    }
+    ++stats_.misses;
+    return vector<char>(kClassSizes[idx]);
+}
+
+
+void BufferPool::release(vector<char>&& storage) {
+    if (storage.empty()) {
+        return;
+    }
+    ++stats_.releases;
+    size_t idx = classIndex(storage.size());
+    if (idx == kNumClasses || kClassSizes[idx] != storage.size() ||
+        stats_.retained_bytes + storage.size() > capacity_)
+    {
+        ++stats_.drops;
+        vector<char>().swap(storage);
+        return;
+    }
+    stats_.retained_bytes += storage.size();
+    free_[idx].push_back(std::move(storage));
+    storage.clear();   // 移动后的状态未指定, 显式置空
+}
+
+
+void BufferPool::setCapacity(size_t capacity_bytes) {
+    capacity_ = capacity_bytes;
+    trim();
+}
+
+
+void BufferPool::trim() {
+    // 自大级别起释放, 直至不超过上限.
+    for (size_t i = kNumClasses; i > 0 && stats_.retained_bytes > capacity_; --i) {
+        auto& list = free_[i - 1];
+        while (!list.empty() && stats_.retained_bytes > capacity_) {
+            stats_.retained_bytes -= list.back().size();
+            list.pop_back();
+        }
+    }
+}
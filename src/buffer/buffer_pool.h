@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Buffer底层存储的对象池, 每个EventLoop持有一个, 仅在所属IO线程中使用, 无需加锁.
+ *
+ * - 按大小分级(1KB/4KB/16KB/64KB), 获取时返回不小于所需大小的最小级别; 超过最大级别时直接分配, 归还时释放.
+ * - 空闲存储的总字节数受capacity限制, 超出时归还的存储直接释放, 避免峰值过后长期占用内存.
+ * - TcpConnection仅在有待处理数据时持有存储, 空闲时归还, 故常驻内存与活跃连接数而非打开连接数相关.
+ */
+class BufferPool {
+public:
+    struct Stats {
+        uint64_t hits;          // 由空闲存储满足的获取次数
+        uint64_t misses;        // 新分配的次数
+        uint64_t releases;      // 归还次数
+        uint64_t drops;         // 归还时因超出上限或大小不合级别而释放的次数
+        size_t retained_bytes;  // 当前空闲存储的总字节数
+    };
+
+public:
+    explicit BufferPool(size_t capacity_bytes = kDefaultCapacity);
+    ~BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // 返回size()不小于min_size的存储.
+    std::vector<char> acquire(size_t min_size);
+    // 归还存储, storage随后被置空.
+    void release(std::vector<char>&& storage);
+
+    void setCapacity(size_t capacity_bytes);
+    size_t getCapacity() const { return capacity_; }
+    const Stats& getStats() const { return stats_; }
+
+public:
+    static const size_t kNumClasses = 4;
+    static const size_t kClassSizes[kNumClasses];
+    static const size_t kDefaultCapacity = 4 * 1024 * 1024;   // 每个EventLoop 4MB
+
+private:
+    // 返回不小于size的最小级别, 超过最大级别时返回kNumClasses.
+    static size_t classIndex(size_t size);
+    void trim();
+
+private:
+    size_t capacity_;
+    std::vector<std::vector<char>> free_[kNumClasses];
+    Stats stats_;
+};
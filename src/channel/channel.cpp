@@ -15,8 +15,15 @@ Channel::Channel(EventLoop* loop, int fd)
     fd_(fd), 
     events_(0), 
     revents_(0),
+    registered_events_(0),
+    update_pending_(false),
+    edge_triggered_(false),
+    completion_(Poller::Completion::NONE),
+    readable_(false),
+    writable_(true),     // 新建立的socket发送缓冲区为空
     event_handling(false),
     state_(StateInEpoll::NOT_EXIST),
+    kind_(LoopMetrics::kOther),
     tied_(false)
 {
 
@@ -51,7 +58,7 @@ void Channel::tie(const std::shared_ptr<void>& obj) {
     tied_ = true;
 }
 
-void Channel::handleEvents(Timestamp receive_time) {
+void Channel::handleEvents(MonoTimestamp receive_time) {
     std::shared_ptr<void> gurad;
     if (tied_) {
         // 若tie_对象仍存在, 则保证其在handleEvents执行期间存活, 不被销毁.
@@ -62,7 +69,7 @@ void Channel::handleEvents(Timestamp receive_time) {
     }
 }
 
-void Channel::handleEventWithGuard(Timestamp receive_time) {
+void Channel::handleEventWithGuard(MonoTimestamp receive_time) {
     event_handling = true; 
     LOG_TRACE << reventsToString(); 
     if (revents_ & EPOLLERR) {
@@ -74,11 +81,13 @@ void Channel::handleEventWithGuard(Timestamp receive_time) {
     }
 
     if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) { // 可读, 带外数据可读, 对端半关闭(可读EOF)
+        readable_ = true; 
         if (readCallback_) readCallback_(receive_time); 
     }
 
-    if (revents_ & EPOLLOUT) {  // 可写
-        if (writeCallback_) writeCallback_(); 
+    if (revents_ & EPOLLOUT) {  // 可写. 边缘触发时EPOLLOUT始终注册, 仅在关心可写事件时回调.
+        writable_ = true; 
+        if (isWriting() && writeCallback_) writeCallback_(); 
     }
     event_handling = false; 
 }
@@ -121,6 +130,23 @@ bool Channel::isNoneEvent() const {
     return events_ == kNoneEvent; 
 }
 
+int Channel::getEpollEvents() const {
+    if (!edge_triggered_ || events_ == kNoneEvent) {
+        return events_; 
+    }
+    return (events_ & kReadEvent) | kWriteEvent | EPOLLRDHUP | EPOLLET; 
+}
+
+void Channel::setEdgeTriggered(bool on) {
+    assert(state_ == StateInEpoll::NOT_EXIST); 
+    edge_triggered_ = on; 
+}
+
+void Channel::setCompletion(Poller::Completion mode) {
+    assert(state_ == StateInEpoll::NOT_EXIST); 
+    completion_ = mode; 
+}
+
 
 void Channel::updateInEpoller() {
     loop_->updateChannelInEpoller(this);
@@ -165,6 +191,7 @@ string Channel::eventsToString(int fd, int ev) {
     if (ev & EPOLLHUP) oss << "EPOLLHUP ";
     if (ev & EPOLLRDHUP) oss << "EPOLLRDHUP ";
     if (ev & EPOLLERR) oss << "EPOLLERR ";
+    if (ev & EPOLLET) oss << "EPOLLET ";
     return oss.str();
 }
 
@@ -4,22 +4,32 @@
 #include <functional>
 #include <memory>
 
+#include "loop_metrics.h"
+#include "poller.h"
 #include "timestamp.h"
 
 class EventLoop;
 
+/* 触发方式:
+ * - 水平触发(默认): 按enableReading()/enableWriting()设定的监听集注册epoll, 
+ *   写积压出现/清空时需epoll_ctl(MOD)增删EPOLLOUT. 修改由Epoller暂存至下次epoll_wait前统一提交, 
+ *   同一轮内开启又关闭(如响应略大于发送缓冲区)时相互抵消, 不产生系统调用. 
+ * - 边缘触发(setEdgeTriggered): 一次注册EPOLLIN|EPOLLOUT|EPOLLET, 此后enableWriting()/disableWriting()
+ *   仅改变是否关心可写事件, 不再调用epoll_ctl. 由于就绪通知只在状态变化时到达一次, 
+ *   Channel记录读/写就绪状态, 持有者须读/写至EAGAIN后调用setReadable(false)/setWritable(false). 
+ */
 class Channel {
 public:
     // 标记channel在Epoller中的注册状态: 未持有/已注册监听/已持有但监听
     enum class StateInEpoll { NOT_EXIST = 0, LISTENING, DETACHED };
     using Callback = std::function<void()>; 
-    using ReadCallback = std::function<void(Timestamp)>;
+    using ReadCallback = std::function<void(MonoTimestamp)>;
 
 public:
     Channel(EventLoop* loop, int fd);
     ~Channel(); 
     void setRevents(int evt); 
-    void handleEvents(Timestamp receive_time);
+    void handleEvents(MonoTimestamp receive_time);
     int getFd() const; 
     int getEvents() const; 
     EventLoop* getOwnerLoop() const;
@@ -34,6 +44,29 @@ public:
     bool isWriting() const;
     bool isReading() const; 
     bool isNoneEvent() const; 
+    // 实际注册到epoll的事件集
+    int getEpollEvents() const; 
+    // 由Poller维护: 最近一次注册(epoll_ctl或io_uring poll请求)的事件集, 以及是否有尚未提交的修改.
+    int getRegisteredEvents() const { return registered_events_; }
+    void setRegisteredEvents(int events) { registered_events_ = events; }
+    bool isUpdatePending() const { return update_pending_; }
+    void setUpdatePending(bool on) { update_pending_ = on; }
+
+    // 须在首次注册到epoll之前设置.
+    void setEdgeTriggered(bool on); 
+    bool isEdgeTriggered() const { return edge_triggered_; }
+    // io_uring完成模式(见Poller), 须在首次注册到Poller之前设置. 
+    void setCompletion(Poller::Completion mode); 
+    Poller::Completion getCompletion() const { return completion_; }
+    // 读/写就绪状态. 收到EPOLLIN/EPOLLOUT时置为true, 由持有者在遇到EAGAIN时置为false.
+    bool isReadable() const { return readable_; }
+    bool isWritable() const { return writable_; }
+    void setReadable(bool on) { readable_ = on; }
+    void setWritable(bool on) { writable_ = on; }
+
+    // channel的类型, EventLoop据此分类记录handleEvents的耗时(LoopMetrics::callback_us). 默认为kOther.
+    void setKind(LoopMetrics::Kind kind) { kind_ = kind; }
+    LoopMetrics::Kind getKind() const { return kind_; }
 
     void setReadCallback(ReadCallback cb);
     void setWriteCallback(Callback cb); 
@@ -46,7 +79,7 @@ public:
 
 private:
     void updateInEpoller();    // add or mod
-    void handleEventWithGuard(Timestamp receive_time);
+    void handleEventWithGuard(MonoTimestamp receive_time);
     // for debug
     static std::string eventsToString(int fd, int ev); 
     std::string reventsToString() const;
@@ -66,8 +99,15 @@ private:
     const int fd_;        // 始终只关联于一个fd.
     int events_;          // bit pattern: 监听事件集
     int revents_;         // bit pattern: 当前活跃事件集
+    int registered_events_;  // 最近一次注册到epoll的事件集, 未变化时省去epoll_ctl
+    bool update_pending_;    // 事件集的修改已暂存于Epoller, 待下次epoll_wait前提交
+    bool edge_triggered_; 
+    Poller::Completion completion_; 
+    bool readable_; 
+    bool writable_; 
     bool event_handling;  
     StateInEpoll state_;  // 该channel在epoller中的注册状态. 
+    LoopMetrics::Kind kind_; 
 
     bool tied_;
     std::weak_ptr<void> tie_; 
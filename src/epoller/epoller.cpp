@@ -1,18 +1,40 @@
 #include "epoller.h"
 
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <unistd.h>
 
 #include "logger.h"
 #include "eventloop.h"
 
+using namespace std;
+
+// 较旧的内核头文件中没有epoll的ioctl定义(include/uapi/linux/eventpoll.h).
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t pad;
+};
+#define EPOLL_IOC_TYPE 0x8A
+#define EPIOCSPARAMS _IOW(EPOLL_IOC_TYPE, 0x01, struct epoll_params)
+#endif
+
 Epoller::Epoller(EventLoop* loop)
-    : owner_loop_(loop), 
+    : Poller(loop), 
     epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
-    events_(kInitEventListSize)
+    events_(kInitEventListSize),
+    ctl_add_(0),
+    ctl_mod_(0),
+    ctl_del_(0),
+    ctl_saved_(0),
+    syscalls_(0)
 {
     if (epoll_fd_ == -1) {
         LOG_SYSFATAL << "EPollPoller::EPollPoller";
@@ -24,13 +46,24 @@ Epoller::~Epoller() {
     ::close(epoll_fd_); 
 }
 
+bool Epoller::setBusyPoll(int usecs, bool prefer) {
+    struct epoll_params params; 
+    memset(&params, 0, sizeof(params)); 
+    params.busy_poll_usecs = static_cast<uint32_t>(usecs > 0 ? usecs : 0); 
+    params.busy_poll_budget = 8;    // 内核默认值(BUSY_POLL_BUDGET), 超过NAPI_POLL_WEIGHT须CAP_NET_ADMIN
+    params.prefer_busy_poll = prefer ? 1 : 0; 
+    return ::ioctl(epoll_fd_, EPIOCSPARAMS, &params) == 0; 
+}
+
 int Epoller::getEpollFd() const {
     return epoll_fd_; 
 }
 
-Timestamp Epoller::poll(int timeout_ms, ChannelList* activeChannels) {
+MonoTimestamp Epoller::poll(int timeout_ms, ChannelList* activeChannels) {
+    flushPendingUpdates(); 
     int nfds = epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()),  timeout_ms); 
-    Timestamp now(Timestamp::now());
+    increase(syscalls_); 
+    MonoTimestamp now(MonoTimestamp::now());
     int savedErrno = errno; 
     if (nfds > 0) {
         fillActiveChannels(nfds, activeChannels); 
@@ -58,7 +91,7 @@ void Epoller::fillActiveChannels(int nfds, ChannelList* activeChannels) const {
     }
 }
 
-bool Epoller::hasChannel(Channel* channel) {
+bool Epoller::hasChannel(Channel* channel) const {
     assertInLoopThread();
     const auto& it = channels_.find(channel->getFd());
     return it != channels_.end() && it->second == channel;  
@@ -89,12 +122,20 @@ void Epoller::updateChannel(Channel* channel) {
 
     if (channel->isNoneEvent()) {
         if (state == State::LISTENING) {
+            cancelPendingUpdate(channel); 
             epollUpdate(EPOLL_CTL_DEL, channel);  
         }
         channel->setState(State::DETACHED);  // 未指定监听事件, 不注册到epoll. 
     } else {
         if (state == State::LISTENING) {
-            epollUpdate(EPOLL_CTL_MOD, channel); 
+            if (channel->isUpdatePending()) {
+                increase(ctl_saved_);   // 与本轮先前的修改合并
+            } else if (channel->getEpollEvents() == channel->getRegisteredEvents()) {
+                increase(ctl_saved_);   // 注册的事件集未变化(如边缘触发下开关写事件)
+            } else {
+                channel->setUpdatePending(true); 
+                pending_updates_.push_back(channel); 
+            }
         } else {
             epollUpdate(EPOLL_CTL_ADD, channel); // NOT_EXISTS或DETACHE, 都重新注册到epoll.
         }
@@ -103,6 +144,28 @@ void Epoller::updateChannel(Channel* channel) {
 }
 
 
+void Epoller::flushPendingUpdates() {
+    for (Channel* channel : pending_updates_) {
+        channel->setUpdatePending(false); 
+        if (channel->getEpollEvents() != channel->getRegisteredEvents()) {
+            epollUpdate(EPOLL_CTL_MOD, channel); 
+        } else {
+            increase(ctl_saved_);   // 本轮内的修改已相互抵消
+        }
+    }
+    pending_updates_.clear(); 
+}
+
+
+void Epoller::cancelPendingUpdate(Channel* channel) {
+    if (channel->isUpdatePending()) {
+        channel->setUpdatePending(false); 
+        pending_updates_.erase(std::find(pending_updates_.begin(), pending_updates_.end(), channel)); 
+        increase(ctl_saved_); 
+    }
+}
+
+
 void Epoller::removeChannel(Channel* channel) {
     assertInLoopThread();  
     int fd = channel->getFd(); 
@@ -119,6 +182,7 @@ void Epoller::removeChannel(Channel* channel) {
     (void)rec;
 
     if (state == State::LISTENING) {
+        cancelPendingUpdate(channel); 
         epollUpdate(EPOLL_CTL_DEL, channel); 
     }
     channel->setState(State::NOT_EXIST);  
@@ -131,7 +195,14 @@ void Epoller::epollUpdate(int epoll_op, Channel* channel) {
     int fd = channel->getFd();
     ev.data.fd = fd;
     ev.data.ptr = channel;
-    ev.events = channel->getEvents();  
+    ev.events = channel->getEpollEvents();  
+    switch (epoll_op) {
+        case EPOLL_CTL_ADD: increase(ctl_add_); break; 
+        case EPOLL_CTL_MOD: increase(ctl_mod_); break; 
+        default: increase(ctl_del_); 
+    }
+    increase(syscalls_); 
+    channel->setRegisteredEvents(epoll_op == EPOLL_CTL_DEL ? 0 : ev.events); 
     if (epoll_ctl(epoll_fd_, epoll_op, fd, &ev) < 0) {
         switch(epoll_op) {
             case EPOLL_CTL_ADD: {
@@ -150,6 +221,12 @@ void Epoller::epollUpdate(int epoll_op, Channel* channel) {
     }
 }
 
-void Epoller::assertInLoopThread() const {
-    owner_loop_->assertInLoopThread(); 
+Epoller::Stats Epoller::getStats() const {
+    Stats stats;
+    stats.ctl_add = ctl_add_.load(memory_order_relaxed); 
+    stats.ctl_mod = ctl_mod_.load(memory_order_relaxed); 
+    stats.ctl_del = ctl_del_.load(memory_order_relaxed); 
+    stats.ctl_saved = ctl_saved_.load(memory_order_relaxed); 
+    stats.syscalls = syscalls_.load(memory_order_relaxed); 
+    return stats; 
 }
\ No newline at end of file
@@ -1,41 +1,59 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <map>
 
 #include "channel.h"
+#include "poller.h"
 #include "timestamp.h"
 
 class EventLoop;
 
-class Epoller {
+/* 对已注册channel的事件集修改(EPOLL_CTL_MOD)不立即提交, 而是暂存至下次epoll_wait前统一提交: 
+ * 两次epoll_wait之间不会观察到就绪事件, 故延后提交不改变语义, 而同一轮内的多次修改只需一次epoll_ctl, 
+ * 相互抵消(如开启EPOLLOUT后随即写完关闭)时无需系统调用. 
+ * 注册(ADD)与注销(DEL)仍立即提交: 前者须尽快开始监听, 后者之后fd可能被关闭. 
+ */
+class Epoller : public Poller {
 public:
     using EventList = std::vector<struct epoll_event>; 
     using ChannelMap = std::map<int, Channel*>; 
-    using ChannelList = std::vector<Channel*>; 
 
     Epoller(EventLoop* loop);
-    ~Epoller(); 
-    Timestamp poll(int timeoutMs, ChannelList* activeChannels); 
+    ~Epoller() override; 
+    MonoTimestamp poll(int timeoutMs, ChannelList* activeChannels) override; 
 
-    bool hasChannel(Channel* channel); 
+    bool hasChannel(Channel* channel) const override; 
     int getEpollFd() const; 
-    void updateChannel(Channel* channel);  // 更新fd及其channel
-    void removeChannel(Channel* channel); 
-    void assertInLoopThread() const; 
+    void updateChannel(Channel* channel) override;  // 更新fd及其channel
+    void removeChannel(Channel* channel) override; 
+    Stats getStats() const override; 
+    Backend getBackend() const override { return Backend::EPOLL; }
+    // 以EPIOCSPARAMS设置该epoll实例的busy poll参数(Linux 6.9+), 不依赖net.core.busy_poll.
+    bool setBusyPoll(int usecs, bool prefer) override; 
 
 
 private:
     enum Operator { ADD, MOD, DELETE }; 
     void epollUpdate(int epoll_op, Channel* channel); 
     void fillActiveChannels(int nfds, ChannelList* activeChannels) const;        // 将events_中活动fd填入activeChannels.
+    void flushPendingUpdates();    // 提交暂存的事件集修改
+    void cancelPendingUpdate(Channel* channel); 
 
 
 private:
     static const int kInitEventListSize = 16; 
 
-    EventLoop* owner_loop_;
     int epoll_fd_;            // epoll 实例
     EventList events_;        // 供epoll_wait使用的epoll_event数组
     ChannelMap channels_;   
+    ChannelList pending_updates_;   // 事件集已修改、尚未提交的channel
+
+    std::atomic<uint64_t> ctl_add_; 
+    std::atomic<uint64_t> ctl_mod_; 
+    std::atomic<uint64_t> ctl_del_; 
+    std::atomic<uint64_t> ctl_saved_; 
+    std::atomic<uint64_t> syscalls_; 
 };
\ No newline at end of file
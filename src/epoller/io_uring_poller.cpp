@@ -0,0 +1,699 @@
+#include "io_uring_poller.h"
+
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include "buffer.h"
+#include "channel.h"
+#include "eventloop.h"
+#include "logger.h"
+
+using namespace std;
+
+const unsigned IoUringPoller::kSqEntries;
+const unsigned IoUringPoller::kCqEntries;
+const uint64_t IoUringPoller::kControlFlag;
+const uint64_t IoUringPoller::kOpFlag;
+const uint64_t IoUringPoller::kAcceptFlag;
+const uint32_t IoUringPoller::kGenerationMask;
+const unsigned IoUringPoller::kRecvBufferCount;
+const unsigned IoUringPoller::kRecvBufferSize;
+const uint16_t IoUringPoller::kBufferGroup;
+
+static int ioUringSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// 内核是否支持ops中的全部操作码.
+static bool probeOps(int ring_fd, initializer_list<unsigned> ops) {
+    const unsigned kNumOps = 256;
+    size_t size = sizeof(struct io_uring_probe) + kNumOps * sizeof(struct io_uring_probe_op);
+    unique_ptr<char[]> buf(new char[size]());
+    auto probe = reinterpret_cast<struct io_uring_probe*>(buf.get());
+    if (ioUringRegister(ring_fd, IORING_REGISTER_PROBE, probe, kNumOps) < 0) {
+        return false;
+    }
+    for (unsigned op : ops) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+unique_ptr<IoUringPoller> IoUringPoller::create(EventLoop* loop, const char** reason) {
+    const char* dummy = nullptr;
+    const char*& why = reason ? *reason : dummy;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP |
+                   IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    params.cq_entries = kCqEntries;
+    int ring_fd = ioUringSetup(kSqEntries, &params);
+    bool single_issuer = ring_fd >= 0;     // 6.0+, 同时支持multishot recv
+    if (ring_fd < 0 && errno == EINVAL) {   // 较旧的内核不识别后三个标志
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+        params.cq_entries = kCqEntries;
+        ring_fd = ioUringSetup(kSqEntries, &params);
+    }
+    if (ring_fd < 0) {
+        why = errno == ENOSYS ? "io_uring_setup not implemented" :
+              errno == EPERM ? "io_uring disabled (EPERM)" : "io_uring_setup failed";
+        return nullptr;
+    }
+
+    const unsigned kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                                       IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;   // RSRC_TAGS: 5.13+
+    if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+        ::close(ring_fd);
+        why = "kernel too old for multishot poll";
+        return nullptr;
+    }
+    if (!probeOps(ring_fd, { IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE })) {
+        ::close(ring_fd);
+        why = "poll opcodes not supported";
+        return nullptr;
+    }
+    unique_ptr<IoUringPoller> poller(new IoUringPoller(loop, ring_fd));
+    if (!poller->mapRings(params)) {
+        why = "mmap of io_uring rings failed";
+        return nullptr;
+    }
+    // 完成模式不可用时仍可作为就绪通知的后端.
+    poller->completion_supported_ = single_issuer &&
+        probeOps(ring_fd, { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_ASYNC_CANCEL }) &&
+        poller->setupBufferRing();
+    return poller;
+}
+
+
+IoUringPoller::IoUringPoller(EventLoop* loop, int ring_fd)
+    : Poller(loop),
+    ring_fd_(ring_fd),
+    sq_ring_ptr_(MAP_FAILED),
+    sq_ring_size_(0),
+    cq_ring_ptr_(MAP_FAILED),
+    cq_ring_size_(0),
+    sqes_size_(0),
+    round_(0),
+    completion_supported_(false),
+    buf_ring_(nullptr),
+    buf_ring_size_(0),
+    buf_ring_tail_(0),
+    ctl_add_(0),
+    ctl_mod_(0),
+    ctl_del_(0),
+    ctl_saved_(0),
+    syscalls_(0)
+{
+}
+
+IoUringPoller::~IoUringPoller() {
+    if (sq_.sqes) {
+        ::munmap(sq_.sqes, sqes_size_);
+    }
+    if (cq_ring_ptr_ != MAP_FAILED && cq_ring_ptr_ != sq_ring_ptr_) {
+        ::munmap(cq_ring_ptr_, cq_ring_size_);
+    }
+    if (sq_ring_ptr_ != MAP_FAILED) {
+        ::munmap(sq_ring_ptr_, sq_ring_size_);
+    }
+    ::close(ring_fd_);   // 未完成的poll请求随之取消, 接收缓冲区环随之注销
+    if (buf_ring_) {
+        ::munmap(buf_ring_, buf_ring_size_);
+    }
+}
+
+bool IoUringPoller::mapRings(const struct io_uring_params& params) {
+    // IORING_FEAT_SINGLE_MMAP: 提交队列与完成队列共用一次映射.
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ptr_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr_ == MAP_FAILED) {
+        return false;
+    }
+    cq_ring_ptr_ = sq_ring_ptr_;
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+
+    char* sq_ptr = static_cast<char*>(sq_ring_ptr_);
+    sq_.head = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.head);
+    sq_.tail = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+    sq_.array = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+    sq_.mask = *reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+    sq_.entries = *reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_entries);
+    sq_.sqes = static_cast<struct io_uring_sqe*>(sqes);
+    sq_.local_tail = *sq_.tail;
+    for (unsigned i = 0; i < sq_.entries; ++i) {
+        sq_.array[i] = i;   // 提交项下标与环形队列位置一一对应
+    }
+
+    char* cq_ptr = static_cast<char*>(cq_ring_ptr_);
+    cq_.head = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+    cq_.tail = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+    cq_.mask = *reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+    cq_.cqes = reinterpret_cast<struct io_uring_cqe*>(cq_ptr + params.cq_off.cqes);
+    return true;
+}
+
+
+// 注册接收缓冲区环(IORING_REGISTER_PBUF_RING, 5.19+), 并提供全部缓冲区.
+bool IoUringPoller::setupBufferRing() {
+    buf_ring_size_ = kRecvBufferCount * sizeof(struct io_uring_buf);
+    void* ring = ::mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = kRecvBufferCount;
+    reg.bgid = kBufferGroup;
+    if (ioUringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        ::munmap(ring, buf_ring_size_);
+        return false;
+    }
+    buf_ring_ = static_cast<struct io_uring_buf_ring*>(ring);
+    recv_buffers_.reset(new char[kRecvBufferCount * kRecvBufferSize]);
+    for (unsigned i = 0; i < kRecvBufferCount; ++i) {
+        provideBuffer(i);
+    }
+    publishBuffers();
+    return true;
+}
+
+void IoUringPoller::provideBuffer(int buf_id) {
+    // 不经buf_ring_->bufs访问: 该柔性数组在C++中位于偏移8(空结构体占1字节), 与内核的布局不一致.
+    struct io_uring_buf* bufs = reinterpret_cast<struct io_uring_buf*>(buf_ring_);
+    struct io_uring_buf* buf = &bufs[buf_ring_tail_ & (kRecvBufferCount - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(recv_buffers_.get() + static_cast<size_t>(buf_id) * kRecvBufferSize);
+    buf->len = kRecvBufferSize;
+    buf->bid = static_cast<uint16_t>(buf_id);
+    ++buf_ring_tail_;
+}
+
+void IoUringPoller::publishBuffers() {
+    __atomic_store_n(&buf_ring_->tail, buf_ring_tail_, __ATOMIC_RELEASE);
+}
+
+
+uint64_t IoUringPoller::makeUserData(int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(generation & kGenerationMask) << 32) | static_cast<uint32_t>(fd);
+}
+
+int IoUringPoller::enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz) {
+    increase(syscalls_);
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, arg, argsz));
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe() {
+    unsigned head = __atomic_load_n(sq_.head, __ATOMIC_ACQUIRE);
+    if (sq_.local_tail - head == sq_.entries) {
+        // 提交队列已满, 先行提交. 完成事件留待poll()收取.
+        __atomic_store_n(sq_.tail, sq_.local_tail, __ATOMIC_RELEASE);
+        if (enter(sq_.entries, 0, 0, nullptr, 0) < 0) {
+            LOG_SYSERR << "IoUringPoller::getSqe io_uring_enter";
+        }
+        head = __atomic_load_n(sq_.head, __ATOMIC_ACQUIRE);
+        if (sq_.local_tail - head == sq_.entries) {
+            LOG_FATAL << "IoUringPoller::getSqe submission queue stuck";
+        }
+    }
+    struct io_uring_sqe* sqe = &sq_.sqes[sq_.local_tail & sq_.mask];
+    ++sq_.local_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+
+MonoTimestamp IoUringPoller::poll(int timeout_ms, ChannelList* active_channels) {
+    flushPendingUpdates();
+    if (!ready_fds_.empty()) {   // 上轮未取完的结果无需等待
+        timeout_ms = 0;
+    }
+    __atomic_store_n(sq_.tail, sq_.local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = sq_.local_tail - __atomic_load_n(sq_.head, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    // 提交本轮的全部请求并等待至少一个完成事件.
+    int ret = enter(to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    int saved_errno = errno;
+    MonoTimestamp now(MonoTimestamp::now());
+    if (ret < 0 && saved_errno != ETIME && saved_errno != EINTR && saved_errno != EBUSY) {
+        errno = saved_errno;
+        LOG_SYSERR << "IoUringPoller::poll()";
+    }
+    ++round_;
+    reapCompletions(active_channels);
+    for (int fd : ready_fds_) {
+        Slot& slot = slots_[fd];
+        slot.ready = false;
+        if (slot.channel && slot.channel->isReading() && slot.results_head < slot.results.size()) {
+            activate(slot, EPOLLIN, active_channels);
+        }
+    }
+    ready_fds_.clear();
+    if (active_channels->empty()) {
+        LOG_TRACE << "nothing happend";
+    }
+    return now;
+}
+
+void IoUringPoller::reapCompletions(ChannelList* active_channels) {
+    unsigned head = *cq_.head;
+    unsigned tail = __atomic_load_n(cq_.tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        handleCompletion(cq_.cqes[head & cq_.mask], active_channels);
+    }
+    __atomic_store_n(cq_.head, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::handleCompletion(const struct io_uring_cqe& cqe, ChannelList* active_channels) {
+    if (cqe.user_data & kControlFlag) {
+        // 修改/注销请求: 目标poll已完成时返回ENOENT/EALREADY, 其完成事件另行处理.
+        if (cqe.res < 0 && cqe.res != -ENOENT && cqe.res != -EALREADY) {
+            LOG_ERROR << "IoUringPoller poll update/remove failed: " << strerror_tl(-cqe.res)
+                      << " fd = " << static_cast<int>(cqe.user_data & 0xffffffff);
+        }
+        return;
+    }
+    if (cqe.user_data & kOpFlag) {
+        handleOpCompletion(cqe, active_channels);
+        return;
+    }
+    int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+    uint32_t generation = getGeneration(cqe.user_data);
+    if (fd < 0 || static_cast<size_t>(fd) >= slots_.size()) {
+        return;
+    }
+    Slot& slot = slots_[fd];
+    if (slot.channel == nullptr || (slot.generation & kGenerationMask) != generation) {
+        return;   // 已注销或已重新注册, 迟到的完成事件
+    }
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {   // 请求已结束, 下轮重新提交
+        slot.armed = false;
+        if (cqe.res >= 0 || cqe.res == -ECANCELED) {
+            markPending(fd, slot);
+        }
+    }
+    if (cqe.res < 0) {
+        if (cqe.res != -ECANCELED) {
+            LOG_ERROR << "IoUringPoller poll failed: " << strerror_tl(-cqe.res) << " fd = " << fd;
+        }
+        return;
+    }
+    if (cqe.res == 0) {
+        return;
+    }
+    activate(slot, cqe.res, active_channels);
+}
+
+void IoUringPoller::activate(Slot& slot, int revents, ChannelList* active_channels) {
+    if (slot.active_round == round_) {   // 同一轮内multishot的多个完成事件
+        slot.revents |= revents;
+    } else {
+        slot.active_round = round_;
+        slot.revents = revents;
+        active_channels->push_back(slot.channel);
+    }
+    slot.channel->setRevents(slot.revents);
+}
+
+void IoUringPoller::handleOpCompletion(const struct io_uring_cqe& cqe, ChannelList* active_channels) {
+    int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+    bool accepted = cqe.user_data & kAcceptFlag;
+    Result result{ cqe.res, (cqe.flags & IORING_CQE_F_BUFFER) ? static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1 };
+    if (fd < 0 || static_cast<size_t>(fd) >= slots_.size() || slots_[fd].channel == nullptr ||
+        (slots_[fd].generation & kGenerationMask) != getGeneration(cqe.user_data)) {
+        discardResult(result, accepted);   // 已注销或已重新注册
+        publishBuffers();
+        return;
+    }
+    Slot& slot = slots_[fd];
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        slot.op_armed = false;
+        slot.op_canceling = false;
+        if (accepted || cqe.res > 0 || cqe.res == -ENOBUFS || cqe.res == -ECANCELED) {
+            markPending(fd, slot);   // 下轮重新提交
+        } else {
+            slot.op_finished = true;
+        }
+    }
+    if (cqe.res == -ENOBUFS || cqe.res == -ECANCELED) {   // 缓冲区耗尽(取走后归还), 或已停止读取
+        return;
+    }
+    slot.results.push_back(result);
+    activate(slot, EPOLLIN, active_channels);
+}
+
+
+IoUringPoller::Slot& IoUringPoller::getSlot(int fd) {
+    assert(fd >= 0);
+    if (static_cast<size_t>(fd) >= slots_.size()) {
+        slots_.resize(std::max(static_cast<size_t>(fd) + 1, slots_.size() * 2));
+    }
+    return slots_[fd];
+}
+
+void IoUringPoller::markPending(int fd, Slot& slot) {
+    if (!slot.pending) {
+        slot.pending = true;
+        pending_fds_.push_back(fd);
+    }
+}
+
+void IoUringPoller::flushPendingUpdates() {
+    for (int fd : pending_fds_) {
+        Slot& slot = slots_[fd];
+        if (!slot.pending) {
+            continue;
+        }
+        slot.pending = false;
+        Channel* channel = slot.channel;
+        if (channel == nullptr || channel->getState() != Channel::StateInEpoll::LISTENING) {
+            continue;
+        }
+        if (channel->getCompletion() != Completion::NONE) {
+            updateOp(fd, slot);
+        }
+        int events = pollEvents(channel);
+        if (!slot.armed) {
+            if (events & ~EPOLLET) {   // 完成模式下不需要读方向以外的事件时不提交poll
+                armPoll(fd, slot, events);
+            }
+        } else if (events != channel->getRegisteredEvents()) {
+            updatePoll(fd, slot, events);
+        } else if (channel->getCompletion() == Completion::NONE) {
+            increase(ctl_saved_);   // 本轮内的修改已相互抵消
+        }
+    }
+    pending_fds_.clear();
+}
+
+void IoUringPoller::armPoll(int fd, Slot& slot, int events) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(events & ~EPOLLET);
+    sqe->len = slot.channel->isEdgeTriggered() ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = makeUserData(fd, slot.generation);
+    slot.armed = true;
+    slot.channel->setRegisteredEvents(events);
+    increase(ctl_add_);
+}
+
+void IoUringPoller::updatePoll(int fd, Slot& slot, int events) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, slot.generation);
+    sqe->poll32_events = static_cast<uint32_t>(events & ~EPOLLET);
+    sqe->len = IORING_POLL_UPDATE_EVENTS | (slot.channel->isEdgeTriggered() ? IORING_POLL_ADD_MULTI : 0);
+    sqe->user_data = makeUserData(fd, slot.generation) | kControlFlag;
+    slot.channel->setRegisteredEvents(events);
+    increase(ctl_mod_);
+}
+
+void IoUringPoller::removePoll(int fd, Slot& slot) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, slot.generation);
+    sqe->user_data = makeUserData(fd, slot.generation) | kControlFlag;
+    increase(ctl_del_);
+}
+
+// 完成模式下读方向由accept/recv请求负责, poll只监听其余事件.
+int IoUringPoller::pollEvents(const Channel* channel) {
+    int events = channel->getEpollEvents();
+    if (channel->getCompletion() != Completion::NONE) {
+        events &= ~(EPOLLIN | EPOLLPRI | EPOLLRDHUP);
+    }
+    return events;
+}
+
+// 停止监听fd. 若poll请求仍在内核中, 提交注销请求; 递增代数, 迟到的完成事件因代数不符被忽略.
+// 尚未取走的结果随之丢弃.
+void IoUringPoller::detach(int fd, Slot& slot) {
+    if (slot.armed) {
+        removePoll(fd, slot);
+    }
+    if (slot.op_armed && !slot.op_canceling) {
+        cancelOp(fd, slot);
+    }
+    bool accepted = slot.channel->getCompletion() == Completion::ACCEPT;
+    for (size_t i = slot.results_head; i < slot.results.size(); ++i) {
+        discardResult(slot.results[i], accepted);
+    }
+    if (slot.results_head < slot.results.size()) {
+        publishBuffers();
+    }
+    slot.results.clear();
+    slot.results_head = 0;
+    slot.op_armed = false;
+    slot.op_canceling = false;
+    slot.op_finished = false;
+    ++slot.generation;
+    if (slot.pending) {
+        increase(ctl_saved_);
+    }
+    slot.channel->setRegisteredEvents(0);
+    slot.channel = nullptr;
+    slot.armed = false;
+    slot.pending = false;
+}
+
+
+// 读方向开启时确保accept/recv请求在内核中, 关闭时取消; 尚有未取走的结果时下轮直接回调.
+void IoUringPoller::updateOp(int fd, Slot& slot) {
+    if (slot.channel->isReading()) {
+        if (!slot.op_armed && !slot.op_finished) {
+            armOp(fd, slot);
+        }
+        if (slot.results_head < slot.results.size()) {
+            markReady(fd, slot);
+        }
+    } else if (slot.op_armed && !slot.op_canceling) {
+        cancelOp(fd, slot);
+    }
+}
+
+void IoUringPoller::armOp(int fd, Slot& slot) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->fd = fd;
+    if (slot.channel->getCompletion() == Completion::ACCEPT) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;   // 对端地址由持有者另行获取
+        sqe->user_data = makeUserData(fd, slot.generation) | kOpFlag | kAcceptFlag;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = makeUserData(fd, slot.generation) | kOpFlag;
+    }
+    slot.op_armed = true;
+    increase(ctl_add_);
+}
+
+void IoUringPoller::cancelOp(int fd, Slot& slot) {
+    uint64_t target = makeUserData(fd, slot.generation) | kOpFlag;
+    if (slot.channel->getCompletion() == Completion::ACCEPT) {
+        target |= kAcceptFlag;
+    }
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = makeUserData(fd, slot.generation) | kControlFlag;
+    slot.op_canceling = true;
+    increase(ctl_del_);
+}
+
+void IoUringPoller::markReady(int fd, Slot& slot) {
+    if (!slot.ready) {
+        slot.ready = true;
+        ready_fds_.push_back(fd);
+    }
+}
+
+// 结果已全部取走时复用存储, 否则留待下轮.
+void IoUringPoller::compactResults(int fd, Slot& slot) {
+    if (slot.results_head == slot.results.size()) {
+        slot.results.clear();
+        slot.results_head = 0;
+    } else {
+        markReady(fd, slot);
+    }
+}
+
+// 丢弃无人取走的结果: 关闭accept到的连接, 归还接收缓冲区. 调用方负责publishBuffers().
+void IoUringPoller::discardResult(const Result& result, bool accepted) {
+    if (accepted && result.res >= 0) {
+        ::close(result.res);
+    }
+    if (result.buf_id >= 0) {
+        provideBuffer(result.buf_id);
+    }
+}
+
+bool IoUringPoller::supportsCompletion(Completion mode) const {
+    return completion_supported_ && mode != Completion::NONE;
+}
+
+size_t IoUringPoller::takeAccepted(Channel* channel, int* results, size_t max) {
+    assertInLoopThread();
+    int fd = channel->getFd();
+    Slot& slot = getSlot(fd);
+    assert(slot.channel == channel);
+    size_t n = 0;
+    while (n < max && slot.results_head < slot.results.size()) {
+        results[n++] = slot.results[slot.results_head++].res;
+    }
+    compactResults(fd, slot);
+    return n;
+}
+
+// 按序拷贝数据直至EOF或错误; EOF与错误在其之前的数据取走之后的下一次调用返回.
+ssize_t IoUringPoller::takeReceived(Channel* channel, Buffer* buffer, int* saved_errno) {
+    assertInLoopThread();
+    int fd = channel->getFd();
+    Slot& slot = getSlot(fd);
+    assert(slot.channel == channel);
+    ssize_t total = 0;
+    while (slot.results_head < slot.results.size()) {
+        Result result = slot.results[slot.results_head];
+        if (result.res <= 0) {
+            if (total > 0) {
+                break;
+            }
+            ++slot.results_head;
+            compactResults(fd, slot);
+            if (result.res < 0) {
+                *saved_errno = -result.res;
+                return -1;
+            }
+            return 0;
+        }
+        buffer->append(recv_buffers_.get() + static_cast<size_t>(result.buf_id) * kRecvBufferSize,
+                       static_cast<size_t>(result.res));
+        provideBuffer(result.buf_id);
+        total += result.res;
+        ++slot.results_head;
+    }
+    if (total > 0) {
+        publishBuffers();
+    } else {
+        *saved_errno = EAGAIN;
+        total = -1;
+    }
+    compactResults(fd, slot);
+    return total;
+}
+
+
+void IoUringPoller::updateChannel(Channel* channel) {
+    assertInLoopThread();
+    using State = Channel::StateInEpoll;
+    int fd = channel->getFd();
+    State state = channel->getState();
+    LOG_TRACE << "fd = " << fd
+              << " events = " << channel->getEvents()
+              << " state = " << static_cast<int>(state);
+    Slot& slot = getSlot(fd);
+    if (state == State::NOT_EXIST) {
+        assert(slot.channel == nullptr);
+    } else {
+        assert(slot.channel == channel);
+    }
+
+    if (channel->isNoneEvent()) {
+        if (state == State::LISTENING) {
+            detach(fd, slot);
+            slot.channel = channel;   // 仍由本Poller持有, 直至removeChannel
+        }
+        channel->setState(State::DETACHED);
+    } else {
+        if (state == State::LISTENING) {
+            if (slot.pending) {
+                increase(ctl_saved_);   // 与本轮先前的修改(或待重新提交的请求)合并
+            } else if (channel->getCompletion() == Completion::NONE &&
+                       channel->getEpollEvents() == channel->getRegisteredEvents()) {
+                increase(ctl_saved_);
+            } else {
+                markPending(fd, slot);
+            }
+        } else {
+            slot.channel = channel;
+            ++slot.generation;
+            slot.armed = false;
+            markPending(fd, slot);   // 与本轮其他请求一并提交
+        }
+        channel->setState(State::LISTENING);
+    }
+}
+
+void IoUringPoller::removeChannel(Channel* channel) {
+    assertInLoopThread();
+    using State = Channel::StateInEpoll;
+    int fd = channel->getFd();
+    State state = channel->getState();
+    LOG_TRACE << "fd = " << fd << " state = " << static_cast<int>(state);
+    assert(channel->isNoneEvent());
+    assert(state == State::LISTENING || state == State::DETACHED);
+    Slot& slot = getSlot(fd);
+    assert(slot.channel == channel);
+    if (state == State::LISTENING) {
+        detach(fd, slot);
+    }
+    slot.channel = nullptr;
+    channel->setState(State::NOT_EXIST);
+}
+
+bool IoUringPoller::hasChannel(Channel* channel) const {
+    assertInLoopThread();
+    int fd = channel->getFd();
+    return fd >= 0 && static_cast<size_t>(fd) < slots_.size() && slots_[fd].channel == channel;
+}
+
+Poller::Stats IoUringPoller::getStats() const {
+    Stats stats;
+    stats.ctl_add = ctl_add_.load(memory_order_relaxed);
+    stats.ctl_mod = ctl_mod_.load(memory_order_relaxed);
+    stats.ctl_del = ctl_del_.load(memory_order_relaxed);
+    stats.ctl_saved = ctl_saved_.load(memory_order_relaxed);
+    stats.syscalls = syscalls_.load(memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "poller.h"
+
+/* 基于io_uring的Poller. 直接使用io_uring_setup/io_uring_enter系统调用, 不依赖liburing.
+ *
+ * - 以IORING_OP_POLL_ADD监听各fd的就绪事件. 注册、修改(IORING_POLL_UPDATE_EVENTS)与注销均写入提交队列,
+ *   在下次poll()时与等待一并经一次io_uring_enter提交, 每轮仅一次系统调用.
+ * - 水平触发的channel使用单次poll, 完成后于下轮重新提交: 提交时内核即检查就绪状态, 仍就绪则立即完成, 与epoll水平触发语义一致.
+ * - 边缘触发的channel使用multishot poll, 仅在状态变化时产生完成事件, 被内核终止(无IORING_CQE_F_MORE)时重新提交.
+ * - 完成模式(见Poller): ACCEPT/RECV的channel以一个multishot accept/recv请求代替读方向的poll, 被内核终止时下轮重新提交; 
+ *   poll请求只在需要其他事件(如EPOLLOUT)时提交. 结果按序暂存于Slot, 持有者本轮未取完的留待下轮直接回调(不等待新的完成事件). 
+ *   RECV共用本Poller注册的kRecvBufferCount个kRecvBufferSize字节的接收缓冲区, 取走时归还; 耗尽时内核以ENOBUFS终止请求, 下轮重新提交. 
+ * - user_data由fd与注册代数组成, 注销后迟到的完成事件因代数不符被忽略(其中accept到的连接随即关闭, 占用的接收缓冲区归还).
+ *
+ * 要求内核支持IORING_FEAT_EXT_ARG(等待超时)与multishot poll及其修改(5.13+), 否则create()返回nullptr.
+ * 完成模式另需multishot recv(6.0+, 以IORING_SETUP_SINGLE_ISSUER判断)与provided buffer ring, 不支持时只提供就绪通知.
+ */
+class IoUringPoller : public Poller {
+public:
+    // 内核不支持、被禁用或资源不足时返回nullptr, reason(若非空)记录原因.
+    static std::unique_ptr<IoUringPoller> create(EventLoop* loop, const char** reason = nullptr);
+    ~IoUringPoller() override;
+
+    MonoTimestamp poll(int timeout_ms, ChannelList* active_channels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+    bool hasChannel(Channel* channel) const override;
+    Stats getStats() const override;
+    Backend getBackend() const override { return Backend::IO_URING; }
+    bool supportsCompletion(Completion mode) const override;
+    size_t takeAccepted(Channel* channel, int* results, size_t max) override;
+    ssize_t takeReceived(Channel* channel, Buffer* buffer, int* saved_errno) override;
+
+private:
+    // 完成模式下一个accept/recv完成事件的结果
+    struct Result {
+        int res;       // 新连接的fd或接收的字节数, 出错时为-errno
+        int buf_id;    // 数据所在的接收缓冲区, 无则为-1
+    };
+
+    // 每个fd对应的注册状态
+    struct Slot {
+        Channel* channel = nullptr;
+        uint32_t generation = 0;   // 每次注册递增
+        bool armed = false;        // 内核中存在未完成的poll请求
+        bool pending = false;      // 待下次提交前重新提交或修改
+        uint64_t active_round = 0; // 最近一次加入active_channels的轮次, 用于合并同一轮的多个完成事件
+        int revents = 0;
+        // 完成模式
+        bool op_armed = false;       // 内核中存在未完成的multishot accept/recv请求
+        bool op_canceling = false;   // 已提交取消请求(停止读取), 尚未收到其最后的完成事件
+        bool op_finished = false;    // recv已返回EOF或出错, 不再重新提交
+        bool ready = false;          // 已加入ready_fds_
+        std::vector<Result> results; // 尚未取走的结果, 自results_head起
+        size_t results_head = 0;
+    };
+
+    struct SubmissionQueue {
+        unsigned* head = nullptr;
+        unsigned* tail = nullptr;
+        unsigned* array = nullptr;
+        unsigned mask = 0;
+        unsigned entries = 0;
+        struct io_uring_sqe* sqes = nullptr;
+        unsigned local_tail = 0;   // 尚未发布给内核的尾部
+    };
+
+    struct CompletionQueue {
+        unsigned* head = nullptr;
+        unsigned* tail = nullptr;
+        unsigned mask = 0;
+        struct io_uring_cqe* cqes = nullptr;
+    };
+
+private:
+    IoUringPoller(EventLoop* loop, int ring_fd);
+    bool mapRings(const struct io_uring_params& params);
+
+    Slot& getSlot(int fd);
+    void markPending(int fd, Slot& slot);
+    void flushPendingUpdates();
+    void armPoll(int fd, Slot& slot, int events);
+    void updatePoll(int fd, Slot& slot, int events);
+    void removePoll(int fd, Slot& slot);
+    void detach(int fd, Slot& slot);
+    static int pollEvents(const Channel* channel);
+    void activate(Slot& slot, int revents, ChannelList* active_channels);
+
+    bool setupBufferRing();
+    void provideBuffer(int buf_id);
+    void publishBuffers();
+    void updateOp(int fd, Slot& slot);
+    void armOp(int fd, Slot& slot);
+    void cancelOp(int fd, Slot& slot);
+    void markReady(int fd, Slot& slot);
+    void compactResults(int fd, Slot& slot);
+    void discardResult(const Result& result, bool accepted);
+    void handleOpCompletion(const struct io_uring_cqe& cqe, ChannelList* active_channels);
+
+    struct io_uring_sqe* getSqe();
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz);
+    void reapCompletions(ChannelList* active_channels);
+    void handleCompletion(const struct io_uring_cqe& cqe, ChannelList* active_channels);
+
+    static uint64_t makeUserData(int fd, uint32_t generation);
+    static uint32_t getGeneration(uint64_t user_data) { return static_cast<uint32_t>(user_data >> 32) & kGenerationMask; }
+
+private:
+    static const unsigned kSqEntries = 256;
+    static const unsigned kCqEntries = 4096;
+    static const uint64_t kControlFlag = 1ULL << 63;   // 修改/注销请求的完成事件
+    static const uint64_t kOpFlag = 1ULL << 62;        // 完成模式accept/recv请求的完成事件
+    static const uint64_t kAcceptFlag = 1ULL << 61;    // 与kOpFlag同时设置: accept请求
+    static const uint32_t kGenerationMask = 0x1fffffff;
+    static const unsigned kRecvBufferCount = 256;      // 2的幂
+    static const unsigned kRecvBufferSize = 4096;
+    static const uint16_t kBufferGroup = 0;
+
+    int ring_fd_;
+    void* sq_ring_ptr_;
+    size_t sq_ring_size_;
+    void* cq_ring_ptr_;
+    size_t cq_ring_size_;
+    size_t sqes_size_;
+    SubmissionQueue sq_;
+    CompletionQueue cq_;
+
+    std::vector<Slot> slots_;     // 以fd为下标
+    std::vector<int> pending_fds_;
+    std::vector<int> ready_fds_;  // 尚有未取走结果的完成模式channel, 下轮直接回调
+    uint64_t round_;
+
+    bool completion_supported_;
+    struct io_uring_buf_ring* buf_ring_;
+    size_t buf_ring_size_;
+    std::unique_ptr<char[]> recv_buffers_;
+    uint16_t buf_ring_tail_;      // 尚未发布给内核的尾部
+
+    std::atomic<uint64_t> ctl_add_;
+    std::atomic<uint64_t> ctl_mod_;
+    std::atomic<uint64_t> ctl_del_;
+    std::atomic<uint64_t> ctl_saved_;
+    std::atomic<uint64_t> syscalls_;
+};
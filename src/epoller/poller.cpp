@@ -0,0 +1,47 @@
+#include "poller.h"
+
+#include <atomic>
+
+#include "epoller.h"
+#include "eventloop.h"
+#include "io_uring_poller.h"
+#include "logger.h"
+
+using namespace std;
+
+static atomic<Poller::Backend> g_default_backend(Poller::Backend::EPOLL);
+static atomic<bool> g_fallback_logged(false);
+
+
+void Poller::assertInLoopThread() const {
+    owner_loop_->assertInLoopThread();
+}
+
+unique_ptr<Poller> Poller::newPoller(EventLoop* loop, Backend backend) {
+    if (backend == Backend::IO_URING) {
+        const char* reason = nullptr;
+        if (auto poller = IoUringPoller::create(loop, &reason)) {
+            return poller;
+        }
+        // 各EventLoop的原因相同, 只记录一次.
+        if (!g_fallback_logged.exchange(true)) {
+            LOG_WARN << "io_uring unavailable (" << reason << "), falling back to epoll";
+        }
+    }
+    return make_unique<Epoller>(loop);
+}
+
+void Poller::setDefaultBackend(Backend backend) {
+    g_default_backend.store(backend, memory_order_relaxed);
+}
+
+Poller::Backend Poller::getDefaultBackend() {
+    return g_default_backend.load(memory_order_relaxed);
+}
+
+const char* Poller::getBackendName(Backend backend) {
+    switch (backend) {
+        case Backend::IO_URING: return "io_uring";
+        default: return "epoll";
+    }
+}
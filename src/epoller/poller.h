@@ -0,0 +1,87 @@
+#pragma once
+
+#include <sys/types.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "timestamp.h"
+
+class Buffer;
+class Channel;
+class EventLoop;
+
+/* I/O多路复用的抽象接口, EventLoop经由它注册channel并等待就绪事件.
+ *
+ * - EPOLL: epoll_wait + epoll_ctl(见Epoller).
+ * - IO_URING: 以io_uring的poll请求监听就绪事件, 每轮的注册/修改/注销与等待合并为一次io_uring_enter(见IoUringPoller).
+ *   内核不支持或被禁用(如seccomp、kernel.io_uring_disabled)时自动退回EPOLL.
+ *
+ * 各实现向Channel回报的就绪事件集均为epoll语义(EPOLLIN/EPOLLOUT/EPOLLHUP...).
+ *
+ * 完成模式(仅IO_URING): 读方向的操作由内核代为执行, 结果暂存于Poller, 以EPOLLIN回调channel后由持有者取走, 
+ * 省去就绪通知之后的accept/read系统调用, 以及水平触发下每次事件后重新提交的poll请求. 
+ * - ACCEPT: multishot accept, 每个完成事件即一个新连接(见takeAccepted). 
+ * - RECV: multishot recv, 数据由内核写入Poller注册的共享接收缓冲区环(provided buffer ring), 取走时拷贝至Buffer并归还(见takeReceived). 
+ * 以Channel::setCompletion()在首次注册前设置; 后端或内核不支持时supportsCompletion()返回false, 调用方继续使用就绪通知. 
+ */
+class Poller {
+public:
+    using ChannelList = std::vector<Channel*>;
+
+    enum class Backend { EPOLL = 0, IO_URING };
+    enum class Completion { NONE = 0, ACCEPT, RECV };
+
+    // 计数, 可由其他线程读取.
+    struct Stats {
+        uint64_t ctl_add;     // 注册(epoll_ctl ADD; io_uring下为poll请求, 含每轮的重新注册)
+        uint64_t ctl_mod;     // 修改事件集
+        uint64_t ctl_del;     // 注销
+        uint64_t ctl_saved;   // 事件集未变化、同一轮内合并或相互抵消而省去的修改次数
+        uint64_t syscalls;    // 实际发起的系统调用(epoll_wait/epoll_ctl, 或io_uring_enter)
+    };
+
+public:
+    explicit Poller(EventLoop* loop) : owner_loop_(loop) {}
+    virtual ~Poller() = default;
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    // 等待就绪事件并填入active_channels, 返回等待结束的时间.
+    virtual MonoTimestamp poll(int timeout_ms, ChannelList* active_channels) = 0;
+    virtual void updateChannel(Channel* channel) = 0;    // 更新fd及其channel
+    virtual void removeChannel(Channel* channel) = 0;
+    virtual bool hasChannel(Channel* channel) const = 0;
+    virtual Stats getStats() const = 0;
+    virtual Backend getBackend() const = 0;
+    // 内核在等待就绪事件时忙轮询网卡队列的时长(微秒), 0为关闭. 后端不支持时返回false.
+    virtual bool setBusyPoll(int usecs, bool prefer) { (void)usecs; (void)prefer; return false; }
+    // 以下为完成模式, 见类注释. 
+    virtual bool supportsCompletion(Completion mode) const { (void)mode; return false; }
+    // 取出至多max个accept结果(新连接的fd, 或-errno), 返回取出的个数. 
+    virtual size_t takeAccepted(Channel* channel, int* results, size_t max) { (void)channel; (void)results; (void)max; return 0; }
+    // 将已接收的数据追加到buffer, 返回字节数; 对端关闭时返回0; 出错时返回-1, 错误码存入saved_errno(暂无数据时为EAGAIN). 
+    virtual ssize_t takeReceived(Channel* channel, Buffer* buffer, int* saved_errno) {
+        (void)channel; (void)buffer; *saved_errno = EAGAIN; return -1; 
+    }
+
+    void assertInLoopThread() const;
+
+    // 按指定后端创建, 不可用时退回EPOLL.
+    static std::unique_ptr<Poller> newPoller(EventLoop* loop, Backend backend);
+    // 此后新建的EventLoop使用的后端.
+    static void setDefaultBackend(Backend backend);
+    static Backend getDefaultBackend();
+    static const char* getBackendName(Backend backend);
+
+protected:
+    // 计数器仅由所属IO线程写入, 无需原子的读-改-写.
+    static void increase(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+protected:
+    EventLoop* owner_loop_;
+};
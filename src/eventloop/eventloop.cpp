@@ -6,8 +6,9 @@
 
 #include "thread.h"
 #include "channel.h"
+#include "cycle_clock.h"
 #include "logger.h"
-#include "epoller.h"
+#include "poller.h"
 
 using namespace std;
 
@@ -15,6 +16,8 @@ thread_local EventLoop* EventLoop::t_loopInThisThread = nullptr;
 
 static constexpr int kPollTimeMs = 10000;
 
+const size_t EventLoop::kReadScratchSize; 
+
 
 // 当向断开的conn_fd调用write写入时会收到SIGPIPE信号, 其默认行为是终止进程.
 // 因此对于服务器端程序通常需要忽略该信号. 通过一个全局变量来实现. 
@@ -27,14 +30,34 @@ IgnoreSigPipe initObj;
 
 
 EventLoop::EventLoop() 
+    : EventLoop(Poller::getDefaultBackend())
+{
+}
+
+EventLoop::EventLoop(Poller::Backend backend) 
     : looping_(false), 
     quit_(false),
     calling_pending_functors_(false),
+    event_handling_(false),
     threadId_(CurrentThread::getTid()),
-    epoller_(make_unique<Epoller>(this)), 
+    epoller_(Poller::newPoller(this, backend)), 
     timer_manager_(make_unique<TimerManager>(this)),
+    poll_return_time_(MonoTimestamp::now()),
+    current_active_channel_(nullptr),
     wakeup_fd_(createEventfd()),
-    wakeup_channel_(this, wakeup_fd_)
+    wakeup_channel_(this, wakeup_fd_),
+    tasks_run_(0),
+    wakeups_(0),
+    cpu_(-1),
+    read_scratch_(new char[kReadScratchSize]),
+    num_connections_(0),
+    num_established_(0),
+    pending_output_bytes_(0),
+    busy_us_(0),
+    idle_us_(0),
+    spin_us_(0),
+    spin_duration_us_(0),
+    callback_timing_(false)
 {
     LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
     if (t_loopInThisThread) {
@@ -43,6 +66,7 @@ EventLoop::EventLoop()
         t_loopInThisThread = this;
     }
     wakeup_channel_.setReadCallback(bind(&EventLoop::handleWakeUp, this));
+    wakeup_channel_.setKind(LoopMetrics::kWakeup); 
     wakeup_channel_.enableReading(); 
 }
 
@@ -88,57 +112,105 @@ void EventLoop::loop() {
     quit_ = false; 
     LOG_TRACE << "EventLoop " << this << " start looping";
 
+    /* 耗时统计读取CycleClock, 未启用TSC时poll返回的时刻直接取poll_return_time_, 
+     * 故每轮只在本轮结束时再取一次时间; 开启回调计时时每个回调之后另取一次. 
+     */
+    bool use_tsc = CycleClock::isEnabled(); 
+    int64_t iteration_end = CycleClock::nowMicros(); 
+    int64_t last_active_time = iteration_end; 
     while (!quit_) {
         active_channels_.clear(); 
-        poll_return_time_ = epoller_->poll(kPollTimeMs, &active_channels_); 
+        bool timing = callback_timing_.load(memory_order_relaxed); 
+        // 自旋窗口内以零超时轮询. 
+        int64_t spin_us = spin_duration_us_.load(memory_order_relaxed); 
+        bool spinning = spin_us > 0 && iteration_end - last_active_time < spin_us; 
+        // 每轮至多重设一次timerfd; poll超时模式下以最早到期时间限定等待时间. 
+        int timeout_ms = timer_manager_->beforePoll(spinning ? 0 : kPollTimeMs); 
+        poll_return_time_ = epoller_->poll(timeout_ms, &active_channels_); 
+        int64_t poll_return_us = use_tsc ? CycleClock::nowMicros() : poll_return_time_.getMicroSecondsSinceEpoch(); 
+        int64_t wait_us = poll_return_us - iteration_end; 
+        record(metrics_.poll_wait_us, wait_us); 
+        metrics_.active_channels.record(active_channels_.size()); 
+        // 相邻回调共用一次取时, 开启回调计时时每个活跃channel只多一次取时. 
+        int64_t callback_start = poll_return_us; 
+        // poll超时模式下到期的定时器不经过channel, 其耗时同样计入定时器类回调. 
+        bool timers_fired = timer_manager_->afterPoll(poll_return_time_); 
+        if (timers_fired && timing) {
+            int64_t timers_end = CycleClock::nowMicros(); 
+            record(metrics_.callback_us[LoopMetrics::kTimer], timers_end - callback_start); 
+            callback_start = timers_end; 
+        }
         event_handling_ = true;
         for (auto& channel : active_channels_) {
             current_active_channel_ = channel; 
+            LoopMetrics::Kind kind = channel->getKind(); 
             current_active_channel_->handleEvents(poll_return_time_); 
+            if (timing) {
+                int64_t callback_end = CycleClock::nowMicros(); 
+                record(metrics_.callback_us[kind], callback_end - callback_start); 
+                callback_start = callback_end; 
+            }
         }
         current_active_channel_ = nullptr; 
         event_handling_ = false; 
-        doPendingFunctors();   
+        size_t n_tasks = doPendingFunctors();   
+        int64_t previous_end = iteration_end; 
+        iteration_end = CycleClock::nowMicros(); 
+        metrics_.functor_batch.record(n_tasks); 
+        if (n_tasks > 0 && timing) {
+            record(metrics_.functor_us, iteration_end - callback_start); 
+        }
+        record(metrics_.iteration_us, iteration_end - previous_end); 
+        bool active = !active_channels_.empty() || n_tasks > 0 || timers_fired; 
+        if (active) {
+            last_active_time = iteration_end; 
+        }
+        // 等待计入阻塞或自旋时间; 自poll返回至本轮结束即为忙碌时间, 但自旋且无事可做的一轮全部计入自旋时间. 
+        int64_t busy_us = iteration_end - poll_return_us; 
+        if (spinning && !active) {
+            wait_us += busy_us; 
+            busy_us = 0; 
+        }
+        if (wait_us > 0) {
+            increase(spinning ? spin_us_ : idle_us_, static_cast<uint64_t>(wait_us)); 
+        }
+        if (busy_us > 0) {
+            increase(busy_us_, static_cast<uint64_t>(busy_us)); 
+        }
     }
 
     LOG_TRACE << "EventLoop " << this << " stop looping";
     looping_ = false; 
 }
 
-void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors; 
-    calling_pending_functors_ = true; 
-    {
-        lock_guard<mutex> lock(mtx_); 
-        functors.swap(pending_functors_);  // 直接快速交换.
-    }
-    for (const auto& functor : functors) {
-        functor(); 
-    }
-    calling_pending_functors_ = false; 
+EventLoop::LoadStats EventLoop::getLoadStats() const {
+    LoadStats stats; 
+    stats.connections = num_connections_.load(memory_order_relaxed); 
+    stats.established = num_established_.load(memory_order_relaxed); 
+    stats.pending_output_bytes = pending_output_bytes_.load(memory_order_relaxed); 
+    stats.busy_us = busy_us_.load(memory_order_relaxed); 
+    stats.idle_us = idle_us_.load(memory_order_relaxed); 
+    stats.spin_us = spin_us_.load(memory_order_relaxed); 
+    return stats; 
 }
 
-
-
-void EventLoop::runInLoop(const Functor& cb) {
-    if (isInLoopThread()) {
-        cb(); 
-    } else {
-        addToQueueInLoop(cb); 
-    }
+EventLoop::TaskStats EventLoop::getTaskStats() const {
+    TaskStats stats; 
+    stats.tasks_run = tasks_run_.load(memory_order_relaxed); 
+    stats.wakeups = wakeups_.load(memory_order_relaxed); 
+    return stats; 
 }
 
-void EventLoop::addToQueueInLoop(const Functor& cb) {
-    {
-        lock_guard<mutex> lock(mtx_);
-        pending_functors_.push_back(cb); 
-    }
-    if (!isInLoopThread() || calling_pending_functors_) {
-        wakeup(); 
-    }
+size_t EventLoop::doPendingFunctors() {
+    calling_pending_functors_ = true; 
+    size_t n = pending_functors_.runAll();   // 一次取走全部任务, 不加锁
+    increase(tasks_run_, n); 
+    calling_pending_functors_ = false; 
+    return n; 
 }
 
 void EventLoop::wakeup() {
+    wakeups_.fetch_add(1, memory_order_relaxed); 
     uint64_t one = 1;
     ssize_t n = write(wakeup_fd_, &one, sizeof(one)); 
     if (n != sizeof(one)) {
@@ -175,21 +247,38 @@ void EventLoop::removeChannelFromEpoller(Channel* channel) {
 }
 
 
-weak_ptr<Timer> EventLoop::runAt(const Timestamp& time, const TimerCallback& cb) {
-    return timer_manager_->addTimer(cb, time, Duration(0)); 
+TimerId EventLoop::runAt(const Timestamp& time, TimerCallback cb) {
+    return runAt(MonoTimestamp::now() + (time - Timestamp::now()), std::move(cb)); 
 }
 
-weak_ptr<Timer> EventLoop::runAfter(const Duration& delay, const TimerCallback& cb) {
-    auto now = Timestamp::now(); 
-    return runAt(now + delay, cb);
+TimerId EventLoop::runAt(const MonoTimestamp& time, TimerCallback cb) {
+    return timer_manager_->addTimer(std::move(cb), time, Duration(0)); 
 }
 
-weak_ptr<Timer> EventLoop::runEvery(const Duration& interval, const TimerCallback& cb) {
-    return timer_manager_->addTimer(cb, Timestamp::now() + interval, interval); 
+TimerId EventLoop::runAfter(const Duration& delay, TimerCallback cb) {
+    auto now = MonoTimestamp::now(); 
+    return runAt(now + delay, std::move(cb));
 }
 
-void EventLoop::removeTimer(const weak_ptr<Timer>& wk_ptr_timer) {
-    timer_manager_->removeTimer(wk_ptr_timer); 
+TimerId EventLoop::runEvery(const Duration& interval, TimerCallback cb) {
+    return timer_manager_->addTimer(std::move(cb), MonoTimestamp::now() + interval, interval); 
+}
+
+void EventLoop::removeTimer(TimerId timer_id) {
+    timer_manager_->removeTimer(timer_id); 
+}
+
+void EventLoop::setTimerSlack(const Duration& slack) {
+    runInLoop([this, slack]() { timer_manager_->setSlack(slack); }); 
+}
+
+void EventLoop::usePollTimeoutForTimers() {
+    // 在channel回调(如timerfd的定时器回调)中调用时推迟到本轮的PendingFunctors, 不在timerfd的事件处理期间关闭它. 
+    if (isInLoopThread() && !event_handling_) {
+        timer_manager_->usePollTimeout(); 
+    } else {
+        addToQueueInLoop([this]() { timer_manager_->usePollTimeout(); }); 
+    }
 }
 
 int EventLoop::createEventfd() {
@@ -3,51 +3,142 @@
 #include <atomic>
 #include <vector>
 #include <memory>
-#include <mutex>
 #include <functional>
 
+#include "buffer_pool.h"
+#include "loop_metrics.h"
+#include "poller.h"
+#include "task_queue.h"
 #include "timer.h"
 #include "timestamp.h"
 #include "any.h"
 
 class Channel; 
 
-class Epoller;
-
 class EventLoop {
 public:
     using Functor = std::function<void()>; 
 
 public:
     EventLoop(); 
+    // 指定I/O多路复用后端, 不可用时退回epoll. 默认为Poller::getDefaultBackend(). 
+    explicit EventLoop(Poller::Backend backend); 
     ~EventLoop();
     void loop(); 
     void quit(); 
     bool isInLoopThread();
     void assertInLoopThread();
     void abortNotInLoopThread(); 
-    void runInLoop(const Functor& cb);         // 可供其他线程调用
-    void addToQueueInLoop(const Functor& cb);  // queueInLoop, 加入当前loop的PendingFunctors. 
+    // 可接受任意可调用对象, 经TaskQueue排队时不转换为std::function.
+    template <typename F>
+    void runInLoop(F&& cb);          // 可供其他线程调用
+    template <typename F>
+    void addToQueueInLoop(F&& cb);   // queueInLoop, 加入当前loop的PendingFunctors. 
 
     bool hasChannel(Channel* channel);
     void updateChannelInEpoller(Channel* channel);
     void removeChannelFromEpoller(Channel* channel); 
-
-    std::weak_ptr<Timer> runAt(const Timestamp& time, const TimerCallback& cb);
-    std::weak_ptr<Timer> runAfter(const Duration& delay, const TimerCallback& cb); 
-    std::weak_ptr<Timer> runEvery(const Duration& interval, const TimerCallback& cb); 
-    void removeTimer(const std::weak_ptr<Timer>& wk_ptr_timer);  
+    // Poller的注册/修改/注销与系统调用计数, 可由其他线程读取.
+    Poller::Stats getPollerStats() const { return epoller_->getStats(); }
+    // 实际使用的I/O多路复用后端(io_uring不可用时为epoll).
+    Poller::Backend getPollerBackend() const { return epoller_->getBackend(); }
+    // 设置内核在epoll_wait中忙轮询网卡队列的时长(见Poller::setBusyPoll). 
+    bool setPollerBusyPoll(int usecs, bool prefer) { return epoller_->setBusyPoll(usecs, prefer); }
+    // io_uring完成模式(见Poller), 仅限所属IO线程调用. 
+    bool supportsCompletion(Poller::Completion mode) const { return epoller_->supportsCompletion(mode); }
+    size_t takeAccepted(Channel* channel, int* results, size_t max) { return epoller_->takeAccepted(channel, results, max); }
+    ssize_t takeReceived(Channel* channel, Buffer* buffer, int* saved_errno) {
+        return epoller_->takeReceived(channel, buffer, saved_errno); 
+    }
+
+    /* 自适应自旋: 最近一次有事件或任务后的spin时间内, 以零超时轮询而不阻塞, 以CPU换取更低的唤醒延迟; 
+     * 超过后恢复阻塞等待. 0为关闭(默认). Thread safe, 下一轮生效. 
+     */
+    void setSpinDuration(const Duration& spin) { spin_duration_us_.store(spin.count(), std::memory_order_relaxed); }
+    /* 按channel类型记录回调耗时(LoopMetrics::callback_us)与PendingFunctors耗时(functor_us), 每个回调之后多读取一次时钟. 
+     * 关闭时(默认)每轮只在poll返回与本轮结束时各取一次时间. Thread safe, 下一轮生效. 
+     */
+    void setCallbackTiming(bool on) { callback_timing_.store(on, std::memory_order_relaxed); }
+
+    // PendingFunctors计数, 可由其他线程读取.
+    struct TaskStats {
+        uint64_t tasks_run;   // 已执行的任务数
+        uint64_t wakeups;     // 实际写eventfd的次数, 同一批任务只唤醒一次
+    };
+    TaskStats getTaskStats() const; 
+
+    // 负载指标, 由所属IO线程更新, 可由其他线程读取. 供EventLoopThreadPool为新连接选择IO线程.
+    struct LoadStats {
+        int64_t connections;            // 已建立的连接数
+        uint64_t established;           // 累计建立的连接数
+        int64_t pending_output_bytes;   // 各连接发送队列中尚未写出的字节数之和
+        uint64_t busy_us;               // 累计处理就绪事件与任务的时间(不含阻塞等待)
+        uint64_t idle_us;               // 累计阻塞等待的时间
+        uint64_t spin_us;               // 累计自旋(零超时轮询)的时间
+    };
+    LoadStats getLoadStats() const; 
+
+    // 每轮循环时间、活跃channel数、PendingFunctors队列深度与耗时、各类channel回调耗时(见setCallbackTiming)的直方图. 
+    // 由所属IO线程记录, 可由其他线程无锁读取. 
+    const LoopMetrics& getMetrics() const { return metrics_; }
+    // 以下两个仅限所属IO线程调用. 
+    void addConnectionCount(int64_t delta) {
+        increase(num_connections_, delta); 
+        if (delta > 0) {
+            increase(num_established_, delta); 
+        }
+    }
+    void addPendingOutputBytes(int64_t delta) { increase(pending_output_bytes_, delta); }
+
+    // 墙上时间按调用时与当前时间之差换算为单调时间, 其后调整系统时间不影响定时器. 
+    TimerId runAt(const Timestamp& time, TimerCallback cb);
+    TimerId runAt(const MonoTimestamp& time, TimerCallback cb);
+    TimerId runAfter(const Duration& delay, TimerCallback cb); 
+    TimerId runEvery(const Duration& interval, TimerCallback cb); 
+    void removeTimer(TimerId timer_id);  
+    // 定时器数量与timerfd重设次数, 仅限所属IO线程调用. 
+    TimerManager::Stats getTimerStats() const { return timer_manager_->getStats(); }
+    // 定时器的合并窗口, 见TimerManager::setSlack(). 可供其他线程调用. 
+    void setTimerSlack(const Duration& slack); 
+    /* 以poll超时代替timerfd驱动定时器, 见TimerManager::usePollTimeout(). 可供其他线程调用, 不可恢复. 
+     * 其他线程添加的定时器经PendingFunctors唤醒本loop后加入, 下一轮poll的超时时间随之缩短. 
+     */
+    void usePollTimeoutForTimers(); 
+
+    /* 本轮poll返回的时刻, 每轮循环只读取一次时钟. 仅限所属IO线程调用. 
+     * 比实际时间略早(至多为本轮已处理事件与任务的时间), 适用于超时判断等不要求精确的场合. 
+     */
+    MonoTimestamp getPollReturnTime() const { return poll_return_time_; }
 
     // 线程局部存储持续性, 保证每个线程只有一个EventLoop实例.
     static thread_local EventLoop* t_loopInThisThread;  
     static EventLoop* getEventLoopInThisThread() { return t_loopInThisThread; }
 
+    // 所属线程绑定的CPU, 未绑定时为-1. 
+    int getCpu() const { return cpu_; }
+    void setCpu(int cpu) { cpu_ = cpu; }
+
     // 归属当前EventLoop的额外上下文
     void setContext(const Any& context) { context_ = context; }
     Any* getMutableContext() { return &context_; }
 
+    // 本loop内各TcpConnection共用的Buffer存储池, 仅限所属IO线程使用.
+    BufferPool* getBufferPool() { return &buffer_pool_; }
+    // 本loop内各TcpConnection读取时共用的临时缓冲区, 替代每次读取时的64KB栈上缓冲区.
+    char* getReadScratch() { return read_scratch_.get(); }
+    static const size_t kReadScratchSize = 64 * 1024; 
+
 private:
-    void doPendingFunctors();        
+    size_t doPendingFunctors();      // 返回执行的任务数
+    // 计数器仅由所属IO线程写入, 无需原子的读-改-写.
+    template <typename T, typename D>
+    static void increase(std::atomic<T>& counter, D delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed); 
+    }
+    // 时钟回拨时记为0. 
+    static void record(Histogram& histogram, int64_t value) {
+        histogram.record(value > 0 ? static_cast<uint64_t>(value) : 0); 
+    }
 
     void wakeup();        // 在addToQueueInLoop()中使用时, 用于唤醒目标线程的EventLoop, 防止阻塞在epoll_wait.
     void handleWakeUp();  
@@ -63,9 +154,9 @@ private:
     std::atomic<bool> event_handling_; 
     const pid_t threadId_; 
 
-    std::unique_ptr<Epoller> epoller_; 
+    std::unique_ptr<Poller> epoller_; 
     std::unique_ptr<TimerManager> timer_manager_; 
-    Timestamp poll_return_time_; 
+    MonoTimestamp poll_return_time_; 
 
     ChannelList active_channels_;
     Channel* current_active_channel_; 
@@ -74,7 +165,41 @@ private:
     // std::unique_ptr<Channel> wakeup_channel_; 
     Channel wakeup_channel_; 
     
-    std::mutex mtx_; 
-    std::vector<Functor> pending_functors_;  // guarded by mutex_
+    TaskQueue pending_functors_; 
+    std::atomic<uint64_t> tasks_run_; 
+    std::atomic<uint64_t> wakeups_; 
     Any context_;
-};
\ No newline at end of file
+    int cpu_; 
+    BufferPool buffer_pool_;
+    std::unique_ptr<char[]> read_scratch_;
+
+    std::atomic<int64_t> num_connections_; 
+    std::atomic<uint64_t> num_established_; 
+    std::atomic<int64_t> pending_output_bytes_; 
+    std::atomic<uint64_t> busy_us_; 
+    std::atomic<uint64_t> idle_us_; 
+    std::atomic<uint64_t> spin_us_; 
+    std::atomic<int64_t> spin_duration_us_; 
+    std::atomic<bool> callback_timing_; 
+    LoopMetrics metrics_; 
+};
+
+
+template <typename F>
+void EventLoop::runInLoop(F&& cb) {
+    if (isInLoopThread()) {
+        cb(); 
+    } else {
+        addToQueueInLoop(std::forward<F>(cb)); 
+    }
+}
+
+template <typename F>
+void EventLoop::addToQueueInLoop(F&& cb) {
+    pending_functors_.push(std::forward<F>(cb)); 
+    // 在所属线程中且不在执行PendingFunctors时, 本轮稍后即会执行, 无需唤醒. 
+    // 否则只有自上次执行以来的第一个任务唤醒, 其余不重复写eventfd. 
+    if ((!isInLoopThread() || calling_pending_functors_) && pending_functors_.claimWakeup()) {
+        wakeup(); 
+    }
+}
\ No newline at end of file
@@ -10,7 +10,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const string& nam
     : loop_(nullptr),
     thread_(bind(&EventLoopThread::threadFunc, this), name), 
     exiting_(false),
-    init_callback_(cb) {}
+    init_callback_(cb),
+    cpu_(-1) {}
 
 EventLoopThread::~EventLoopThread() {
     exiting_ = true;
@@ -38,7 +39,16 @@ EventLoop* EventLoopThread::startLoop() {
 }
 
 void EventLoopThread::threadFunc() {
+    int node = -1; 
+    bool bound = cpu_ >= 0 && CurrentThread::bindToCpu(cpu_, &node); 
+    if (cpu_ >= 0 && !bound) {
+        LOG_SYSERR << "EventLoopThread::threadFunc() failed to bind thread " << CurrentThread::name() << " to CPU " << cpu_; 
+    }
     EventLoop loop;  // 创建EventLoop. 其构造函数本身保证每个线程下只能存在一个EventLoop对象.
+    if (bound) {
+        loop.setCpu(cpu_); 
+        LOG_INFO << "EventLoopThread " << CurrentThread::name() << " bound to CPU " << cpu_ << ", NUMA node " << node; 
+    }
     if (init_callback_) {
         init_callback_(&loop); 
     }
@@ -16,6 +16,8 @@ public:
 public:
     EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), const std::string& name = ""); 
     ~EventLoopThread(); 
+    // 线程启动后、创建EventLoop之前绑定到该CPU, EventLoop及其缓冲区分配在本地NUMA节点. 须在startLoop()之前调用.
+    void setCpu(int cpu) { cpu_ = cpu; }
     EventLoop* startLoop(); 
 
 private:
@@ -28,4 +30,5 @@ private:
     std::mutex mtx_;  
     std::condition_variable cond_;  // GUARDED_BY(mtx_)
     ThreadInitCallback init_callback_; 
+    int cpu_; 
 };
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "eventloop_threadpool.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "eventloop.h"
+#include "logger.h"
 
 using namespace std;
 
@@ -11,10 +13,23 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* base_loop, const string& nam
     name_(name),
     started_(false),
     num_threads_(0),
-    next_(0)
+    next_(0),
+    placement_(Placement::ROUND_ROBIN),
+    rng_(random_device{}())
 {
 }
 
+const int64_t EventLoopThreadPool::kBusySampleIntervalUs;
+
+const char* EventLoopThreadPool::getPlacementName(Placement placement) {
+    switch (placement) {
+        case Placement::LEAST_CONNECTIONS: return "least connections"; 
+        case Placement::LEAST_PENDING_BYTES: return "least pending bytes"; 
+        case Placement::POWER_OF_TWO_BUSY: return "power of two choices on busy time"; 
+        default: return "round-robin"; 
+    }
+}
+
 
 EventLoopThreadPool::~EventLoopThreadPool() {
 }
@@ -24,26 +39,120 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
     assert(!started_);
     base_loop_->assertInLoopThread(); 
     started_ = true;
+    if (!cpus_.empty()) {
+        int node = -1; 
+        if (CurrentThread::bindToCpu(cpus_[0], &node)) {
+            base_loop_->setCpu(cpus_[0]); 
+            LOG_INFO << "EventLoopThreadPool::start base loop bound to CPU " << cpus_[0] << ", NUMA node " << node; 
+        } else {
+            LOG_SYSERR << "EventLoopThreadPool::start failed to bind base loop to CPU " << cpus_[0]; 
+        }
+    }
     for (int i = 0; i < num_threads_; ++i) {
-        threads_.push_back(make_unique<EventLoopThread>(cb, name_ + to_string(i))); 
+        // 线程名形如"HttpServer-io0", 可在top -H等工具中区分各IO线程.
+        threads_.push_back(make_unique<EventLoopThread>(cb, name_ + "-io" + to_string(i))); 
+        if (!cpus_.empty()) {
+            threads_.back()->setCpu(cpus_[(i + 1) % cpus_.size()]); 
+        }
         loops_.push_back(threads_.back()->startLoop()); 
     }
+    placed_.assign(loops_.size(), 0); 
+    last_busy_us_.assign(loops_.size(), 0); 
+    recent_busy_us_.assign(loops_.size(), 0); 
     if (num_threads_ == 0 && cb) {  
         cb(base_loop_);     // 单线程, baseloop所在线程即作为io线程. 
     }
 }
 
-// 以round-robin方式选取
 EventLoop* EventLoopThreadPool::getNextLoop() {
     base_loop_->assertInLoopThread(); 
     assert(started_); 
-    EventLoop* loop = base_loop_;  
-    if (!loops_.empty()) {
-        loop = loops_[next_]; 
-        ++next_; 
-        if (static_cast<size_t>(next_) >= loops_.size()) {
-            next_ = 0; 
+    if (loops_.empty()) {
+        return base_loop_; 
+    }
+    size_t idx; 
+    switch (placement_) {
+        case Placement::LEAST_CONNECTIONS: 
+            idx = getLeastLoaded(false); 
+            break; 
+        case Placement::LEAST_PENDING_BYTES: 
+            idx = getLeastLoaded(true); 
+            break; 
+        case Placement::POWER_OF_TWO_BUSY: 
+            idx = getLessBusyOfTwo(); 
+            break; 
+        default: 
+            idx = next_;   // 以round-robin方式选取
+            break; 
+    }
+    next_ = static_cast<int>((idx + 1) % loops_.size()); 
+    ++placed_[idx]; 
+    return loops_[idx]; 
+}
+
+int64_t EventLoopThreadPool::getEffectiveConnections(size_t idx, const EventLoop::LoadStats& stats) const {
+    int64_t in_flight = static_cast<int64_t>(placed_[idx] - std::min(placed_[idx], stats.established)); 
+    return stats.connections + in_flight; 
+}
+
+// 选取指标最小者: 按连接数, 或按积压字节数(相同时再按连接数). 
+// 指标相同时从轮询位置开始比较, 避免总是偏向前面的loop.
+size_t EventLoopThreadPool::getLeastLoaded(bool by_pending_bytes) {
+    size_t n = loops_.size(); 
+    size_t best = 0; 
+    pair<int64_t, int64_t> best_load; 
+    for (size_t i = 0; i < n; ++i) {
+        size_t idx = (next_ + i) % n; 
+        EventLoop::LoadStats stats = loops_[idx]->getLoadStats(); 
+        int64_t conns = getEffectiveConnections(idx, stats); 
+        pair<int64_t, int64_t> load = by_pending_bytes ? make_pair(stats.pending_output_bytes, conns) : make_pair(conns, int64_t(0)); 
+        if (i == 0 || load < best_load) {
+            best = idx; 
+            best_load = load; 
         }
-    } 
-    return loop; 
+    }
+    return best; 
+}
+
+// power of two choices: 随机取两个loop, 选近期忙碌时间较少者, 相同时选连接数较少者. 
+// 只比较两个指标, 不必遍历全部loop, 也避免所有新连接同时涌向同一个"最空闲"的loop.
+size_t EventLoopThreadPool::getLessBusyOfTwo() {
+    size_t n = loops_.size(); 
+    if (n == 1) {
+        return 0; 
+    }
+    sampleBusyTime(); 
+    size_t a = rng_() % n; 
+    size_t b = rng_() % (n - 1); 
+    if (b >= a) {
+        ++b;   // 保证两者不同
+    }
+    if (recent_busy_us_[a] != recent_busy_us_[b]) {
+        return recent_busy_us_[a] < recent_busy_us_[b] ? a : b; 
+    }
+    int64_t conns_a = getEffectiveConnections(a, loops_[a]->getLoadStats()); 
+    int64_t conns_b = getEffectiveConnections(b, loops_[b]->getLoadStats()); 
+    return conns_a <= conns_b ? a : b; 
+}
+
+// 累计忙碌时间每隔kBusySampleIntervalUs采样一次, 取窗口内的增量作为近期负载.
+void EventLoopThreadPool::sampleBusyTime() {
+    MonoTimestamp now = base_loop_->getPollReturnTime(); 
+    if ((now - last_sample_time_).count() < kBusySampleIntervalUs) {
+        return; 
+    }
+    last_sample_time_ = now; 
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        uint64_t busy = loops_[i]->getLoadStats().busy_us; 
+        recent_busy_us_[i] = busy - last_busy_us_[i]; 
+        last_busy_us_[i] = busy; 
+    }
+}
+
+vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
+    assert(started_); 
+    if (loops_.empty()) {
+        return vector<EventLoop*>(1, base_loop_); 
+    }
+    return loops_; 
 }
\ No newline at end of file
@@ -1,30 +1,55 @@
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <random>
 #include <vector>
 
+#include "eventloop.h"
 #include "eventloop_thread.h"
 
-class EventLoop;
-
 class EventLoopThreadPool {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
+    // 新连接的IO线程选择策略, 依据各EventLoop发布的负载指标(EventLoop::LoadStats). 
+    enum class Placement {
+        ROUND_ROBIN = 0,       // 轮询
+        LEAST_CONNECTIONS,     // 已建立连接数最少
+        LEAST_PENDING_BYTES,   // 发送队列积压字节数最少(长时间下载集中时)
+        POWER_OF_TWO_BUSY,     // 随机取两个, 选近期忙碌时间较少者
+    };
+
 public:
     EventLoopThreadPool(EventLoop* base_loop, const std::string& name); 
     ~EventLoopThreadPool(); 
 
     void setThreadNum(int num_thread) { num_threads_ = num_thread; }
+    void setPlacement(Placement placement) { placement_ = placement; }
+    Placement getPlacement() const { return placement_; }
+    static const char* getPlacementName(Placement placement);
+    // 绑定CPU: base loop所在线程绑定到cpus[0], 第i个IO线程绑定到cpus[(i+1) % cpus.size()]; 
+    // 无IO线程时base loop即IO线程. 为空时不绑定. 须在start()之前调用.
+    void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
     // the two function valid after calling start()
-    EventLoop* getNextLoop();    // round-robin
-    std::vector<EventLoop*> getAllLoops() { return loops_;  } 
+    EventLoop* getNextLoop();    // 按placement选取
+    std::vector<EventLoop*> getAllLoops();   // 无IO线程时返回base_loop, 与getNextLoop一致
 
     bool isStarted() const { return started_; }
     const std::string& getName() const { return name_; }
 
 private:
+    // 已建立的连接数加上已分配但尚未建立的连接数, 使同一批新连接不会都分给同一个loop.
+    int64_t getEffectiveConnections(size_t idx, const EventLoop::LoadStats& stats) const; 
+    size_t getLeastLoaded(bool by_pending_bytes);   // 返回loops_下标
+    size_t getLessBusyOfTwo(); 
+    void sampleBusyTime(); 
+
+private:
+    // POWER_OF_TWO_BUSY: 两次采样之间的最小间隔, 以此窗口内的忙碌时间衡量近期负载.
+    static const int64_t kBusySampleIntervalUs = 10 * 1000; 
+
     EventLoop* base_loop_;
     std::string name_; 
     bool started_; 
@@ -32,5 +57,12 @@ private:
     int next_;  
     std::vector<std::unique_ptr<EventLoopThread>> threads_; 
     std::vector<EventLoop*> loops_;
+    Placement placement_; 
+    std::vector<int> cpus_; 
+    std::vector<uint64_t> placed_;           // 由本线程池分配给各loop的连接数
+    std::vector<uint64_t> last_busy_us_;     // 上次采样时各loop的累计忙碌时间
+    std::vector<uint64_t> recent_busy_us_;   // 最近一个采样窗口内的忙碌时间
+    MonoTimestamp last_sample_time_; 
+    std::minstd_rand rng_; 
 
 };
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "loop_metrics.h"
+
+#include <cstdio>
+
+using namespace std;
+
+const int Histogram::kSubBucketBits;
+const uint64_t Histogram::kSubBuckets;
+const int Histogram::kMaxExponent;
+const size_t Histogram::kNumBuckets;
+
+
+Histogram::Histogram()
+    : count_(0),
+    sum_(0),
+    max_(0)
+{
+    for (auto& bucket : buckets_) {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snap;
+    snap.buckets.resize(kNumBuckets);
+    snap.count = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        snap.buckets[i] = buckets_[i].load(memory_order_relaxed);
+        snap.count += snap.buckets[i];   // 以各桶之和为准, 与分位数计算一致
+    }
+    snap.sum = sum_.load(memory_order_relaxed);
+    snap.max = max_.load(memory_order_relaxed);
+    return snap;
+}
+
+uint64_t Histogram::bucketUpperBound(size_t idx) {
+    if (idx < kSubBuckets) {
+        return idx;
+    }
+    size_t shift = (idx - kSubBuckets) / kSubBuckets;
+    uint64_t sub = (idx - kSubBuckets) % kSubBuckets;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100 * count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+
+const char* LoopMetrics::getKindName(int kind) {
+    switch (kind) {
+        case kWakeup: return "wakeup";
+        case kTimer: return "timer";
+        case kAcceptor: return "acceptor";
+        case kConnection: return "connection";
+        default: return "other";
+    }
+}
+
+string LoopMetrics::summary() const {
+    string result;
+    auto append = [&result](const string& name, const Histogram& histogram) {
+        Histogram::Snapshot snap = histogram.snapshot();
+        if (snap.count == 0) {
+            return;
+        }
+        char line[160];
+        snprintf(line, sizeof(line), "%s count=%llu mean=%.1f p50=%llu p99=%llu max=%llu\n",
+                 name.c_str(),
+                 static_cast<unsigned long long>(snap.count), snap.mean(),
+                 static_cast<unsigned long long>(snap.percentile(50)),
+                 static_cast<unsigned long long>(snap.percentile(99)),
+                 static_cast<unsigned long long>(snap.max));
+        result += line;
+    };
+    append("iteration_us", iteration_us);
+    append("poll_wait_us", poll_wait_us);
+    append("active_channels", active_channels);
+    append("functor_batch", functor_batch);
+    append("functor_us", functor_us);
+    for (int kind = 0; kind < kNumKinds; ++kind) {
+        append(string("callback_us.") + getKindName(kind), callback_us[kind]);
+    }
+    return result;
+}
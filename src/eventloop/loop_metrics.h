@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* 对数-线性分桶的直方图(HDR风格): 小于16的值各占一个桶, 此后每个2的幂区间等分为16个桶, 相对误差不超过1/16.
+ *
+ * 仅由一个线程(所属IO线程)record, 各桶为relaxed原子计数, 其他线程可随时无锁读取快照;
+ * 快照不保证各桶之间的一致性, 但每个计数都是某一时刻的真实值, 足以估计分位数.
+ * record只有一次位运算与一次非竞争的原子写, 不加锁也没有读-改-写指令.
+ */
+class Histogram {
+public:
+    static const int kSubBucketBits = 4;
+    static const uint64_t kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxExponent = 40;    // 超过2^41的值计入最后一个桶
+    static const size_t kNumBuckets = kSubBuckets + (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    struct Snapshot {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        std::vector<uint64_t> buckets;
+
+        double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0; }
+        // 第p(0~100)百分位数所在桶的上界.
+        uint64_t percentile(double p) const;
+    };
+
+public:
+    Histogram();
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(uint64_t value) {
+        size_t idx = bucketIndex(value);
+        increase(buckets_[idx], 1);
+        increase(count_, 1);
+        increase(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+    Snapshot snapshot() const;   // Thread safe.
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        int exponent = 63 - __builtin_clzll(value);   // value >= 16, exponent >= 4
+        if (exponent > kMaxExponent) {
+            return kNumBuckets - 1;
+        }
+        int shift = exponent - kSubBucketBits;
+        size_t sub = static_cast<size_t>((value >> shift) - kSubBuckets);
+        return kSubBuckets + static_cast<size_t>(shift) * kSubBuckets + sub;
+    }
+    // 桶内的最大值.
+    static uint64_t bucketUpperBound(size_t idx);
+
+private:
+    static void increase(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[kNumBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+/* EventLoop的运行指标, 由所属IO线程记录, 其他线程可无锁读取(Histogram::snapshot).
+ * 时间单位均为微秒.
+ */
+struct LoopMetrics {
+    // 按channel类型区分回调耗时, 由channel的持有者设置(Channel::setKind).
+    enum Kind { kOther = 0, kWakeup, kTimer, kAcceptor, kConnection, kNumKinds };
+    static const char* getKindName(int kind);
+
+    Histogram iteration_us;        // 一轮循环的总时间(含等待)
+    Histogram poll_wait_us;        // poll等待的时间
+    Histogram active_channels;     // 每次poll返回的活跃channel数
+    Histogram functor_batch;       // 每轮执行的PendingFunctors数(队列深度)
+    // 以下仅在EventLoop::setCallbackTiming(true)时记录.
+    Histogram functor_us;          // 每轮执行PendingFunctors的时间
+    Histogram callback_us[kNumKinds];   // 单个channel的handleEvents时间, 定时器回调计入kTimer
+
+    // 按"名称 count/mean/p50/p99/max"逐行输出非空的直方图, 供日志记录.
+    std::string summary() const;
+};
@@ -0,0 +1,98 @@
+#include "task_queue.h"
+
+using namespace std;
+
+const size_t TaskQueue::kInlineSize;
+const uint32_t TaskQueue::kSlabSize;
+
+
+TaskQueue::TaskQueue()
+  : head_(nullptr),
+    wakeup_pending_(false),
+    slab_(new Node[kSlabSize]),
+    free_top_(0) {
+    for (uint32_t i = 0; i < kSlabSize; ++i) {
+        slab_[i].free_next.store(i + 1 < kSlabSize ? i + 2 : 0, memory_order_relaxed);
+    }
+    free_top_.store(makeTop(0, 1), memory_order_release);
+}
+
+TaskQueue::~TaskQueue() {
+    freeList(head_.exchange(nullptr, memory_order_acquire));
+}
+
+size_t TaskQueue::runAll() {
+    // 先允许唤醒再取任务: 此后加入的任务若未被本次取走, 其生产者必定会再次唤醒.
+    wakeup_pending_.exchange(false, memory_order_acq_rel);
+    Node* node = takeReversed(head_.exchange(nullptr, memory_order_acquire));
+    size_t n = 0;
+    Node* first = nullptr;   // 本批执行完、待归还空闲栈的节点
+    Node* last = nullptr;
+    while (node) {
+        Node* next = node->next;
+        node->invoke(node);
+        if (inSlab(node)) {
+            node->free_next.store(first ? static_cast<uint32_t>(first - slab_.get()) + 1 : 0,
+                                  memory_order_relaxed);
+            first = node;
+            last = last ? last : node;
+        } else {
+            delete node;
+        }
+        node = next;
+        ++n;
+    }
+    if (first) {
+        releaseNodes(first, last);
+    }
+    return n;
+}
+
+// 从空闲栈弹出一个节点, 栈空时临时分配. 版本号随每次修改栈顶递增, 
+// 读取free_next后栈顶若已被其他线程弹出又压回, CAS会因版本号不同而失败.
+TaskQueue::Node* TaskQueue::allocNode() {
+    uint64_t top = free_top_.load(memory_order_acquire);
+    while (topIndex(top) != 0) {
+        Node* node = &slab_[topIndex(top) - 1];
+        uint32_t next = node->free_next.load(memory_order_relaxed);
+        if (free_top_.compare_exchange_weak(top, makeTop(top, next),
+                                            memory_order_acquire,
+                                            memory_order_acquire)) {
+            return node;
+        }
+    }
+    return new Node;
+}
+
+void TaskQueue::releaseNodes(Node* first, Node* last) {
+    uint32_t index = static_cast<uint32_t>(first - slab_.get()) + 1;
+    uint64_t top = free_top_.load(memory_order_relaxed);
+    do {
+        last->free_next.store(topIndex(top), memory_order_relaxed);
+    } while (!free_top_.compare_exchange_weak(top, makeTop(top, index),
+                                              memory_order_release,
+                                              memory_order_relaxed));
+}
+
+// 将LIFO链表反转为加入顺序.
+TaskQueue::Node* TaskQueue::takeReversed(Node* head) {
+    Node* prev = nullptr;
+    while (head) {
+        Node* next = head->next;
+        head->next = prev;
+        prev = head;
+        head = next;
+    }
+    return prev;
+}
+
+void TaskQueue::freeList(Node* node) {
+    while (node) {
+        Node* next = node->next;
+        node->destroy(node);
+        if (!inSlab(node)) {
+            delete node;
+        }
+        node = next;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/* EventLoop待执行任务的无锁队列: 多生产者(任意线程push)、单消费者(所属IO线程runAll).
+ *
+ * - 节点复用: 每个队列预先分配kSlabSize个节点, 空闲节点组成无锁栈, 生产者从中弹出, 消费者执行完一批后
+ *   一次性归还; 以带版本号的下标作为栈顶避免ABA. 空闲栈耗尽时才临时new节点, 执行后delete.
+ *   可调用对象不超过kInlineSize时直接构造在节点内(small buffer), 不经过std::function; 超过时才单独分配.
+ * - 生产者以CAS压入栈顶; 消费者以一次exchange取走整条链表并反转为FIFO顺序执行.
+ *   执行期间新加入的任务留待下一次runAll, 与原先交换vector的语义一致.
+ * - 唤醒抑制: 自上次runAll开始后, 只有第一个需要唤醒的生产者claimWakeup()返回true,
+ *   其余不必重复写eventfd, 消费者开始处理时重新允许唤醒.
+ */
+class TaskQueue {
+public:
+    static const size_t kInlineSize = 48;
+    static const uint32_t kSlabSize = 256;   // 预分配的节点数
+
+public:
+    TaskQueue(); 
+    ~TaskQueue();   // 释放未执行的任务(不执行)
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+
+    // 线程安全.
+    template <typename F>
+    void push(F&& f);
+    // 在push之后调用, 返回调用方是否需要唤醒消费者. 线程安全.
+    bool claimWakeup() { return !wakeup_pending_.exchange(true, std::memory_order_acq_rel); }
+    // 执行当前已加入的全部任务, 返回执行的数量. 仅限消费者线程调用.
+    size_t runAll();
+    bool empty() const { return head_.load(std::memory_order_acquire) == nullptr; }
+
+private:
+    struct Node {
+        Node* next;
+        void (*invoke)(Node*);    // 执行并析构可调用对象
+        void (*destroy)(Node*);   // 仅析构可调用对象
+        std::atomic<uint32_t> free_next;   // 空闲栈中下一节点的下标+1, 0表示栈底
+        alignas(std::max_align_t) unsigned char storage[kInlineSize];
+    };
+
+    template <typename Fn, bool kInline = (sizeof(Fn) <= kInlineSize &&
+                                           alignof(Fn) <= alignof(std::max_align_t))>
+    struct Ops;
+
+    static Node* takeReversed(Node* head);
+    void freeList(Node* node);
+
+    Node* allocNode(); 
+    bool inSlab(const Node* node) const { return node >= slab_.get() && node < slab_.get() + kSlabSize; }
+    // 将first..last(以free_next相连)整段压回空闲栈.
+    void releaseNodes(Node* first, Node* last); 
+
+    static uint32_t topIndex(uint64_t top) { return static_cast<uint32_t>(top); }
+    static uint64_t makeTop(uint64_t old_top, uint32_t index) { return ((old_top >> 32) + 1) << 32 | index; }
+
+private:
+    std::atomic<Node*> head_;            // 最近压入的任务, 链表为LIFO顺序
+    std::atomic<bool> wakeup_pending_;
+    std::unique_ptr<Node[]> slab_; 
+    std::atomic<uint64_t> free_top_;     // 高32位为版本号, 低32位为栈顶节点下标+1
+};
+
+// 可调用对象直接构造在节点内.
+template <typename Fn>
+struct TaskQueue::Ops<Fn, true> {
+    template <typename F>
+    static void construct(Node* node, F&& f) {
+        ::new (static_cast<void*>(node->storage)) Fn(std::forward<F>(f));
+    }
+    static Fn* get(Node* node) { return reinterpret_cast<Fn*>(node->storage); }
+    static void invoke(Node* node) {
+        Fn* fn = get(node);
+        (*fn)();
+        fn->~Fn();
+    }
+    static void destroy(Node* node) { get(node)->~Fn(); }
+};
+
+// 可调用对象过大, 节点内只保存指针.
+template <typename Fn>
+struct TaskQueue::Ops<Fn, false> {
+    template <typename F>
+    static void construct(Node* node, F&& f) {
+        ::new (static_cast<void*>(node->storage)) Fn*(new Fn(std::forward<F>(f)));
+    }
+    static Fn* get(Node* node) { return *reinterpret_cast<Fn**>(node->storage); }
+    static void invoke(Node* node) {
+        Fn* fn = get(node);
+        (*fn)();
+        delete fn;
+    }
+    static void destroy(Node* node) { delete get(node); }
+};
+
+template <typename F>
+void TaskQueue::push(F&& f) {
+    using Fn = typename std::decay<F>::type;
+    Node* node = allocNode();
+    Ops<Fn>::construct(node, std::forward<F>(f));
+    node->invoke = &Ops<Fn>::invoke;
+    node->destroy = &Ops<Fn>::destroy;
+    node->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(node->next, node,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+    }
+}
@@ -0,0 +1,121 @@
+#include "compress_cache.h"
+
+#include <cassert>
+#include <cstring>
+#include <zlib.h>
+
+#include "logger.h"
+
+using namespace std;
+
+CompressCache::CompressCache(size_t capacity_bytes)
+    : capacity_(capacity_bytes),
+    bytes_(0),
+    hits_(0),
+    misses_(0),
+    evictions_(0)
+{
+}
+
+
+CompressCache::EntryPtr CompressCache::get(const string& path, const char* encoding, const string& source_etag) {
+    string key = path + '\n' + encoding;
+    lock_guard<mutex> lock(mtx_);
+    auto it = map_.find(key);
+    if (it == map_.end() || it->second.entry->source_etag != source_etag) {
+        ++misses_;
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru_pos);  // 移至头部
+    ++hits_;
+    return it->second.entry;
+}
+
+
+CompressCache::EntryPtr CompressCache::compress(const string& path,
+                                                const char* encoding,
+                                                const string& source_etag,
+                                                const char* data,
+                                                size_t len)
+{
+    auto entry = make_shared<Entry>();
+    entry->source_etag = source_etag;
+    if (!zlibCompress(encoding, data, len, &entry->data) || 
+        entry->data.size() >= len ||           // 压缩无收益
+        entry->data.size() > capacity_)
+    {
+        return nullptr;
+    }
+    LOG_DEBUG << "CompressCache::compress " << path << " " << encoding 
+              << " " << len << " -> " << entry->data.size();
+
+    string key = path + '\n' + encoding;
+    lock_guard<mutex> lock(mtx_);
+    auto it = map_.find(key);
+    if (it != map_.end()) {  // 旧版本或其他IO线程已抢先压缩, 以新结果为准.
+        bytes_ -= it->second.entry->data.size();
+        lru_.erase(it->second.lru_pos);
+        map_.erase(it);
+    }
+    evictUntilFit(entry->data.size());
+    lru_.push_front(key);
+    map_[key] = Node{entry, lru_.begin()};
+    bytes_ += entry->data.size();
+    return entry;
+}
+
+
+bool CompressCache::zlibCompress(const char* encoding, const char* data, size_t len, string* out) {
+    int window_bits = 0;
+    if (strcmp(encoding, "gzip") == 0) {
+        window_bits = 15 + 16;     // gzip封装
+    } else if (strcmp(encoding, "deflate") == 0) {
+        window_bits = 15;          // HTTP的deflate即zlib封装
+    } else {
+        return false;
+    }
+    z_stream stream {};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        LOG_ERROR << "CompressCache::zlibCompress deflateInit2 failed";
+        return false;
+    }
+    out->resize(deflateBound(&stream, len));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = len;
+    stream.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+    stream.avail_out = out->size();
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        LOG_ERROR << "CompressCache::zlibCompress deflate failed, ret: " << ret;
+        out->clear();
+        return false;
+    }
+    out->resize(stream.total_out);
+    out->shrink_to_fit();
+    return true;
+}
+
+
+void CompressCache::evictUntilFit(size_t incoming) {
+    while (!lru_.empty() && bytes_ + incoming > capacity_) {
+        auto it = map_.find(lru_.back());
+        assert(it != map_.end());
+        bytes_ -= it->second.entry->data.size();
+        map_.erase(it);
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
+
+
+CompressCache::Stats CompressCache::getStats() const {
+    Stats stats;
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.misses = misses_.load(memory_order_relaxed);
+    stats.evictions = evictions_.load(memory_order_relaxed);
+    lock_guard<mutex> lock(mtx_);
+    stats.entries = map_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* 静态资源压缩结果缓存.
+ *
+ * 无预压缩文件(foo.js.gz/foo.js.br)时, 以zlib即时压缩文本类资源, 压缩结果缓存于内存,
+ * 后续请求直接复用, 每个版本的文件只压缩一次.
+ *
+ * - 以"URL路径 + 编码"为键, 记录源文件的ETag; 源文件变化(ETag不同)时视为未命中, 重新压缩后覆盖.
+ * - 总字节数受capacity限制, 超出时按LRU淘汰.
+ * - 所有IO线程共享同一实例, 内部以互斥锁保护; 压缩在锁外进行.
+ */
+class CompressCache {
+public:
+    struct Entry {
+        std::string source_etag;    // 源文件的ETag
+        std::string data;           // 压缩后的内容
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+public:
+    explicit CompressCache(size_t capacity_bytes);
+    ~CompressCache() = default;
+
+    // 查找path以encoding压缩的结果, 源文件ETag不符时视为未命中.
+    EntryPtr get(const std::string& path, const char* encoding, const std::string& source_etag);
+    // 压缩data并加入缓存. 不支持的编码、压缩失败或压缩无收益时返回nullptr.
+    EntryPtr compress(const std::string& path,
+                      const char* encoding,
+                      const std::string& source_etag,
+                      const char* data,
+                      size_t len);
+
+    Stats getStats() const;
+
+    // 以zlib压缩, encoding为"gzip"或"deflate".
+    static bool zlibCompress(const char* encoding, const char* data, size_t len, std::string* out);
+
+private:
+    struct Node {
+        EntryPtr entry;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    void evictUntilFit(size_t incoming);   // 须持有mtx_
+
+private:
+    const size_t capacity_;
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, Node> map_;   // GUARDED_BY(mtx_)
+    std::list<std::string> lru_;                  // 头部为最近使用. GUARDED_BY(mtx_)
+    size_t bytes_;                                // GUARDED_BY(mtx_)
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+};
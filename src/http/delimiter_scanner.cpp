@@ -0,0 +1,124 @@
+#include "delimiter_scanner.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86 1
+#endif
+
+using namespace std;
+
+using ScanFunc = const char* (*)(const char*, const char*, char);
+
+static inline bool isDelimiter(unsigned char c, unsigned char delim) {
+    return c == delim || c < 0x20 || c == 0x7f;
+}
+
+static const char* scanScalar(const char* p, const char* end, char delim) {
+    unsigned char d = static_cast<unsigned char>(delim);
+    while (p != end && !isDelimiter(static_cast<unsigned char>(*p), d)) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef SCANNER_X86
+__attribute__((target("sse4.2")))
+static const char* scanSse42(const char* p, const char* end, char delim) {
+    // 区间比较: [0x00, 0x1f], [0x7f, 0x7f], [delim, delim].
+    const __m128i ranges = _mm_setr_epi8(0x00, 0x1f, 0x7f, 0x7f, delim, delim, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int idx = _mm_cmpestri(ranges, 6, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (idx != 16) {
+            return p + idx;
+        }
+        p += 16;
+    }
+    return scanScalar(p, end, delim);
+}
+
+__attribute__((target("avx2")))
+static const char* scanAvx2(const char* p, const char* end, char delim) {
+    const __m256i d = _mm256_set1_epi8(delim);
+    const __m256i ctl_max = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        // 无符号比较 c <= 0x1f 等价于 min(c, 0x1f) == c.
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, d), _mm256_cmpeq_epi8(chunk, del)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, ctl_max), chunk));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return scanSse42(p, end, delim);   // 剩余不足32字节
+}
+#endif
+
+static ScanFunc getScanFunc(ScanLevel level) {
+    switch (level) {
+#ifdef SCANNER_X86
+        case ScanLevel::AVX2: return scanAvx2;
+        case ScanLevel::SSE42: return scanSse42;
+#endif
+        default: return scanScalar;
+    }
+}
+
+static const char* scanResolve(const char* p, const char* end, char delim);
+
+// 首次调用时按CPU特性选定实现, 无须依赖静态初始化顺序.
+static atomic<ScanFunc> g_scan_func(scanResolve);
+static atomic<ScanLevel> g_scan_level(ScanLevel::SCALAR);
+
+static const char* scanResolve(const char* p, const char* end, char delim) {
+    setScanLevel(detectScanLevel());
+    return g_scan_func.load(memory_order_relaxed)(p, end, delim);
+}
+
+
+const char* scanDelimiter(const char* p, const char* end, char delim) {
+    return g_scan_func.load(memory_order_relaxed)(p, end, delim);
+}
+
+ScanLevel detectScanLevel() {
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ScanLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return ScanLevel::SSE42;
+    }
+#endif
+    return ScanLevel::SCALAR;
+}
+
+ScanLevel getScanLevel() {
+    if (g_scan_func.load(memory_order_relaxed) == scanResolve) {
+        setScanLevel(detectScanLevel());
+    }
+    return g_scan_level.load(memory_order_relaxed);
+}
+
+bool setScanLevel(ScanLevel level) {
+    if (static_cast<int>(level) > static_cast<int>(detectScanLevel())) {
+        return false;
+    }
+    g_scan_level.store(level, memory_order_relaxed);
+    g_scan_func.store(getScanFunc(level), memory_order_relaxed);
+    return true;
+}
+
+const char* getScanLevelName(ScanLevel level) {
+    switch (level) {
+        case ScanLevel::AVX2: return "avx2";
+        case ScanLevel::SSE42: return "sse4.2";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+/* HttpParser的分隔符扫描.
+ *
+ * 在[p, end)中查找第一个等于delim或为控制字符(0x00-0x1f, 0x7f)的字节, 不存在时返回end.
+ * 请求行与头部中的普通字符由此批量跳过, 遇到分隔符/控制字符后再交由状态机逐字节处理,
+ * 因此控制字符的合法性校验(如头部值中的'\t')仍由状态机完成; 方法与头部名称的token字符(tchar)
+ * 在找到分隔符后对完整字段校验.
+ *
+ * x86-64上按CPU特性在运行时选择实现: AVX2每次比较32字节, SSE4.2(pcmpestri)每次16字节,
+ * 其余平台或CPU不支持时使用标量实现. 各实现的结果完全一致.
+ */
+
+enum class ScanLevel {
+    SCALAR = 0,
+    SSE42,
+    AVX2,
+};
+
+const char* scanDelimiter(const char* p, const char* end, char delim);
+
+// 当前CPU支持的最高实现.
+ScanLevel detectScanLevel();
+// 当前使用的实现.
+ScanLevel getScanLevel();
+// 指定实现(用于测试与基准比较). CPU不支持时返回false, 保持原实现不变.
+bool setScanLevel(ScanLevel level);
+const char* getScanLevelName(ScanLevel level);
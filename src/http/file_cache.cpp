@@ -0,0 +1,168 @@
+#include "file_cache.h"
+
+#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "http_message.h"
+#include "logger.h"
+
+using namespace std;
+
+const Timestamp::Duration FileCache::kDefaultRevalidateInterval = Timestamp::secondsToDuration(1);
+const int FileCache::Entry::kMaxSiblings;
+
+FileCache::Entry::~Entry() {
+    if (addr) {
+        munmap(addr, size);
+    }
+}
+
+
+FileCache::FileCache(size_t capacity_bytes, size_t max_file_bytes, Timestamp::Duration revalidate_interval)
+    : capacity_(capacity_bytes),
+    max_file_bytes_(max_file_bytes),
+    revalidate_interval_(revalidate_interval),
+    bytes_(0),
+    hits_(0),
+    misses_(0),
+    evictions_(0),
+    invalidations_(0)
+{
+}
+
+
+FileCache::EntryPtr FileCache::get(const string& key) {
+    EntryPtr entry;
+    {
+        lock_guard<mutex> lock(mtx_);
+        auto it = map_.find(key);
+        if (it != map_.end()) {
+            entry = it->second.entry;
+            lru_.splice(lru_.begin(), lru_, it->second.lru_pos);  // 移至头部
+        }
+    }
+    if (!entry) {
+        ++misses_;
+        return nullptr;
+    }
+    // 校验放在锁外进行, 避免stat阻塞其他IO线程.
+    MonoTimestamp now = MonoTimestamp::now();
+    if (now.getMicroSecondsSinceEpoch() - entry->checked_us.load(memory_order_relaxed)
+        >= revalidate_interval_.count())
+    {
+        if (!revalidate(*entry, now)) {
+            LOG_DEBUG << "FileCache::get invalidate: " << entry->path;
+            ++invalidations_;
+            ++misses_;
+            erase(key, entry);
+            return nullptr;
+        }
+    }
+    ++hits_;
+    return entry;
+}
+
+
+bool FileCache::revalidate(const Entry& entry, MonoTimestamp now) const {
+    struct stat file_stat {};
+    if (stat(entry.path.c_str(), &file_stat) == -1 ||
+        file_stat.st_ino != entry.inode ||
+        static_cast<size_t>(file_stat.st_size) != entry.size ||
+        file_stat.st_mtim.tv_sec != entry.mtime.tv_sec ||
+        file_stat.st_mtim.tv_nsec != entry.mtime.tv_nsec)
+    {
+        return false;
+    }
+    entry.checked_us.store(now.getMicroSecondsSinceEpoch(), memory_order_relaxed);
+    return true;
+}
+
+
+FileCache::EntryPtr FileCache::load(const string& key, const string& real_path, const struct stat& file_stat) {
+    if (!cacheable(file_stat.st_size)) {
+        return nullptr;
+    }
+    int fd = open(real_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        LOG_SYSERR << "FileCache::load open failed, file: " << real_path;
+        return nullptr;
+    }
+    // 以fstat结果为准, 防止resolve与open之间文件被替换.
+    struct stat st {};
+    if (fstat(fd, &st) == -1 || !cacheable(st.st_size)) {
+        close(fd);
+        return nullptr;
+    }
+    auto entry = make_shared<Entry>();
+    entry->path = real_path;
+    entry->content_type = getContentType(real_path);
+    entry->size = st.st_size;
+    entry->inode = st.st_ino;
+    entry->mtime = st.st_mtim;
+    entry->etag = makeETag(st.st_ino, entry->size, st.st_mtim);
+    entry->last_modified = formatHttpDate(st.st_mtim.tv_sec);
+    entry->checked_us = MonoTimestamp::now().getMicroSecondsSinceEpoch();
+    if (entry->size > 0) {
+        void* addr = mmap(nullptr, entry->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            LOG_SYSERR << "FileCache::load mmap failed, file: " << real_path;
+            close(fd);
+            return nullptr;
+        }
+        entry->addr = addr;
+    }
+    close(fd);
+
+    lock_guard<mutex> lock(mtx_);
+    auto it = map_.find(key);
+    if (it != map_.end()) {  // 其他IO线程已抢先加载, 以新加载的为准.
+        bytes_ -= it->second.entry->size;
+        lru_.erase(it->second.lru_pos);
+        map_.erase(it);
+    }
+    evictUntilFit(entry->size);
+    lru_.push_front(key);
+    map_[key] = Node{entry, lru_.begin()};
+    bytes_ += entry->size;
+    return entry;
+}
+
+
+void FileCache::erase(const string& key, const EntryPtr& entry) {
+    lock_guard<mutex> lock(mtx_);
+    auto it = map_.find(key);
+    // 仅当仍为同一项时才移除, 避免误删其他线程刚加载的新项.
+    if (it != map_.end() && it->second.entry == entry) {
+        bytes_ -= entry->size;
+        lru_.erase(it->second.lru_pos);
+        map_.erase(it);
+    }
+}
+
+
+void FileCache::evictUntilFit(size_t incoming) {
+    while (!lru_.empty() && bytes_ + incoming > capacity_) {
+        auto it = map_.find(lru_.back());
+        assert(it != map_.end());
+        LOG_DEBUG << "FileCache evict: " << it->second.entry->path;
+        bytes_ -= it->second.entry->size;
+        map_.erase(it);
+        lru_.pop_back();
+        ++evictions_;
+    }
+}
+
+
+FileCache::Stats FileCache::getStats() const {
+    Stats stats;
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.misses = misses_.load(memory_order_relaxed);
+    stats.evictions = evictions_.load(memory_order_relaxed);
+    stats.invalidations = invalidations_.load(memory_order_relaxed);
+    lock_guard<mutex> lock(mtx_);
+    stats.entries = map_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
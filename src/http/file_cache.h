@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+
+#include "timestamp.h"
+
+/* 静态资源文件缓存.
+ *
+ * 以请求URL路径为键, 缓存热点文件的解析路径、大小、mtime、Content-Type、ETag/Last-Modified以及mmap映射的文件内容.
+ * 命中时仅需一次哈希查找, 省去realpath/stat/faccessat/open/fstat/mmap/munmap等系统调用.
+ *
+ * - 总字节数受budget限制, 超出时按LRU淘汰; 超过单文件上限的文件不缓存.
+ * - 失效检查: 命中时若距上次校验已超过revalidate_interval, 则重新stat比对inode/size/mtime,
+ *   文件被修改或删除时移除该项, 视为未命中.
+ * - 所有IO线程共享同一实例, 内部以互斥锁保护. Entry以shared_ptr<const Entry>返回,
+ *   被淘汰后仍可安全使用, 直至最后一个持有者释放时才munmap.
+ * - 关联文件(如预压缩文件foo.js.br)不存在的结果可记入Entry: 文件inode/size/mtime变化时随该项失效,
+ *   该项重新校验后也不再有效, 即否定结果至多保留revalidate_interval.
+ */
+class FileCache {
+public:
+    struct Entry {
+        static const int kMaxSiblings = 2;
+
+        Entry() : addr(nullptr), size(0), inode(0), mtime{}, checked_us(0) {
+            for (auto& missing_us : sibling_missing_us) {
+                missing_us.store(-1, std::memory_order_relaxed);
+            }
+        }
+        ~Entry();
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        const char* data() const { return static_cast<const char*>(addr); }
+        // 第idx个关联文件是否已知不存在: 记录时的校验时间与当前相同, 即此后该项未重新校验.
+        bool siblingMissing(int idx) const {
+            return sibling_missing_us[idx].load(std::memory_order_relaxed) == checked_us.load(std::memory_order_relaxed);
+        }
+        void setSiblingMissing(int idx) const {
+            sibling_missing_us[idx].store(checked_us.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        std::string path;           // realpath解析后的绝对路径
+        std::string content_type;
+        std::string etag;           // 加载时预先生成的校验器, 命中时免去格式化
+        std::string last_modified;
+        void* addr;                 // mmap映射地址, 空文件时为nullptr
+        size_t size;
+        ino_t inode;
+        struct timespec mtime;
+        mutable std::atomic<int64_t> checked_us;  // 上次校验时间(单调时间, 微秒)
+        mutable std::atomic<int64_t> sibling_missing_us[kMaxSiblings];  // 记录关联文件不存在时的checked_us
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t invalidations;
+        size_t entries;
+        size_t bytes;
+    };
+
+public:
+    FileCache(size_t capacity_bytes, 
+              size_t max_file_bytes, 
+              Timestamp::Duration revalidate_interval = kDefaultRevalidateInterval);
+    ~FileCache() = default;
+
+    // 查找缓存项. 未命中或已失效时返回nullptr.
+    EntryPtr get(const std::string& key);
+    // 映射real_path对应文件并加入缓存. 文件过大或映射失败时返回nullptr.
+    EntryPtr load(const std::string& key, const std::string& real_path, const struct stat& file_stat);
+    // 文件大小是否允许缓存.
+    bool cacheable(size_t size) const { return size <= max_file_bytes_ && size <= capacity_; }
+
+    Stats getStats() const;
+
+public:
+    static const Timestamp::Duration kDefaultRevalidateInterval;  // 1s
+
+private:
+    struct Node {
+        EntryPtr entry;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    bool revalidate(const Entry& entry, MonoTimestamp now) const;
+    void erase(const std::string& key, const EntryPtr& entry);
+    void evictUntilFit(size_t incoming);   // 须持有mtx_
+
+private:
+    const size_t capacity_;
+    const size_t max_file_bytes_;
+    const Timestamp::Duration revalidate_interval_;
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, Node> map_;   // GUARDED_BY(mtx_)
+    std::list<std::string> lru_;                  // 头部为最近使用. GUARDED_BY(mtx_)
+    size_t bytes_;                                // GUARDED_BY(mtx_)
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> invalidations_;
+};
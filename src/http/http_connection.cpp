@@ -1,6 +1,8 @@
 #include "http_connection.h"
 
+#include <algorithm>
 #include <climits>
+#include <cstring>
 #include <string>
 #include <strings.h>
 #include <sys/socket.h>
@@ -45,41 +47,130 @@ string getErrorCodeRerturnFile(HttpStatusCode code) {
 static vector<char> FIX_MSG(5 * 1024, 'A');  // 5KB
 
 std::string HttpConnection::root_path_; 
-int HttpConnection::timeout_seconds_;  
+HttpConnection::Timeouts HttpConnection::timeouts_ = { 0, 0, 0, 0, 0 };  
+atomic<uint64_t> HttpConnection::evictions_[HttpConnection::kNumPhases]; 
+const int HttpConnection::kRateWindowSeconds; 
+std::shared_ptr<FileCache> HttpConnection::file_cache_; 
+std::shared_ptr<CompressCache> HttpConnection::compress_cache_; 
+std::unordered_map<std::string, std::string> HttpConnection::cache_control_; 
+
+// 小于该字节数的文件不压缩, 收益抵不过编码开销.
+static const size_t kMinCompressBytes = 256; 
 
 void HttpConnection::setRootPath(std::string root_path) {
     root_path_ = std::move(root_path);
 }
 
-void HttpConnection::setTimeout(int seconds) {
-    timeout_seconds_ = seconds; 
+void HttpConnection::setTimeouts(const Timeouts& timeouts) {
+    timeouts_ = timeouts; 
+}
+
+int HttpConnection::getMaxTimeoutSeconds() {
+    int seconds = max({ timeouts_.first_byte_seconds, timeouts_.header_seconds, timeouts_.keep_alive_seconds, 0 }); 
+    if (timeouts_.min_body_rate > 0 || timeouts_.min_send_rate > 0) {
+        seconds = max(seconds, kRateWindowSeconds); 
+    }
+    return seconds; 
+}
+
+const char* HttpConnection::getPhaseName(Phase phase) {
+    switch (phase) {
+        case kFirstByte: return "first-byte"; 
+        case kHeader: return "header"; 
+        case kBody: return "body"; 
+        case kSend: return "send"; 
+        case kKeepAlive: return "keep-alive"; 
+        default: return "unknown"; 
+    }
+}
+
+void HttpConnection::setFileCache(std::shared_ptr<FileCache> cache) {
+    file_cache_ = std::move(cache); 
+}
+
+void HttpConnection::setCompressCache(std::shared_ptr<CompressCache> cache) {
+    compress_cache_ = std::move(cache); 
+}
+
+void HttpConnection::setCacheControl(std::unordered_map<std::string, std::string> policies) {
+    cache_control_ = std::move(policies); 
 }
 
 HttpConnection::HttpConnection(TcpConnectionWeakPtr tcp_conn) 
-    : tcp_conn_wkptr(tcp_conn)
+    : parser_(true),
+    tcp_conn_wkptr(tcp_conn),
+    wheel_(nullptr),
+    deadline_entry_(this),
+    phase_(kFirstByte),
+    transfer_mark_(0),
+    closing_(false)
 {
-    // 新增定时器
-    if (timeout_seconds_ > 0) {
-        if (auto conn_sptr = tcp_conn.lock()) {
-            auto wheel = any_cast<unique_ptr<TimingWheel>>(
-                conn_sptr->getOwnerLoop()->getMutableContext()
-            );
-            timer_wkptr_ = (*wheel)->insert(tcp_conn); 
+    // 加入所属loop的时间轮(在该IO线程中构造), 等待第一个请求.
+    if (auto conn_sptr = tcp_conn.lock()) {
+        auto wheel = any_cast<unique_ptr<TimingWheel>>(
+            conn_sptr->getOwnerLoop()->getMutableContext()
+        );
+        if (wheel) {
+            wheel_ = wheel->get(); 
+            enterPhase(kFirstByte, *conn_sptr); 
         }
     }
 }
 
-void HttpConnection::onTimer(Any& context) {
-    auto conn_wkptr = any_cast<weak_ptr<TcpConnection>>(&context); 
-    if (auto conn_sptr = (*conn_wkptr).lock()) {
-        conn_sptr->forceClose(); 
+void HttpConnection::onTimer(TimingWheel::Entry* entry) {
+    static_cast<HttpConnection*>(entry->getOwner())->onDeadline(); 
+}
+
+void HttpConnection::enterPhase(Phase phase, const TcpConnection& conn) {
+    phase_ = phase; 
+    int seconds = 0; 
+    switch (phase) {
+        case kFirstByte: seconds = timeouts_.first_byte_seconds; break; 
+        case kHeader: seconds = timeouts_.header_seconds; break; 
+        case kBody: {
+            transfer_mark_ = conn.getBytesReceived(); 
+            seconds = timeouts_.min_body_rate > 0 ? kRateWindowSeconds : 0; 
+        } break; 
+        case kSend: {
+            transfer_mark_ = conn.getBytesSent(); 
+            seconds = timeouts_.min_send_rate > 0 ? kRateWindowSeconds : 0; 
+        } break; 
+        case kKeepAlive: seconds = timeouts_.keep_alive_seconds; break; 
+        default: break; 
+    }
+    if (seconds > 0) {
+        wheel_->insert(&deadline_entry_, seconds); 
+    } else {
+        deadline_entry_.leave(); 
     }
 }
 
+void HttpConnection::onDeadline() {
+    auto conn_sptr = tcp_conn_wkptr.lock(); 
+    if (!conn_sptr) {
+        return; 
+    }
+    if (phase_ == kSend && !conn_sptr->hasPendingOutput()) {
+        enterPhase(kKeepAlive, *conn_sptr);   // 已发送完毕, 写完成回调尚未执行
+        return; 
+    }
+    if (phase_ == kBody || phase_ == kSend) {
+        uint64_t transferred = phase_ == kBody ? conn_sptr->getBytesReceived() : conn_sptr->getBytesSent(); 
+        size_t min_rate = phase_ == kBody ? timeouts_.min_body_rate : timeouts_.min_send_rate; 
+        if (transferred - transfer_mark_ >= min_rate * kRateWindowSeconds) {
+            enterPhase(phase_, *conn_sptr);   // 速率达标, 开始下一个检查周期
+            return; 
+        }
+    }
+    evictions_[phase_].fetch_add(1, memory_order_relaxed); 
+    LOG_INFO << "HttpConnection::onDeadline " << conn_sptr->getName() 
+             << " " << getPhaseName(phase_) << " timeout"; 
+    conn_sptr->forceClose(); 
+}
+
 HttpConnection::~HttpConnection() {
     LOG_TRACE << "HttpConnection::~HttpConnection this::" <<  this 
               << " tcp_conn_wkptr use count: " << tcp_conn_wkptr.use_count();
-    removeTimer();
 }
 
 void HttpConnection::shutdown() const {
@@ -94,74 +185,113 @@ void HttpConnection::forceClose() const {
     }
 }
 
-void HttpConnection::restartTimer() {
-    if (auto timer = timer_wkptr_.lock()) {
-        timer->owner_wheel_->update(timer); 
+void HttpConnection::handleMessage(Buffer* buf) {
+    using R = HttpConnection::ParseResult; 
+    // pipelining: 依次处理缓冲区中所有完整的请求. 若其后仍有请求, 则合并发送各响应, 
+    // 响应按请求顺序追加到发送队列, 处理完毕后一次写出.
+    // 解析器为零拷贝模式: 请求各字段直接引用buf中的数据, 须在请求处理完毕后才能retrieve; 
+    // 不完整的请求保留在buf中, 下次从请求起始处重新传入.
+    shared_ptr<TcpConnection> corked_conn; 
+    bool completed = false; 
+    while (buf->readableBytes() > 0 && !closing_) {
+        size_t parsed_size = 0; 
+        auto ret = parser_.parse(buf->peek(), buf->readableBytes(), parsed_size);
+
+        if (ret == R::SUCCESS) {
+            // 解析得到完整HTTP请求报文, 处理请求.
+            LOG_TRACE << "HttpServer::onMessage http request parsing successed"; 
+            if (!corked_conn && buf->readableBytes() > parsed_size) {
+                if ((corked_conn = tcp_conn_wkptr.lock())) {
+                    corked_conn->cork(); 
+                }
+            }
+            handleRequest();
+            buf->retrieve(parsed_size); 
+            completed = true; 
+            if (!parser_.isKeepAlive()) {
+                closing_ = true; 
+            }
+        } else if (ret == R::ERROR) {
+            LOG_WARN << "HttpServer::onMessage http request parsing error"; 
+            closing_ = true; 
+            errorResponse(HttpStatusCode::BadRequest);
+            buf->retrieveAll(); 
+            // 先关闭写端: 客户端可能已发出后续数据, 直接close会以RST结束连接, 客户端可能收不到响应与FIN.
+            shutdown(); 
+            forceClose();
+        } else {
+            LOG_TRACE << "HttpServer::onMessage http request parsing continue"; 
+            break; 
+        }
     }
-}
-
-void HttpConnection::removeTimer() {
-    if (auto timer = timer_wkptr_.lock()) {
-        timer->owner_wheel_->remove(timer); 
+    if (corked_conn) {
+        corked_conn->uncork(); 
+    }
+    if (wheel_) {
+        updatePhase(buf, completed); 
     }
 }
 
-void HttpConnection::handleMessage(Buffer* buf) {
-    restartTimer(); 
-    size_t size = buf->readableBytes(); 
-    size_t parsed_size = 0; 
-    auto ret = parser_.parse(buf->peek(), size, parsed_size);
-    buf->retrieve(parsed_size); 
-
-    using R = HttpConnection::ParseResult; 
-    if (ret == R::SUCCESS) {
-        // 解析得到完整HTTP请求报文, 处理请求.
-        LOG_TRACE << "HttpServer::onMessage http request parsing successed"; 
-        handleRequest();
-    } else if (ret == R::ERROR) {
-        LOG_WARN << "HttpServer::onMessage http request parsing error"; 
-        errorResponse(HttpStatusCode::BadRequest);
-        forceClose();
+void HttpConnection::updatePhase(const Buffer* buf, bool completed) {
+    auto conn_sptr = tcp_conn_wkptr.lock(); 
+    if (!conn_sptr) {
+        return; 
+    }
+    if (buf->readableBytes() > 0 && !closing_) {
+        // 不完整的请求. 头部阶段自请求的第一个字节起计时, 其后收到的数据不延长期限.
+        if (parser_.isHeaderComplete()) {
+            if (phase_ != kBody) {
+                enterPhase(kBody, *conn_sptr); 
+            }
+        } else if (phase_ != kHeader || completed) {
+            enterPhase(kHeader, *conn_sptr); 
+        }
+    } else if (conn_sptr->hasPendingOutput()) {
+        if (phase_ != kSend) {
+            enterPhase(kSend, *conn_sptr); 
+        }
     } else {
-        LOG_TRACE << "HttpServer::onMessage http request parsing continue"; 
+        enterPhase(kKeepAlive, *conn_sptr); 
     }
 }
 
 void HttpConnection::handleRequest() {
     LOG_TRACE << parser_.encode(); 
-    string path = parser_.getUri(); 
+    HeaderView uri = parser_.getUriView(); 
     // For benchmark testing.
-    if (path == "/benchmark") {
+    if (uri == "/benchmark") {
         responseMsg("Hello World!", 12, HttpStatusCode::OK);  // 不取文件, 省略磁盘I/O
         return; 
     }
-    if (path == "/benchmark-5KB") {
+    if (uri == "/benchmark-5KB") {
         responseMsg(FIX_MSG.data(), FIX_MSG.size(), HttpStatusCode::OK);  // 5KB
         return;
     }
-    if (path == "/nocontent") {
+    if (uri == "/nocontent") {
         responseMsg(nullptr, 0, HttpStatusCode::NoContent);
         return;
     }
 
+    // path_各请求复用, 容量足够时不再分配.
+    path_.assign(uri.data, uri.len); 
     // URL匹配默认文件
-    auto it = DEFAULT_FILE.find(path);
+    auto it = DEFAULT_FILE.find(path_);
     if (it != DEFAULT_FILE.end()) {
-        path = it->second;
+        path_ = it->second;
     }
     // 请求静态资源
-    responseFile(path, HttpStatusCode::OK); 
+    responseFile(path_, HttpStatusCode::OK); 
 }
 
 
 void HttpConnection::responseMsg(const char* msg, size_t len, HttpStatusCode code) {
-    HttpResponse response; 
-    HttpMethod method = getHttpMethodAsEnum(parser_.getMethod()); 
+    HttpMethod method = getHttpMethodAsEnum(parser_.getMethodView()); 
     if (method != HttpMethod::HEAD && method != HttpMethod::GET) {
         return errorResponse(HttpStatusCode::NotImplemented); 
     }
 
-    response.setVersion(parser_.getVersion());
+    HttpResponse& response = beginResponse(); 
+    response.setVersion(parser_.getVersionView());
     response.setStatus(code);
     if (msg && len > 0) {
         assert(strlen(msg) == len); 
@@ -169,7 +299,7 @@ void HttpConnection::responseMsg(const char* msg, size_t len, HttpStatusCode cod
             response.setBody(msg, len);  
         }
         response.addHeader("Content-Type", "text/plain");
-        response.addHeader("Content-Length", to_string(len)); 
+        response.addHeader("Content-Length", len); 
     }
     if (!parser_.isKeepAlive()) {
         response.addHeader("Connection", "close"); 
@@ -181,64 +311,304 @@ void HttpConnection::responseMsg(const char* msg, size_t len, HttpStatusCode cod
 
 void HttpConnection::responseFile(const string& path, HttpStatusCode code) {
     // 构造响应报文
-    HttpResponse response; 
-    MmapData mmap_data; 
+    HttpResponse& response = beginResponse(); 
+    StaticFile file; 
 
-    HttpMethod method = getHttpMethodAsEnum(parser_.getMethod()); 
+    HttpMethod method = getHttpMethodAsEnum(parser_.getMethodView()); 
     if (method != HttpMethod::HEAD && method != HttpMethod::GET) {
         return errorResponse(HttpStatusCode::NotImplemented); 
     }
 
     if (!path.empty() && path[0] == '/') {
+        bool conditional = code == HttpStatusCode::OK; 
+        HttpStatusCode ret = openStaticFile(path, method, conditional, &file); 
+        if (ret != HttpStatusCode::OK) {
+            return errorResponse(ret); 
+        }
+        negotiateEncoding(path, method, conditional, &file); 
+        // 校验器与缓存策略
+        response.addHeader("ETag", file.etag); 
+        response.addHeader("Last-Modified", file.last_modified); 
+        auto it = cache_control_.find(getFileSuffix(path)); 
+        if (it != cache_control_.end()) {
+            response.addHeader("Cache-Control", it->second); 
+        }
+        if (file.vary) {
+            response.addHeader("Vary", "Accept-Encoding"); 
+        }
+    }
+
+    response.setVersion(parser_.getVersionView());
+    if (!parser_.isKeepAlive()) {
+        response.addHeader("Connection", "close"); 
+    }
+
+    bool is_static = code == HttpStatusCode::OK && !path.empty() && path[0] == '/'; 
+    // 条件请求: 资源未变化时返回不带消息体的304.
+    if (is_static && notModified(file)) {
+        response.setStatus(HttpStatusCode::NotModified); 
+        LOG_TRACE << response.encode();
+        return sendResponse(response); 
+    }
+    if (is_static) {
+        response.addHeader("Content-Type", file.content_type);  // 根据文件后缀确认Content-Type.
+        response.addHeader("Accept-Ranges", "bytes"); 
+        if (file.encoding) {
+            response.addHeader("Content-Encoding", HeaderView(file.encoding, strlen(file.encoding))); 
+        }
+    }
+
+    // 处理Range请求
+    vector<ByteRange> ranges; 
+    HeaderView range = parser_.getHeaderView("Range"); 
+    RangeResult range_ret = RangeResult::NONE; 
+    if (range.data && is_static && ifRangeMatches(file)) {
+        range_ret = parseRange(range, file.size, &ranges); 
+    }
+    char content_range[kMaxContentRangeLen]; 
+    if (range_ret == RangeResult::UNSATISFIABLE) {
+        response.setStatus(HttpStatusCode::RangeNotSatisfiable); 
+        response.addHeader("Content-Range", HeaderView(content_range, formatContentRange(content_range, nullptr, file.size))); 
+        response.addHeader("Content-Length", "0"); 
+        LOG_TRACE << response.encode();
+        return sendResponse(response); 
+    }
+    if (range_ret == RangeResult::SATISFIABLE && ranges.size() > 1) {
+        return responseMultiRange(response, file, ranges, method); 
+    }
+
+    size_t offset = 0; 
+    size_t length = file.size; 
+    if (range_ret == RangeResult::SATISFIABLE) {  // 单区间(含合并后只剩一个区间)
+        offset = ranges[0].first; 
+        length = ranges[0].length(); 
+        response.setStatus(HttpStatusCode::PartialContent); 
+        response.addHeader("Content-Range", HeaderView(content_range, formatContentRange(content_range, &ranges[0], file.size))); 
+    } else {
+        response.setStatus(code);
+    }
+    response.addHeader("Content-Length", length); 
+    if (method == HttpMethod::GET && file.inMemory() && length > 0) {
+        response.setBody(file.data() + offset, length);  // 位于内存中: 与头部一并writev
+    }
+    LOG_TRACE << response.encode();
+    sendResponse(response); 
+    if (method == HttpMethod::GET && !file.inMemory() && length > 0) {
+        sendFileRange(file, offset, length); 
+    }
+}
+
+
+void HttpConnection::responseMultiRange(HttpResponse& response, 
+                                        StaticFile& file, 
+                                        const vector<ByteRange>& ranges, 
+                                        HttpMethod method)
+{
+#define MULTIPART_BOUNDARY "3d6b6a416f9b5c7e"
+    static const char kPartBegin[] = "\r\n--" MULTIPART_BOUNDARY "\r\nContent-Type: "; 
+    static const char kTail[] = "\r\n--" MULTIPART_BOUNDARY "--\r\n"; 
+    static const char kContentType[] = "multipart/byteranges; boundary=" MULTIPART_BOUNDARY; 
+#undef MULTIPART_BOUNDARY
+    // 预先将各部分的头部依次格式化进同一块内存, 以计算总长度; head_ends记录各部分头部的结束位置.
+    string heads; 
+    heads.reserve(ranges.size() * (sizeof(kPartBegin) + file.content_type.size() + kMaxContentRangeLen + 20)); 
+    vector<size_t> head_ends; 
+    head_ends.reserve(ranges.size()); 
+    size_t total = sizeof(kTail) - 1; 
+    char content_range[kMaxContentRangeLen]; 
+    for (auto& r : ranges) {
+        heads.append(kPartBegin, sizeof(kPartBegin) - 1); 
+        heads.append(file.content_type); 
+        heads.append("\r\nContent-Range: "); 
+        heads.append(content_range, formatContentRange(content_range, &r, file.size)); 
+        heads.append("\r\n\r\n"); 
+        head_ends.push_back(heads.size()); 
+        total += r.length(); 
+    }
+    total += heads.size(); 
+
+    response.setStatus(HttpStatusCode::PartialContent); 
+    response.setHeader("Content-Type", kContentType); 
+    response.addHeader("Content-Length", total); 
+    LOG_TRACE << response.encode();
+    sendResponse(response); 
+    if (method != HttpMethod::GET) {
+        return; 
+    }
+    auto tcp_conn_sptr = tcp_conn_wkptr.lock(); 
+    if (!tcp_conn_sptr) {
+        return; 
+    }
+    size_t head_begin = 0; 
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        tcp_conn_sptr->send(heads.data() + head_begin, head_ends[i] - head_begin); 
+        sendFileRange(file, ranges[i].first, ranges[i].length()); 
+        head_begin = head_ends[i]; 
+    }
+    tcp_conn_sptr->send(kTail, sizeof(kTail) - 1); 
+}
+
+
+HttpStatusCode HttpConnection::openStaticFile(const string& path, HttpMethod method, bool conditional, StaticFile* file) {
+    // 优先查缓存, 命中时省去路径解析、stat、mmap等系统调用.
+    if (file_cache_) {
+        file->entry = file_cache_->get(path); 
+    }
+    if (!file->entry) {
         string real_path = root_path_ + path; 
         // 路径解析, 得到绝对路径
         char resolved_path[PATH_MAX]; 
         if (realpath(real_path.c_str(), resolved_path) == nullptr) {
-            return errorResponse(HttpStatusCode::NotFound); 
+            return HttpStatusCode::NotFound; 
         }
         real_path = resolved_path;
         // 检查目标路径是否仍在资源目标下. 
         if (real_path.compare(0, root_path_.length(), root_path_) != 0 ||
             (real_path.size() > root_path_.size() && real_path[root_path_.size()] != '/')) {
-            return errorResponse(HttpStatusCode::Forbidden); 
+            return HttpStatusCode::Forbidden; 
         }
         // 检查文件属性
         struct stat file_stat {}; 
         if (stat(real_path.c_str(), &file_stat) == -1 || S_ISDIR(file_stat.st_mode)) { 
             LOG_TRACE << "HttpConnection::requestFile fstat failed, file: " << real_path;
-            return errorResponse(HttpStatusCode::NotFound); 
+            return HttpStatusCode::NotFound; 
         } else if (faccessat(AT_FDCWD, real_path.c_str(), R_OK, AT_EACCESS) != 0) {
             LOG_TRACE << "HttpConnection::requestFile faccessat failed, file: " << real_path;
-            return errorResponse(HttpStatusCode::Forbidden); 
+            return HttpStatusCode::Forbidden; 
         }
-        // 获取文件大小与文件内容
         LOG_TRACE << real_path;
-        if (method == HttpMethod::HEAD) {
-            response.setBody(nullptr, file_stat.st_size);
-        } else {
-            if (mmap_data.mmap(real_path)) {
-                response.setBody(mmap_data.addr_, mmap_data.size_);
-            } else {
-                return errorResponse(HttpStatusCode::InternalServerError);
+        if (file_cache_) {
+            file->entry = file_cache_->load(path, real_path, file_stat); 
+        }
+        if (!file->entry) {
+            file->content_type = getContentType(real_path); 
+            file->size = file_stat.st_size; 
+            file->mtime = file_stat.st_mtim.tv_sec; 
+            file->etag = makeETag(file_stat.st_ino, file_stat.st_size, file_stat.st_mtim); 
+            file->last_modified = formatHttpDate(file->mtime); 
+            // 大文件不缓存也不映射, 由sendfile零拷贝发送, 内存占用与文件大小、客户端快慢无关.
+            // 校验器匹配时将返回不带消息体的304(与responseFile()以同一组校验器判断), 不必打开文件. 
+            if (method == HttpMethod::GET && !(conditional && notModified(*file))) {
+                FileData data; 
+                if (!data.open(real_path)) {
+                    return HttpStatusCode::InternalServerError; 
+                }
+                file->size = data.size_; 
+                file->fd = data.fd_; 
+                file->guard = data.share(); 
             }
+            return HttpStatusCode::OK; 
         }
-        response.addHeader("Content-Type", getContentType(real_path));  // 根据文件后缀确认Content-Type.
     }
+    file->content_type = file->entry->content_type; 
+    file->size = file->entry->size; 
+    file->mtime = file->entry->mtime.tv_sec; 
+    file->etag = file->entry->etag; 
+    file->last_modified = file->entry->last_modified; 
+    return HttpStatusCode::OK; 
+}
 
-    response.setVersion(parser_.getVersion());
-    response.setStatus(code);
-    response.addHeader("Content-Length", to_string(response.getBodySize())); 
-    if (!parser_.isKeepAlive()) {
-        response.addHeader("Connection", "close"); 
+
+void HttpConnection::negotiateEncoding(const string& path, HttpMethod method, bool conditional, StaticFile* file) {
+    if (!isCompressible(file->content_type) || file->size < kMinCompressBytes) {
+        return; 
+    }
+    file->vary = true; 
+    HeaderView accept_encoding = parser_.getHeaderView("Accept-Encoding"); 
+    if (!accept_encoding.data) {
+        return; 
+    }
+    AcceptedEncodings accepted = parseAcceptEncoding(accept_encoding); 
+    static const char* kZlibEncodings[] = { "gzip", "deflate" }; 
+
+    // 1. 已有即时压缩结果(说明压缩时不存在预压缩文件), 直接复用, 省去查找预压缩文件的系统调用.
+    CompressCache::EntryPtr encoded; 
+    const char* encoding = nullptr; 
+    if (compress_cache_) {
+        for (const char* enc : kZlibEncodings) {
+            if (accepted.accepts(enc) && (encoded = compress_cache_->get(path, enc, file->etag))) {
+                encoding = enc; 
+                break; 
+            }
+        }
+    }
+    // 2. 预压缩文件foo.js.br/foo.js.gz, 与普通文件一样经FileCache缓存或以sendfile发送.
+    //    原文件位于缓存中时, 预压缩文件不存在的结果记入其缓存项, 至该项下次校验前不再查找. 
+    static const pair<const char*, const char*> kPrecompressed[FileCache::Entry::kMaxSiblings] = { 
+        {"br", ".br"}, {"gzip", ".gz"} 
+    }; 
+    if (!encoded) {
+        for (int i = 0; i < FileCache::Entry::kMaxSiblings; ++i) {
+            auto& p = kPrecompressed[i]; 
+            if (!accepted.accepts(p.first) || (file->entry && file->entry->siblingMissing(i))) {
+                continue; 
+            }
+            StaticFile sibling; 
+            HttpStatusCode ret = openStaticFile(path + p.second, method, conditional, &sibling); 
+            if (ret == HttpStatusCode::OK) {
+                sibling.content_type = std::move(file->content_type); 
+                sibling.encoding = p.first; 
+                sibling.vary = true; 
+                *file = std::move(sibling); 
+                return; 
+            }
+            if (ret == HttpStatusCode::NotFound && file->entry) {
+                file->entry->setSiblingMissing(i); 
+            }
+        }
+    }
+    // 3. zlib即时压缩. 仅压缩已位于FileCache中的文件, 避免在IO线程中读取、压缩大文件.
+    if (!encoded && compress_cache_ && file->entry) {
+        for (const char* enc : kZlibEncodings) {
+            if (accepted.accepts(enc)) {
+                encoded = compress_cache_->compress(path, enc, file->etag, file->entry->data(), file->size); 
+                encoding = enc; 
+                break; 
+            }
+        }
+    }
+    if (encoded) {
+        // 编码后为不同的表示, ETag加上编码后缀以示区分.
+        file->etag.insert(file->etag.size() - 1, string("-") + encoding); 
+        file->encoded = std::move(encoded); 
+        file->size = file->encoded->data.size(); 
+        file->encoding = encoding; 
     }
-    LOG_TRACE << response.encode();
-    sendResponse(response); 
+}
+
+
+bool HttpConnection::notModified(const StaticFile& file) const {
+    // If-None-Match优先, 存在时忽略If-Modified-Since.
+    HeaderView if_none_match = parser_.getHeaderView("If-None-Match"); 
+    if (if_none_match.data) {
+        return matchETag(if_none_match, file.etag); 
+    }
+    HeaderView if_modified_since = parser_.getHeaderView("If-Modified-Since"); 
+    if (if_modified_since.data) {
+        time_t since = 0; 
+        return parseHttpDate(if_modified_since, &since) && file.mtime <= since; 
+    }
+    return false; 
+}
+
+
+bool HttpConnection::ifRangeMatches(const StaticFile& file) const {
+    HeaderView if_range = parser_.getHeaderView("If-Range"); 
+    if (!if_range.data) {
+        return true; 
+    }
+    // If-Range要求强比较, 弱校验器不匹配.
+    if (if_range.len > 0 && if_range.data[0] == '"') {
+        return if_range == file.etag; 
+    }
+    time_t date = 0; 
+    return parseHttpDate(if_range, &date) && file.mtime == date; 
 }
 
 
 void HttpConnection::errorResponse(HttpStatusCode code) {
     LOG_TRACE << getHttpStatusCodeString(code); 
-    HttpResponse response; 
+    HttpResponse& response = beginResponse(); 
     MmapData mmap_data;
     // 根据错误状态码, 获取对应返回的HTML文件: 
     string error_html_path = getErrorCodeRerturnFile(code); 
@@ -248,7 +618,7 @@ void HttpConnection::errorResponse(HttpStatusCode code) {
         if (stat(error_html_path.c_str(), &file_stat) == 0 &&
             faccessat(AT_FDCWD, error_html_path.c_str(), R_OK, AT_EACCESS) == 0) 
         { 
-            HttpMethod method = getHttpMethodAsEnum(parser_.getMethod()); 
+            HttpMethod method = getHttpMethodAsEnum(parser_.getMethodView()); 
             if (method == HttpMethod::HEAD) {
                 response.setBody(nullptr, file_stat.st_size);
                 response.addHeader("Content-Type", "text/html"); 
@@ -260,10 +630,12 @@ void HttpConnection::errorResponse(HttpStatusCode code) {
             }
         }
     }
-    string version = parser_.getVersion(); 
-    response.setVersion(version.empty() ? "HTTP/1.1" : version); // 若HTTP请求错误, 则解析结果无版本号.
+    HeaderView version = parser_.getVersionView(); 
+    if (version.len == 0 || !response.setVersion(version)) {   // 若HTTP请求错误, 则解析结果无版本号.
+        response.setVersion("HTTP/1.1"); 
+    }
     response.setStatus(code); 
-    response.addHeader("Content-Length", to_string(response.getBodySize()));
+    response.addHeader("Content-Length", response.getBodySize());
     if (!parser_.isKeepAlive() || code == HttpStatusCode::BadRequest) {
         response.addHeader("Connection", "close"); 
     }
@@ -272,6 +644,13 @@ void HttpConnection::errorResponse(HttpStatusCode code) {
 }
 
 
+HttpResponse& HttpConnection::beginResponse() {
+    response_.clear(); 
+    response_.addHeader("Date", getCachedHttpDate()); 
+    return response_; 
+}
+
+
 void HttpConnection::sendResponse(const HttpResponse& response) {
     if (auto tcp_conn_sptr = tcp_conn_wkptr.lock()) {
         // Buffer buf;  
@@ -283,13 +662,30 @@ void HttpConnection::sendResponse(const HttpResponse& response) {
     }
 }
 
+void HttpConnection::sendFileRange(const StaticFile& file, size_t offset, size_t len) {
+    if (auto tcp_conn_sptr = tcp_conn_wkptr.lock()) {
+        if (file.inMemory()) {
+            tcp_conn_sptr->send(file.data() + offset, len); 
+        } else {
+            tcp_conn_sptr->sendFile(file.fd, offset, len, file.guard); 
+        }
+    }
+}
+
 void HttpConnection::onWriteComplete() {
     // 短连接下, 服务器端回发完响应报文后关闭写端.
-    if (!parser_.isKeepAlive() || !parser_.parsingCompletion()) {
+    // 注: 不能以解析器状态判断, pipelining下此时可能已收到下一请求的部分数据.
+    if (closing_) {
         shutdown();
         forceClose();
+        return; 
+    }
+    // 响应发送完毕, 等待下一个请求.
+    if (wheel_ && phase_ == kSend) {
+        if (auto conn_sptr = tcp_conn_wkptr.lock()) {
+            enterPhase(kKeepAlive, *conn_sptr); 
+        }
     }
-    restartTimer(); 
 }
 
 
@@ -328,4 +724,35 @@ MmapData::~MmapData() {
     if (fd_ != -1) {
         close(fd_);
     }
-}
\ No newline at end of file
+}
+
+
+bool FileData::open(const string& file_path) {
+    fd_ = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ == -1) {
+        LOG_SYSERR << "FileData::open open failed, file : " << file_path; 
+        return false;
+    }
+    struct stat file_stat {}; 
+    if (fstat(fd_, &file_stat) == -1) {
+        LOG_SYSERR << "FileData::open fstat failed, file: " << file_path << " fd:" << fd_;
+        close(fd_); 
+        fd_ = -1;
+        return false;
+    }
+    size_ = file_stat.st_size; 
+    return true;
+}
+
+shared_ptr<void> FileData::share() {
+    // fd的所有权转交给guard, 由最后一个持有者(如TcpConnection的文件段)释放时关闭.
+    int fd = fd_; 
+    fd_ = -1; 
+    return shared_ptr<void>(nullptr, [fd](void*) { ::close(fd); }); 
+}
+
+FileData::~FileData() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
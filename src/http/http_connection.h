@@ -1,35 +1,77 @@
 #pragma once 
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "buffer.h"
 #include "timer.h"
 #include "http_message.h"
 #include "http_parser.h"
 #include "timing_wheel.h"
+#include "file_cache.h"
+#include "compress_cache.h"
 
 class TcpConnection;
+struct StaticFile; 
 
 class HttpConnection {
 public:
     using ParseResult = HttpParser::ParseResult; 
-    using TimerWeakPtr = TimingWheel::EntryWeakPtr;
     using TcpConnectionWeakPtr = std::weak_ptr<TcpConnection>;
 
+    // 连接所处的阶段, 各阶段的超时分别计时与计数.
+    enum Phase {
+        kFirstByte = 0,   // 建立连接后等待首个请求的第一个字节
+        kHeader,          // 接收请求行与头部: 自请求的第一个字节起计时, 期间收到数据也不延长
+        kBody,            // 接收消息体: 每个检查周期内须达到最低速率
+        kSend,            // 发送响应: 每个检查周期内须达到最低速率
+        kKeepAlive,       // 响应已发送完毕, 等待下一个请求
+        kNumPhases
+    };
+    // 各项为0时不限制.
+    struct Timeouts {
+        int first_byte_seconds; 
+        int header_seconds; 
+        int keep_alive_seconds; 
+        size_t min_body_rate;     // 字节/秒
+        size_t min_send_rate;     // 字节/秒
+    };
+    // 检查消息体与响应传输速率的周期.
+    static const int kRateWindowSeconds = 5; 
+
 public:
     HttpConnection(TcpConnectionWeakPtr tcp_conn);
     ~HttpConnection();
-    // 处理&解析HTTP请求报文
+    // 处理&解析HTTP请求报文. 缓冲区中的多个完整请求(pipelining)依次处理, 响应按序合并发送.
     void handleMessage(Buffer* buf);
 
     TcpConnectionWeakPtr getTcpConnectionWeakPtr() const { return tcp_conn_wkptr; }
-    TimerWeakPtr getTimerWeakPtr() const { return timer_wkptr_; }
+    bool inTimingWheel() const { return deadline_entry_.inWheel(); }
+    Phase getPhase() const { return phase_; }
+    // 移除定时器. 最后一个引用可能在其他线程释放, 故须在连接断开时(IO线程中)先行移出时间轮.
+    void removeTimer() { deadline_entry_.leave(); }
 
     static void setRootPath(std::string root_path);
-    static void setTimeout(int seconds); 
-    // 定时器回调.
-    static void onTimer(Any& context);
+    static void setTimeouts(const Timeouts& timeouts); 
+    static const Timeouts& getTimeouts() { return timeouts_; }
+    // 时间轮须支持的最长超时秒数, 为0时无需时间轮.
+    static int getMaxTimeoutSeconds(); 
+    // 各阶段因超时被断开的连接数. 
+    static uint64_t getEvictions(Phase phase) { return evictions_[phase].load(std::memory_order_relaxed); }
+    static const char* getPhaseName(Phase phase); 
+    // 静态资源文件缓存, 为空时不启用.
+    static void setFileCache(std::shared_ptr<FileCache> cache); 
+    static const std::shared_ptr<FileCache>& getFileCache() { return file_cache_; }
+    // 即时压缩结果缓存, 为空时仅使用预压缩文件. 
+    static void setCompressCache(std::shared_ptr<CompressCache> cache); 
+    static const std::shared_ptr<CompressCache>& getCompressCache() { return compress_cache_; }
+    // 按文件后缀(如".css")配置静态资源响应的Cache-Control策略. 
+    static void setCacheControl(std::unordered_map<std::string, std::string> policies); 
+    // 时间轮超时回调.
+    static void onTimer(TimingWheel::Entry* entry);
     // 消息完整发送时的回调(异步)
     void onWriteComplete(); 
 
@@ -39,27 +81,55 @@ private:
     // 请求静态资源
     void responseMsg(const char* msg, size_t len, HttpStatusCode code);
     void responseFile(const string& path, HttpStatusCode code);  
+    // 多区间Range请求, 以multipart/byteranges响应
+    void responseMultiRange(HttpResponse& response, StaticFile& file, 
+                            const std::vector<ByteRange>& ranges, HttpMethod method); 
+    // 定位静态资源文件(优先查缓存), 失败时返回对应错误状态码. 
+    // conditional为true时响应可按条件请求返回304, 此时校验器匹配的文件不必打开. 
+    HttpStatusCode openStaticFile(const string& path, HttpMethod method, bool conditional, StaticFile* file); 
+    // 内容编码协商: 按Accept-Encoding选用预压缩文件或即时压缩结果, 替换file.
+    void negotiateEncoding(const string& path, HttpMethod method, bool conditional, StaticFile* file); 
+    // 条件请求: If-None-Match/If-Modified-Since校验通过(资源未变化)时返回true.
+    bool notModified(const StaticFile& file) const; 
+    // If-Range校验: 无If-Range或校验器匹配时Range才生效.
+    bool ifRangeMatches(const StaticFile& file) const; 
     // 错误响应        
     void errorResponse(HttpStatusCode code);
+    // 复用response_构造新的响应报文, 并添加Date头部.
+    HttpResponse& beginResponse(); 
     // 发送报文
     void sendResponse(const HttpResponse& response);     // base.
+    // 发送文件区间: 缓存命中时直接发送映射内容, 否则以sendfile发送.
+    void sendFileRange(const StaticFile& file, size_t offset, size_t len); 
 
     // 仅关闭写端. 
     void shutdown() const;
     // 断开连接
     void forceClose() const;
 
-    // 重置定时器
-    void restartTimer(); 
-    // 移除定时器
-    void removeTimer();
+    // 进入新的阶段, 按该阶段的超时重设到期时间. 
+    void enterPhase(Phase phase, const TcpConnection& conn); 
+    // 处理完本次收到的数据后, 按未完成的请求与待发送的响应切换阶段. 
+    void updatePhase(const Buffer* buf, bool completed); 
+    // 到期: 传输阶段检查速率, 达标时开始下一个检查周期, 否则断开连接. 
+    void onDeadline(); 
 
 private:
     HttpParser parser_;
     TcpConnectionWeakPtr tcp_conn_wkptr; 
-    TimerWeakPtr timer_wkptr_; 
+    TimingWheel* wheel_;      // 所属loop的时间轮, 未启用超时时为空
+    TimingWheel::Entry deadline_entry_;   // 嵌入的时间轮表项
+    Phase phase_; 
+    uint64_t transfer_mark_;  // 传输阶段: 本检查周期开始时累计收发的字节数
+    HttpResponse response_;   // 各响应复用, 编码头部的内存在连接内重复利用
+    std::string path_;        // 当前请求的资源路径, 各请求复用
+    bool closing_;      // 已响应短连接请求或错误请求, 发送完毕后关闭连接, 不再处理后续请求.
     static std::string root_path_; 
-    static int timeout_seconds_;  
+    static Timeouts timeouts_;  
+    static std::atomic<uint64_t> evictions_[kNumPhases]; 
+    static std::shared_ptr<FileCache> file_cache_; 
+    static std::shared_ptr<CompressCache> compress_cache_; 
+    static std::unordered_map<std::string, std::string> cache_control_; 
 };
 
 
@@ -72,3 +142,36 @@ struct MmapData {
     void* addr_;
     size_t size_;
 };
+
+
+// 打开文件供sendfile发送. RAII封装
+struct FileData {
+    explicit FileData(): fd_(-1), size_(0) { }
+    ~FileData();
+    bool open(const std::string& file_path); 
+    std::shared_ptr<void> share();    // 转移fd所有权至共享的guard
+    int fd_;
+    size_t size_;
+};
+
+
+// 待响应的静态资源文件: 命中缓存时持有缓存项, 否则持有打开的fd供sendfile发送(HEAD请求时不打开).
+// 经内容编码协商后, 也可能是预压缩文件或即时压缩的结果.
+struct StaticFile {
+    StaticFile(): size(0), mtime(0), fd(-1), encoding(nullptr), vary(false) { }
+    // 消息体是否位于内存中(缓存项或压缩结果), 否则以sendfile发送.
+    bool inMemory() const { return encoded || entry; }
+    const char* data() const { return encoded ? encoded->data.data() : entry->data(); }
+
+    FileCache::EntryPtr entry; 
+    CompressCache::EntryPtr encoded; 
+    std::string content_type; 
+    std::string etag; 
+    std::string last_modified; 
+    size_t size; 
+    time_t mtime; 
+    int fd; 
+    std::shared_ptr<void> guard;  // 维持fd有效
+    const char* encoding;         // Content-Encoding, 为空表示未编码
+    bool vary;                    // 响应随Accept-Encoding而变
+};
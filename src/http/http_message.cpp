@@ -1,7 +1,12 @@
 #include "http_message.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <strings.h>
 
 #include "logger.h"
@@ -10,11 +15,26 @@ using namespace std;
 
 
 HttpMethod getHttpMethodAsEnum(const std::string &method) {
-    if (strncasecmp(method.c_str(), "HEAD", 4) == 0) {
+    return getHttpMethodAsEnum(method.c_str()); 
+}
+
+HttpMethod getHttpMethodAsEnum(HeaderView method) {
+    if (method.len == 4 && strncasecmp(method.data, "HEAD", 4) == 0) {
         return HttpMethod::HEAD;
-    } else if (strncasecmp(method.c_str(), "GET", 3) == 0) {
+    } else if (method.len == 3 && strncasecmp(method.data, "GET", 3) == 0) {
         return HttpMethod::GET;
-    } else if (strncasecmp(method.c_str(), "POST", 4) == 0) {
+    } else if (method.len == 4 && strncasecmp(method.data, "POST", 4) == 0) {
+        return HttpMethod::POST;
+    }
+    return HttpMethod::UNKNOWN;
+}
+
+HttpMethod getHttpMethodAsEnum(const char* method) {
+    if (strncasecmp(method, "HEAD", 4) == 0) {
+        return HttpMethod::HEAD;
+    } else if (strncasecmp(method, "GET", 3) == 0) {
+        return HttpMethod::GET;
+    } else if (strncasecmp(method, "POST", 4) == 0) {
         return HttpMethod::POST;
     }
     return HttpMethod::UNKNOWN;
@@ -46,47 +66,342 @@ string getHttpStatusCodePhaseString(HttpStatusCode code) {
 
 
 string getContentType(const std::string& path) {
-    string::size_type pos = path.find_last_of('.'); 
-    if (pos == string::npos) {
-        return "text/plain";
-    }
-    string suffix = path.substr(pos);
-    auto it = CONTENT_TYPE.find(suffix); 
+    auto it = CONTENT_TYPE.find(getFileSuffix(path)); 
     if (it != CONTENT_TYPE.end()) {
         return it->second;
     }
     return "text/plain";
 }
 
-bool HttpMessage::setVersion(const string str) {
-    if (str == "HTTP/1.1" || str == "HTTP/1.0" || str == "HTTP/0") {
-        version_ = std::move(str);  
+string getFileSuffix(const string& path) {
+    string::size_type pos = path.find_last_of("./"); 
+    if (pos == string::npos || path[pos] != '.') {
+        return ""; 
+    }
+    return path.substr(pos); 
+}
+
+bool isCompressible(const string& content_type) {
+    return content_type.compare(0, 5, "text/") == 0 || 
+           content_type == "application/javascript" ||
+           content_type == "application/json" ||
+           content_type == "image/svg+xml"; 
+}
+
+
+bool AcceptedEncodings::accepts(const char* encoding) const {
+    if (strcmp(encoding, "gzip") == 0) return gzip; 
+    if (strcmp(encoding, "deflate") == 0) return deflate; 
+    if (strcmp(encoding, "br") == 0) return br; 
+    return false; 
+}
+
+static bool tokenEquals(const char* begin, const char* end, const char* token) {
+    size_t len = strlen(token); 
+    return static_cast<size_t>(end - begin) == len && strncasecmp(begin, token, len) == 0; 
+}
+
+AcceptedEncodings parseAcceptEncoding(HeaderView value) {
+    // 形如"gzip, deflate;q=0.5, br;q=0, *". 仅区分可接受与否, 不按q值排序, 优先级由服务器决定.
+    AcceptedEncodings result; 
+    int gzip = -1, deflate = -1, br = -1, star = -1;    // -1: 未列出, 0: 拒绝, 1: 接受
+    const char* p = value.data; 
+    const char* end = value.data + value.len; 
+    while (p < end) {
+        const char* item_end = static_cast<const char*>(memchr(p, ',', end - p)); 
+        if (item_end == nullptr) item_end = end; 
+        const char* semi = static_cast<const char*>(memchr(p, ';', item_end - p)); 
+        const char* name = p; 
+        const char* name_end = semi ? semi : item_end; 
+        while (name < name_end && *name == ' ') ++name; 
+        while (name_end > name && name_end[-1] == ' ') --name_end; 
+        int accepted = 1; 
+        if (semi != nullptr) {
+            // 在"q="之后解析数值, 仅关心是否为0.
+            for (const char* q = semi; q + 1 < item_end; ++q) {
+                if (q[0] == 'q' && q[1] == '=') {
+                    char buf[16]; 
+                    size_t n = min<size_t>(item_end - q - 2, sizeof(buf) - 1); 
+                    memcpy(buf, q + 2, n); 
+                    buf[n] = '\0'; 
+                    if (atof(buf) <= 0) accepted = 0; 
+                    break; 
+                }
+            }
+        }
+        if (tokenEquals(name, name_end, "gzip") || tokenEquals(name, name_end, "x-gzip")) gzip = accepted; 
+        else if (tokenEquals(name, name_end, "deflate")) deflate = accepted; 
+        else if (tokenEquals(name, name_end, "br")) br = accepted; 
+        else if (tokenEquals(name, name_end, "*")) star = accepted; 
+        p = item_end + 1; 
+    }
+    result.gzip = gzip == -1 ? star == 1 : gzip == 1; 
+    result.deflate = deflate == -1 ? star == 1 : deflate == 1; 
+    result.br = br == -1 ? star == 1 : br == 1; 
+    return result; 
+}
+
+
+string makeETag(ino_t inode, size_t size, const struct timespec& mtime) {
+    char buf[80]; 
+    int64_t mtime_ns = static_cast<int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec; 
+    snprintf(buf, sizeof(buf), "\"%lx-%zx-%lx\"", 
+             static_cast<unsigned long>(inode), size, static_cast<unsigned long>(mtime_ns)); 
+    return buf; 
+}
+
+bool matchETag(HeaderView value, const string& etag) {
+    // 弱比较: 忽略"W/"前缀.
+    const char* p = value.data; 
+    const char* end = value.data + value.len; 
+    while (p != end) {
+        while (p != end && (*p == ' ' || *p == ',')) ++p; 
+        if (p == end) break; 
+        if (*p == '*') {
+            return true; 
+        }
+        if (end - p > 2 && p[0] == 'W' && p[1] == '/') {
+            p += 2; 
+        }
+        const char* begin = p; 
+        if (p != end && *p == '"') {
+            ++p; 
+            while (p != end && *p != '"') ++p; 
+            if (p != end) ++p; 
+        } else {
+            while (p != end && *p != ',' && *p != ' ') ++p; 
+        }
+        if (static_cast<size_t>(p - begin) == etag.size() && 
+            memcmp(begin, etag.data(), etag.size()) == 0) {
+            return true; 
+        }
+    }
+    return false; 
+}
+
+string formatHttpDate(time_t t) {
+    struct tm tm_time {}; 
+    gmtime_r(&t, &tm_time); 
+    char buf[32]; 
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_time); 
+    return buf; 
+}
+
+bool parseHttpDate(HeaderView value, time_t* t) {
+    static const char* kFormats[] = {
+        "%a, %d %b %Y %H:%M:%S GMT",    // IMF-fixdate
+        "%A, %d-%b-%y %H:%M:%S GMT",    // RFC 850
+        "%a %b %e %H:%M:%S %Y",         // asctime
+    }; 
+    // strptime要求以'\0'结尾, 合法日期不超过29字节, 过长的值直接拒绝.
+    char buf[64]; 
+    if (value.len >= sizeof(buf)) {
+        return false; 
+    }
+    memcpy(buf, value.data, value.len); 
+    buf[value.len] = '\0'; 
+    for (const char* fmt : kFormats) {
+        struct tm tm_time {}; 
+        const char* end = strptime(buf, fmt, &tm_time); 
+        if (end != nullptr && *end == '\0') {
+            *t = timegm(&tm_time); 
+            return true; 
+        }
+    }
+    return false; 
+}
+
+// 单个请求中允许的最大区间数, 防止大量细碎区间放大响应开销.
+static const size_t kMaxRanges = 16; 
+
+static bool parseRangeNumber(const char*& p, const char* end, size_t* num) {
+    const char* begin = p; 
+    size_t n = 0; 
+    while (p != end && *p >= '0' && *p <= '9') {
+        size_t next = n * 10 + (*p - '0'); 
+        if (next < n) return false;   // 溢出
+        n = next; 
+        ++p; 
+    }
+    *num = n; 
+    return p != begin; 
+}
+
+RangeResult parseRange(HeaderView value, size_t file_size, vector<ByteRange>* ranges) {
+    ranges->clear(); 
+    if (value.len < 6 || memcmp(value.data, "bytes=", 6) != 0) {
+        return RangeResult::NONE; 
+    }
+    const char* p = value.data + 6; 
+    const char* end = value.data + value.len; 
+    size_t num_specs = 0; 
+    while (p != end) {
+        while (p != end && (*p == ' ' || *p == ',')) ++p; 
+        if (p == end) break; 
+        if (++num_specs > kMaxRanges) {
+            return RangeResult::NONE; 
+        }
+        size_t first = 0, last = 0; 
+        if (*p == '-') {  // 后缀区间"-N": 最后N个字节
+            ++p; 
+            if (!parseRangeNumber(p, end, &last)) return RangeResult::NONE; 
+            if (last == 0 || file_size == 0) continue;    // 不可满足
+            first = last >= file_size ? 0 : file_size - last; 
+            last = file_size - 1; 
+        } else {
+            if (!parseRangeNumber(p, end, &first)) return RangeResult::NONE; 
+            if (p == end || *p++ != '-') return RangeResult::NONE; 
+            if (p != end && *p >= '0' && *p <= '9') {
+                if (!parseRangeNumber(p, end, &last) || last < first) return RangeResult::NONE; 
+            } else {
+                last = SIZE_MAX; 
+            }
+            if (first >= file_size) continue;   // 不可满足
+            if (last >= file_size) last = file_size - 1; 
+        }
+        while (p != end && *p == ' ') ++p; 
+        if (p != end && *p != ',') return RangeResult::NONE; 
+        ranges->push_back(ByteRange{first, last}); 
+    }
+    if (num_specs == 0) {
+        return RangeResult::NONE; 
+    }
+    if (ranges->empty()) {
+        return RangeResult::UNSATISFIABLE; 
+    }
+    // 重复或大量重叠的区间会放大响应, 请求总量超过文件大小时直接返回完整内容. 
+    size_t requested = 0; 
+    for (auto& r : *ranges) {
+        requested += r.length(); 
+    }
+    if (requested > file_size) {
+        ranges->clear(); 
+        return RangeResult::NONE; 
+    }
+    // 按起始位置排序, 合并重叠或相邻的区间. 
+    sort(ranges->begin(), ranges->end(), [](const ByteRange& a, const ByteRange& b) { 
+        return a.first < b.first; 
+    }); 
+    size_t n = 0; 
+    for (size_t i = 1; i < ranges->size(); ++i) {
+        ByteRange& merged = (*ranges)[n]; 
+        const ByteRange& r = (*ranges)[i]; 
+        if (r.first <= merged.last + 1) {
+            merged.last = max(merged.last, r.last); 
+        } else {
+            (*ranges)[++n] = r; 
+        }
+    }
+    ranges->resize(n + 1); 
+    return RangeResult::SATISFIABLE; 
+}
+
+size_t formatUint(char* buf, uint64_t value) {
+    // 逆序写出各位数字, 再复制到buf, 免去to_string的临时对象.
+    char digits[kMaxUintDigits]; 
+    char* p = digits + sizeof(digits); 
+    do {
+        *--p = static_cast<char>('0' + value % 10); 
+        value /= 10; 
+    } while (value != 0); 
+    size_t len = digits + sizeof(digits) - p; 
+    memcpy(buf, p, len); 
+    return len; 
+}
+
+size_t formatContentRange(char* buf, const ByteRange* range, size_t complete_length) {
+    char* p = buf; 
+    memcpy(p, "bytes ", 6); 
+    p += 6; 
+    if (range) {
+        p += formatUint(p, range->first); 
+        *p++ = '-'; 
+        p += formatUint(p, range->last); 
+    } else {
+        *p++ = '*'; 
+    }
+    *p++ = '/'; 
+    p += formatUint(p, complete_length); 
+    return p - buf; 
+}
+
+
+HeaderView getCachedHttpDate() {
+    static thread_local time_t cached_sec = 0; 
+    static thread_local char cached_date[32]; 
+    static thread_local size_t cached_len = 0; 
+    time_t now = ::time(nullptr); 
+    if (now != cached_sec) {
+        struct tm tm_time {}; 
+        gmtime_r(&now, &tm_time); 
+        cached_len = strftime(cached_date, sizeof(cached_date), "%a, %d %b %Y %H:%M:%S GMT", &tm_time); 
+        cached_sec = now; 
+    }
+    return HeaderView(cached_date, cached_len); 
+}
+
+
+void HttpMessage::clear() {
+    version_.clear(); 
+    arena_.clear(); 
+    body_ = nullptr; 
+    body_size_ = 0; 
+}
+
+
+bool HttpMessage::setVersion(HeaderView str) {
+    if ((str.len == 8 && (memcmp(str.data, "HTTP/1.1", 8) == 0 || memcmp(str.data, "HTTP/1.0", 8) == 0)) ||
+        (str.len == 6 && memcmp(str.data, "HTTP/0", 6) == 0))
+    {
+        version_.assign(str.data, str.len);  
         return true;
     }
     return false; 
 }
 
 
-bool HttpMessage::addHeader(const string name, const string value) {
-    if (name.length() == 0 || value.length() == 0) return false; 
-    headers_.emplace_back(std::move(name), std::move(value)); 
+bool HttpMessage::addHeader(HeaderView name, HeaderView value) {
+    if (name.len == 0 || value.len == 0) return false; 
+    arena_.insert(arena_.end(), name.data, name.data + name.len); 
+    arena_.push_back(':'); 
+    arena_.push_back(' '); 
+    arena_.insert(arena_.end(), value.data, value.data + value.len); 
+    arena_.push_back('\r'); 
+    arena_.push_back('\n'); 
     return true;
 }
 
 
-bool HttpMessage::setHeader(const string name, const string value) {
-    for (auto& h : headers_) {
-        if (h.first.length() == name.length() && strcasecmp(h.first.c_str(), name.c_str()) == 0) {
-            h.second = std::move(value); 
-            return true; 
+bool HttpMessage::addHeader(HeaderView name, uint64_t value) {
+    char digits[kMaxUintDigits]; 
+    return addHeader(name, HeaderView(digits, formatUint(digits, value))); 
+}
+
+
+bool HttpMessage::setHeader(HeaderView name, HeaderView value) {
+    // 查找同名头部所在行, 移除后再追加. 仅用于少数需要覆盖头部的场景.
+    size_t line = 0; 
+    while (line < arena_.size()) {
+        const char* begin = arena_.data() + line; 
+        const char* end = static_cast<const char*>(memchr(begin, '\n', arena_.size() - line)); 
+        size_t line_len = end - begin + 1; 
+        if (line_len > name.len + 1 && begin[name.len] == ':' && 
+            strncasecmp(begin, name.data, name.len) == 0) 
+        {
+            arena_.erase(arena_.begin() + line, arena_.begin() + line + line_len); 
+            break; 
         }
+        line += line_len; 
     }
-    return addHeader(std::move(name), std::move(value)); 
+    return addHeader(name, value); 
 }
 
 
-bool HttpMessage::setHeaders(vector<pair<string, string>> headers) {
-    this->headers_ = std::move(headers); 
+bool HttpMessage::setHeaders(const vector<pair<string, string>>& headers) {
+    arena_.clear(); 
+    for (auto& h : headers) {
+        addHeader(h.first, h.second); 
+    }
     return true;
 }
 
@@ -101,54 +416,26 @@ bool HttpMessage::setBody(const void* data, size_t len) {
 }
 
 int HttpMessage::encode(struct iovec vectors[], int max) const{
-    fillStartLine();
-    assert(max >= 6); 
-    vectors[0].iov_base = (void*)startline_[0].base;  // static_cast<void*>(const_cast<char*>(version.c_str())); 
-    vectors[0].iov_len = startline_[0].len; 
-    vectors[1].iov_base = (void*)" ";  // static_cast<void*>(const_cast<char*>(" ")); 
-    vectors[1].iov_len = 1; 
-    vectors[2].iov_base = (void*)startline_[1].base; 
-    vectors[2].iov_len = startline_[1].len; 
-    vectors[3].iov_base = (void*)" ";
-    vectors[3].iov_len = 1;
-    vectors[4].iov_base = (void*)startline_[2].base;
-    vectors[4].iov_len = startline_[2].len;   
-    vectors[5].iov_base = (void*)"\r\n"; 
-    vectors[5].iov_len = 2; 
-
-    int i = 6; 
-    for (auto& t : headers_) {
-        if (i + 4 > max) {
-            errno = EOVERFLOW;  
-            return -1; 
-        }
-        vectors[i].iov_base = (void*)t.first.data();   // name
-        vectors[i].iov_len = t.first.length(); 
-        ++i; 
-        vectors[i].iov_base = (void*)": "; 
-        vectors[i].iov_len = 2;
-        ++i; 
-        vectors[i].iov_base = (void*)t.second.data();  // value
-        vectors[i].iov_len = t.second.length(); 
-        ++i; 
-        vectors[i].iov_base = (void*)"\r\n";
-        vectors[i].iov_len = 2; 
-        ++i;
-    }    
-
-    if (i + 2 > max) {
-        errno = EOVERFLOW; 
+    HeaderView start_line = getStartLine(); 
+    if (max < 4) {
+        errno = EOVERFLOW;  
         return -1; 
     }
+    // 起始行 + 已编码的头部 + 空行 + 消息体.
+    int i = 0; 
+    vectors[i].iov_base = (void*)start_line.data; 
+    vectors[i].iov_len = start_line.len; 
+    ++i; 
+    if (!arena_.empty()) {
+        vectors[i].iov_base = (void*)arena_.data(); 
+        vectors[i].iov_len = arena_.size(); 
+        ++i; 
+    }
     vectors[i].iov_base = (void*)"\r\n";
     vectors[i].iov_len = 2; 
     ++i;
 
     if (body_ && body_size_ > 0) {
-        if (i == max) {
-            errno = EOVERFLOW;
-            return -1; 
-        }
         vectors[i].iov_base = (void*)body_; 
         vectors[i].iov_len = body_size_;   
         ++i;
@@ -157,19 +444,9 @@ int HttpMessage::encode(struct iovec vectors[], int max) const{
 }
 
 void HttpMessage::encode(Buffer* buf) const {
-    fillStartLine();  
-    buf->append(startline_[0].base, startline_[0].len); 
-    buf->append(" ");
-    buf->append(startline_[1].base, startline_[1].len);
-    buf->append(" ");
-    buf->append(startline_[2].base, startline_[2].len);
-    buf->append("\r\n"); 
-    for (auto& t : headers_) {
-        buf->append(t.first.data(), t.first.length()); 
-        buf->append(": ");
-        buf->append(t.second.data(), t.second.length());
-        buf->append("\r\n"); 
-    }
+    HeaderView start_line = getStartLine(); 
+    buf->append(start_line.data, start_line.len); 
+    buf->append(arena_.data(), arena_.size()); 
     buf->append("\r\n");
     if (body_ && body_size_ > 0) {
         LOG_TRACE << " HttpMessage::encode buf->append(body, body_size), body: " 
@@ -180,19 +457,9 @@ void HttpMessage::encode(Buffer* buf) const {
 
 
 string HttpMessage::encode() const {
-    fillStartLine(); 
-    string ret = string(startline_[0].base, startline_[0].len);
-    ret += " ";
-    ret += string(startline_[1].base, startline_[1].len);
-    ret += " ";
-    ret += string(startline_[2].base, startline_[2].len);
-    ret += "\r\n";
-    for (auto& t: headers_) {
-        ret += t.first;
-        ret += ": ";
-        ret += t.second;
-        ret += "\r\n";
-    }
+    HeaderView start_line = getStartLine(); 
+    string ret(start_line.data, start_line.len);
+    ret.append(arena_.data(), arena_.size()); 
     ret += "\r\n";
     if (body_ && body_size_ > 0) {
         ret += string((char*)body_, body_size_); 
@@ -232,19 +499,12 @@ bool HttpRequest::setUri(const string str) {
     return true;
 }
 
-void HttpRequest::fillStartLine() const {
-    startline_[0].base = method_.data(); 
-    startline_[0].len = method_.length();
-    startline_[1].base = uri_.data();
-    startline_[1].len = uri_.length();
-    startline_[2].base = version_.data();
-    startline_[2].len = version_.length(); 
-    assert(startline_[0].base);
-    assert(startline_[0].len > 0);
-    assert(startline_[1].base);
-    assert(startline_[1].len > 0); 
-    assert(startline_[2].base);
-    assert(startline_[2].len > 0); 
+HeaderView HttpRequest::getStartLine() const {
+    assert(!method_.empty());
+    assert(!uri_.empty()); 
+    assert(!version_.empty()); 
+    startline_ = method_ + " " + uri_ + " " + version_ + "\r\n"; 
+    return startline_; 
 }
 
 // ----------------------------------------HttpRequest end
@@ -254,30 +514,53 @@ void HttpRequest::fillStartLine() const {
 
 // ----------------------------------------HttpResponse begin
 
+struct HttpResponse::StatusLine {
+    HttpStatusCode code; 
+    std::string http11;     // "HTTP/1.1 200 OK\r\n"
+    std::string http10; 
+    std::string code_phase; // "200 OK"
+};
+
+// 启动时由STATUS_CODE_PHASE生成全部状态行. 状态码不多, 顺序查找即可, 免去哈希.
+static const vector<HttpResponse::StatusLine>& getStatusLines() {
+    static const vector<HttpResponse::StatusLine> lines = []() {
+        vector<HttpResponse::StatusLine> v; 
+        for (auto& p : STATUS_CODE_PHASE) {
+            string code_phase = p.second.first + " " + p.second.second; 
+            v.push_back(HttpResponse::StatusLine{
+                p.first, 
+                "HTTP/1.1 " + code_phase + "\r\n", 
+                "HTTP/1.0 " + code_phase + "\r\n", 
+                code_phase
+            }); 
+        }
+        return v; 
+    }(); 
+    return lines; 
+}
+
 bool HttpResponse::setStatus(HttpStatusCode code) {
-    auto p = STATUS_CODE_PHASE.find(code);
     code_ = code;
-    if (p != STATUS_CODE_PHASE.end()) {
-        this->code_str_ = p->second.first;
-        this->phase_ = p->second.second; 
-        return true; 
+    status_ = nullptr; 
+    for (auto& line : getStatusLines()) {
+        if (line.code == code) {
+            status_ = &line; 
+            return true; 
+        }
     }
     return false; 
 }
 
-void HttpResponse::fillStartLine() const {
-    startline_[0].base = version_.data(); 
-    startline_[0].len = version_.length();
-    startline_[1].base = code_str_.data();
-    startline_[1].len = code_str_.length();
-    startline_[2].base = phase_.data();
-    startline_[2].len = phase_.length(); 
-    assert(startline_[0].base);
-    assert(startline_[0].len > 0);
-    assert(startline_[1].base);
-    assert(startline_[1].len > 0); 
-    assert(startline_[2].base);
-    assert(startline_[2].len > 0); 
+HeaderView HttpResponse::getStartLine() const {
+    assert(status_);
+    assert(!version_.empty()); 
+    if (version_ == "HTTP/1.1") {
+        return status_->http11; 
+    } else if (version_ == "HTTP/1.0") {
+        return status_->http10; 
+    }
+    startline_ = version_ + " " + status_->code_phase + "\r\n"; 
+    return startline_; 
 }
 
-// ----------------------------------------HttpResponse end
\ No newline at end of file
+// ----------------------------------------HttpResponse end
@@ -1,13 +1,35 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <ctime>
+#include <sys/types.h>
 #include <sys/uio.h>
 
 #include "buffer.h"
 
 
+// 头部名称/值(或请求报文字段)的只读视图, 避免构造临时std::string. 
+// 字符串字面量在编译期即确定长度, 常用头部名称无需strlen, 也无需拷贝.
+struct HeaderView {
+    HeaderView(): data(nullptr), len(0) { }
+    HeaderView(const char* d, size_t l): data(d), len(l) { }
+    HeaderView(const std::string& s): data(s.data()), len(s.size()) { }
+    template <size_t N>
+    HeaderView(const char (&s)[N]): data(s), len(N - 1) { }
+
+    const char* data; 
+    size_t len; 
+};
+
+inline bool operator==(HeaderView lhs, HeaderView rhs) {
+    return lhs.len == rhs.len && (lhs.len == 0 || memcmp(lhs.data, rhs.data, lhs.len) == 0); 
+}
+
+
 enum class HttpMethod {
     GET = 0,
     HEAD,
@@ -16,6 +38,8 @@ enum class HttpMethod {
 }; 
 
 HttpMethod getHttpMethodAsEnum(const std::string& method); 
+HttpMethod getHttpMethodAsEnum(const char* method); 
+HttpMethod getHttpMethodAsEnum(HeaderView method); 
 std::string  getHttpMethodAsString(const HttpMethod& method); 
 
 
@@ -23,9 +47,12 @@ enum class HttpStatusCode {
     Continue = 100,  
 	OK = 200,
     NoContent = 204, 
+    PartialContent = 206, 
+    NotModified = 304, 
     BadRequest = 400,
     Forbidden = 403, 
     NotFound = 404, 
+    RangeNotSatisfiable = 416, 
     InternalServerError = 500,
     NotImplemented = 501
 }; 
@@ -35,9 +62,12 @@ STATUS_CODE_PHASE {
     {HttpStatusCode::Continue,    {"100", "Continue"}},
     {HttpStatusCode::OK,          {"200", "OK"}}, 
     {HttpStatusCode::NoContent,   {"204", "No Content"}}, 
+    {HttpStatusCode::PartialContent, {"206", "Partial Content"}}, 
+    {HttpStatusCode::NotModified, {"304", "Not Modified"}}, 
     {HttpStatusCode::BadRequest,  {"400", "Bad Request"}},
     {HttpStatusCode::Forbidden,   {"403", "Forbidden"}},
     {HttpStatusCode::NotFound,    {"404", "Not Found"}},
+    {HttpStatusCode::RangeNotSatisfiable, {"416", "Range Not Satisfiable"}},
     {HttpStatusCode::InternalServerError,  {"500", "Internal Server Error"}},
     {HttpStatusCode::NotImplemented, {"501", "Not Implemented"}}
 }; 
@@ -64,16 +94,83 @@ const std::unordered_map<std::string, std::string> CONTENT_TYPE = {
 };
 
 std::string getContentType(const std::string& path); 
+// 文件后缀(含'.'), 无后缀时返回空串. 
+std::string getFileSuffix(const std::string& path); 
+// 是否值得压缩的内容类型(文本类). 
+bool isCompressible(const std::string& content_type); 
+
+
+// Accept-Encoding中可接受(q>0)的编码. 
+struct AcceptedEncodings {
+    bool gzip = false; 
+    bool deflate = false; 
+    bool br = false; 
+    bool accepts(const char* encoding) const; 
+};
+
+AcceptedEncodings parseAcceptEncoding(HeaderView value); 
+
 
+// 由inode/size/mtime生成强校验器ETag, 形如"\"<inode>-<size>-<mtime>\""(16进制). 
+std::string makeETag(ino_t inode, size_t size, const struct timespec& mtime); 
+// If-None-Match/If-Range的值与etag是否匹配(弱比较, 支持"*"与逗号分隔的列表). 
+bool matchETag(HeaderView value, const std::string& etag); 
+// 格式化为HTTP-date(IMF-fixdate), 如"Sun, 06 Nov 1994 08:49:37 GMT". 
+std::string formatHttpDate(time_t t); 
+// 解析HTTP-date, 支持IMF-fixdate/RFC 850/asctime三种格式. 
+bool parseHttpDate(HeaderView value, time_t* t); 
 
+
+// 字节区间[first, last], 闭区间. 
+struct ByteRange {
+    size_t first; 
+    size_t last; 
+    size_t length() const { return last - first + 1; }
+};
+
+enum class RangeResult {
+    NONE = 0,         // 无Range头或格式无法识别, 忽略之, 返回完整内容
+    SATISFIABLE,      // 至少一个区间有效
+    UNSATISFIABLE     // 所有区间均超出文件范围, 应返回416
+};
+
+/* 解析Range头部值(如"bytes=0-499, -500, 9500-"). 
+ * 有效区间按起始位置排序, 重叠或相邻的区间合并, 合并后只剩一个区间时按单区间响应. 
+ * 请求的字节总数(合并前)超过文件大小时视为滥用, 返回NONE, 忽略Range头返回完整内容. 
+ */
+RangeResult parseRange(HeaderView value, size_t file_size, std::vector<ByteRange>* ranges); 
+
+// 十进制格式化value写入buf, 返回写入的字节数. buf至少kMaxUintDigits字节, 不写入'\0'. 
+const size_t kMaxUintDigits = 20; 
+size_t formatUint(char* buf, uint64_t value); 
+// 格式化Content-Range的值"bytes <first>-<last>/<size>", range为nullptr时为"bytes */<size>"(416). 
+// buf至少kMaxContentRangeLen字节, 返回写入的字节数. 
+const size_t kMaxContentRangeLen = 6 + 3 * kMaxUintDigits + 2; 
+size_t formatContentRange(char* buf, const ByteRange* range, size_t complete_length); 
+
+
+// 当前时间的HTTP-date. 每个线程(即每个EventLoop)各缓存一份, 每秒至多格式化一次.
+HeaderView getCachedHttpDate(); 
+
+
+/* HTTP报文的编码.
+ *
+ * 头部在添加时即以"name: value\r\n"的形式编码进arena_, 整数值直接格式化进arena_,
+ * 不为每个头部分配std::string; clear()保留arena_容量, 
+ * 同一对象复用于连接上的后续报文时, 编码头部不再分配内存.
+ */
 class HttpMessage {
 public:
     HttpMessage(): body_(nullptr), body_size_(0) {};
     virtual ~HttpMessage() = default; 
-    bool setVersion(const std::string str); 
-    bool addHeader(const std::string name, const std::string value);
-    bool setHeader(const std::string name, const std::string value);
-    bool setHeaders(std::vector<std::pair<std::string, std::string>> headers); 
+    // 清空报文内容以便复用, 保留已分配的内存.
+    void clear(); 
+    bool setVersion(HeaderView str); 
+    bool setVersion(const char* str) { return setVersion(HeaderView(str, strlen(str))); }
+    bool addHeader(HeaderView name, HeaderView value);
+    bool addHeader(HeaderView name, uint64_t value);    // 整数值, 如Content-Length
+    bool setHeader(HeaderView name, HeaderView value);
+    bool setHeaders(const std::vector<std::pair<std::string, std::string>>& headers); 
     bool setBody(const void* data, size_t len); 
     const void* getBody() const { return body_; }
     size_t getBodySize() const { return body_size_; }
@@ -83,20 +180,15 @@ public:
     void encode(Buffer* buffer) const;
 
 protected:
-    virtual void fillStartLine() const = 0;    // 纯虚函数
+    // 返回起始行(含结尾的"\r\n").
+    virtual HeaderView getStartLine() const = 0;    // 纯虚函数
 
 public:
     static const int ENCODE_IOV_MAX = 2048; 
 
 protected:
-    // 用于作为请求行/响应行中的三个字段的占位符.
-    struct field {
-        const char* base;
-        size_t len; 
-    } mutable startline_[3]; 
-    
     std::string version_;
-    std::vector<std::pair<std::string, std::string>> headers_; 
+    std::vector<char> arena_;    // 已编码的头部
     const void* body_;    
     size_t body_size_; 
 };
@@ -111,26 +203,30 @@ public:
     bool setUri(const std::string str); 
 
 private:
-    void fillStartLine() const override; 
+    HeaderView getStartLine() const override; 
 private:
     std::string method_;
     std::string uri_;
+    mutable std::string startline_; 
 };
 
 
 class HttpResponse: public HttpMessage {
 public:
-    HttpResponse() = default;
+    HttpResponse(): code_(HttpStatusCode::OK), status_(nullptr) { }
     ~HttpResponse() = default; 
     bool setStatus(HttpStatusCode code);  // 根据状态码, 自动设定值, 短语; 
     HttpStatusCode getCode() const  { return code_; }
-    std::string getCodeAsString() const { return code_str_; }
+    std::string getCodeAsString() const { return getHttpStatusCodeString(code_); }
+
+    // 预先生成的状态行, 按状态码查表, 不再逐次拼接.
+    struct StatusLine; 
 
 private:
-    void fillStartLine() const override; 
+    HeaderView getStartLine() const override; 
 
 private:
     HttpStatusCode code_;
-    std::string code_str_;
-    std::string phase_;
+    const StatusLine* status_;
+    mutable std::string startline_;   // 非HTTP/1.0与HTTP/1.1时临时拼接
 };
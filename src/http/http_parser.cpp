@@ -1,11 +1,51 @@
 #include "http_parser.h"
 
 #include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <strings.h>
+
+#include "delimiter_scanner.h"
 
 using namespace std; 
 
-HttpParser::HttpParser() {
+bool HttpParser::fast_scan = true; 
+
+// 控制字符(0x00-0x1f, 0x7f)不得出现在请求行与头部中(头部值中的'\t'除外).
+static inline bool isCtl(char c) {
+    unsigned char u = static_cast<unsigned char>(c); 
+    return u < 0x20 || u == 0x7f; 
+}
+
+// 方法与头部名称为token(RFC 9110 5.6.2): 1*tchar, 
+// tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." / "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+struct TcharTable {
+    bool valid[256]; 
+    TcharTable() : valid() {
+        for (int c = '0'; c <= '9'; ++c) valid[c] = true; 
+        for (int c = 'a'; c <= 'z'; ++c) valid[c] = true; 
+        for (int c = 'A'; c <= 'Z'; ++c) valid[c] = true; 
+        for (const char* p = "!#$%&'*+-.^_`|~"; *p; ++p) valid[static_cast<unsigned char>(*p)] = true; 
+    }
+}; 
+static const TcharTable kTchar; 
+
+// 分隔符扫描只排除控制字符, 完整的方法与头部名称在此逐字节校验. 
+static bool isToken(const char* p, const char* end) {
+    if (p == end) {
+        return false; 
+    }
+    for (; p != end; ++p) {
+        if (!kTchar.valid[static_cast<unsigned char>(*p)]) {
+            return false; 
+        }
+    }
+    return true; 
+}
+
+HttpParser::HttpParser(bool zero_copy)
+    : zero_copy(zero_copy)
+{
     reset(); 
 }
 
@@ -24,6 +64,9 @@ void HttpParser::reset() {
     end = nullptr; 
     headers.clear(); 
     body.clear();  
+    base = nullptr; 
+    method_slice = uri_slice = version_slice = name_slice = body_slice = Slice{0, 0}; 
+    header_slices.clear(); 
 }
 
 
@@ -31,9 +74,16 @@ HttpParser::ParseResult HttpParser::parse(const char* data, const size_t len, si
     if (parse_phase == ParsePhase::DONE) {
         reset(); 
     }
-    this->pos = data;
-    this->end = data + len; 
     size_t msg_size = header_offset + body_offset;  // 记录当前已解析得到的消息字节数. 
+    if (zero_copy) {
+        // data为请求起始处, 跳过此前已解析的部分.
+        assert(len >= msg_size); 
+        this->base = data; 
+        this->pos = data + msg_size; 
+    } else {
+        this->pos = data;
+    }
+    this->end = data + len; 
 
     ParseResult ret = ParseResult::SUCCESS; 
     while (ret == ParseResult::SUCCESS && parse_phase != ParsePhase::DONE) {
@@ -67,9 +117,12 @@ HttpParser::ParseResult HttpParser::parse(const char* data, const size_t len, si
         }
     }
 
-    // 计算此次调用中解析得到的有效字节数.
+    // 计算此次调用中解析得到的有效字节数(零拷贝模式下为该请求累计已解析的字节数).
+    parsed_size = header_offset + body_offset; 
+    if (!zero_copy) {
+        parsed_size -= msg_size; 
+    }
     assert(parsed_size <= len); 
-    parsed_size = header_offset + body_offset - msg_size; 
     return ret; 
 };
 
@@ -85,13 +138,18 @@ HttpParser::ParseResult HttpParser::parseRequestLine() {
             } break; 
 
             case State::METHOD: {
+                if (fast_scan && (pos = scanDelimiter(pos, end, ' ')) == end) {
+                    break;   // 字段不完整, 留待下次解析
+                }
                 if (*pos == ' ') {
                     parse_rl_state = State::BEFORE_URI; 
-                    if (!checkMethod(method, pos - method)) {
+                    if (!isToken(method, pos) || !checkMethod(method, pos - method)) {
                         return ParseResult::ERROR; 
                     }
                     header_offset += pos - method + 1;    // 包括空格. 
-                } 
+                } else if (isCtl(*pos)) {
+                    return ParseResult::ERROR; 
+                }
                 ++pos; 
             } break; 
 
@@ -101,12 +159,17 @@ HttpParser::ParseResult HttpParser::parseRequestLine() {
             } break; 
             
             case State::URI: {
+                if (fast_scan && (pos = scanDelimiter(pos, end, ' ')) == end) {
+                    break; 
+                }
                 if (*pos == ' ') {
                     parse_rl_state = State::BEFORE_VERSION; 
                     if (!checkUri(uri, pos - uri)) {
                         return ParseResult::ERROR; 
                     }
                     header_offset += pos - uri + 1;
+                } else if (isCtl(*pos)) {
+                    return ParseResult::ERROR; 
                 }
                 ++pos; 
             } break;
@@ -117,12 +180,17 @@ HttpParser::ParseResult HttpParser::parseRequestLine() {
             } break; 
 
             case State::VERSION: {
+                if (fast_scan && (pos = scanDelimiter(pos, end, '\r')) == end) {
+                    break; 
+                }
                 if (*pos == '\r') {
                     parse_rl_state = State::LF; 
                     if (!checkVersion(version, pos - version)) {
                         return ParseResult::ERROR; 
                     }
                     header_offset += pos - version + 1; 
+                } else if (isCtl(*pos)) {
+                    return ParseResult::ERROR; 
                 }
                 ++pos; 
             } break; 
@@ -158,9 +226,10 @@ HttpParser::ParseResult HttpParser::parseRequestLine() {
 
 
 HttpParser::ParseResult HttpParser::parseHeader() {
-    // 解析name时利用一个name_buf缓冲区记录name, 而value则直接用指针指示起始位置. 
+    // 解析name时利用一个name_buf缓冲区记录name(零拷贝模式下仅记录其位置), 而value则直接用指针指示起始位置. 
     // 当得到完整的name-value后, 再记录. 
     using State = ParseHeaderState;
+    const char* name = nullptr; 
     const char* value = nullptr; 
     while (pos != end) { 
         switch (parse_hd_state) {
@@ -168,19 +237,46 @@ HttpParser::ParseResult HttpParser::parseHeader() {
                 if (*pos == '\r') {
                     parse_hd_state = State::END_CR;
                 } else {
+                    name = pos; 
                     name_buf_pos = 0; 
                     parse_hd_state = State::KEY; 
                 }
             } break;
 
             case State::KEY: {
+                if (fast_scan) {
+                    // 一次跳过name中的普通字符, 至多扫描至name_buf上限处, 超限由下方逐字节判断.
+                    size_t room = HEADER_NAME_MAX - 1 - name_buf_pos; 
+                    const char* limit = static_cast<size_t>(end - pos) > room ? pos + room : end; 
+                    const char* stop = scanDelimiter(pos, limit, ':'); 
+                    if (!zero_copy) {
+                        memcpy(name_buf + name_buf_pos, pos, stop - pos); 
+                    }
+                    name_buf_pos += stop - pos; 
+                    pos = stop; 
+                    if (pos == end) {
+                        break; 
+                    }
+                }
                 if (*pos == ':') {
-                    name_buf[name_buf_pos++] = '\0'; 
+                    if (!isToken(name, pos)) {
+                        return ParseResult::ERROR; 
+                    }
+                    if (zero_copy) {
+                        name_slice = toSlice(name, pos - name); 
+                        name_buf_pos = pos - name + 1; 
+                    } else {
+                        name_buf[name_buf_pos++] = '\0'; 
+                    }
                     parse_hd_state = State::SPACE; 
                     header_offset += name_buf_pos;   // 包括':'
+                } else if (isCtl(*pos)) {
+                    return ParseResult::ERROR; 
                 } else {
-                    name_buf[name_buf_pos++] = *pos; 
-                    if (name_buf_pos == HEADER_NAME_MAX) {
+                    if (!zero_copy) {
+                        name_buf[name_buf_pos] = *pos; 
+                    }
+                    if (++name_buf_pos == HEADER_NAME_MAX) {
                         return ParseResult::ERROR; 
                     }
                 }
@@ -202,12 +298,18 @@ HttpParser::ParseResult HttpParser::parseHeader() {
             } break; 
 
             case State::VALUE: {
+                if (fast_scan && (pos = scanDelimiter(pos, end, '\r')) == end) {
+                    break; 
+                }
                 if (*pos == '\r') {
-                    if (!checkHeader(name_buf, name_buf_pos - 1, value, pos - value)) {   // name_buf_pos-1, 不计入'\0'. 
+                    const char* n = zero_copy ? base + name_slice.offset : name_buf; 
+                    if (!checkHeader(n, name_buf_pos - 1, value, pos - value)) {   // name_buf_pos-1, 不计入'\0'或':'. 
                         return ParseResult::ERROR; 
                     }
                     parse_hd_state = State::LF; 
                     header_offset += pos - value + 1;  // 包括'\r'
+                } else if (*pos != '\t' && isCtl(*pos)) {
+                    return ParseResult::ERROR; 
                 }
                 ++pos; 
             } break; 
@@ -255,6 +357,15 @@ HttpParser::ParseResult HttpParser::parseBody() {
     size_t len = end - pos; 
     if (this->chunked) {
         return ParseResult::SUCCESS; 
+    } else if (zero_copy) {
+        // 消息体紧随头部之后, 仅记录位置.
+        if (body_offset + len >= content_length) {
+            body_offset = content_length; 
+            body_slice = Slice{header_offset, content_length}; 
+            return ParseResult::SUCCESS; 
+        }
+        body_offset += len; 
+        return ParseResult::AGAIN; 
     } else {
         body.reserve(content_length);   // 保留足够的content_length空间. 
         if (body_offset + len >= content_length) {  // 剩余内容覆盖了完整body. 
@@ -279,26 +390,37 @@ bool HttpParser::checkMethod(const char* str, size_t len) {
     //     this->method = string(str, len); 
     // }
     // return ret;
-    this->method = string(str, len); 
+    if (zero_copy) {
+        this->method_slice = toSlice(str, len); 
+    } else {
+        this->method = string(str, len); 
+    }
     return true;
 }
 
 bool HttpParser::checkUri(const char* str, size_t len) {
-    this->uri = string(str, len); 
+    if (zero_copy) {
+        this->uri_slice = toSlice(str, len); 
+    } else {
+        this->uri = string(str, len); 
+    }
     return true; 
 }
 
 bool HttpParser::checkVersion(const char* str, size_t len) {
     if (strncasecmp(str, "HTTP/1.0", len) == 0 || strncasecmp(str, "HTTP/0", len) == 0) {
-        this->version = string(str, len); 
         this->keep_alive = false; 
-        return true;
     } else if (strncasecmp(str, "HTTP/1.1", len) == 0) {
-        this->version = string(str, len); 
         this->keep_alive = true;   
-        return true;
+    } else {
+        return false;
+    }
+    if (zero_copy) {
+        this->version_slice = toSlice(str, len); 
+    } else {
+        this->version = string(str, len); 
     }
-    return false;
+    return true;
 }
 
 
@@ -320,7 +442,18 @@ bool HttpParser::checkHeader(const char* name, size_t n_len, const char* value,
         case 14: {
             if (strncasecmp(name, "Content-Length", 14) == 0) {
                 // this->has_content_length = true; 
-                this->content_length = stoi(string(value, v_len)); 
+                // 逐位解析, 非法值视为错误请求, 而非抛出异常.
+                size_t n = 0; 
+                for (size_t i = 0; i < v_len; ++i) {
+                    if (value[i] < '0' || value[i] > '9' || n > (SIZE_MAX - 9) / 10) {
+                        return false; 
+                    }
+                    n = n * 10 + (value[i] - '0'); 
+                }
+                if (v_len == 0) {
+                    return false; 
+                }
+                this->content_length = n; 
             }
         } break;
 
@@ -331,13 +464,27 @@ bool HttpParser::checkHeader(const char* name, size_t n_len, const char* value,
         } break; 
     }
 
-    headers.emplace_back(string(name, n_len), string(value, v_len)); 
+    if (zero_copy) {
+        header_slices.emplace_back(Slice{static_cast<size_t>(name - base), n_len}, toSlice(value, v_len)); 
+    } else {
+        headers.emplace_back(string(name, n_len), string(value, v_len)); 
+    }
     return true; 
 }
 
 
 string HttpParser::encode() const {
     assert(parse_phase == ParsePhase::DONE);
+    if (zero_copy) {
+        auto str = [this](const Slice& slice) { return string(base + slice.offset, slice.len); }; 
+        string ret = str(method_slice) + " " + str(uri_slice) + " " + str(version_slice) + "\r\n";
+        for (auto& p : header_slices) {
+            ret += str(p.first) + ": " + str(p.second) + "\r\n"; 
+        }
+        ret += "\r\n";
+        ret += str(body_slice); 
+        return ret; 
+    }
     string ret = method + " " + uri + " " + version + "\r\n";
     for (auto& p : headers) {
         ret += p.first + ": " + p.second + "\r\n"; 
@@ -376,6 +523,46 @@ const vector<pair<string, string>>& HttpParser::getHeaders() const {
     return headers; 
 }
 
+const string* HttpParser::getHeader(const char* name) const {
+    size_t len = strlen(name); 
+    for (auto& h : headers) {
+        if (h.first.length() == len && strncasecmp(h.first.data(), name, len) == 0) {
+            return &h.second; 
+        }
+    }
+    return nullptr; 
+}
+
+HeaderView HttpParser::getMethodView() const {
+    return zero_copy ? toView(method_slice) : HeaderView(method); 
+}
+
+HeaderView HttpParser::getUriView() const {
+    return zero_copy ? toView(uri_slice) : HeaderView(uri); 
+}
+
+HeaderView HttpParser::getVersionView() const {
+    return zero_copy ? toView(version_slice) : HeaderView(version); 
+}
+
+HeaderView HttpParser::getBodyView() const {
+    return zero_copy ? toView(body_slice) : HeaderView(body.data(), body.size()); 
+}
+
+HeaderView HttpParser::getHeaderView(const char* name) const {
+    size_t len = strlen(name); 
+    if (zero_copy) {
+        for (auto& h : header_slices) {
+            if (h.first.len == len && strncasecmp(base + h.first.offset, name, len) == 0) {
+                return toView(h.second); 
+            }
+        }
+        return HeaderView(); 
+    }
+    const string* value = getHeader(name); 
+    return value ? HeaderView(*value) : HeaderView(); 
+}
+
 bool HttpParser::isKeepAlive() const {
     return keep_alive; 
 }
\ No newline at end of file
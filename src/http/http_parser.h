@@ -3,8 +3,20 @@
 #include <string>
 #include <vector>
 
+#include "http_message.h"
+
 using namespace std; 
 
+/* HTTP请求报文解析器(主-从状态机), 支持不完整报文的多次重入解析. 两种模式:
+ *
+ * - 拷贝模式(默认): 每次parse()返回本次解析的字节数, 调用方随即可丢弃这部分数据; 
+ *   method/uri/version/头部/消息体均拷贝至解析器内部.
+ * - 零拷贝模式: 调用方保留整个请求的数据, 每次parse()均从请求起始处传入(此前已解析的部分亦然),
+ *   parsed_size为该请求累计已解析的字节数. 各字段仅记录相对请求起始处的(偏移, 长度), 
+ *   经get*View()返回指向最近一次传入数据的视图, 有效期至调用方丢弃该请求(如Buffer::retrieve)为止. 
+ *   复用同一解析器时, 解析请求不再分配内存.
+ */
+
 class HttpParser {
 public:
     enum class ParseResult {
@@ -16,20 +28,38 @@ public:
     using Headers = std::vector<std::pair<std::string, std::string>>;
 
 public:
-    HttpParser(); 
+    explicit HttpParser(bool zero_copy = false); 
     ~HttpParser() = default;
     ParseResult parse(const char* data, const size_t len, size_t& parsed_size);
     std::string encode() const ; 
+    bool isZeroCopy() const { return zero_copy; }
     
+    // 以下仅限拷贝模式.
     const char* getMethod() const ;
     const char* getUri() const ;
     const char* getVersion() const ;
     const Headers& getHeaders() const ; 
+    // 按名称查找头部(忽略大小写), 不存在时返回nullptr.
+    const std::string* getHeader(const char* name) const; 
     const char* getBody() const ; 
     size_t getBodySize() const;
+
+    // 两种模式通用. 
+    HeaderView getMethodView() const; 
+    HeaderView getUriView() const; 
+    HeaderView getVersionView() const; 
+    // 按名称查找头部(忽略大小写), 不存在时返回的视图data为nullptr.
+    HeaderView getHeaderView(const char* name) const; 
+    HeaderView getBodyView() const; 
     bool isKeepAlive() const; 
 
     bool parsingCompletion(); 
+    // 当前请求的头部是否已解析完毕(正在解析消息体或已完成).
+    bool isHeaderComplete() const { return parse_phase == ParsePhase::BODY || parse_phase == ParsePhase::DONE; }
+
+    // 是否以delimiter_scanner批量跳过普通字符(默认开启). 关闭时逐字节经状态机解析, 用于测试与基准比较.
+    static void setFastScan(bool on) { fast_scan = on; }
+    static bool isFastScan() { return fast_scan; }
 
 private:
     enum class ParsePhase {
@@ -60,8 +90,16 @@ private:
         END_LF, 
     }; 
 
+    // 零拷贝模式下, 字段相对请求起始处的位置.
+    struct Slice {
+        size_t offset; 
+        size_t len; 
+    };
+
 private:
     void reset(); 
+    Slice toSlice(const char* str, size_t len) const { return Slice{static_cast<size_t>(str - base), len}; }
+    HeaderView toView(const Slice& slice) const { return HeaderView(base + slice.offset, slice.len); }
     ParseResult parseRequestLine(); 
     ParseResult parseHeader();
     ParseResult parseBody(); 
@@ -72,7 +110,9 @@ private:
 
 private:
     static const int HEADER_NAME_MAX = 128; 
+    static bool fast_scan; 
 
+    const bool zero_copy; 
     ParsePhase parse_phase; 
     ParseRequestLineState parse_rl_state;
     ParseHeaderState parse_hd_state;  
@@ -84,6 +124,13 @@ private:
     size_t name_buf_pos;  
     Headers headers; 
     std::vector<char> body;
+    const char* base;        // 零拷贝模式: 最近一次parse()传入的请求起始地址. 
+    Slice method_slice; 
+    Slice uri_slice; 
+    Slice version_slice; 
+    Slice name_slice;        // 当前头部的name
+    Slice body_slice; 
+    std::vector<std::pair<Slice, Slice>> header_slices;   // clear()保留容量, 复用时不再分配
     size_t content_length;   // content-length头部值, 若存在. 
     size_t transfer_length;  // 消息体实际长度(考虑chunked 分块编码的情况)
     size_t header_offset;    // 当前已解析的头部偏移量; 
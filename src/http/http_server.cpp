@@ -2,6 +2,8 @@
 
 #include <functional>
 
+#include "cycle_clock.h"
+#include "delimiter_scanner.h"
 #include "http_connection.h"
 #include "inet_address.h"
 #include "logger.h"
@@ -12,9 +14,16 @@
 
 using namespace std;
 
+// loop_先于构造函数体构造, 须在此之前设定Poller后端; IO线程的EventLoop随后在start()中创建.
+static Poller::Backend selectPollerBackend(const Config& config) {
+    Poller::setDefaultBackend(config.io_uring_ ? Poller::Backend::IO_URING : Poller::Backend::EPOLL); 
+    return Poller::getDefaultBackend(); 
+}
+
 
 HttpServer::HttpServer(const Config& config)
-    : config_(config),
+    : loop_(selectPollerBackend(config)),
+    config_(config),
     tcp_server_(&loop_, config.ip.empty()?InetAddress(config.port):InetAddress(config.port), "HttpServer"),
     num_connected_(0)
 {   
@@ -39,6 +48,20 @@ HttpServer::HttpServer(const Config& config)
     }
     // TcpServer配置
     tcp_server_.setThreadNum(config.num_thread); 
+    tcp_server_.setEdgeTriggered(config.edge_triggered_, config.read_budget_); 
+    tcp_server_.setReusePort(config.reuse_port_, config.cpu_steering_); 
+    tcp_server_.setAcceptBudget(config.accept_budget_); 
+    tcp_server_.setPlacement(config.placement_); 
+    tcp_server_.setRebalanceInterval(chrono::seconds(config.rebalance_seconds_)); 
+    tcp_server_.setCpuAffinity(config.cpus_); 
+    tcp_server_.setSpinDuration(chrono::microseconds(config.spin_us_)); 
+    tcp_server_.setBusyPoll(config.busy_poll_us_); 
+    tcp_server_.setMetricsInterval(chrono::seconds(config.metrics_seconds_)); 
+    tcp_server_.setTimerSlack(chrono::milliseconds(config.timer_slack_ms_)); 
+    tcp_server_.setPollTimeoutForTimers(config.poll_timeout_timers_); 
+    if (config.tsc_clock_ && !CycleClock::enable()) {
+        LOG_WARN << "HttpServer::HttpServer invariant TSC is unavailable, loop metrics use CLOCK_MONOTONIC"; 
+    }
     tcp_server_.setConnectionCallback(
         bind(&HttpServer::onConnection, this, placeholders::_1)); 
     tcp_server_.setMessageCallback(
@@ -48,28 +71,52 @@ HttpServer::HttpServer(const Config& config)
         bind(&HttpServer::onWriteComplete, this, placeholders::_1));
     // HttpConn配置
     HttpConnection::setRootPath(config.root_path_); 
-    HttpConnection::setTimeout(config.timeout_seconds_); 
+    HttpConnection::setTimeouts(HttpConnection::Timeouts{
+        config.first_byte_timeout_seconds_, 
+        config.header_timeout_seconds_, 
+        config.timeout_seconds_, 
+        config.min_body_rate_, 
+        config.min_send_rate_}); 
+    // 各IO线程EventLoop绑定时间轮, 统一管理各阶段的超时. 时间轮仅限所属线程访问, 故在IO线程开始循环之前于该线程中创建. 
+    int max_timeout_seconds = HttpConnection::getMaxTimeoutSeconds(); 
+    if (max_timeout_seconds > 0) {
+        tcp_server_.setThreadInitCallback([max_timeout_seconds](EventLoop* loop) {
+            loop->setContext(make_unique<TimingWheel>(loop, max_timeout_seconds, HttpConnection::onTimer));
+        }); 
+    }
+    HttpConnection::setCacheControl(config.cache_control_); 
+    if (config.file_cache_bytes_ > 0) {
+        HttpConnection::setFileCache(make_shared<FileCache>(
+            config.file_cache_bytes_, 
+            config.file_cache_max_file_bytes_)); 
+    } else {
+        HttpConnection::setFileCache(nullptr); 
+    }
+    if (config.compress_cache_bytes_ > 0) {
+        HttpConnection::setCompressCache(make_shared<CompressCache>(config.compress_cache_bytes_)); 
+    } else {
+        HttpConnection::setCompressCache(nullptr); 
+    }
 }
 
 
 void HttpServer::start() {
     LOG_INFO << "HttpServer starts listening on " << tcp_server_.getIpPort();
+    LOG_INFO << "HttpParser delimiter scanner: " << getScanLevelName(getScanLevel());
+    LOG_INFO << "Poller backend: " << Poller::getBackendName(loop_.getPollerBackend());
+    if (CycleClock::isEnabled()) {
+        LOG_INFO << "Loop metrics clock: tsc, " << CycleClock::getCyclesPerMicro() << " cycles/us";
+    }
     printf("HttpServer starts listening on %s\n", tcp_server_.getIpPort().c_str()); 
     config_.printArgs();
     if (async_logger_) {
         async_logger_->start(); 
     }
     tcp_server_.start();
-    // 各IO线程EventLoop绑定时间轮.
-    if (config_.timeout_seconds_ > 0) {
-        auto loops = tcp_server_.getEventLoopPool()->getAllLoops(); 
-        for (auto& loop : loops) {
-            loop->setContext(make_unique<TimingWheel>(
-                loop, 
-                config_.timeout_seconds_, 
-                HttpConnection::onTimer
-            ));
-        }
+    // 各IO线程的Buffer缓冲池上限.
+    size_t pool_bytes = config_.buffer_pool_bytes_; 
+    for (EventLoop* loop : tcp_server_.getEventLoopPool()->getAllLoops()) {
+        loop->runInLoop([loop, pool_bytes]() { loop->getBufferPool()->setCapacity(pool_bytes); }); 
     }
     loop_.loop();
 }
@@ -90,13 +137,16 @@ void HttpServer::onConnection(const TcpServer::TcpConnectionPtr& tcp_conn) {
         tcp_conn->setContext(make_shared<HttpConnection>(tcp_conn));
     } else {
         --num_connected_;
+        if (auto http_conn = any_cast<shared_ptr<HttpConnection>>(tcp_conn->getMutableContext())) {
+            (*http_conn)->removeTimer(); 
+        }
     }
 }
 
 
 void HttpServer::onMessage(const TcpServer::TcpConnectionPtr& tcp_conn,
                            Buffer* buf, 
-                           Timestamp receive_time)
+                           MonoTimestamp receive_time)
 {
     LOG_TRACE << "HttpServer::onMessage receive_time: " << receive_time.toFormattedString().c_str(); 
     auto http_conn = any_cast<shared_ptr<HttpConnection>>(tcp_conn->getMutableContext());
@@ -110,6 +160,37 @@ void HttpServer::onWriteComplete(const TcpServer::TcpConnectionPtr& tcp_conn) {
     (*http_conn)->onWriteComplete();
 }
 
+FileCache::Stats HttpServer::getFileCacheStats() const {
+    if (auto& cache = HttpConnection::getFileCache()) {
+        return cache->getStats(); 
+    }
+    return FileCache::Stats{}; 
+}
+
+CompressCache::Stats HttpServer::getCompressCacheStats() const {
+    if (auto& cache = HttpConnection::getCompressCache()) {
+        return cache->getStats(); 
+    }
+    return CompressCache::Stats{}; 
+}
+
+Poller::Stats HttpServer::getPollerStats() {
+    Poller::Stats total{0, 0, 0, 0, 0}; 
+    auto loops = tcp_server_.getEventLoopPool()->getAllLoops(); 
+    if (loops.front() != &loop_) {
+        loops.push_back(&loop_); 
+    }
+    for (EventLoop* loop : loops) {
+        Poller::Stats stats = loop->getPollerStats(); 
+        total.ctl_add += stats.ctl_add; 
+        total.ctl_mod += stats.ctl_mod; 
+        total.ctl_del += stats.ctl_del; 
+        total.ctl_saved += stats.ctl_saved; 
+        total.syscalls += stats.syscalls; 
+    }
+    return total; 
+}
+
 void HttpServer::logOutputToFile(const char* msg, int len) {
     async_logger_->append(msg, len); 
 }
@@ -9,6 +9,8 @@
 #include "async_logger.h"
 #include "config.h"
 #include "timing_wheel.h"
+#include "file_cache.h"
+#include "compress_cache.h"
 
 class HttpConnection;
 
@@ -17,6 +19,12 @@ public:
     explicit HttpServer(const Config& config);     // 从buffer定期刷入日志文件的间隔秒数. 
 
     void start(); 
+    // 静态资源文件缓存的命中/未命中/淘汰计数. 
+    FileCache::Stats getFileCacheStats() const; 
+    // 即时压缩结果缓存的命中/未命中/淘汰计数. 
+    CompressCache::Stats getCompressCacheStats() const; 
+    // 各IO线程Poller计数之和(epoll_ctl/io_uring请求数, 省去的修改次数, 系统调用次数). 
+    Poller::Stats getPollerStats(); 
 
 private:
     using TcpConnectionPtr = TcpServer::TcpConnectionPtr;
@@ -25,7 +33,7 @@ private:
 private:
     // 注册于TcpConnection中的回调
     void onConnection(const TcpConnectionPtr& conn); 
-    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receive_time); 
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, MonoTimestamp receive_time); 
     void onWriteComplete(const TcpServer::TcpConnectionPtr& conn);
 
     // 日志输出回调, 指定输出位置. (stdout 或 )
@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <cassert>
 #include <sys/uio.h>
+#include <sys/sendfile.h>
 #include <netinet/tcp.h>  // TCP_NODELAY
 
 #include "eventloop.h"
@@ -13,6 +14,9 @@
 
 using namespace std;
 
+const size_t TcpConnection::kDefaultReadBudget;
+const size_t TcpConnection::kSendfileChunk;
+
 TcpConnection::TcpConnection(EventLoop* loop,
                              const string& name, 
                              int sockfd,
@@ -22,10 +26,20 @@ TcpConnection::TcpConnection(EventLoop* loop,
     name_(name),
     state_(State::kConnecting),
     reading_(false), 
+    corked_(false), 
     // sockfd_(sockfd),
     channel_(loop, sockfd),
     local_addr_(local_addr),
-    peer_addr_(peer_addr)
+    peer_addr_(peer_addr),
+    input_buffer_(0),     // 存储在建立连接后从所属loop的缓冲池按需获取
+    output_buffer_(0),
+    output_appended_(0),
+    output_written_(0),
+    bytes_received_(0),
+    bytes_sent_(0),
+    read_budget_(kDefaultReadBudget),
+    reported_output_bytes_(0),
+    last_read_time_(MonoTimestamp::now())
 {
     channel_.setReadCallback(
         bind(&TcpConnection::handleRead, this, placeholders::_1));
@@ -35,6 +49,7 @@ TcpConnection::TcpConnection(EventLoop* loop,
         bind(&TcpConnection::handleClose, this));
     channel_.setErrorCallback(
         bind(&TcpConnection::handleError, this));
+    channel_.setKind(LoopMetrics::kConnection); 
     LOG_DEBUG << "TcpConnection::construct[" <<  name_  << "] at " << this
               << " fd=" << sockfd;
 
@@ -48,6 +63,13 @@ TcpConnection::TcpConnection(EventLoop* loop,
 }   
 
 
+const InetAddress& TcpConnection::getLocalAddress() const {
+    if (local_addr_.isWildcard()) {
+        local_addr_ = InetAddress(InetAddress::getLocalAddrBySockfd(channel_.getFd())); 
+    }
+    return local_addr_; 
+}
+
 TcpConnection::~TcpConnection() {
     LOG_DEBUG << "TcpConnection::destroyed[" <<  name_ << "] at " << this
               << " fd=" << channel_.getFd()
@@ -57,13 +79,29 @@ TcpConnection::~TcpConnection() {
 }
 
 
-void TcpConnection::handleRead(Timestamp receive_time) {
+void TcpConnection::setEdgeTriggered(bool on, size_t read_budget) {
+    channel_.setEdgeTriggered(on); 
+    read_budget_ = read_budget > 0 ? read_budget : kDefaultReadBudget; 
+}
+
+
+void TcpConnection::handleRead(MonoTimestamp receive_time) {
+    if (channel_.getCompletion() == Poller::Completion::RECV) {
+        return handleReadCompleted(receive_time); 
+    }
+    if (channel_.isEdgeTriggered()) {
+        return handleReadEdgeTriggered(receive_time); 
+    }
     LOG_TRACE << "TcpConnection::handleRead() msgCallback_ invoked"; 
     int save_errno = 0;
-    ssize_t n = input_buffer_.readFd(channel_.getFd(), &save_errno); 
+    ssize_t n = input_buffer_.readFd(channel_.getFd(), &save_errno, 
+                                     loop_->getReadScratch(), EventLoop::kReadScratchSize); 
     if (n > 0) {
+        last_read_time_ = receive_time; 
+        bytes_received_ += n; 
         msgCallback_(shared_from_this(), &input_buffer_, receive_time);
         LOG_TRACE << "TcpConnection::handleRead() msgCallback_ invoked"; 
+        releaseIdleBuffers(); 
     } else if (n == 0) {  // EOF, 连接关闭
         handleClose();    
     } else {
@@ -73,27 +111,103 @@ void TcpConnection::handleRead(Timestamp receive_time) {
     }
 }
 
-void TcpConnection::handleWrite() {
+void TcpConnection::handleReadEdgeTriggered(MonoTimestamp receive_time) {
     loop_->assertInLoopThread(); 
-    if (channel_.isWriting()) {
-        // OutputBuffer => fd;
-        ssize_t n = ::write(channel_.getFd(), 
-                            output_buffer_.peek(), 
-                            output_buffer_.readableBytes()); 
+    if (state_ != State::kConnected && state_ != State::kDisconnecting) {
+        return;   // 排队期间连接已关闭
+    }
+    // 边缘触发: 读取直至EAGAIN、EOF或达到读取上限. 
+    int save_errno = 0; 
+    size_t total = 0; 
+    bool eof = false; 
+    bool failed = false; 
+    while (total < read_budget_) {
+        size_t space = input_buffer_.writableBytes() + EventLoop::kReadScratchSize; 
+        ssize_t n = input_buffer_.readFd(channel_.getFd(), &save_errno, 
+                                         loop_->getReadScratch(), EventLoop::kReadScratchSize); 
         if (n > 0) {
-            LOG_TRACE << "TcpConnection::handleWrite send " << n << "bytes"; 
-            output_buffer_.retrieve(n);
-            if (output_buffer_.readableBytes() == 0) {  // TCP发送缓冲区清空, 数据发送完毕, 取消监听EPOLLOUT.
-                channel_.disableWriting(); 
-                if (writeCompleteCallback_) {
-                    loop_->addToQueueInLoop(bind(writeCompleteCallback_, shared_from_this())); 
-                }
-                if (state_ == State::kDisconnecting) {  // 正在断开连接的过程中, 关闭写端.
-                    shutdownInLoop(); 
-                }
+            total += n; 
+            if (static_cast<size_t>(n) < space) {   // 未填满, 内核接收缓冲区已读空, 省去一次返回EAGAIN的read
+                channel_.setReadable(false); 
+                break; 
             }
+        } else if (n == 0) {
+            eof = true; 
+            break; 
+        } else if (save_errno == EINTR) {
+            continue; 
         } else {
+            if (save_errno == EAGAIN || save_errno == EWOULDBLOCK) {
+                channel_.setReadable(false); 
+            } else {
+                failed = true; 
+            }
+            break; 
+        }
+    }
+    LOG_TRACE << "TcpConnection::handleReadEdgeTriggered read " << total << " bytes"; 
+    if (total > 0) {
+        last_read_time_ = receive_time; 
+        bytes_received_ += total; 
+        msgCallback_(shared_from_this(), &input_buffer_, receive_time);
+    }
+    if (eof || failed) {
+        if (failed) {
+            errno = save_errno; 
+            LOG_SYSERR << "TcpConnection::handleReadEdgeTriggered"; 
+        }
+        // 边缘触发下不会再有通知, 出错时也直接关闭.
+        if (state_ == State::kConnected || state_ == State::kDisconnecting) {
+            handleClose(); 
+        }
+        return; 
+    }
+    if (channel_.isReadable()) {
+        // 达到读取上限, 剩余数据排在本轮其他就绪事件之后继续读取.
+        loop_->addToQueueInLoop(bind(&TcpConnection::handleReadEdgeTriggered, shared_from_this(), receive_time)); 
+    }
+    releaseIdleBuffers(); 
+}
+
+void TcpConnection::handleReadCompleted(MonoTimestamp receive_time) {
+    loop_->assertInLoopThread(); 
+    if (state_ != State::kConnected && state_ != State::kDisconnecting) {
+        return;   // 已因EPOLLHUP等关闭
+    }
+    int save_errno = 0; 
+    ssize_t n = loop_->takeReceived(&channel_, &input_buffer_, &save_errno); 
+    if (n > 0) {
+        last_read_time_ = receive_time; 
+        bytes_received_ += n; 
+        msgCallback_(shared_from_this(), &input_buffer_, receive_time);
+        releaseIdleBuffers(); 
+    } else if (n == 0) {  // EOF, 连接关闭
+        handleClose(); 
+    } else if (save_errno != EAGAIN) {
+        // recv请求出错后不再提交, 也不会再有通知, 直接关闭.
+        errno = save_errno; 
+        LOG_SYSERR << "TcpConnection::handleReadCompleted"; 
+        handleClose(); 
+    }
+}
+
+void TcpConnection::handleWrite() {
+    loop_->assertInLoopThread(); 
+    if (channel_.isWriting()) {
+        // OutputBuffer & 文件段 => fd;
+        bool ok = drainOutput(); 
+        updatePendingOutputMetric(); 
+        if (!ok) {
             LOG_SYSERR << "TcpConnection::handleWrite";
+        } else if (!hasPendingOutput()) {  // 数据发送完毕, 取消监听EPOLLOUT.
+            channel_.disableWriting(); 
+            releaseIdleBuffers(); 
+            if (writeCompleteCallback_) {
+                loop_->addToQueueInLoop(bind(writeCompleteCallback_, shared_from_this())); 
+            }
+            if (state_ == State::kDisconnecting) {  // 正在断开连接的过程中, 关闭写端.
+                shutdownInLoop(); 
+            }
         }
     } else {
         LOG_TRACE << "Connection fd = " << channel_.getFd()
@@ -101,6 +215,58 @@ void TcpConnection::handleWrite() {
     }
 }
 
+bool TcpConnection::drainOutput() {
+    int sockfd = channel_.getFd(); 
+    while (hasPendingOutput()) {
+        if (!file_segments_.empty() && file_segments_.front().stream_pos == output_written_) {
+            // 文件段之前的缓冲区数据已全部写出, 直接由内核从文件拷贝到socket.
+            FileSegment& seg = file_segments_.front(); 
+            size_t len = std::min(seg.remaining, kSendfileChunk); 
+            ssize_t n = ::sendfile(sockfd, seg.fd, &seg.offset, len); 
+            if (n > 0) {
+                LOG_TRACE << "TcpConnection::drainOutput sendfile " << n << " bytes"; 
+                seg.remaining -= n; 
+                bytes_sent_ += n; 
+                if (seg.remaining == 0) {
+                    file_segments_.pop_front(); 
+                }
+                if (static_cast<size_t>(n) < len) {   // 发送缓冲区已满
+                    onWriteBlocked(); 
+                    break; 
+                }
+            } else if (n == 0) {  // 文件被截断, 无法再满足已承诺的长度.
+                LOG_ERROR << "TcpConnection::drainOutput sendfile EOF, fd = " << seg.fd; 
+                file_segments_.pop_front(); 
+                forceClose(); 
+                return true; 
+            } else {
+                if (errno == EWOULDBLOCK) onWriteBlocked(); 
+                return errno == EWOULDBLOCK; 
+            }
+        } else {
+            size_t len = output_buffer_.readableBytes(); 
+            if (!file_segments_.empty()) {
+                len = file_segments_.front().stream_pos - output_written_; 
+            }
+            ssize_t n = ::write(sockfd, output_buffer_.peek(), len); 
+            if (n > 0) {
+                LOG_TRACE << "TcpConnection::drainOutput send " << n << " bytes"; 
+                output_buffer_.retrieve(n);
+                output_written_ += n; 
+                bytes_sent_ += n; 
+                if (static_cast<size_t>(n) < len) {
+                    onWriteBlocked(); 
+                    break; 
+                }
+            } else {
+                if (errno == EWOULDBLOCK) onWriteBlocked(); 
+                return errno == EWOULDBLOCK; 
+            }
+        }
+    }
+    return true; 
+}
+
 void TcpConnection::handleClose() {
     loop_->assertInLoopThread(); 
     LOG_TRACE << "fd = " << channel_.getFd() << " state = " << stateToString();
@@ -136,7 +302,13 @@ void TcpConnection::connectionEstablished() {
     // 将该TcpConnection对象绑定到channel_
     // 确保channel_执行handleEvent()时该TcpConnection对象不会被析构
     channel_.tie(shared_from_this());  
+    if (loop_->supportsCompletion(Poller::Completion::RECV)) {
+        channel_.setCompletion(Poller::Completion::RECV);   // io_uring: 以multishot recv代替可读通知之后的read
+    }
     channel_.enableReading(); 
+    loop_->addConnectionCount(1); 
+    input_buffer_.setPool(loop_->getBufferPool()); 
+    output_buffer_.setPool(loop_->getBufferPool()); 
     // 执行用户回调.
     connCallback_(shared_from_this()); 
 }
@@ -144,12 +316,24 @@ void TcpConnection::connectionEstablished() {
 
 void TcpConnection::connectionDestroyed() {
     loop_->assertInLoopThread(); 
-    if (state_ == State::kConnected) {
+    if (state_ != State::kConnecting) {   // 已计入connectionEstablished()
+        loop_->addConnectionCount(-1); 
+    }
+    loop_->addPendingOutputBytes(-static_cast<int64_t>(reported_output_bytes_)); 
+    reported_output_bytes_ = 0; 
+    // 已shutdown但对端尚未关闭(kDisconnecting)的连接, 随TcpServer析构时同样须先注销事件. 
+    if (state_ == State::kConnected || state_ == State::kDisconnecting) {
         setState(State::kDisconnected);
         channel_.disableAll(); 
         connCallback_(shared_from_this());  // 执行用户回调. 
     }
     channel_.removeFromEpoller(); 
+    // 在所属IO线程中归还缓冲区存储, 此后TcpConnection可在任意线程析构.
+    input_buffer_.retrieveAll(); 
+    output_buffer_.retrieveAll(); 
+    releaseIdleBuffers(); 
+    input_buffer_.setPool(nullptr); 
+    output_buffer_.setPool(nullptr); 
 }
 
 void TcpConnection::shutdown() {
@@ -168,6 +352,19 @@ void TcpConnection::shutdownInLoop() {
     }
 }
 
+bool TcpConnection::shutdownIfIdle(Timestamp::Duration min_idle) {
+    loop_->assertInLoopThread(); 
+    if (state_ != State::kConnected || input_buffer_.readableBytes() > 0 || hasPendingOutput()) {
+        return false; 
+    }
+    if (loop_->getPollReturnTime() - last_read_time_ < min_idle) {
+        return false; 
+    }
+    setState(State::kDisconnecting); 
+    shutdownInLoop(); 
+    return true; 
+}
+
 void TcpConnection::forceClose() {
     if (state_ == State::kConnected || state_ == State::kDisconnecting) {
         setState(State::kDisconnecting); 
@@ -242,17 +439,22 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     // 两种情况:
     // 1) 如果channel空闲且输出缓冲区为空, 即没有尚未发送出去的预留数据, 则直接向fd写, 不会导致数据乱序
     //    从而省略OutputBuffer->fd的过程(监听EPOLLOUT, 等待可写, 拷贝开销等)
-    // 2) 否则, 将数据追加到OutputBuffer,  等到handleWrite()里进行写. 
-    if (!channel_.isWriting() && output_buffer_.readableBytes() == 0) {
+    // 2) 否则(含合并发送期间), 将数据追加到OutputBuffer,  等到handleWrite()或uncork()里进行写. 
+    if (!corked_ && !channel_.isWriting() && !hasPendingOutput()) {
         n_written = ::write(channel_.getFd(), data, len); 
         if (n_written >= 0) {
             remaining -= n_written; 
-            if (remaining == 0 && writeCompleteCallback_) { // 已全写完, 执行用户回调.
-                loop_->addToQueueInLoop(bind(writeCompleteCallback_, shared_from_this())); 
+            bytes_sent_ += n_written; 
+            if (remaining == 0) { // 已全写完, 执行用户回调.
+                queueWriteCompleteCallback(); 
+            } else {
+                onWriteBlocked(); 
             }
         } else {
             n_written = 0;
-            if (errno != EWOULDBLOCK) {  // 非缓冲区已满
+            if (errno == EWOULDBLOCK) {
+                onWriteBlocked(); 
+            } else {  // 非缓冲区已满
                 LOG_SYSERR << "TcpConnection::sendInLoop";
                 if (errno == EPIPE || errno == ECONNRESET) {  // 连接异常
                     fault_error = true; 
@@ -265,9 +467,9 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     assert(remaining <= len); 
     // 还有剩余数据
     if (!fault_error && remaining > 0) {  
-        output_buffer_.append(static_cast<const char*>(data) + n_written, remaining); 
-        if (!channel_.isWriting()) {   
-            channel_.enableWriting();  // epoll上开启监听EPOLLOUT.
+        appendToOutputBuffer(static_cast<const char*>(data) + n_written, remaining); 
+        if (!corked_ && !channel_.isWriting()) {   
+            waitForWritable();  // epoll上开启监听EPOLLOUT.
         }
     }
 }
@@ -305,16 +507,21 @@ void TcpConnection::sendInLoop(struct iovec vecs[], size_t iovcnt) {
         LOG_WARN << "disconnected, give up writing";
         return;
     }
-    if (!channel_.isWriting() && output_buffer_.readableBytes() == 0) {
+    if (!corked_ && !channel_.isWriting() && !hasPendingOutput()) {
         n_written = ::writev(channel_.getFd(), vecs, iovcnt); 
         if (n_written >= 0) {
             remaining -= n_written;
-            if (remaining == 0 && writeCompleteCallback_) { // 已全写完, 执行用户回调.
-                loop_->addToQueueInLoop(bind(writeCompleteCallback_, shared_from_this())); 
+            bytes_sent_ += n_written; 
+            if (remaining == 0) { // 已全写完, 执行用户回调.
+                queueWriteCompleteCallback(); 
+            } else {
+                onWriteBlocked(); 
             }
         } else {
             n_written = 0; 
-            if (errno != EWOULDBLOCK) {
+            if (errno == EWOULDBLOCK) {
+                onWriteBlocked(); 
+            } else {
                 LOG_SYSERR << "TcpConnection::sendInLoop writev";
                 if (errno == EPIPE || errno == ECONNRESET) {
                     fault_error = true; 
@@ -346,10 +553,144 @@ void TcpConnection::sendInLoop(struct iovec vecs[], size_t iovcnt) {
             rest.push_back(vecs[i]);
         }
         output_buffer_.append(rest.data(), rest.size());
-        if (!channel_.isWriting()) {
-            channel_.enableWriting();  
+        output_appended_ += remaining; 
+        updatePendingOutputMetric(); 
+        if (!corked_ && !channel_.isWriting()) {
+            waitForWritable();  
+        }
+    }
+}
+
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len, shared_ptr<void> guard) {
+    if (state_ == State::kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(fd, offset, len, guard); 
+        } else {
+            // guard随任务一并传递, 保证任务执行前fd仍有效.
+            loop_->runInLoop(
+                [this, fd, offset, len, g = std::move(guard)]() {
+                    this->sendFileInLoop(fd, offset, len, g);
+                }
+            );
+        }
+    }
+}
+
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len, const shared_ptr<void>& guard) {
+    loop_->assertInLoopThread(); 
+    size_t remaining = len; 
+    bool fault_error = false; 
+    if (state_ == State::kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+    // 与sendInLoop相同: 无待发送数据时直接sendfile, 否则排入队列等待handleWrite/uncork.
+    if (!corked_ && !channel_.isWriting() && !hasPendingOutput()) {
+        size_t chunk = std::min(len, kSendfileChunk); 
+        ssize_t n = ::sendfile(channel_.getFd(), fd, &offset, chunk); 
+        if (n >= 0) {
+            remaining -= n; 
+            bytes_sent_ += n; 
+            if (remaining == 0) {
+                queueWriteCompleteCallback(); 
+            } else if (static_cast<size_t>(n) < chunk) {
+                onWriteBlocked(); 
+            }
+        } else if (errno == EWOULDBLOCK) {
+            onWriteBlocked(); 
+        } else {
+            LOG_SYSERR << "TcpConnection::sendFileInLoop";
+            if (errno == EPIPE || errno == ECONNRESET) {
+                fault_error = true; 
+            }
         }
     }
+    LOG_TRACE << "TcpConnection::sendFile remaining: " << remaining; 
+    if (!fault_error && remaining > 0) {
+        file_segments_.push_back(FileSegment{fd, offset, remaining, output_appended_, guard}); 
+        updatePendingOutputMetric(); 
+        if (!corked_ && !channel_.isWriting()) {
+            waitForWritable(); 
+        }
+    }
+}
+
+
+void TcpConnection::cork() {
+    loop_->assertInLoopThread(); 
+    corked_ = true; 
+}
+
+
+void TcpConnection::uncork() {
+    loop_->assertInLoopThread(); 
+    corked_ = false; 
+    if (state_ == State::kDisconnected || channel_.isWriting() || !hasPendingOutput()) {
+        return;   // 已在等待EPOLLOUT时, 由handleWrite按序写出.
+    }
+    // 期间累积的数据连续存放于output_buffer_, 一次write即可写出.
+    bool ok = drainOutput(); 
+    updatePendingOutputMetric(); 
+    if (!ok) {
+        LOG_SYSERR << "TcpConnection::uncork";
+    } else if (!hasPendingOutput()) {
+        queueWriteCompleteCallback(); 
+        releaseIdleBuffers(); 
+    } else {
+        waitForWritable(); 
+    }
+}
+
+
+void TcpConnection::appendToOutputBuffer(const void* data, size_t len) {
+    output_buffer_.append(data, len); 
+    output_appended_ += len; 
+    updatePendingOutputMetric(); 
+}
+
+void TcpConnection::updatePendingOutputMetric() {
+    size_t pending = output_buffer_.readableBytes(); 
+    for (const FileSegment& seg : file_segments_) {
+        pending += seg.remaining; 
+    }
+    if (pending != reported_output_bytes_) {
+        loop_->addPendingOutputBytes(static_cast<int64_t>(pending) - static_cast<int64_t>(reported_output_bytes_)); 
+        reported_output_bytes_ = pending; 
+    }
+}
+
+
+void TcpConnection::waitForWritable() {
+    channel_.enableWriting(); 
+    if (channel_.isEdgeTriggered() && channel_.isWritable()) {
+        // 边缘触发下socket未曾写满时不会再有EPOLLOUT通知, 直接排队写出.
+        loop_->addToQueueInLoop(bind(&TcpConnection::handleWrite, shared_from_this())); 
+    }
+}
+
+
+void TcpConnection::releaseIdleBuffers() {
+    if (input_buffer_.readableBytes() == 0 && input_buffer_.hasStorage()) {
+        input_buffer_.releaseStorage(); 
+    }
+    if (output_buffer_.readableBytes() == 0 && output_buffer_.hasStorage()) {
+        output_buffer_.releaseStorage(); 
+    }
+}
+
+
+void TcpConnection::queueWriteCompleteCallback() {
+    if (writeCompleteCallback_) {
+        // 回调延后执行, 期间可能又有数据(如文件段)排入队列, 此时留待handleWrite写完后再回调.
+        TcpConnectionPtr self(shared_from_this()); 
+        loop_->addToQueueInLoop([self]() {
+            if (!self->hasPendingOutput()) {
+                self->writeCompleteCallback_(self); 
+            }
+        });
+    }
 }
 
 
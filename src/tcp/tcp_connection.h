@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <functional>
+#include <deque>
+#include <sys/types.h>
 
 #include "channel.h"
 #include "timestamp.h"
@@ -17,7 +19,7 @@ public:
     using ConnectionCallback = std::function<void(const std::shared_ptr<TcpConnection>&)>;
     using CloseCallback = ConnectionCallback;
     using WriteCompleteCallback = ConnectionCallback;
-    using MessageCallback = std::function<void(const std::shared_ptr<TcpConnection>&, Buffer*, Timestamp t)>; 
+    using MessageCallback = std::function<void(const std::shared_ptr<TcpConnection>&, Buffer*, MonoTimestamp t)>; 
     using TcpConnectionPtr = std::shared_ptr<TcpConnection>; 
 
 public:
@@ -30,10 +32,12 @@ public:
 
     bool connected() const { return state_ == State::kConnected; }
     bool disconnected() const { return state_ == State::kDisconnected; }
+    bool disconnecting() const { return state_ == State::kDisconnecting; }
 
     EventLoop* getOwnerLoop() const { return loop_; }
     std::string getName() const { return name_; }
-    const InetAddress& getLocalAddress() const { return local_addr_; }
+    // 构造时传入的本端地址为通配地址(如监听0.0.0.0)时, 首次调用以getsockname解析. 须在所属IO线程调用.
+    const InetAddress& getLocalAddress() const; 
     const InetAddress& getPeerAddress() const { return peer_addr_; }
 
     // 用户回调
@@ -44,6 +48,10 @@ public:
     // 非用户回调. 该回调用于通知TcpServer移除持有的指向该对象的TcpConnectionPtr.
     void setCloseCallback(const CloseCallback& cb) {  closeCallback_ = cb; }
 
+    // 以边缘触发方式监听socket, 须在connectionEstablished()之前设置. 
+    // 可读时反复读取直至EAGAIN, 单次事件至多读取read_budget字节, 剩余数据留待本轮其他连接处理后再读, 保证公平.
+    void setEdgeTriggered(bool on, size_t read_budget = kDefaultReadBudget); 
+
     // 供TcpServer调用
     // called when TcpServer accepts a new connection. should be called only once
     void connectionEstablished(); 
@@ -54,11 +62,29 @@ public:
     void send(const std::string& message); 
     void send(Buffer* message);
     void send(struct iovec vecs[], size_t iovcnt);
+    // 以sendfile零拷贝发送文件fd的[offset, offset+len)区间, 与send()的数据保持先后顺序.
+    // guard须在该文件段发送完毕(或连接销毁)前维持fd有效, 通常由其析构负责关闭fd.
+    void sendFile(int fd, off_t offset, size_t len, std::shared_ptr<void> guard);
+    // 合并发送(仅限所属IO线程调用): cork()之后send()/sendFile()的数据只追加到发送队列, 
+    // 直到uncork()时按序统一写出, 多个响应只需一次系统调用.
+    void cork(); 
+    void uncork(); 
 
 
     // 半关闭, 仅关闭写端
     void shutdown(); // 调用shutdownInLoop, 后者保证在EventLoop所属的IO线程调用
     void forceClose(); 
+    // 连接空闲(无待处理的输入与输出)且距最近一次读取已超过min_idle时半关闭, 返回是否关闭. 须在所属IO线程调用.
+    bool shutdownIfIdle(Timestamp::Duration min_idle); 
+
+    // 以下须在所属IO线程调用. 
+    // 是否有尚未写出的数据(发送缓冲区或文件段). 
+    bool hasPendingOutput() const { return output_buffer_.readableBytes() > 0 || !file_segments_.empty(); }
+    // 发送缓冲区中尚未写出的字节数, 不含文件段. 
+    size_t getOutputBufferBytes() const { return output_buffer_.readableBytes(); }
+    // 累计读取、写出到socket的字节数, 供上层检查传输速率. 
+    uint64_t getBytesReceived() const { return bytes_received_; }
+    uint64_t getBytesSent() const { return bytes_sent_; }
 
     void setContext(const Any& context) { context_ = context; }
     Any* getMutableContext() { return &context_; }
@@ -71,13 +97,30 @@ private:
     enum class State { kConnecting, kConnected, kDisconnected, kDisconnecting }; 
     void setState(State s) { state_ = s; }
     const char* stateToString() const;
-    void handleRead(Timestamp receive_time);
+    void handleRead(MonoTimestamp receive_time);
+    void handleReadEdgeTriggered(MonoTimestamp receive_time);
+    // io_uring完成模式: 取出内核multishot recv已接收的数据, 不再调用read. 
+    void handleReadCompleted(MonoTimestamp receive_time);
+    // 写入未完成(EAGAIN或部分写入)时, 记录socket不可写, 边缘触发下等待EPOLLOUT.
+    void onWriteBlocked() { channel_.setWritable(false); }
+    // 开始关注可写事件, 等待handleWrite()写出积压数据.
+    void waitForWritable();
     void handleWrite();
     void handleClose();
     void handleError(); 
 
     void sendInLoop(const void* message, size_t len); 
     void sendInLoop(struct iovec vecs[], size_t iovcnt);
+    void sendFileInLoop(int fd, off_t offset, size_t len, const std::shared_ptr<void>& guard);
+    // 按序写出output_buffer_与文件段, 直到全部写完或内核发送缓冲区已满. 出错时返回false.
+    bool drainOutput();
+    // 将发送队列长度的变化计入所属EventLoop的负载指标. 
+    void updatePendingOutputMetric();
+    void appendToOutputBuffer(const void* data, size_t len);
+    // 输出全部写完后才执行writeCompleteCallback_.
+    void queueWriteCompleteCallback();
+    // 无待处理数据的缓冲区归还存储, 空闲连接不占用缓冲区内存.
+    void releaseIdleBuffers();
     void shutdownInLoop();  
     void forceCloseInLoop();
     
@@ -92,8 +135,9 @@ private:
     std::string name_; 
     State state_; 
     bool reading_; 
+    bool corked_;     // 合并发送中, 暂不直接写fd
     Channel channel_; 
-    InetAddress local_addr_;
+    mutable InetAddress local_addr_;
     InetAddress peer_addr_; 
     Any context_;
 
@@ -102,6 +146,29 @@ private:
     WriteCompleteCallback writeCompleteCallback_; 
     CloseCallback closeCallback_;   // 用于通知TcpServer移除持有的指向该对象的TcpConnectionPtr, 非用户回调. 
 
+    // 待发送的文件段. 
+    struct FileSegment {
+        int fd;
+        off_t offset;
+        size_t remaining;
+        uint64_t stream_pos;           // 该段在output_buffer_字节流中的位置, 之前的字节须先写出.
+        std::shared_ptr<void> guard;
+    };
+
     Buffer input_buffer_; 
     Buffer output_buffer_; 
+    std::deque<FileSegment> file_segments_; 
+    uint64_t output_appended_;   // 累计追加到output_buffer_的字节数
+    uint64_t output_written_;    // 累计从output_buffer_写出的字节数
+    uint64_t bytes_received_;    // 累计读取的字节数
+    uint64_t bytes_sent_;        // 累计写出的字节数(含直接写出与sendfile)
+    size_t read_budget_;         // 边缘触发时单次可读事件的读取字节上限
+    size_t reported_output_bytes_;   // 已计入EventLoop负载指标的待发送字节数
+    MonoTimestamp last_read_time_;   // 最近一次读取到数据(或建立连接)的时间
+
+public:
+    static const size_t kDefaultReadBudget = 256 * 1024; 
+private:
+
+    static const size_t kSendfileChunk = 1024 * 1024;   // 单次sendfile的字节上限
 };
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "tcp_server.h"
 
+#include <sys/socket.h>
+
 #include "eventloop.h"
 #include "acceptor.h"
+#include "count_down_latch.h"
 #include "logger.h"
 
 using namespace std;
@@ -10,13 +13,27 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& addr, const string& nam
     : loop_(loop),
     ip_port_(addr.getIpPortString()),
     name_(name),
+    listen_addr_(addr),
     acceptor_(make_unique<Acceptor>(loop_, addr)),
     eventloop_thread_pool_(make_shared<EventLoopThreadPool>(loop_, name_)),
     started_(false), 
-    next_conn_id_(1)
+    next_conn_id_(1),
+    edge_triggered_(false),
+    read_budget_(TcpConnection::kDefaultReadBudget),
+    reuse_port_(false),
+    cpu_steering_(false),
+    accept_budget_(Acceptor::kDefaultAcceptBudget),
+    rebalance_interval_(0),
+    metrics_interval_(0),
+    spin_duration_(0),
+    busy_poll_us_(0),
+    busy_poll_error_logged_(false),
+    timer_slack_(0),
+    poll_timeout_timers_(false)
 {
     acceptor_->setNewConnCallback(
-        bind(&TcpServer::newConnection, this, placeholders::_1, placeholders::_2));
+        bind(&TcpServer::queueNewConnection, this, placeholders::_1, placeholders::_2));
+    acceptor_->setAcceptBatchCallback(bind(&TcpServer::flushNewConnections, this)); 
 }
 
 
@@ -24,6 +41,8 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& addr, const string& nam
 TcpServer::~TcpServer() {
     loop_->assertInLoopThread(); 
     LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+    loop_->removeTimer(rebalance_timer_); 
+    loop_->removeTimer(metrics_timer_); 
     // 销毁其持有的所有TcpConnection. 
     for (auto& item : connections_) {
         TcpConnectionPtr conn(item.second);
@@ -31,45 +50,260 @@ TcpServer::~TcpServer() {
         conn->getOwnerLoop()->runInLoop(
             std::bind(&TcpConnection::connectionDestroyed, conn));
     }
+    // reuseport模式下的Acceptor与连接归属各IO线程, 须在其线程中销毁. 等待完成后IO线程才可退出. 
+    if (!loop_acceptors_.empty()) {
+        CountDownLatch latch(static_cast<int>(loop_acceptors_.size())); 
+        for (auto& item : loop_acceptors_) {
+            LoopAcceptor* loop_acceptor = item.get(); 
+            loop_acceptor->loop->runInLoop([loop_acceptor, &latch]() {
+                loop_acceptor->acceptor.reset(); 
+                for (auto& conn_item : loop_acceptor->connections) {
+                    conn_item.second->connectionDestroyed(); 
+                }
+                loop_acceptor->connections.clear(); 
+                latch.countDown(); 
+            }); 
+        }
+        latch.wait(); 
+    }
 }
 
 void TcpServer::start() {
     if (!started_.exchange(true, std::memory_order_acq_rel)) {
         eventloop_thread_pool_->start(threadInitCallback_); 
+        vector<EventLoop*> timer_loops = eventloop_thread_pool_->getAllLoops(); 
+        if (timer_loops.front() != loop_) {
+            timer_loops.push_back(loop_); 
+        }
+        for (EventLoop* timer_loop : timer_loops) {
+            timer_loop->setTimerSlack(timer_slack_); 
+            // 只在定期输出指标时按回调计时, 否则每轮只取两次时间. 
+            timer_loop->setCallbackTiming(metrics_interval_.count() > 0); 
+            if (poll_timeout_timers_) {
+                timer_loop->usePollTimeoutForTimers(); 
+            }
+        }
+        for (EventLoop* io_loop : eventloop_thread_pool_->getAllLoops()) {
+            io_loop->setSpinDuration(spin_duration_); 
+            if (busy_poll_us_ > 0 && !io_loop->setPollerBusyPoll(busy_poll_us_, true)) {
+                LOG_WARN << "TcpServer::start [" << name_ << "] - poller of loop " << io_loop 
+                         << " does not support busy poll parameters"; 
+            }
+        }
         assert(!acceptor_->isListening());  
-        loop_->runInLoop(bind(&Acceptor::listen, acceptor_.get()));
+        acceptor_->setAcceptBudget(accept_budget_); 
+        if (reuse_port_ && eventloop_thread_pool_->getAllLoops().front() != loop_) {
+            // 与单Acceptor一样在base loop中启动, start()可在任意线程调用. 
+            loop_->runInLoop(bind(&TcpServer::startReusePort, this)); 
+        } else {
+            loop_->runInLoop(bind(&Acceptor::listen, acceptor_.get()));
+            if (rebalance_interval_.count() > 0 && eventloop_thread_pool_->getAllLoops().size() > 1) {
+                rebalance_timer_ = loop_->runEvery(rebalance_interval_, bind(&TcpServer::rebalance, this)); 
+            }
+        }
+        if (metrics_interval_.count() > 0) {
+            metrics_timer_ = loop_->runEvery(metrics_interval_, bind(&TcpServer::logMetrics, this)); 
+        }
+        LOG_INFO << "TcpServer::start [" << name_ << "] - placement: " 
+                 << EventLoopThreadPool::getPlacementName(eventloop_thread_pool_->getPlacement()); 
     }
 }
 
+// 每个IO线程创建并监听各自的Acceptor. 
+void TcpServer::startReusePort() {
+    loop_->assertInLoopThread(); 
+    // 在base loop中绑定的socket不再使用. 各socket均已设置SO_REUSEPORT, 关闭前后端口均可再次绑定. 
+    acceptor_.reset(); 
+    auto loops = eventloop_thread_pool_->getAllLoops(); 
+    for (size_t i = 0; i < loops.size(); ++i) {
+        auto loop_acceptor = make_unique<LoopAcceptor>(); 
+        loop_acceptor->loop = loops[i]; 
+        loop_acceptor->name = name_ + "-" + to_string(i); 
+        loop_acceptor->acceptor = make_unique<Acceptor>(loops[i], listen_addr_); 
+        loop_acceptor->acceptor->setNewConnCallback(
+            bind(&TcpServer::newConnectionInIoLoop, this, loop_acceptor.get(), placeholders::_1, placeholders::_2)); 
+        loop_acceptor->acceptor->setAcceptBudget(accept_budget_); 
+        if (loops[i]->getCpu() >= 0) {
+            // IO线程已绑定CPU: 在该CPU上完成协议栈处理的连接优先由此IO线程接受. 
+            loop_acceptor->acceptor->setIncomingCpu(loops[i]->getCpu()); 
+        }
+        loop_acceptors_.push_back(std::move(loop_acceptor)); 
+    }
+    // 依次listen: socket在reuseport组中的序号与IO线程序号一致, CBPF程序返回的序号即对应IO线程. 
+    for (auto& loop_acceptor : loop_acceptors_) {
+        CountDownLatch latch(1); 
+        Acceptor* acceptor = loop_acceptor->acceptor.get(); 
+        loop_acceptor->loop->runInLoop([acceptor, &latch]() {
+            acceptor->listen(); 
+            latch.countDown(); 
+        }); 
+        latch.wait(); 
+    }
+    if (cpu_steering_) {
+        // 按各IO线程实际绑定的CPU构造程序, 与SO_INCOMING_CPU一致. 程序作用于整个reuseport组, 附加到任一socket即可. 
+        vector<int> socket_cpus; 
+        for (auto& loop_acceptor : loop_acceptors_) {
+            socket_cpus.push_back(loop_acceptor->loop->getCpu()); 
+        }
+        loop_acceptors_.front()->acceptor->attachCpuSteeringFilter(socket_cpus); 
+    }
+    LOG_INFO << "TcpServer::startReusePort [" << name_ << "] - " << loop_acceptors_.size()
+             << " acceptors on " << ip_port_ << (cpu_steering_ ? ", steered by CPU" : ""); 
+}
 
-// 为conn_fd绑定一个TcpConnection对象. 
-void TcpServer::newConnection(int sockfd, const InetAddress& peer_addr) {
+
+void TcpServer::queueNewConnection(int sockfd, const InetAddress& peer_addr) {
+    TcpConnectionPtr conn = addConnection(sockfd, peer_addr); 
+    EventLoop* io_loop = conn->getOwnerLoop(); 
+    if (io_loop == loop_) {
+        conn->connectionEstablished(); 
+        return; 
+    }
+    for (auto& item : pending_established_) {
+        if (item.first == io_loop) {
+            item.second.push_back(std::move(conn)); 
+            return; 
+        }
+    }
+    pending_established_.emplace_back(io_loop, vector<TcpConnectionPtr>{ std::move(conn) }); 
+}
+
+void TcpServer::flushNewConnections() {
+    loop_->assertInLoopThread(); 
+    for (auto& item : pending_established_) {
+        if (item.second.empty()) {
+            continue; 
+        }
+        vector<TcpConnectionPtr> conns; 
+        conns.swap(item.second); 
+        item.first->addToQueueInLoop([conns]() {
+            for (auto& conn : conns) {
+                conn->connectionEstablished(); 
+            }
+        }); 
+    }
+}
+
+TcpServer::TcpConnectionPtr TcpServer::addConnection(int sockfd, const InetAddress& peer_addr) {
     loop_->assertInLoopThread(); 
 
     int conn_id = next_conn_id_++;
     string conn_name = name_ + "#" + to_string(conn_id); 
-    LOG_INFO << "TcpServer::newConnection [" << name_
+    LOG_INFO << "TcpServer::addConnection [" << name_
     << "] - new connection [" << conn_name 
     << "] from " << peer_addr.getIpPortString(); 
 
-    InetAddress local_addr(InetAddress::getLocalAddrBySockfd(sockfd)); 
-    // FIXME poll with zero timeout to double confirm the new connection
-
     EventLoop* io_loop = eventloop_thread_pool_->getNextLoop(); 
-    auto conn = make_shared<TcpConnection>(io_loop, conn_name, sockfd, local_addr, peer_addr); 
+    auto conn = createConnection(io_loop, conn_name, sockfd, peer_addr); 
     connections_[conn_name] = conn; 
+    conn->setCloseCallback(
+        bind(&TcpServer::removeConnection, this, placeholders::_1));
+    return conn; 
+}
+
+// reuseport模式: 连接直接在接受它的IO线程中建立, 无需跨线程转交. 
+void TcpServer::newConnectionInIoLoop(LoopAcceptor* loop_acceptor, int sockfd, const InetAddress& peer_addr) {
+    EventLoop* io_loop = loop_acceptor->loop; 
+    io_loop->assertInLoopThread(); 
+
+    string conn_name = loop_acceptor->name + "#" + to_string(loop_acceptor->next_conn_id++); 
+    LOG_INFO << "TcpServer::newConnectionInIoLoop [" << name_
+    << "] - new connection [" << conn_name 
+    << "] from " << peer_addr.getIpPortString(); 
 
+    auto conn = createConnection(io_loop, conn_name, sockfd, peer_addr); 
+    loop_acceptor->connections[conn_name] = conn; 
+    conn->setCloseCallback(
+        bind(&TcpServer::removeConnectionInIoLoop, this, loop_acceptor, placeholders::_1));
+    conn->connectionEstablished(); 
+}
+
+TcpServer::TcpConnectionPtr TcpServer::createConnection(EventLoop* io_loop, const string& conn_name,
+                                                        int sockfd, const InetAddress& peer_addr) {
+    // 监听地址非通配地址时即为本端地址; 否则由TcpConnection在首次获取时解析, 建立连接时不调用getsockname. 
+    if (busy_poll_us_ > 0) {
+        setBusyPollOptions(sockfd); 
+    }
+    auto conn = make_shared<TcpConnection>(io_loop, conn_name, sockfd, listen_addr_, peer_addr); 
     // conn的回调
     conn->setConnectionCallback(connCallback_);  // 用户回调
     conn->setMessageCallback(msgCallback_);      // 用户回调
     conn->setWriteCompleteCallback(writeCompleteCallback_); 
-    conn->setCloseCallback(
-        bind(&TcpServer::removeConnection, this, placeholders::_1));
-    // 放到runInLoop, 保证移除TcpConnection的操作只能在其所属EventLoop所在线程中执行
-    // 注: bind内部拷贝得到的是weak_ptr, 而不是shared_ptr. gbd跟踪显示weak count为2.
-    io_loop->runInLoop(bind(&TcpConnection::connectionEstablished, conn)); 
+    if (edge_triggered_) {
+        conn->setEdgeTriggered(true, read_budget_); 
+    }
+    return conn; 
+}
+
+
+// 可在base loop或reuseport模式下的各IO线程中调用. 
+void TcpServer::setBusyPollOptions(int sockfd) {
+    int usecs = busy_poll_us_; 
+    int prefer = 1; 
+    if (::setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) < 0 ||
+        ::setsockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0) {
+        if (!busy_poll_error_logged_.exchange(true)) {
+            LOG_SYSERR << "TcpServer::setBusyPollOptions [" << name_ << "] setsockopt SO_BUSY_POLL/SO_PREFER_BUSY_POLL"; 
+        }
+    }
+}
+
+// 在base loop中执行: 连接表归base loop所有, 按所属IO线程分组后, 由各IO线程检查空闲并半关闭. 
+void TcpServer::rebalance() {
+    loop_->assertInLoopThread(); 
+    auto loops = eventloop_thread_pool_->getAllLoops(); 
+    vector<int64_t> counts; 
+    int64_t total = 0; 
+    for (EventLoop* loop : loops) {
+        counts.push_back(loop->getLoadStats().connections); 
+        total += counts.back(); 
+    }
+    // 向上取整, 连接数相差不超过1时不处理. 
+    int64_t target = (total + static_cast<int64_t>(loops.size()) - 1) / static_cast<int64_t>(loops.size()); 
+    for (size_t i = 0; i < loops.size(); ++i) {
+        int64_t excess = counts[i] - target; 
+        if (excess <= 0) {
+            continue; 
+        }
+        vector<TcpConnectionPtr> conns; 
+        for (auto& item : connections_) {
+            if (item.second->getOwnerLoop() == loops[i]) {
+                conns.push_back(item.second); 
+            }
+        }
+        Timestamp::Duration min_idle = rebalance_interval_; 
+        string name = name_; 
+        loops[i]->runInLoop([conns, excess, min_idle, name]() {
+            // 已半关闭、等待对端关闭的连接仍计入连接数, 不再重复关闭其他连接. 
+            int64_t n_closing = 0; 
+            for (auto& conn : conns) {
+                n_closing += conn->disconnecting(); 
+            }
+            int64_t n_shed = 0; 
+            for (size_t j = 0; j < conns.size() && n_closing + n_shed < excess; ++j) {
+                n_shed += conns[j]->shutdownIfIdle(min_idle); 
+            }
+            if (n_shed > 0) {
+                LOG_INFO << "TcpServer::rebalance [" << name << "] - shed " << n_shed 
+                         << " idle connections, excess " << excess; 
+            }
+        }); 
+    }
 }
 
+// 在base loop中无锁读取各IO线程的直方图. 
+void TcpServer::logMetrics() {
+    loop_->assertInLoopThread(); 
+    auto loops = eventloop_thread_pool_->getAllLoops(); 
+    for (size_t i = 0; i < loops.size(); ++i) {
+        EventLoop::LoadStats stats = loops[i]->getLoadStats(); 
+        uint64_t total_us = stats.busy_us + stats.idle_us + stats.spin_us; 
+        LOG_INFO << "TcpServer::logMetrics [" << name_ << "] - loop " << i 
+                 << " connections: " << stats.connections 
+                 << " utilization: " << (total_us > 0 ? stats.busy_us * 100 / total_us : 0) << "%\n"
+                 << loops[i]->getMetrics().summary(); 
+    }
+}
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn) {
     // 放到runInLoop, 保证移除TcpConnection的操作只能在其所属EventLoop所在线程中执行
@@ -97,6 +331,20 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
 }
 
 
+void TcpServer::removeConnectionInIoLoop(LoopAcceptor* loop_acceptor, const TcpConnectionPtr& conn) {
+    loop_acceptor->loop->assertInLoopThread(); 
+    LOG_INFO << "TcpServer::removeConnectionInIoLoop [" << name_
+             << "] - connection " << conn->getName()
+             << " remainer: " << loop_acceptor->connections.size(); 
+
+    size_t n = loop_acceptor->connections.erase(conn->getName()); 
+    assert(n == 1); 
+    (void)n; 
+    // 同removeConnectionInLoop, 不能在channel_.handleEvent()中直接销毁. 
+    loop_acceptor->loop->addToQueueInLoop(bind(&TcpConnection::connectionDestroyed, conn));
+}
+
+
 void TcpServer::setThreadNum(int num_threads) {
     assert(num_threads >= 0);
     eventloop_thread_pool_->setThreadNum(num_threads);
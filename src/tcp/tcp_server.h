@@ -5,14 +5,14 @@
 #include <map>
 #include <string>
 #include <atomic>
+#include <vector>
 
+#include "acceptor.h"
 #include "tcp_connection.h"
 #include "eventloop_threadpool.h"
 
 class EventLoop;
 
-class Acceptor; 
-
 class TcpConnection;
 
 class Buffer;
@@ -21,7 +21,7 @@ class TcpServer {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>; 
     using ConnectionCallback = std::function<void(const std::shared_ptr<TcpConnection>&)>;
-    using MessageCallback = std::function<void(const std::shared_ptr<TcpConnection>&, Buffer*, Timestamp)>; 
+    using MessageCallback = std::function<void(const std::shared_ptr<TcpConnection>&, Buffer*, MonoTimestamp)>; 
     using WriteCompleteCallback = ConnectionCallback;
     using CloseCallback = ConnectionCallback;
     using TcpConnectionPtr = std::shared_ptr<TcpConnection>; 
@@ -39,8 +39,6 @@ public:
     // Not thread safe.
     void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb;}
 
-    // Not thread safe, but in loop.
-    void newConnection(int sockfd, const InetAddress& addr);  
     // Thread safe.
     void removeConnection(const TcpConnectionPtr& conn); 
     // Not thread safe, but in loop.
@@ -49,7 +47,7 @@ public:
 
     /* Set the number of threads for handling input. 
      *
-     * Always accepts new connection in loop's thread.
+     * Always accepts new connection in loop's thread, unless setReusePort(true).
      * Must be called before @c start
      * @param numThreads 
      * - 0 means all I/O in loop's thread, no thread will created. 
@@ -60,6 +58,46 @@ public:
      */
     void setThreadNum(int num_threads);
     void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    // 新连接以边缘触发方式监听, read_budget为单次可读事件的读取字节上限. Not thread safe, 须在start()之前调用.
+    void setEdgeTriggered(bool on, size_t read_budget = TcpConnection::kDefaultReadBudget) {
+        edge_triggered_ = on; 
+        read_budget_ = read_budget; 
+    }
+    /* 每个IO线程各持有一个监听同一端口的Acceptor(SO_REUSEPORT), 由内核在其间分配新连接. 
+     * 连接在接受它的IO线程中建立与移除, 不经由base loop转交. 
+     * cpu_steering为true时附加SO_ATTACH_REUSEPORT_CBPF程序, 以处理该连接的CPU编号对IO线程数取模选择监听socket. 
+     * 无IO线程时不生效. Not thread safe, 须在start()之前调用.
+     */
+    void setReusePort(bool on, bool cpu_steering = false) {
+        reuse_port_ = on; 
+        cpu_steering_ = cpu_steering; 
+    }
+    // 每次可读事件最多accept的连接数. Not thread safe, 须在start()之前调用.
+    void setAcceptBudget(int budget) { accept_budget_ = budget; }
+    // 绑定base loop与各IO线程的CPU, 见EventLoopThreadPool::setCpuAffinity(). 
+    // reuseport模式下各监听socket另设置SO_INCOMING_CPU为其IO线程的CPU. Not thread safe, 须在start()之前调用.
+    void setCpuAffinity(const std::vector<int>& cpus) { eventloop_thread_pool_->setCpuAffinity(cpus); }
+    // 各IO线程的自适应自旋时长, 见EventLoop::setSpinDuration(). Not thread safe, 须在start()之前调用.
+    void setSpinDuration(Timestamp::Duration spin) { spin_duration_ = spin; }
+    /* 内核忙轮询: 新连接设置SO_BUSY_POLL(usecs)与SO_PREFER_BUSY_POLL, 各IO线程的epoll实例设置相同的busy poll参数. 
+     * 0为关闭. 超过net.core.busy_poll时设置SO_BUSY_POLL须CAP_NET_ADMIN, 失败时记录一次错误. 
+     * Not thread safe, 须在start()之前调用.
+     */
+    void setBusyPoll(int usecs) { busy_poll_us_ = usecs; }
+    /* 定时器: base loop与各IO线程的合并窗口(见TimerManager::setSlack()), 以及是否以poll超时代替timerfd. 
+     * Not thread safe, 须在start()之前调用.
+     */
+    void setTimerSlack(Timestamp::Duration slack) { timer_slack_ = slack; }
+    void setPollTimeoutForTimers(bool on) { poll_timeout_timers_ = on; }
+    // 新连接的IO线程选择策略. Not thread safe, 须在start()之前调用.
+    void setPlacement(EventLoopThreadPool::Placement placement) { eventloop_thread_pool_->setPlacement(placement); }
+    /* 每隔interval比较各IO线程的连接数, 超出平均值的IO线程半关闭其中空闲时间超过interval的keep-alive连接(至多超出的数量), 
+     * 客户端重连后按placement重新分配. 已建立的连接不跨线程迁移. 
+     * interval为0时不启用, reuseport模式下不生效. Not thread safe, 须在start()之前调用.
+     */
+    void setRebalanceInterval(Timestamp::Duration interval) { rebalance_interval_ = interval; }
+    // 每隔interval在日志中输出各IO线程的LoopMetrics摘要. 0为不输出. Not thread safe, 须在start()之前调用.
+    void setMetricsInterval(Timestamp::Duration interval) { metrics_interval_ = interval; }
     /// valid after calling start()
     std::shared_ptr<EventLoopThreadPool> getEventLoopPool() { return eventloop_thread_pool_; }
 
@@ -69,14 +107,43 @@ public:
 private:
     using ConnectionMap = std::map<std::string, TcpConnectionPtr>;
 
+    // reuseport模式下一个IO线程的监听socket及其连接, 仅在该IO线程中访问. 
+    struct LoopAcceptor {
+        EventLoop* loop; 
+        std::string name;                   // 连接名前缀
+        std::unique_ptr<Acceptor> acceptor; 
+        ConnectionMap connections; 
+        size_t next_conn_id = 1; 
+    };
+
+private:
+    void startReusePort(); 
+    // 创建TcpConnection, 加入connections_并设置关闭回调. 
+    TcpConnectionPtr addConnection(int sockfd, const InetAddress& peer_addr); 
+    // Acceptor批量接受: 逐个创建连接, 建立操作按IO线程暂存, 一批结束后每个IO线程只转交(唤醒)一次. 
+    void queueNewConnection(int sockfd, const InetAddress& peer_addr); 
+    void flushNewConnections(); 
+    TcpConnectionPtr createConnection(EventLoop* io_loop, const std::string& conn_name,
+                                      int sockfd, const InetAddress& peer_addr); 
+    // reuseport模式下的连接回调, 在loop_acceptor->loop所在IO线程执行. 
+    void newConnectionInIoLoop(LoopAcceptor* loop_acceptor, int sockfd, const InetAddress& peer_addr); 
+    void removeConnectionInIoLoop(LoopAcceptor* loop_acceptor, const TcpConnectionPtr& conn); 
+    void rebalance(); 
+    void logMetrics(); 
+    void setBusyPollOptions(int sockfd); 
+
 private:
     EventLoop* loop_;   // the acceptor loop 
 
     const std::string ip_port_; 
     const std::string name_;
+    const InetAddress listen_addr_; 
 
-    std::unique_ptr<Acceptor> acceptor_; 
+    std::unique_ptr<Acceptor> acceptor_;   // reuseport模式下启动后即关闭
     std::shared_ptr<EventLoopThreadPool> eventloop_thread_pool_; 
+    std::vector<std::unique_ptr<LoopAcceptor>> loop_acceptors_; 
+    // 本批次待转交各IO线程建立的连接
+    std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>> pending_established_; 
 
     ConnectionCallback connCallback_;
     MessageCallback msgCallback_;
@@ -85,4 +152,18 @@ private:
     std::atomic<bool> started_; 
     ConnectionMap connections_;
     size_t next_conn_id_; 
+    bool edge_triggered_; 
+    size_t read_budget_; 
+    bool reuse_port_; 
+    bool cpu_steering_; 
+    int accept_budget_; 
+    Timestamp::Duration rebalance_interval_; 
+    Timestamp::Duration metrics_interval_; 
+    Timestamp::Duration spin_duration_; 
+    int busy_poll_us_; 
+    std::atomic<bool> busy_poll_error_logged_; 
+    Timestamp::Duration timer_slack_; 
+    bool poll_timeout_timers_; 
+    TimerId rebalance_timer_; 
+    TimerId metrics_timer_; 
 };
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "cycle_clock.h"
+
+#include <atomic>
+#include <thread>
+
+#include "timestamp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CYCLE_CLOCK_X86 1
+#endif
+
+using namespace std;
+
+static constexpr int kCalibrateMs = 20;
+
+// 以下在enable()中写入后不再修改, 由g_enabled的release/acquire发布给各IO线程.
+static atomic<bool> g_enabled(false);
+static uint64_t g_base_cycles = 0;
+static int64_t g_base_us = 0;
+static double g_cycles_per_us = 0;
+
+static int64_t monotonicMicros() {
+    return MonoTimestamp::now().getMicroSecondsSinceEpoch();
+}
+
+#ifdef CYCLE_CLOCK_X86
+// CPUID.80000007H:EDX[8], invariant TSC.
+static bool hasInvariantTsc() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1u << 8)) != 0;
+}
+#endif
+
+bool CycleClock::enable() {
+#ifdef CYCLE_CLOCK_X86
+    if (g_enabled.load(memory_order_acquire)) {
+        return true;
+    }
+    if (!hasInvariantTsc()) {
+        return false;
+    }
+    uint64_t c0 = __rdtsc();
+    int64_t t0 = monotonicMicros();
+    this_thread::sleep_for(chrono::milliseconds(kCalibrateMs));
+    uint64_t c1 = __rdtsc();
+    int64_t t1 = monotonicMicros();
+    if (c1 <= c0 || t1 <= t0) {
+        return false;
+    }
+    g_cycles_per_us = static_cast<double>(c1 - c0) / static_cast<double>(t1 - t0);
+    g_base_cycles = c1;
+    g_base_us = t1;
+    g_enabled.store(true, memory_order_release);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CycleClock::isEnabled() {
+    return g_enabled.load(memory_order_relaxed);
+}
+
+int64_t CycleClock::nowMicros() {
+#ifdef CYCLE_CLOCK_X86
+    if (g_enabled.load(memory_order_acquire)) {
+        int64_t cycles = static_cast<int64_t>(__rdtsc() - g_base_cycles);   // 各核读数可能有微小偏差, 以有符号数计算
+        return g_base_us + static_cast<int64_t>(static_cast<double>(cycles) / g_cycles_per_us);
+    }
+#endif
+    return monotonicMicros();
+}
+
+double CycleClock::getCyclesPerMicro() {
+    return isEnabled() ? g_cycles_per_us : 0;
+}
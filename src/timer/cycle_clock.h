@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+/* 耗时统计使用的单调时钟, 微秒.
+ *
+ * 默认读取CLOCK_MONOTONIC(经vDSO, 不陷入内核), 与MonoTimestamp同源.
+ * 启用后在x86-64上以rdtsc读取时间戳计数器, 开销更低; 启用时以CLOCK_MONOTONIC校准频率,
+ * 仅当CPU声明TSC恒定频率且不随休眠停止(invariant TSC)时可以启用.
+ * TSC不随NTP微调, 长时间运行后与CLOCK_MONOTONIC可能有微小偏差, 故只用于统计短时间间隔, 不用于定时器.
+ */
+class CycleClock {
+public:
+    // 启动IO线程前调用. CPU不支持时返回false, 仍使用CLOCK_MONOTONIC.
+    static bool enable();
+    static bool isEnabled();
+    static int64_t nowMicros();
+    // 校准得到的每微秒TSC周期数, 未启用时为0.
+    static double getCyclesPerMicro();
+};
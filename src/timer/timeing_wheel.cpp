@@ -1,95 +1,95 @@
 /* 时间轮
  * 其本身向TimerManager注册一个周期性定时器, 每秒触发一次TimingWheel::onTimer()
- * onTimer里处理当前槽内的Entry, 通过clear()清空, 析构触发回调.
- * bucket以shared_ptr<Entry>方式进行管理, 故bucket清空时, 触发Entry析构 => 触发用户回调
+ * onTimer推进到下一个槽并检查其中的Entry: 到期的移出并回调, 到期时间已延后的按新的刻度移到后面的槽.
+ * Entry在上次放置后每次延后只更新刻度, 每个超时周期至多移动一次; 仅提前到期时间时才立即移动.
  */
 
 #include "timing_wheel.h"
 
+#include <algorithm>
+#include <cassert>
+
 #include "timestamp.h"
 #include "eventloop.h"
 #include "logger.h"
 
 using namespace std;
 
-static TimingWheel::Callback callback_;       
-
-TimingWheel::Entry::Entry(TimingWheel* wheel, Any data)
-    :owner_wheel_(wheel),
-    data_(std::move(data)),
-    bucket_num_(-1)
-{ }
-
-TimingWheel::Entry::~Entry() {
-    // if (owner_wheel_ && owner_wheel_->callback_) {
-    //     owner_wheel_->callback_(data_); 
-    // }
-}
-
-TimingWheel::TimingWheel(EventLoop* loop, int idle_seconds, Callback cb)
+TimingWheel::TimingWheel(EventLoop* loop, int max_seconds, Callback cb)
     : loop_(loop),
-    idle_seconds_(idle_seconds),
-    begin_idx_(0),
-    end_idx_(idle_seconds - 1),
-    buckets_(idle_seconds),  // 槽数即超时时长, 每秒对应一个槽.
+    max_seconds_(max_seconds),
+    current_tick_(0),
+    buckets_(max_seconds),  // 槽数即最长超时, 每秒对应一个槽.
+    size_(0),
     callback_(std::move(cb))
-{   
+{
+    assert(max_seconds_ > 0);
     // 基准定时器: 每秒处理一次槽
-    base_timer_ = loop_->runEvery(Timestamp::secondsToDuration(1), bind(&TimingWheel::onTimer, this));  
-}
-
-TimingWheel::EntryWeakPtr TimingWheel::insert(Any data) {
-    EntryPtr ptr = make_shared<Entry>(this, std::move(data)); 
-    loop_->runInLoop(bind(&TimingWheel::insertInLoop, this, ptr)); 
-    return ptr;
-}
-
-void TimingWheel::update(const EntryWeakPtr& entry_wkptr) {
-    loop_->runInLoop(bind(&TimingWheel::updateInLoop, this, entry_wkptr)); 
+    base_timer_ = loop_->runEvery(Timestamp::secondsToDuration(1), bind(&TimingWheel::onTimer, this));
 }
 
-void TimingWheel::remove(const EntryWeakPtr& entry_wkptr)  {
-    loop_->runInLoop(bind(&TimingWheel::removeInLoop, this, entry_wkptr)); 
-
+TimingWheel::~TimingWheel() {
+    loop_->removeTimer(base_timer_);
+    for (auto& bucket : buckets_) {
+        while (!bucket.empty()) {
+            Entry* entry = toEntry(bucket.next);
+            entry->detach();
+            entry->wheel_ = nullptr;
+        }
+    }
 }
 
-void TimingWheel::onTimer() {
-    LOG_TRACE << "TimingWheel::onTimer:  bucket[" << begin_idx_ << "]: "<< buckets_[begin_idx_].size();
-    for (auto& entry : buckets_[begin_idx_]) {
-        if (entry->owner_wheel_ && entry->owner_wheel_->callback_) {
-            entry->owner_wheel_->callback_(entry->data_); 
+void TimingWheel::insert(Entry* entry, int seconds) {
+    loop_->assertInLoopThread();
+    // 至少到下一刻度, 至多一圈.
+    entry->timeout_ = max(1, min(seconds, max_seconds_));
+    entry->deadline_tick_ = current_tick_ + entry->timeout_;
+    if (entry->wheel_) {
+        assert(entry->wheel_ == this);
+        if (entry->deadline_tick_ < entry->bucket_tick_) {
+            entry->detach();     // 提前到期: 所在槽检查得太晚, 立即移动
+            link(entry);
         }
+        return;
     }
-    buckets_[begin_idx_].clear();  
-    begin_idx_ = (begin_idx_ + 1) % idle_seconds_;
-    end_idx_ = (end_idx_ + 1) % idle_seconds_;
+    entry->wheel_ = this;
+    link(entry);
+    ++size_;
 }
 
+void TimingWheel::remove(Entry* entry) {
+    loop_->assertInLoopThread();
+    if (entry->wheel_ == this) {
+        entry->detach();
+        entry->wheel_ = nullptr;
+        --size_;
+    }
+}
 
-void TimingWheel::insertInLoop(const EntryPtr& ptr) {
-    loop_->assertInLoopThread(); 
-    buckets_[end_idx_].push_back(ptr); 
-    ptr->bucket_num_ = end_idx_;
-    ptr->pos_ = --buckets_[end_idx_].end();
+// 放入到期刻度对应的槽. 到期刻度距当前不超过一圈, 该槽恰在到期时被检查.
+void TimingWheel::link(Entry* entry) {
+    entry->bucket_tick_ = entry->deadline_tick_;
+    buckets_[entry->deadline_tick_ % max_seconds_].pushBack(entry);
 }
 
-void TimingWheel::updateInLoop(const EntryWeakPtr& entry_wkptr) {
-    loop_->assertInLoopThread(); 
-    if (auto ptr = entry_wkptr.lock()) {
-        int ori_idx = ptr->bucket_num_; 
-        if (ori_idx != end_idx_) {
-            buckets_[ori_idx].erase(ptr->pos_); 
-            buckets_[end_idx_].push_back(ptr);
-            ptr->bucket_num_ = end_idx_;
-            ptr->pos_ = --buckets_[end_idx_].end();
+void TimingWheel::onTimer() {
+    ++current_tick_;
+    TimerLink& bucket = buckets_[current_tick_ % max_seconds_];
+    LOG_TRACE << "TimingWheel::onTimer: tick " << current_tick_ << " size " << size_;
+    // 先取出整个槽, 重新放置的Entry不会再次被检查. 回调中可移除或重新插入due中的其他Entry.
+    TimerLink due;
+    due.splice(&bucket);
+    while (!due.empty()) {
+        Entry* entry = toEntry(due.next);
+        entry->detach();
+        if (entry->deadline_tick_ > current_tick_) {
+            link(entry);     // 到期时间已延后, 惰性重排
+        } else {
+            entry->wheel_ = nullptr;
+            --size_;
+            if (callback_) {
+                callback_(entry);
+            }
         }
     }
 }
-
-void TimingWheel::removeInLoop(const EntryWeakPtr& entry_wkptr) {
-    loop_->assertInLoopThread(); 
-    if (auto ptr = entry_wkptr.lock()) {
-        int ori_idx = ptr->bucket_num_; 
-        buckets_[ori_idx].erase(ptr->pos_); 
-    }
-}
\ No newline at end of file
@@ -2,8 +2,9 @@
 
 #include <unistd.h>
 #include <sys/timerfd.h>
-#include <iterator>
 #include <cassert>
+#include <cstring>
+#include <limits>
 
 #include "eventloop.h"
 #include "logger.h"
@@ -11,133 +12,369 @@
 
 using namespace std;
 
+const int TimerManager::kLevels;
+const int TimerManager::kLevel0Bits;
+const int TimerManager::kLevelBits;
+const int TimerManager::kLevel0Slots;
+const int TimerManager::kLevelSlots;
+const int TimerManager::kNumSlots;
+const int64_t TimerManager::kMaxSpanTicks;
 
-TimerManager::TimerManager(EventLoop* loop) 
+static constexpr int64_t kNoTick = numeric_limits<int64_t>::max();
+
+
+TimerManager::TimerManager(EventLoop* loop)
     : loop_(loop),
     timerfd_(createTimerfd()),
-    timerfd_channel_(loop_, timerfd_), 
-    timers_()
-{   
+    timerfd_channel_(loop_, timerfd_),
+    current_tick_(toTick(MonoTimestamp::now())),
+    armed_tick_(kNoTick),
+    next_tick_(kNoTick),
+    slack_ticks_(1),
+    num_timers_(0),
+    free_list_(nullptr),
+    num_free_(0),
+    next_sequence_(1),
+    rearms_(0),
+    batches_(0)
+{
+    memset(occupied_, 0, sizeof(occupied_));
     // 设置timerfd的回调
-    timerfd_channel_.setReadCallback(bind(&TimerManager::handleExpiredTimer, this));
-    timerfd_channel_.enableReading(); 
+    timerfd_channel_.setReadCallback(bind(&TimerManager::handleExpiredTimer, this, placeholders::_1));
+    timerfd_channel_.setKind(LoopMetrics::kTimer);
+    timerfd_channel_.enableReading();
 };
 
 TimerManager::~TimerManager() {
-    timerfd_channel_.disableAll(); 
-    timerfd_channel_.removeFromEpoller(); 
-    close(timerfd_);
+    if (timerfd_ >= 0) {
+        timerfd_channel_.disableAll();
+        timerfd_channel_.removeFromEpoller();
+        close(timerfd_);
+    }
+    for (auto& slot : slots_) {
+        while (!slot.empty()) {
+            Timer* timer = toTimer(slot.next);
+            timer->detach();
+            delete timer;
+        }
+    }
+    while (free_list_) {
+        Timer* next = toTimer(free_list_->next);
+        delete free_list_;
+        free_list_ = next;
+    }
 }
 
 int TimerManager::createTimerfd() {
-    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC); 
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
     if (tfd < 0) {
         LOG_SYSFATAL << "TimerManager::create_timerfd() timerfd_create";
     }
-    return tfd; 
+    return tfd;
 }
 
-weak_ptr<Timer> TimerManager::addTimer(TimerCallback cb, Timestamp exp, Duration interval) {
-    // TimeManager是无锁的, 非线程安全, 故必须将`addTimer`操作放在其所属EvenLoop所在线程中执行. 
-    auto ptr_timer = make_shared<Timer>(std::move(cb), exp, interval); 
-    loop_->runInLoop(bind(&TimerManager::addTimerInLoop, this, ptr_timer)); 
-    return ptr_timer; 
+TimerId TimerManager::addTimer(TimerCallback cb, MonoTimestamp exp, Duration interval) {
+    // TimeManager是无锁的, 非线程安全, 故必须将`addTimer`操作放在其所属EvenLoop所在线程中执行.
+    if (loop_->isInLoopThread()) {
+        Timer* timer = allocateTimer(std::move(cb), exp, interval);
+        addTimerInLoop(timer);
+        return TimerId(timer, timer->sequence_);
+    }
+    // 其他线程不访问空闲链表, 单独分配节点; 任务未执行即随loop析构时由unique_ptr释放.
+    unique_ptr<Timer> timer(new Timer(std::move(cb), exp, interval));
+    timer->sequence_ = next_sequence_.fetch_add(1, memory_order_relaxed);
+    timer->state_ = Timer::State::kPending;
+    TimerId timer_id(timer.get(), timer->sequence_);
+    loop_->runInLoop([this, timer = std::move(timer)]() mutable {
+        addTimerInLoop(timer.release());
+    });
+    return timer_id;
 }
 
-void TimerManager::addTimerInLoop(const shared_ptr<Timer>& ptr_timer) {
-    loop_->assertInLoopThread();  
-    if (insert(ptr_timer)) {
-        checkUpdateTimerfd(); 
+Timer* TimerManager::allocateTimer(TimerCallback&& cb, MonoTimestamp when, Duration interval) {
+    Timer* timer = free_list_;
+    if (timer) {
+        free_list_ = toTimer(timer->next);
+        timer->prev = timer->next = timer;
+        --num_free_;
+        timer->callback_ = std::move(cb);
+        timer->expiration_ = when;
+        timer->interval_ = interval;
+    } else {
+        timer = new Timer(std::move(cb), when, interval);
     }
+    timer->sequence_ = next_sequence_.fetch_add(1, memory_order_relaxed);
+    return timer;
 }
 
-bool TimerManager::insert(const shared_ptr<Timer>& ptr_timer) {
-    loop_->assertInLoopThread();  
-    Timestamp exp = ptr_timer->getExpiration(); 
-    bool update_timerfd = false; 
-    auto it = timers_.begin();
-    if (it == timers_.end() || exp < it->first) {
-        update_timerfd = true; 
+// 节点加入空闲链表而不释放; 回调随即析构, 以释放其捕获的对象.
+void TimerManager::freeTimer(Timer* timer) {
+    timer->callback_ = nullptr;
+    timer->sequence_ = 0;
+    timer->state_ = Timer::State::kFree;
+    timer->next = free_list_;
+    free_list_ = timer;
+    ++num_free_;
+}
+
+void TimerManager::addTimerInLoop(Timer* timer) {
+    loop_->assertInLoopThread();
+    if (timer->state_ == Timer::State::kCanceled) {
+        freeTimer(timer);   // 其他线程添加的定时器在加入时间轮之前已被撤销
+        return;
     }
-    
-    auto res = timers_.insert(Entry(exp, ptr_timer)); 
-    assert(res.second);
-    (void)res; 
-    return update_timerfd; 
+    int64_t tick = toTick(timer->getExpiration());
+    timer->tick_ = (tick + slack_ticks_ - 1) / slack_ticks_ * slack_ticks_;
+    link(timer);
+    ++num_timers_;
+    // timerfd推迟到本轮poll之前重设.
+    next_tick_ = min(next_tick_, max(timer->tick_, current_tick_));
 }
 
-void TimerManager::handleExpiredTimer() {
-    loop_->assertInLoopThread(); 
-    // 1.获取当前时间
-    auto now = Timestamp::now(); 
-    // 2.读取timerfd
-    uint64_t clicks; 
-    ssize_t n = read(timerfd_, &clicks, sizeof(clicks)); 
-    if (n != sizeof(clicks)) {
-        LOG_SYSFATAL << "TimerManager::handleExpiredTimer() read";
+void TimerManager::setSlack(Duration slack) {
+    loop_->assertInLoopThread();
+    slack_ticks_ = max<int64_t>(slack.count() / 1000, 1);
+}
+
+void TimerManager::usePollTimeout() {
+    loop_->assertInLoopThread();
+    if (timerfd_ < 0) {
+        return;
     }
-    // 3.从set中获取&移除已到期的定时器列表, 记入expired.
-    vector<Entry> expired; 
-    Entry sentry = make_pair(Timestamp::now(), 
-        shared_ptr<Timer>(reinterpret_cast<Timer*>(UINTPTR_MAX), [](Timer*){}));  // 哨兵值, 必须自定义删除器, 避免对UINTPTR_MAX地址释放内存.
-    auto it = timers_.lower_bound(sentry);  // 获取指向第一个未到期的Timer的迭代器
-    assert(it == timers_.end() || now < it->first);  
-    std::copy(timers_.begin(), it, back_inserter(expired));  
-    timers_.erase(timers_.begin(), it); 
-
-    // 4.处理每个到期的定时器: 执行回调
-    LOG_TRACE << "TimerManager::handleExpiredTimer cnt:" << expired.size();
-    calling_expired_timers_ = true;
-    canceling_timers_.clear(); 
-    for (const auto& p : expired) {
-        p.second->run();   // 执行回调. 
-    }
-    calling_expired_timers_ = false; 
-
-    // 5.对于周期性事件, 更新到期时间, 重新加入计时. 
-    for (const auto& p : expired) {
-        auto& timer = p.second; 
-        // 若timer在canceling_timers_中, 表明需移除, 故不再重新加入.
-        if (timer->repeatable() && (canceling_timers_.find(timer) == canceling_timers_.end())) {
-            timer->restart(now); 
-            insert(timer); 
+    timerfd_channel_.disableAll();
+    timerfd_channel_.removeFromEpoller();
+    close(timerfd_);
+    timerfd_ = -1;
+    armed_tick_ = kNoTick;
+}
+
+int TimerManager::beforePoll(int max_timeout_ms) {
+    if (timerfd_ >= 0) {
+        // 仅当早于timerfd当前的到期时间时才重设.
+        if (next_tick_ < armed_tick_) {
+            armTimerfd(next_tick_);
         }
+        return max_timeout_ms;
+    }
+    if (next_tick_ == kNoTick || max_timeout_ms == 0) {
+        return max_timeout_ms;
+    }
+    // 向上取整到毫秒, poll返回时不早于到期刻度.
+    int64_t wait_us = next_tick_ * 1000 - MonoTimestamp::now().getMicroSecondsSinceEpoch();
+    int64_t wait_ms = wait_us > 0 ? (wait_us + 999) / 1000 : 0;
+    if (max_timeout_ms < 0 || wait_ms < max_timeout_ms) {
+        return static_cast<int>(wait_ms);
     }
-    // 全部插入后, 重新取最小到期时间, 作为timerfd到期时间.
-    checkUpdateTimerfd();  
+    return max_timeout_ms;
 }
 
+bool TimerManager::afterPoll(MonoTimestamp now) {
+    if (timerfd_ >= 0 || now.getMicroSecondsSinceEpoch() / 1000 < next_tick_) {
+        return false;
+    }
+    return expireTimers(now);
+}
 
-void TimerManager::checkUpdateTimerfd() {
-    // 根据timers中的最小到期时间, 重设timerfd的到期时间. 
-    // cout << "trigger" << endl; 
-    if (timers_.empty()) return; 
-    auto it = timers_.begin(); 
-    struct timespec ts = it->second->getExpiration().getDurationFromNowAsTimeSpec(); 
+void TimerManager::link(Timer* timer) {
+    int64_t tick = max(timer->tick_, current_tick_);   // 已过期的定时器在下一个刻度处理
+    int64_t delta = tick - current_tick_;
+    if (delta >= kMaxSpanTicks) {
+        delta = kMaxSpanTicks - 1;
+        tick = current_tick_ + delta;
+    }
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (int64_t(1) << levelShift(level + 1))) {
+        ++level;
+    }
+    int slot = levelOffset(level) + static_cast<int>((tick >> levelShift(level)) & levelMask(level));
+    slots_[slot].pushBack(timer);
+    occupied_[slot / 64] |= uint64_t(1) << (slot % 64);
+    timer->slot_ = slot;
+    timer->state_ = Timer::State::kInWheel;
+}
+
+void TimerManager::unlink(Timer* timer) {
+    timer->detach();
+    int slot = timer->slot_;
+    if (slots_[slot].empty()) {
+        occupied_[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    }
+    timer->slot_ = -1;
+}
 
+int TimerManager::findOccupied(int begin, int end) const {
+    while (begin < end) {
+        uint64_t word = occupied_[begin / 64] >> (begin % 64);
+        if (word) {
+            int found = begin + __builtin_ctzll(word);
+            return found < end ? found : end;
+        }
+        begin = (begin / 64 + 1) * 64;
+    }
+    return end;
+}
+
+void TimerManager::advance(int64_t now_tick, TimerLink* expired) {
+    while (current_tick_ <= now_tick) {
+        if (num_timers_ == 0) {
+            current_tick_ = now_tick + 1;
+            break;
+        }
+        int idx = static_cast<int>(current_tick_ & (kLevel0Slots - 1));
+        if (idx == 0) {
+            // 第0层转完一圈, 降级上一层的当前槽; 该层下标也为0时继续降级更高一层.
+            for (int level = 1; level < kLevels; ++level) {
+                int level_idx = static_cast<int>((current_tick_ >> levelShift(level)) & levelMask(level));
+                cascade(level, level_idx);
+                if (level_idx != 0) {
+                    break;
+                }
+            }
+        }
+        if (!slots_[idx].empty()) {
+            for (TimerLink* node = slots_[idx].next; node != &slots_[idx]; node = node->next) {
+                toTimer(node)->state_ = Timer::State::kExpired;
+                toTimer(node)->slot_ = -1;
+                --num_timers_;
+            }
+            expired->splice(&slots_[idx]);
+            occupied_[idx / 64] &= ~(uint64_t(1) << (idx % 64));
+        }
+        // 跳过本圈内的空槽, 至多到下一圈的起点.
+        int next = findOccupied(idx + 1, kLevel0Slots);
+        current_tick_ = min((current_tick_ & ~int64_t(kLevel0Slots - 1)) + next, now_tick + 1);
+    }
+}
+
+void TimerManager::cascade(int level, int idx) {
+    int slot = levelOffset(level) + idx;
+    if (slots_[slot].empty()) {
+        return;
+    }
+    TimerLink pending;
+    pending.splice(&slots_[slot]);
+    occupied_[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    while (!pending.empty()) {
+        Timer* timer = toTimer(pending.next);
+        timer->detach();
+        link(timer);
+    }
+}
+
+int64_t TimerManager::nextTick() const {
+    if (num_timers_ == 0) {
+        return kNoTick;
+    }
+    int64_t result = kNoTick;
+    // 第0层: 自当前下标起循环查找, 同一槽内定时器的到期刻度相同.
+    int64_t base = current_tick_ & ~int64_t(kLevel0Slots - 1);
+    int idx = static_cast<int>(current_tick_ & (kLevel0Slots - 1));
+    int found = findOccupied(idx, kLevel0Slots);
+    if (found < kLevel0Slots) {
+        result = base + found;
+    } else if ((found = findOccupied(0, idx)) < idx) {
+        result = base + kLevel0Slots + found;
+    }
+    // 上层: 下一个非空槽的降级刻度, 即其中定时器到期刻度的下界.
+    for (int level = 1; level < kLevels; ++level) {
+        int shift = levelShift(level);
+        int64_t round = (current_tick_ + (int64_t(1) << shift) - 1) >> shift;   // 不早于当前刻度的首个降级点
+        int start = static_cast<int>(round & levelMask(level));
+        int offset = levelOffset(level);
+        int k = findOccupied(offset + start, offset + kLevelSlots) - offset;
+        int64_t distance = k - start;
+        if (k == kLevelSlots) {
+            k = findOccupied(offset, offset + start) - offset;
+            if (k == start) {
+                continue;    // 本层为空
+            }
+            distance = k + kLevelSlots - start;
+        }
+        result = min(result, (round + distance) << shift);
+    }
+    return result;
+}
+
+void TimerManager::armTimerfd(int64_t tick) {
+    armed_tick_ = tick;
+    ++rearms_;
+    // steady_clock即CLOCK_MONOTONIC, 刻度可直接作为timerfd的绝对到期时间; 已过去的时间立即触发.
     struct itimerspec new_value;
     memset(&new_value, 0, sizeof(new_value));
-    new_value.it_value = ts;
-    if (timerfd_settime(timerfd_, 0, &new_value, nullptr) < 0) {
-        LOG_SYSFATAL << "TimerManager::checkUpdateTimerfd() timerfd_settime";
+    new_value.it_value.tv_sec = static_cast<time_t>(tick / 1000);
+    new_value.it_value.tv_nsec = static_cast<long>(tick % 1000 * 1000 * 1000);
+    if (timerfd_settime(timerfd_, TFD_TIMER_ABSTIME, &new_value, nullptr) < 0) {
+        LOG_SYSFATAL << "TimerManager::armTimerfd() timerfd_settime";
     }
 }
 
-void TimerManager::removeTimer(const weak_ptr<Timer>& wk_ptr) {
-    loop_->runInLoop(bind(&TimerManager::removeTimerInLoop, this, wk_ptr)); 
+void TimerManager::handleExpiredTimer(MonoTimestamp now) {
+    loop_->assertInLoopThread();
+    // 1.读取timerfd
+    uint64_t clicks;
+    ssize_t n = read(timerfd_, &clicks, sizeof(clicks));
+    if (n != sizeof(clicks)) {
+        LOG_SYSFATAL << "TimerManager::handleExpiredTimer() read";
+    }
+    armed_tick_ = kNoTick;
+    expireTimers(now);
 }
 
-void TimerManager::removeTimerInLoop(const weak_ptr<Timer>& wk_ptr) {
-    loop_->assertInLoopThread(); 
-    if (shared_ptr<Timer> s_ptr = wk_ptr.lock()) {
-        auto it = timers_.find(Entry(s_ptr->getExpiration(), s_ptr)); 
-        LOG_TRACE << "TTimerManager::removeTimerInLoop remove timer: " << it->second.get();
-        if (it != timers_.end()) {
-            timers_.erase(it);  
-        } else if (calling_expired_timers_) {  // 自注销
-            // 处理自注销的情况——Timer的回调任务的注销该Timer本身, 
-            // 即此时正位于执行handleExpiredTimer的过程, 该Timer已不在timers_中而在expired中.
-            canceling_timers_.insert(s_ptr);  
+bool TimerManager::expireTimers(MonoTimestamp now) {
+    loop_->assertInLoopThread();
+    // 2.推进时间轮, 取出到期的定时器. 当前时间(poll返回时刻)向下取整、到期时间向上取整, 不会提前触发.
+    TimerLink expired;
+    advance(now.getMicroSecondsSinceEpoch() / 1000, &expired);
+    bool fired = !expired.empty();
+    if (fired) {
+        ++batches_;
+    }
+
+    // 3.依次执行回调. 回调中撤销其他尚未执行的定时器时直接将其从expired中摘除, 撤销自身时标记为kCanceled.
+    while (!expired.empty()) {
+        Timer* timer = toTimer(expired.next);
+        timer->detach();
+        timer->state_ = Timer::State::kRunning;
+        timer->run();
+        // 4.周期性定时器更新到期时间, 重新加入时间轮(不重设timerfd).
+        if (timer->state_ == Timer::State::kRunning && timer->repeatable()) {
+            timer->restart(now);
+            addTimerInLoop(timer);
+        } else {
+            freeTimer(timer);
         }
     }
-}
\ No newline at end of file
+    // 5.以最早到期刻度的下界作为下次唤醒的时间, 由本轮poll之前的beforePoll()统一重设.
+    next_tick_ = nextTick();
+    return fired;
+}
+
+void TimerManager::removeTimer(TimerId timer_id) {
+    loop_->runInLoop(bind(&TimerManager::removeTimerInLoop, this, timer_id));
+}
+
+void TimerManager::removeTimerInLoop(TimerId timer_id) {
+    loop_->assertInLoopThread();
+    Timer* timer = timer_id.timer_;
+    if (!timer || timer->sequence_ != timer_id.sequence_) {
+        return;   // 已到期或已撤销, 节点可能已被复用
+    }
+    LOG_TRACE << "TimerManager::removeTimerInLoop remove timer: " << timer;
+    switch (timer->state_) {
+        case Timer::State::kInWheel:
+            unlink(timer);
+            --num_timers_;
+            freeTimer(timer);
+            break;
+        case Timer::State::kExpired:
+            timer->detach();
+            freeTimer(timer);
+            break;
+        case Timer::State::kPending:   // 尚未加入时间轮: 由addTimerInLoop()回收
+        case Timer::State::kRunning:   // 自注销: 回调返回后回收
+            timer->state_ = Timer::State::kCanceled;
+            break;
+        default:
+            break;
+    }
+}
@@ -2,70 +2,200 @@
 
 #include <functional>
 #include <utility>
-#include <set>
 #include <memory>
 #include <atomic>
+#include <cstdint>
 
 #include "channel.h"
 #include "timestamp.h"
- 
-using TimerCallback = std::function<void()>; 
-using Duration = Timestamp::Duration; 
 
-class EventLoop; 
+using TimerCallback = std::function<void()>;
+using Duration = MonoTimestamp::Duration;
 
-class Timer {
+class EventLoop;
+class TimerManager;
+
+// 侵入式双向循环链表的节点, 时间轮的每个槽以一个哨兵节点表示.
+struct TimerLink {
+    TimerLink* prev = this;
+    TimerLink* next = this;
+
+    bool empty() const { return next == this; }
+    // 以下由哨兵节点调用: 将node加入链表末尾; 将from的全部节点移至本链表末尾.
+    void pushBack(TimerLink* node) {
+        node->prev = prev;
+        node->next = this;
+        prev->next = node;
+        prev = node;
+    }
+    void splice(TimerLink* from) {
+        if (from->empty()) {
+            return;
+        }
+        from->next->prev = prev;
+        prev->next = from->next;
+        from->prev->next = this;
+        prev = from->prev;
+        from->prev = from->next = from;
+    }
+    // 从所在链表中摘除.
+    void detach() {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+    }
+};
+
+class Timer : private TimerLink {
 public:
-    Timer(TimerCallback cb, Timestamp exp, Duration interval) 
-        : callback_(cb), expiration_(exp), interval_(interval) {}
+    Timer(TimerCallback cb, MonoTimestamp exp, Duration interval)
+        : callback_(std::move(cb)), expiration_(exp), interval_(interval) {}
     // ~Timer();
 
     void run() const {  callback_();  }
-    void restart(const Timestamp& now) {
+    void restart(const MonoTimestamp& now) {
         if (repeatable()) {
             expiration_ = now + interval_;
         } else {
-            expiration_ = Timestamp::invalid();
+            expiration_ = MonoTimestamp::invalid();
         }
     }
 
-    Timestamp getExpiration() const {  return expiration_; }
+    MonoTimestamp getExpiration() const {  return expiration_; }
     bool repeatable() { return interval_ != Duration(0); }
 
 private:
+    friend class TimerManager;
+    // kPending: 其他线程添加, 尚未由所属线程加入时间轮; 此时撤销即标记为kCanceled, 加入前检查.
+    enum class State { kFree, kPending, kInWheel, kExpired, kRunning, kCanceled };
+
     TimerCallback callback_;   // 定时器回调任务
-    Timestamp expiration_;     // 过期时间
+    MonoTimestamp expiration_; // 过期时间(单调时间)
     Duration interval_;        // 回调间隔
+    // 以下由TimerManager维护
+    int64_t tick_ = 0;         // 到期的毫秒刻度(向上取整)
+    uint64_t sequence_ = 0;    // 创建序号, 节点回收后置0, 用于识别失效的TimerId
+    int slot_ = -1;            // 所在时间轮槽的下标
+    State state_ = State::kFree;
 };
 
+/* 定时器的句柄, 用于撤销. 可复制, 不延长定时器的生命周期:
+ * 定时器到期(非周期)或已撤销后, 其节点可能被复用, 以创建序号识别, 此时撤销不产生任何作用.
+ */
+class TimerId {
+public:
+    TimerId() : timer_(nullptr), sequence_(0) {}
+    bool valid() const { return timer_ != nullptr; }
 
-class TimerManager {
 private:
-    using Entry = std::pair<Timestamp, std::shared_ptr<Timer>>;
-    using TimerList = std::set<Entry>; 
-    using ActiveTimerSet = std::set<std::shared_ptr<Timer>>; 
+    friend class TimerManager;
+    TimerId(Timer* timer, uint64_t sequence) : timer_(timer), sequence_(sequence) {}
+
+    Timer* timer_;
+    uint64_t sequence_;
+};
 
-public: 
+
+/* 分层时间轮(hierarchical hashed timing wheel), 毫秒精度.
+ *
+ * - 到期时间均为单调时间(CLOCK_MONOTONIC), 与timerfd使用同一时钟, 不受系统时间调整的影响.
+ * - 第0层256个槽, 每槽1ms; 第1~4层各64个槽, 每槽分别为2^8, 2^14, 2^20, 2^26ms, 共覆盖2^32ms(约49天),
+ *   更远的定时器置于最高层末端, 降级时按实际到期时间重新放置.
+ * - 插入与撤销均为O(1): 定时器节点即链表节点(侵入式), 按到期刻度与当前刻度之差选择层与槽, 撤销时直接从槽中摘除.
+ * - 推进时逐槽取出第0层到期的定时器; 第0层转完一圈时将上一层的下一个槽降级(cascade)到下层.
+ *   各槽以位图标记是否非空, 推进时跳过空槽.
+ * - 节点由本loop的空闲链表复用, 所属线程内新建定时器不再分配内存; 其他线程新建时分配节点, 回收后同样加入空闲链表.
+ *   节点在TimerManager析构时才释放, 故失效的TimerId仍可安全地比较创建序号.
+ * - 添加定时器与到期处理只更新最早到期刻度的下界, timerfd由EventLoop在每轮poll之前按需重设, 每轮至多一次;
+ *   仅当下界早于timerfd当前的到期时间时才重设, 撤销时不重设, 提前醒来时按时间轮重新计算.
+ *   timerfd以绝对时间(TFD_TIMER_ABSTIME)设置, 无须读取当前时间; 到期处理以本轮poll返回的时刻为当前时间.
+ * - 合并窗口(slack): 到期刻度向上对齐到窗口的整数倍, 窗口内的定时器在同一次唤醒中执行, 不会提前触发.
+ * - poll超时模式: 不使用timerfd, 以最早到期刻度限定poll的超时时间, poll返回后处理到期的定时器,
+ *   省去timerfd channel及每次到期的read与timerfd_settime.
+ */
+class TimerManager {
+public:
+    static const int kLevels = 5;
+    static const int kLevel0Bits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevel0Slots = 1 << kLevel0Bits;
+    static const int kLevelSlots = 1 << kLevelBits;
+    static const int kNumSlots = kLevel0Slots + (kLevels - 1) * kLevelSlots;
+    static const int64_t kMaxSpanTicks = int64_t(1) << (kLevel0Bits + (kLevels - 1) * kLevelBits);
+
+    struct Stats {
+        size_t timers;       // 未到期的定时器数
+        size_t free_nodes;   // 空闲链表中的节点数
+        uint64_t rearms;     // timerfd_settime的调用次数
+        uint64_t batches;    // 有定时器到期的处理次数, 每次执行同一刻度(窗口)内到期的全部定时器
+    };
+
+public:
     TimerManager(EventLoop* loop);
     ~TimerManager();
 
-    std::weak_ptr<Timer> addTimer(TimerCallback cb, Timestamp when, Duration interval); 
-    void removeTimer(const std::weak_ptr<Timer>& wk_ptr_timer); 
+    TimerId addTimer(TimerCallback cb, MonoTimestamp when, Duration interval);
+    void removeTimer(TimerId timer_id);
+    // 以下仅限所属IO线程调用.
+    Stats getStats() const { return Stats{num_timers_, num_free_, rearms_, batches_}; }
+    // 合并窗口, 向下取整到毫秒, 0或1ms为不合并(默认). 只影响其后添加的定时器.
+    void setSlack(Duration slack);
+    Duration getSlack() const { return Duration(slack_ticks_ * 1000); }
+    // 改为poll超时模式, 关闭timerfd, 不可恢复. 不能在定时器回调中调用.
+    void usePollTimeout();
+    bool isPollTimeoutMode() const { return timerfd_ < 0; }
+    // 由EventLoop在每轮poll之前调用: timerfd模式下按需重设timerfd, 返回max_timeout_ms;
+    // poll超时模式下返回不晚于最早到期刻度的超时时间(毫秒).
+    int beforePoll(int max_timeout_ms);
+    // 由EventLoop在poll返回之后调用, 仅poll超时模式下处理到期的定时器. 返回是否有定时器到期.
+    bool afterPoll(MonoTimestamp now);
 
 private:
-    void addTimerInLoop(const std::shared_ptr<Timer>& ptr_timer); 
-    bool insert(const std::shared_ptr<Timer>& ptr_timer);  // 插入timer, 返回是否需要更新timerfd
-    void removeTimerInLoop(const std::weak_ptr<Timer>& wk_ptr_timer);  
-    void handleExpiredTimer();    // timerfd触发事件时, 处理到期的定时器事件
-    void checkUpdateTimerfd();    // 检查是否需要更新timerfd的到期时间.
+    void addTimerInLoop(Timer* timer);
+    void removeTimerInLoop(TimerId timer_id);
+    void handleExpiredTimer(MonoTimestamp now);    // timerfd触发事件时, 处理到期的定时器事件
+    bool expireTimers(MonoTimestamp now);          // 执行到期的定时器, 返回是否有定时器到期
+
+    Timer* allocateTimer(TimerCallback&& cb, MonoTimestamp when, Duration interval);
+    void freeTimer(Timer* timer);
+    // 按到期刻度放入时间轮.
+    void link(Timer* timer);
+    void unlink(Timer* timer);
+    // 推进至now_tick(含), 到期的定时器移入expired.
+    void advance(int64_t now_tick, TimerLink* expired);
+    void cascade(int level, int idx);
+    // 下一个到期刻度的下界: 第0层为确切的到期刻度, 上层为其下一个非空槽的降级刻度. 无定时器时返回INT64_MAX.
+    int64_t nextTick() const;
+    // 从位图中查找[begin, end)内第一个非空槽, 不存在时返回end.
+    int findOccupied(int begin, int end) const;
+    void armTimerfd(int64_t tick);
     int createTimerfd();
 
+    static int64_t toTick(const MonoTimestamp& time) {
+        return (time.getMicroSecondsSinceEpoch() + 999) / 1000;    // 向上取整, 不早于到期时间触发
+    }
+    static int levelOffset(int level) { return level == 0 ? 0 : kLevel0Slots + (level - 1) * kLevelSlots; }
+    static int levelShift(int level) { return level == 0 ? 0 : kLevel0Bits + (level - 1) * kLevelBits; }
+    static int levelMask(int level) { return level == 0 ? kLevel0Slots - 1 : kLevelSlots - 1; }
+
+    static Timer* toTimer(TimerLink* link) { return static_cast<Timer*>(link); }
+
 private:
     EventLoop* loop_;
     int timerfd_;
-    Channel timerfd_channel_; 
-    TimerList timers_; 
-    
-    ActiveTimerSet  canceling_timers_;   // 暂存需要被撤销的Timer. 
-    std::atomic<bool> calling_expired_timers_;  
-};
\ No newline at end of file
+    Channel timerfd_channel_;
+
+    TimerLink slots_[kNumSlots];
+    uint64_t occupied_[kNumSlots / 64];   // 各槽是否非空的位图
+    int64_t current_tick_;                // 下一个待处理的刻度, 此前的刻度均已处理
+    int64_t armed_tick_;                  // timerfd当前的到期刻度, 未设置时为INT64_MAX
+    int64_t next_tick_;                   // 最早到期刻度的下界, 无定时器时为INT64_MAX
+    int64_t slack_ticks_;                 // 合并窗口(毫秒), 至少为1
+    size_t num_timers_;
+
+    Timer* free_list_;                    // 以next链接的空闲节点(单链表)
+    size_t num_free_;
+    std::atomic<uint64_t> next_sequence_;
+    uint64_t rearms_;
+    uint64_t batches_;
+};
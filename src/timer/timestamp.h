@@ -7,25 +7,30 @@
 #include <string>
 #include <sys/time.h>
 
-class Timestamp {
+/* 微秒精度的时间戳, 以时钟类型区分两种用途, 二者不能混用:
+ * - Timestamp(system_clock): 墙上时间, 用于日志、HTTP日期等需要显示的时间.
+ * - MonoTimestamp(steady_clock, 即CLOCK_MONOTONIC): 单调时间, 用于定时器、超时与耗时统计, 不受NTP等调整系统时间的影响.
+ */
+template <typename ClockType>
+class BasicTimestamp {
 public:
-    using Clock = std::chrono::system_clock;     // 系统时钟
+    using Clock = ClockType;
     using Duration = std::chrono::microseconds;  // 微秒数   
     using TimePoint = std::chrono::time_point<Clock, Duration>; // 微秒单位的时间点
 
     static constexpr int kMicroSecondsPerSecond = 1000 * 1000; 
     
 public:
-    Timestamp() : time_point_(TimePoint{}) {}
+    BasicTimestamp() : time_point_(TimePoint{}) {}
 
-    explicit Timestamp(TimePoint tp) : time_point_(tp) {}
+    explicit BasicTimestamp(TimePoint tp) : time_point_(tp) {}
 
-    static Timestamp now() {
-        return Timestamp(std::chrono::time_point_cast<Duration>(Clock::now()));  
+    static BasicTimestamp now() {
+        return BasicTimestamp(std::chrono::time_point_cast<Duration>(Clock::now()));  
     }
     
-    static Timestamp invalid() {
-        return Timestamp(); 
+    static BasicTimestamp invalid() {
+        return BasicTimestamp(); 
     }
 
     static Duration secondsToDuration(double s) {
@@ -43,7 +48,7 @@ public:
 
     // 计算该Timestamp指定时间相较于now()的差值, 以timespec类型返回.
     struct timespec getDurationFromNowAsTimeSpec() const {
-        int64_t us = (*this - Timestamp::now()).count(); 
+        int64_t us = (*this - BasicTimestamp::now()).count(); 
         if (us < 100) {  // 保证非负
             us = 100; 
         }
@@ -53,9 +58,11 @@ public:
         return ts;
     }
 
+    // 单调时间按当前两个时钟之差换算为墙上时间, 仅用于显示.
     std::string toFormattedString(bool show_microseconds = true, bool use_utc = false) const {
         char buf[80] = {0};
-        std::time_t tt = Clock::to_time_t(time_point_); 
+        auto wall = toSystemTime(time_point_); 
+        std::time_t tt = std::chrono::system_clock::to_time_t(wall); 
         struct tm tm;
         if (use_utc) {
             gmtime_r(&tt, &tm);     // UTC时间
@@ -63,7 +70,7 @@ public:
             localtime_r(&tt, &tm);  // 本地时间
         }
         if (show_microseconds) {
-            int remain_us = static_cast<int>(time_point_.time_since_epoch().count() % kMicroSecondsPerSecond); 
+            int remain_us = static_cast<int>(wall.time_since_epoch().count() % kMicroSecondsPerSecond); 
             snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d.%06d",
             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
             tm.tm_hour, tm.tm_min, tm.tm_sec, remain_us);
@@ -76,31 +83,48 @@ public:
     }
 
     // 时间戳相减得到时间间隔
-    Duration operator-(const Timestamp& rhs) const {
+    Duration operator-(const BasicTimestamp& rhs) const {
         return time_point_ - rhs.time_point_;
     }
 
     // 加减时间间隔得到时间戳
-    Timestamp operator+(const Duration& duration) const {
-        return Timestamp(time_point_ + duration);
+    BasicTimestamp operator+(const Duration& duration) const {
+        return BasicTimestamp(time_point_ + duration);
     }
 
-    Timestamp operator-(const Duration& duration) const {
-        return Timestamp(time_point_ - duration);
+    BasicTimestamp operator-(const Duration& duration) const {
+        return BasicTimestamp(time_point_ - duration);
     }
 
-    bool operator<(const Timestamp& other) const { 
+    bool operator<(const BasicTimestamp& other) const { 
         return time_point_ < other.time_point_; 
     }
 
-    bool operator>(const Timestamp& other) const { 
+    bool operator>(const BasicTimestamp& other) const { 
         return time_point_ > other.time_point_; 
     }
 
-    bool operator==(const Timestamp& other) const { 
+    bool operator==(const BasicTimestamp& other) const { 
         return time_point_ == other.time_point_; 
     }
 
 private:
+    using SystemTimePoint = std::chrono::time_point<std::chrono::system_clock, Duration>; 
+
+    static SystemTimePoint toSystemTime(const SystemTimePoint& tp) {
+        return tp; 
+    }
+
+    static SystemTimePoint toSystemTime(const std::chrono::time_point<std::chrono::steady_clock, Duration>& tp) {
+        auto offset = std::chrono::duration_cast<Duration>(tp - std::chrono::steady_clock::now()); 
+        return std::chrono::time_point_cast<Duration>(std::chrono::system_clock::now()) + offset; 
+    }
+
     TimePoint time_point_; 
-};
\ No newline at end of file
+};
+
+template <typename ClockType>
+constexpr int BasicTimestamp<ClockType>::kMicroSecondsPerSecond;
+
+using Timestamp = BasicTimestamp<std::chrono::system_clock>;
+using MonoTimestamp = BasicTimestamp<std::chrono::steady_clock>;
\ No newline at end of file
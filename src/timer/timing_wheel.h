@@ -2,51 +2,78 @@
 
 #include <functional>
 #include <vector>
-#include <list>
-#include <memory>
 
 #include "timer.h"
-#include "any.h"
 
 class EventLoop;
 
+/* 断开超时连接的时间轮, 每秒推进一个槽, 槽数即支持的最长超时秒数.
+ *
+ * 表项(Entry)嵌入在被管理的对象中, 以侵入式链表挂在槽上, 插入与移除均不分配内存.
+ * 各表项有各自的到期刻度; 延后到期时间只写入新的刻度, 不移动表项. 槽到期时才检查其中的表项:
+ * 尚未到期的按新的刻度重新放入对应的槽(惰性重排), 否则移出并回调. 提前到期时间时立即移到对应的槽.
+ * 所有操作仅限所属IO线程调用.
+ */
 class TimingWheel {
 public:
-    struct Entry; 
-    using EntryPtr = std::shared_ptr<Entry>;
-    using EntryWeakPtr = std::weak_ptr<Entry>;  
-    using Pos = std::list<EntryPtr>::const_iterator;
-    using Buckets = std::vector<std::list<EntryPtr>>; 
-    using Callback = std::function<void(Any& data)>; 
-    using BaseTimer = std::weak_ptr<Timer>; 
-
-    struct Entry {
-        explicit Entry(TimingWheel* wheel, Any data); 
-        ~Entry();
-        TimingWheel* owner_wheel_;
-        Any data_;           // 任意类型数据
-        int bucket_num_;     // 记录Entry所在槽
-        Pos pos_;            // 记录Entry在槽中的位置
+    class Entry : private TimerLink {
+    public:
+        // owner为被管理的对象, 回调时由getOwner()取回.
+        explicit Entry(void* owner) : owner_(owner), wheel_(nullptr), timeout_(0), deadline_tick_(0), bucket_tick_(0) {}
+        ~Entry() { leave(); }
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        void* getOwner() const { return owner_; }
+        bool inWheel() const { return wheel_ != nullptr; }
+        // 记录一次活动: 以最近一次设定的超时秒数重新计时. 仅一次写入, 到期检查时才按此重新放置.
+        void touch() {
+            if (wheel_) {
+                deadline_tick_ = wheel_->current_tick_ + timeout_;
+            }
+        }
+        // 移出所在的时间轮, 须在该时间轮所属IO线程调用.
+        void leave() {
+            if (wheel_) {
+                wheel_->remove(this);
+            }
+        }
+
+    private:
+        friend class TimingWheel;
+        void* owner_;
+        TimingWheel* wheel_;        // 所在的时间轮, 不在时间轮中时为空
+        int timeout_;               // 最近一次设定的超时秒数
+        int64_t deadline_tick_;     // 到期的刻度
+        int64_t bucket_tick_;       // 所在槽被检查的刻度, 不早于deadline_tick_时无需移动
     };
+    using Callback = std::function<void(Entry* entry)>;
 
 public:
-    TimingWheel(EventLoop* loop, int idle_seconds, Callback cb);
-    EntryWeakPtr insert(Any data);
-    void update(const EntryWeakPtr& entry_wkptr);
-    void remove(const EntryWeakPtr& entry_wkptr);
+    // max_seconds为支持的最长超时秒数(槽数), 超出的按此截断.
+    TimingWheel(EventLoop* loop, int max_seconds, Callback cb);
+    ~TimingWheel();
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    // 加入时间轮, 自当前起seconds秒后到期(省略时为最长超时). 已在时间轮中时重设到期时间.
+    void insert(Entry* entry) { insert(entry, max_seconds_); }
+    void insert(Entry* entry, int seconds);
+    void remove(Entry* entry);
+    size_t size() const { return size_; }
+    int getMaxSeconds() const { return max_seconds_; }
 
 private:
-    void onTimer(); 
-    void insertInLoop(const EntryPtr& ptr);
-    void updateInLoop(const EntryWeakPtr& entry_wkptr);
-    void removeInLoop(const EntryWeakPtr& entry_wkptr);
+    void onTimer();
+    void link(Entry* entry);
+    static Entry* toEntry(TimerLink* link) { return static_cast<Entry*>(link); }
 
 private:
-    EventLoop* loop_; 
-    BaseTimer base_timer_;
-    const int idle_seconds_;  // 连接超时定时. 等同于槽数. 
-    int begin_idx_;           // 当前时刻指向的槽(需清除)
-    int end_idx_;             // 当前时刻末尾的槽(供插入)
-    Buckets buckets_;   
-    Callback callback_;     
-};
\ No newline at end of file
+    EventLoop* loop_;
+    TimerId base_timer_;
+    const int max_seconds_;       // 最长超时秒数. 等同于槽数.
+    int64_t current_tick_;        // 已推进的秒数
+    std::vector<TimerLink> buckets_;
+    size_t size_;
+    Callback callback_;
+};
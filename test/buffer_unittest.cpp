@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include <string>
+#include <fcntl.h>
+#include <unistd.h>
 #include "buffer.h"  
+#include "buffer_pool.h"
 
 using namespace std;
 
@@ -76,6 +79,109 @@ TEST(BufferTest, InsideGrow) {
     EXPECT_EQ(buf.prependableBytes(), 8);
 }
 
+TEST(BufferTest, LazyStorage) {
+    Buffer buf(0);
+    EXPECT_FALSE(buf.hasStorage());
+    EXPECT_EQ(buf.readableBytes(), 0);
+    EXPECT_EQ(buf.writableBytes(), 0);
+
+    buf.append(string(100, 'x'));
+    EXPECT_TRUE(buf.hasStorage());
+    EXPECT_EQ(buf.retrieveAllToString(), string(100, 'x'));
+    buf.releaseStorage();
+    EXPECT_FALSE(buf.hasStorage());
+    EXPECT_EQ(buf.writableBytes(), 0);
+    EXPECT_EQ(buf.prependableBytes(), 8);
+}
+
+TEST(BufferTest, PoolReuse) {
+    BufferPool pool(64 * 1024);
+    Buffer buf(0);
+    buf.setPool(&pool);
+
+    buf.append(string(500, 'a'));
+    EXPECT_EQ(buf.capacity(), 1024);            // 最小级别
+    const char* first = buf.peek();
+    buf.retrieveAll();
+    buf.releaseStorage();
+    EXPECT_EQ(pool.getStats().retained_bytes, 1024);
+
+    buf.append(string(500, 'b'));               // 复用刚归还的存储
+    EXPECT_EQ(buf.peek(), first);
+    EXPECT_EQ(pool.getStats().hits, 1);
+
+    buf.retrieve(100);
+    buf.append(string(3000, 'c'));              // 升级至4KB, 旧存储归还缓冲池
+    EXPECT_EQ(buf.capacity(), 4096);
+    EXPECT_EQ(buf.readableBytes(), 3400);
+    EXPECT_EQ(buf.retrieveToString(400), string(400, 'b'));
+    EXPECT_EQ(buf.retrieveAllToString(), string(3000, 'c'));
+    EXPECT_EQ(pool.getStats().retained_bytes, 1024);
+
+    buf.releaseStorage();
+    EXPECT_EQ(pool.getStats().retained_bytes, 1024 + 4096);
+}
+
+// 超过最大级别后按倍数增长: 逐次追加至4MB, 重新分配存储的次数为对数级.
+TEST(BufferTest, PoolOversizeGrowsGeometrically) {
+    BufferPool pool(64 * 1024);
+    Buffer buf(0);
+    buf.setPool(&pool);
+    string chunk(1000, 'x');
+    size_t capacity = buf.capacity();
+    int n_grow = 0;
+    while (buf.readableBytes() < 4 * 1024 * 1024) {
+        buf.append(chunk);
+        if (buf.capacity() != capacity) {
+            capacity = buf.capacity();
+            ++n_grow;
+        }
+    }
+    EXPECT_LE(n_grow, 12);      // 4个级别 + 64KB至4MB约7次翻倍
+    EXPECT_LT(buf.capacity(), 16u * 1024 * 1024);
+}
+
+TEST(BufferTest, ReadFdScratch) {
+    int fds[2];
+    ASSERT_EQ(::pipe2(fds, O_NONBLOCK), 0);
+    string data(3000, 'r');
+    ASSERT_EQ(::write(fds[1], data.data(), data.size()), 3000);
+
+    Buffer buf(0);                              // 无存储时全部读入extrabuf再追加
+    char scratch[4096];
+    int err = 0;
+    EXPECT_EQ(buf.readFd(fds[0], &err, scratch, sizeof scratch), 3000);
+    EXPECT_EQ(buf.retrieveAllToString(), data);
+
+    EXPECT_EQ(buf.readFd(fds[0], &err, scratch, sizeof scratch), -1);   // 非阻塞, 已读空
+    EXPECT_EQ(err, EAGAIN);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(BufferTest, PoolCapacity) {
+    BufferPool pool(2048);
+    vector<vector<char>> storages;
+    for (int i = 0; i < 3; ++i) {
+        storages.push_back(pool.acquire(1000));
+    }
+    storages.push_back(pool.acquire(100 * 1024));   // 超过最大级别, 不经缓冲池
+    EXPECT_EQ(storages.back().size(), 100 * 1024);
+    for (auto& s : storages) {
+        pool.release(std::move(s));
+        EXPECT_TRUE(s.empty());
+    }
+    auto stats = pool.getStats();
+    EXPECT_EQ(stats.misses, 4);
+    EXPECT_EQ(stats.retained_bytes, 2048);          // 超出上限的部分直接释放
+    EXPECT_EQ(stats.drops, 2);
+
+    pool.setCapacity(1024);
+    EXPECT_EQ(pool.getStats().retained_bytes, 1024);
+    pool.setCapacity(0);
+    EXPECT_EQ(pool.getStats().retained_bytes, 0);
+}
+
 // TEST(BufferTest, Shrink)
 // {
 //     Buffer buf;
@@ -12,7 +12,7 @@ EventLoop* g_loop;
 
 // 测试Epoller的epoll功能以及channel的事件分发功能. 
 
-void timeout(Timestamp receive_time) {
+void timeout(MonoTimestamp receive_time) {
     printf("%s Timeout\n", receive_time.toFormattedString().c_str()); 
     g_loop->quit(); 
 }
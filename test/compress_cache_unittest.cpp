@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <zlib.h>
+
+#include "compress_cache.h"
+#include "http_message.h"
+
+using namespace std;
+
+/* CompressCache单元测试
+ *
+ * 1. 压缩结果可被zlib正确解压, 再次请求时命中;
+ * 2. 源文件ETag变化后视为未命中;
+ * 3. 超出总字节上限时按LRU淘汰;
+ * 4. Accept-Encoding解析.
+ */
+
+static string inflateAll(const string& data, int window_bits) {
+    z_stream stream {};
+    inflateInit2(&stream, window_bits);
+    string out(64 * 1024, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = out.size();
+    int ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    out.resize(ret == Z_STREAM_END ? stream.total_out : 0);
+    return out;
+}
+
+static string makeText(size_t len) {
+    string text;
+    while (text.size() < len) {
+        text += "body { margin: 0; padding: " + to_string(text.size() % 97) + "px; }\n";
+    }
+    text.resize(len);
+    return text;
+}
+
+
+TEST(CompressCacheTest, CompressAndHit) {
+    CompressCache cache(1024 * 1024);
+    string text = makeText(8192);
+    EXPECT_EQ(cache.get("/a.css", "gzip", "\"v1\""), nullptr);
+
+    auto gzip = cache.compress("/a.css", "gzip", "\"v1\"", text.data(), text.size());
+    ASSERT_NE(gzip, nullptr);
+    EXPECT_LT(gzip->data.size(), text.size());
+    EXPECT_EQ(inflateAll(gzip->data, 15 + 16), text);
+
+    auto deflate = cache.compress("/a.css", "deflate", "\"v1\"", text.data(), text.size());
+    ASSERT_NE(deflate, nullptr);
+    EXPECT_EQ(inflateAll(deflate->data, 15), text);
+
+    EXPECT_EQ(cache.get("/a.css", "gzip", "\"v1\""), gzip);
+    EXPECT_EQ(cache.get("/a.css", "gzip", "\"v2\""), nullptr);   // 源文件已变化
+    EXPECT_EQ(cache.compress("/a.css", "br", "\"v1\"", text.data(), text.size()), nullptr);
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.entries, 2u);
+    EXPECT_EQ(stats.bytes, gzip->data.size() + deflate->data.size());
+}
+
+TEST(CompressCacheTest, LruEviction) {
+    string text = makeText(8192);
+    string compressed;
+    ASSERT_TRUE(CompressCache::zlibCompress("gzip", text.data(), text.size(), &compressed));
+    CompressCache cache(compressed.size() * 2);
+    cache.compress("/a.css", "gzip", "\"a\"", text.data(), text.size());
+    cache.compress("/b.css", "gzip", "\"b\"", text.data(), text.size());
+    EXPECT_NE(cache.get("/a.css", "gzip", "\"a\""), nullptr);   // b成为最久未使用
+    cache.compress("/c.css", "gzip", "\"c\"", text.data(), text.size());
+    EXPECT_EQ(cache.get("/b.css", "gzip", "\"b\""), nullptr);
+    EXPECT_NE(cache.get("/a.css", "gzip", "\"a\""), nullptr);
+    EXPECT_NE(cache.get("/c.css", "gzip", "\"c\""), nullptr);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+}
+
+TEST(CompressCacheTest, ParseAcceptEncoding) {
+    AcceptedEncodings accepted = parseAcceptEncoding("gzip, deflate, br");
+    EXPECT_TRUE(accepted.gzip && accepted.deflate && accepted.br);
+
+    accepted = parseAcceptEncoding("br;q=0, gzip;q=0.5");
+    EXPECT_TRUE(accepted.gzip);
+    EXPECT_FALSE(accepted.br);
+    EXPECT_FALSE(accepted.deflate);
+
+    accepted = parseAcceptEncoding("*, gzip;q=0");
+    EXPECT_FALSE(accepted.gzip);
+    EXPECT_TRUE(accepted.br && accepted.deflate);
+
+    accepted = parseAcceptEncoding("identity");
+    EXPECT_FALSE(accepted.gzip || accepted.deflate || accepted.br);
+}
@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "channel.h"
+#include "epoller.h"
+#include "eventloop.h"
+
+using namespace std;
+
+/* Epoller暂存事件集修改的单元测试
+ *
+ * 以管道写端为channel: 其始终可写, 开启EPOLLOUT后下一次epoll_wait立即返回.
+ * 比较操作前后的epoll_ctl计数, 排除EventLoop自身wakeup/timer channel的注册.
+ */
+
+static Epoller::Stats diff(const Epoller::Stats& after, const Epoller::Stats& before) {
+    return Epoller::Stats{
+        after.ctl_add - before.ctl_add,
+        after.ctl_mod - before.ctl_mod,
+        after.ctl_del - before.ctl_del,
+        after.ctl_saved - before.ctl_saved,
+        after.syscalls - before.syscalls
+    };
+}
+
+class EpollerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(::pipe2(fds_, O_NONBLOCK | O_CLOEXEC), 0);
+    }
+    void TearDown() override {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+    }
+    int fds_[2];
+};
+
+// 同一轮内的多次修改合并为一次epoll_ctl(MOD).
+TEST_F(EpollerTest, CoalesceWithinIteration) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[1]);
+    Epoller::Stats before = loop.getPollerStats();
+
+    channel.enableReading();          // ADD
+    channel.enableWriting();          // 暂存
+    channel.disableWriting();         // 以下两次修改与之合并, 
+    channel.enableWriting();          // 下次epoll_wait前只提交一次MOD
+    int n_write_events = 0;
+    channel.setWriteCallback([&]() {
+        ++n_write_events;
+        channel.disableWriting();     // 暂存, 随后注销时丢弃
+        loop.quit();
+    });
+    loop.loop();
+    EXPECT_EQ(n_write_events, 1);
+
+    channel.disableAll();             // DEL
+    channel.removeFromEpoller();
+
+    Epoller::Stats stats = diff(loop.getPollerStats(), before);
+    EXPECT_EQ(stats.ctl_add, 1);
+    EXPECT_EQ(stats.ctl_mod, 1);
+    EXPECT_EQ(stats.ctl_del, 1);
+    EXPECT_EQ(stats.ctl_saved, 3);
+}
+
+// 同一轮内开启又关闭写事件, 不产生epoll_ctl(MOD).
+TEST_F(EpollerTest, ToggleWithinIterationCancels) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[1]);
+    channel.enableReading();
+    Epoller::Stats before = loop.getPollerStats();
+
+    channel.enableWriting();
+    channel.disableWriting();
+    loop.runAfter(chrono::milliseconds(1), [&]() { loop.quit(); });
+    loop.loop();                      // epoll_wait前提交时发现事件集未变化
+
+    Epoller::Stats stats = diff(loop.getPollerStats(), before);
+    EXPECT_EQ(stats.ctl_mod, 0);
+    EXPECT_EQ(stats.ctl_saved, 2);
+    channel.disableAll();
+    channel.removeFromEpoller();
+}
+
+// 边缘触发下EPOLLOUT始终注册, 开关写事件不调用epoll_ctl.
+TEST_F(EpollerTest, EdgeTriggeredKeepsWriteRegistered) {
+    EventLoop loop;
+    Channel channel(&loop, fds_[1]);
+    channel.setEdgeTriggered(true);
+    Epoller::Stats before = loop.getPollerStats();
+
+    channel.enableReading();
+    EXPECT_TRUE(channel.getRegisteredEvents() & EPOLLOUT);
+    for (int i = 0; i < 10; ++i) {
+        channel.enableWriting();
+        channel.disableWriting();
+    }
+    channel.disableAll();
+    channel.removeFromEpoller();
+
+    Epoller::Stats stats = diff(loop.getPollerStats(), before);
+    EXPECT_EQ(stats.ctl_add, 1);
+    EXPECT_EQ(stats.ctl_mod, 0);
+    EXPECT_EQ(stats.ctl_del, 1);
+    EXPECT_EQ(stats.ctl_saved, 20);
+}
+
+/* IoUringPoller的单元测试, 内核不支持io_uring时跳过. */
+
+class IoUringPollerTest : public EpollerTest {
+protected:
+    void SetUp() override {
+        EpollerTest::SetUp();
+        loop_ = make_unique<EventLoop>(Poller::Backend::IO_URING);
+        if (loop_->getPollerBackend() != Poller::Backend::IO_URING) {
+            GTEST_SKIP() << "io_uring unavailable";
+        }
+    }
+    void TearDown() override {
+        loop_.reset();
+        EpollerTest::TearDown();
+    }
+    unique_ptr<EventLoop> loop_;
+};
+
+// 水平触发: 数据未读完时每轮都报告可读.
+TEST_F(IoUringPollerTest, LevelTriggeredRedelivers) {
+    EventLoop& loop = *loop_;
+    Channel channel(&loop, fds_[0]);
+    ASSERT_EQ(::write(fds_[1], "x", 1), 1);
+    int n_read_events = 0;
+    channel.setReadCallback([&](MonoTimestamp) {
+        if (++n_read_events == 3) {
+            loop.quit();
+        }
+    });
+    channel.enableReading();
+    loop.loop();
+    EXPECT_EQ(n_read_events, 3);
+    channel.disableAll();
+    channel.removeFromEpoller();
+}
+
+// 边缘触发: 不读取数据时只报告一次, 新数据到达后再次报告.
+TEST_F(IoUringPollerTest, EdgeTriggeredDeliversOnce) {
+    EventLoop& loop = *loop_;
+    Channel channel(&loop, fds_[0]);
+    channel.setEdgeTriggered(true);
+    ASSERT_EQ(::write(fds_[1], "x", 1), 1);
+    int n_read_events = 0;
+    bool written = false;
+    bool redelivered = false;   // 新数据写入之前再次报告
+    channel.setReadCallback([&](MonoTimestamp) {
+        if (++n_read_events == 1) {
+            // 不读取数据, 稍后写入新数据; 在此之前不应再次报告.
+            loop.runAfter(chrono::milliseconds(20), [&]() {
+                written = true;
+                ASSERT_EQ(::write(fds_[1], "y", 1), 1);
+            });
+        } else {
+            redelivered = !written;
+            loop.quit();
+        }
+    });
+    channel.enableReading();
+    loop.runAfter(chrono::seconds(2), [&]() { loop.quit(); });   // 未收到第二次事件时退出
+    loop.loop();
+    EXPECT_FALSE(redelivered);
+    EXPECT_EQ(n_read_events, 2);
+    channel.disableAll();
+    channel.removeFromEpoller();
+}
+
+// 注销后不再报告事件.
+TEST_F(IoUringPollerTest, RemoveStopsEvents) {
+    EventLoop& loop = *loop_;
+    Channel channel(&loop, fds_[0]);
+    ASSERT_EQ(::write(fds_[1], "x", 1), 1);
+    int n_read_events = 0;
+    channel.setReadCallback([&](MonoTimestamp) {
+        ++n_read_events;
+        channel.disableAll();
+        channel.removeFromEpoller();
+    });
+    channel.enableReading();
+    loop.runAfter(chrono::milliseconds(20), [&]() { loop.quit(); });
+    loop.loop();
+    EXPECT_EQ(n_read_events, 1);
+    EXPECT_FALSE(loop.hasChannel(&channel));
+}
+
+// poll请求仍在内核中时disableAll(未removeChannel), 随后对端关闭产生的POLLHUP不再报告.
+TEST_F(IoUringPollerTest, DetachedChannelIgnoresHangup) {
+    EventLoop& loop = *loop_;
+    Channel channel(&loop, fds_[0]);
+    int n_events = 0;
+    channel.setReadCallback([&](MonoTimestamp) { ++n_events; });
+    channel.setCloseCallback([&]() { ++n_events; });
+    channel.enableReading();
+    loop.runAfter(chrono::milliseconds(5), [&]() {
+        channel.disableAll();
+        ::close(fds_[1]);
+        fds_[1] = ::open("/dev/null", O_WRONLY | O_CLOEXEC);   // 供TearDown关闭
+    });
+    loop.runAfter(chrono::milliseconds(25), [&]() { loop.quit(); });
+    loop.loop();
+    EXPECT_EQ(n_events, 0);
+    channel.removeFromEpoller();
+}
+
+// 注册、修改与等待合并提交: 每轮仅一次io_uring_enter.
+TEST_F(IoUringPollerTest, OneSyscallPerIteration) {
+    EventLoop& loop = *loop_;
+    Channel channel(&loop, fds_[1]);
+    Poller::Stats before = loop.getPollerStats();
+    int n_iterations = 0;
+    channel.setWriteCallback([&]() {
+        channel.disableWriting();     // 与下次enableWriting在同一轮提交前合并
+        channel.enableWriting();
+        if (++n_iterations == 10) {
+            loop.quit();
+        }
+    });
+    channel.enableWriting();
+    loop.loop();
+
+    Poller::Stats stats = diff(loop.getPollerStats(), before);
+    EXPECT_EQ(n_iterations, 10);
+    EXPECT_EQ(stats.syscalls, 10);
+    channel.disableAll();
+    channel.removeFromEpoller();
+}
+
+/* EventLoop自适应自旋的单元测试: 比较Poller系统调用次数与各时间计数. */
+
+// 有活动后的自旋窗口内以零超时轮询, 系统调用次数远多于事件数; 窗口过后恢复阻塞.
+TEST(EventLoopSpinTest, SpinsAfterActivity) {
+    EventLoop loop;
+    loop.setSpinDuration(chrono::milliseconds(20));
+    Poller::Stats before = loop.getPollerStats();
+    loop.runAfter(chrono::milliseconds(1), []() {});
+    // 窗口之后留出足够时间, 调度延迟不至于吞掉阻塞等待的阶段.
+    loop.runAfter(chrono::milliseconds(300), [&]() { loop.quit(); });
+    loop.loop();
+
+    // 只比较各阶段的关系, 不假设IO线程按时获得CPU.
+    EventLoop::LoadStats stats = loop.getLoadStats();
+    EXPECT_GT(loop.getPollerStats().syscalls - before.syscalls, 20u);   // 事件只有3个(唤醒与两次定时器)
+    EXPECT_GT(stats.spin_us, 0u);
+    EXPECT_GT(stats.idle_us, 0u);     // 窗口过后恢复阻塞等待
+}
+
+// 默认不自旋: 只在事件到达时返回.
+TEST(EventLoopSpinTest, BlocksByDefault) {
+    EventLoop loop;
+    Poller::Stats before = loop.getPollerStats();
+    loop.runAfter(chrono::milliseconds(1), []() {});
+    loop.runAfter(chrono::milliseconds(30), [&]() { loop.quit(); });
+    loop.loop();
+
+    EventLoop::LoadStats stats = loop.getLoadStats();
+    EXPECT_LE(loop.getPollerStats().syscalls - before.syscalls, 6u);
+    EXPECT_EQ(stats.spin_us, 0u);
+    EXPECT_GE(stats.idle_us, 25000u);
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "file_cache.h"
+
+using namespace std;
+
+/* FileCache单元测试
+ *
+ * 1. 加载后命中, 内容与文件一致;
+ * 2. 超出单文件上限时不缓存;
+ * 3. 超出总字节上限时按LRU淘汰;
+ * 4. 文件被修改后失效, 重新加载;
+ * 5. 关联文件不存在的结果在缓存项重新校验前有效.
+ */
+
+class FileCacheFixture : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/file_cache_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+    }
+
+    void TearDown() override {
+        for (auto& f : files_) {
+            ::unlink(f.c_str());
+        }
+        ::rmdir(dir_.c_str());
+    }
+
+    string writeFile(const string& name, const string& content) {
+        string path = dir_ + "/" + name;
+        FILE* fp = fopen(path.c_str(), "w");
+        fwrite(content.data(), 1, content.size(), fp);
+        fclose(fp);
+        files_.push_back(path);
+        return path;
+    }
+
+    FileCache::EntryPtr load(FileCache& cache, const string& key, const string& path) {
+        struct stat st {};
+        stat(path.c_str(), &st);
+        return cache.load(key, path, st);
+    }
+
+    string dir_;
+    vector<string> files_;
+};
+
+
+TEST_F(FileCacheFixture, HitAfterLoad) {
+    FileCache cache(1024, 1024);
+    string path = writeFile("a.html", "<html>hello</html>");
+    EXPECT_EQ(cache.get("/a.html"), nullptr);
+
+    auto entry = load(cache, "/a.html", path);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->content_type, "text/html");
+    EXPECT_EQ(string(entry->data(), entry->size), "<html>hello</html>");
+
+    auto hit = cache.get("/a.html");
+    EXPECT_EQ(hit, entry);
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_EQ(stats.bytes, entry->size);
+}
+
+TEST_F(FileCacheFixture, TooLarge) {
+    FileCache cache(1024, 8);
+    string path = writeFile("big.txt", string(16, 'x'));
+    EXPECT_FALSE(cache.cacheable(16));
+    EXPECT_EQ(load(cache, "/big.txt", path), nullptr);
+    EXPECT_EQ(cache.getStats().entries, 0u);
+}
+
+TEST_F(FileCacheFixture, LruEviction) {
+    FileCache cache(30, 30);
+    string a = writeFile("a.txt", string(10, 'a'));
+    string b = writeFile("b.txt", string(10, 'b'));
+    string c = writeFile("c.txt", string(10, 'c'));
+    string d = writeFile("d.txt", string(10, 'd'));
+    load(cache, "/a.txt", a);
+    load(cache, "/b.txt", b);
+    auto evicted = load(cache, "/c.txt", c);   // 持有将被淘汰的c.
+    EXPECT_NE(cache.get("/a.txt"), nullptr);
+    EXPECT_NE(cache.get("/b.txt"), nullptr);   // a, b变为最近使用, c成为最久未使用.
+
+    load(cache, "/d.txt", d);                  // 淘汰c.
+    uint64_t misses = cache.getStats().misses;
+    EXPECT_EQ(cache.get("/c.txt"), nullptr);
+    EXPECT_EQ(cache.getStats().misses, misses + 1);
+    EXPECT_NE(cache.get("/a.txt"), nullptr);
+    EXPECT_NE(cache.get("/b.txt"), nullptr);
+    EXPECT_NE(cache.get("/d.txt"), nullptr);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+    EXPECT_EQ(cache.getStats().bytes, 30u);
+    // 被淘汰的项仍被持有时, 其映射内容可安全访问.
+    ASSERT_NE(evicted, nullptr);
+    EXPECT_EQ(string(evicted->data(), evicted->size), string(10, 'c'));
+}
+
+TEST_F(FileCacheFixture, Invalidation) {
+    FileCache cache(1024, 1024, Timestamp::Duration(0));   // 每次命中都校验
+    string path = writeFile("a.txt", "version1");
+    load(cache, "/a.txt", path);
+    EXPECT_NE(cache.get("/a.txt"), nullptr);
+
+    writeFile("a.txt", "version22");
+    EXPECT_EQ(cache.get("/a.txt"), nullptr);
+    EXPECT_EQ(cache.getStats().invalidations, 1u);
+
+    auto entry = load(cache, "/a.txt", path);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(string(entry->data(), entry->size), "version22");
+
+    ::unlink(path.c_str());
+    EXPECT_EQ(cache.get("/a.txt"), nullptr);
+}
+
+TEST_F(FileCacheFixture, SiblingMissingUntilRevalidate) {
+    FileCache cache(1024, 1024, Timestamp::Duration(0));   // 每次命中都校验
+    string path = writeFile("a.js", "var a;");
+    auto entry = load(cache, "/a.js", path);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_FALSE(entry->siblingMissing(0));
+    entry->setSiblingMissing(0);
+    EXPECT_TRUE(entry->siblingMissing(0));
+    EXPECT_FALSE(entry->siblingMissing(1));
+
+    // 重新校验后否定结果不再有效, 须重新查找.
+    ::usleep(10);
+    EXPECT_EQ(cache.get("/a.js"), entry);
+    EXPECT_FALSE(entry->siblingMissing(0));
+}
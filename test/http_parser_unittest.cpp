@@ -1,6 +1,7 @@
 #include <cstddef>
 #include <gtest/gtest.h> 
 
+#include "delimiter_scanner.h"
 #include "http_parser.h"
 #include "http_message.h"
 
@@ -217,3 +218,263 @@ TEST_F(RequestFixture, TestReuse) {
     EXPECT_EQ(parser.encode(), text4);
 }
 
+
+// 零拷贝模式: 每次均从请求起始处传入, 字段以视图引用输入数据.
+TEST(ZeroCopyTest, PartialAndPipelined) {
+    using Result = HttpParser::ParseResult;
+    HttpParser parser(true); 
+    EXPECT_TRUE(parser.isZeroCopy()); 
+
+    const string text = 
+        "POST /upload HTTP/1.1\r\n"
+        "Host: 127.0.0.1\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "Hello"
+        "GET /index.html HTTP/1.0\r\n"
+        "Connection: Keep-Alive\r\n"
+        "\r\n"; 
+    const size_t first_len = text.find("GET"); 
+
+    // 逐字节增加可读数据, 模拟分包; 数据在每次调用间被移动到新地址.
+    size_t consumed = 0; 
+    Result ret = Result::AGAIN; 
+    string moved; 
+    for (size_t n = 1; n <= first_len && ret == Result::AGAIN; ++n) {
+        moved.assign(text.data(), n); 
+        ret = parser.parse(moved.data(), moved.size(), consumed); 
+        EXPECT_LE(consumed, n); 
+    }
+    ASSERT_EQ(ret, Result::SUCCESS); 
+    EXPECT_EQ(consumed, first_len); 
+    EXPECT_TRUE(parser.getMethodView() == "POST"); 
+    EXPECT_TRUE(parser.getUriView() == "/upload"); 
+    EXPECT_TRUE(parser.getVersionView() == "HTTP/1.1"); 
+    EXPECT_TRUE(parser.getHeaderView("host") == "127.0.0.1"); 
+    EXPECT_EQ(parser.getHeaderView("Range").data, nullptr); 
+    EXPECT_TRUE(parser.getBodyView() == "Hello"); 
+    EXPECT_EQ(parser.encode(), text.substr(0, first_len)); 
+    // 视图直接指向输入数据
+    EXPECT_EQ(parser.getUriView().data, moved.data() + 5); 
+    EXPECT_TRUE(parser.isKeepAlive()); 
+
+    // pipelining: 丢弃第一个请求后, 解析缓冲区中的下一个请求.
+    const char* second = text.data() + first_len; 
+    ret = parser.parse(second, text.size() - first_len, consumed); 
+    ASSERT_EQ(ret, Result::SUCCESS); 
+    EXPECT_EQ(consumed, text.size() - first_len); 
+    EXPECT_TRUE(parser.getMethodView() == "GET"); 
+    EXPECT_TRUE(parser.getVersionView() == "HTTP/1.0"); 
+    EXPECT_TRUE(parser.getHeaderView("Connection") == "Keep-Alive"); 
+    EXPECT_EQ(parser.getBodyView().len, 0u); 
+    EXPECT_TRUE(parser.isKeepAlive()); 
+
+    // 非法的Content-Length视为错误请求.
+    const char* bad = "GET / HTTP/1.1\r\nContent-Length: 12x\r\n\r\n"; 
+    EXPECT_EQ(parser.parse(bad, strlen(bad), consumed), Result::ERROR); 
+}
+
+
+// 各SIMD实现与标量实现的结果一致.
+TEST(ScanTest, AllLevelsAgree) {
+    ScanLevel saved = getScanLevel(); 
+    string data(256, 'a'); 
+    const char specials[] = { ' ', ':', '\r', '\n', '\t', '\0', '\x7f', '\x1f' }; 
+    const char normals[] = { '\x20', '\x7e', '\x80', '\xff', '/', 'z' }; 
+    unsigned seed = 12345; 
+    for (int level = 0; level <= static_cast<int>(detectScanLevel()); ++level) {
+        ASSERT_TRUE(setScanLevel(static_cast<ScanLevel>(level))); 
+        for (int round = 0; round < 200; ++round) {
+            for (auto& c : data) {
+                seed = seed * 1103515245 + 12345; 
+                c = (seed >> 16) % 40 == 0 ? specials[(seed >> 8) % sizeof(specials)] 
+                                           : normals[(seed >> 8) % sizeof(normals)]; 
+            }
+            for (size_t begin = 0; begin < 40; ++begin) {
+                for (char delim : { ' ', ':', '\r' }) {
+                    const char* p = data.data() + begin; 
+                    const char* end = data.data() + data.size() - round % 33; 
+                    const char* expected = p; 
+                    while (expected != end && *expected != delim && 
+                           static_cast<unsigned char>(*expected) >= 0x20 && *expected != '\x7f') {
+                        ++expected; 
+                    }
+                    ASSERT_EQ(scanDelimiter(p, end, delim), expected) << getScanLevelName(getScanLevel()); 
+                }
+            }
+        }
+    }
+    setScanLevel(saved); 
+}
+
+// 批量扫描与逐字节解析结果一致, 包括任意位置分包与控制字符校验.
+TEST(ScanTest, FastScanMatchesStateMachine) {
+    using Result = HttpParser::ParseResult;
+    const string text = 
+        "GET /static/js/app.min.js?v=20240101 HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0 Safari/537.36\r\n"
+        "Accept: */*\r\n"
+        "X-Tab: a\tb\r\n"
+        "\r\n"; 
+    for (bool fast : { false, true }) {
+        HttpParser::setFastScan(fast); 
+        for (size_t split = 1; split < text.size(); ++split) {
+            HttpParser parser(true); 
+            size_t consumed = 0; 
+            ASSERT_EQ(parser.parse(text.data(), split, consumed), Result::AGAIN); 
+            ASSERT_EQ(parser.parse(text.data(), text.size(), consumed), Result::SUCCESS); 
+            EXPECT_EQ(consumed, text.size()); 
+            EXPECT_EQ(parser.encode(), text); 
+        }
+        HttpParser parser; 
+        size_t consumed = 0; 
+        EXPECT_EQ(parser.parse(text.data(), text.size(), consumed), Result::SUCCESS); 
+        EXPECT_EQ(string(parser.getHeader("x-tab")->c_str()), "a\tb"); 
+
+        const char* bad[] = {
+            "GET /a\x01b HTTP/1.1\r\n\r\n", 
+            "GET /a\nHTTP/1.1\r\n\r\n", 
+            "GET / HTTP/1.1\r\nHo\x7fst: x\r\n\r\n", 
+            "GET / HTTP/1.1\r\nHost: x\x00y\r\n\r\n", 
+            // 方法与头部名称须为token(RFC 9110 tchar)
+            "GET / HTTP/1.1\r\nFoo Bar: x\r\n\r\n", 
+            "GET / HTTP/1.1\r\nFoo(: x\r\n\r\n", 
+            "GET / HTTP/1.1\r\nFoo : x\r\n\r\n", 
+            "GET / HTTP/1.1\r\n: x\r\n\r\n", 
+            "G\xc3\x89T / HTTP/1.1\r\n\r\n", 
+            "GE\"T / HTTP/1.1\r\n\r\n", 
+        }; 
+        const size_t bad_len[] = { 21, 19, 28, 29, 30, 27, 27, 23, 19, 19 }; 
+        for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+            HttpParser p; 
+            EXPECT_EQ(p.parse(bad[i], bad_len[i], consumed), Result::ERROR) << i << " fast=" << fast; 
+        }
+        // 头部名称超长
+        string long_name = "GET / HTTP/1.1\r\n" + string(200, 'x') + ": v\r\n\r\n"; 
+        HttpParser p; 
+        EXPECT_EQ(p.parse(long_name.data(), long_name.size(), consumed), Result::ERROR); 
+    }
+    HttpParser::setFastScan(true); 
+}
+
+
+
+// 测试Range头部解析
+TEST(RangeTest, ParseRange) {
+    vector<ByteRange> ranges; 
+    EXPECT_EQ(parseRange("bytes=0-499", 1000, &ranges), RangeResult::SATISFIABLE); 
+    ASSERT_EQ(ranges.size(), 1u); 
+    EXPECT_EQ(ranges[0].first, 0u); 
+    EXPECT_EQ(ranges[0].last, 499u); 
+
+    // 按起始位置排序
+    EXPECT_EQ(parseRange("bytes=-100, 0-99", 1000, &ranges), RangeResult::SATISFIABLE); 
+    ASSERT_EQ(ranges.size(), 2u); 
+    EXPECT_EQ(ranges[0].first, 0u); 
+    EXPECT_EQ(ranges[0].last, 99u); 
+    EXPECT_EQ(ranges[1].first, 900u); 
+    EXPECT_EQ(ranges[1].length(), 100u); 
+
+    // 重叠与相邻的区间合并, 只剩一个区间时按单区间响应
+    EXPECT_EQ(parseRange("bytes=500-, -100", 1000, &ranges), RangeResult::SATISFIABLE); 
+    ASSERT_EQ(ranges.size(), 1u); 
+    EXPECT_EQ(ranges[0].first, 500u); 
+    EXPECT_EQ(ranges[0].last, 999u); 
+    EXPECT_EQ(parseRange("bytes=200-299, 0-99, 100-149, 300-310, 400-", 1000, &ranges), RangeResult::SATISFIABLE); 
+    ASSERT_EQ(ranges.size(), 3u); 
+    EXPECT_EQ(ranges[0].first, 0u); 
+    EXPECT_EQ(ranges[0].last, 149u); 
+    EXPECT_EQ(ranges[1].first, 200u); 
+    EXPECT_EQ(ranges[1].last, 310u); 
+    EXPECT_EQ(ranges[2].first, 400u); 
+    EXPECT_EQ(ranges[2].last, 999u); 
+
+    // 请求总量超过文件大小时忽略Range
+    EXPECT_EQ(parseRange("bytes=0-599, 400-999", 1000, &ranges), RangeResult::NONE); 
+    EXPECT_TRUE(ranges.empty()); 
+    EXPECT_EQ(parseRange("bytes=0-, 0-, 0-", 1000, &ranges), RangeResult::NONE); 
+
+    EXPECT_EQ(parseRange("bytes=900-2000", 1000, &ranges), RangeResult::SATISFIABLE); 
+    EXPECT_EQ(ranges[0].last, 999u); 
+    EXPECT_EQ(parseRange("bytes=-5000", 1000, &ranges), RangeResult::SATISFIABLE); 
+    EXPECT_EQ(ranges[0].first, 0u); 
+
+    EXPECT_EQ(parseRange("bytes=1000-", 1000, &ranges), RangeResult::UNSATISFIABLE); 
+    EXPECT_EQ(parseRange("bytes=0-1", 0, &ranges), RangeResult::UNSATISFIABLE); 
+
+    EXPECT_EQ(parseRange("items=0-1", 1000, &ranges), RangeResult::NONE); 
+    EXPECT_EQ(parseRange("bytes=5-1", 1000, &ranges), RangeResult::NONE); 
+    EXPECT_EQ(parseRange("bytes=abc", 1000, &ranges), RangeResult::NONE); 
+    EXPECT_EQ(parseRange("bytes=", 1000, &ranges), RangeResult::NONE); 
+
+    char buf[kMaxContentRangeLen]; 
+    ByteRange r{ 0, UINT64_MAX - 1 }; 
+    EXPECT_EQ(string(buf, formatContentRange(buf, &r, UINT64_MAX)), 
+              "bytes 0-18446744073709551614/18446744073709551615"); 
+    EXPECT_EQ(string(buf, formatContentRange(buf, nullptr, 1000)), "bytes */1000"); 
+}
+
+
+// 测试条件请求所用的校验器
+TEST(ValidatorTest, ETagAndHttpDate) {
+    struct timespec mtime {}; 
+    mtime.tv_sec = 784111777; 
+    string etag = makeETag(0x1234, 100, mtime); 
+    EXPECT_EQ(etag.front(), '"'); 
+    EXPECT_EQ(etag.back(), '"'); 
+    EXPECT_TRUE(matchETag(etag, etag)); 
+    EXPECT_TRUE(matchETag("\"abc\", W/" + etag, etag)); 
+    EXPECT_TRUE(matchETag("*", etag)); 
+    EXPECT_FALSE(matchETag("\"abc\"", etag)); 
+    mtime.tv_nsec = 1; 
+    EXPECT_NE(makeETag(0x1234, 100, mtime), etag); 
+
+    EXPECT_EQ(formatHttpDate(784111777), "Sun, 06 Nov 1994 08:49:37 GMT"); 
+    time_t t = 0; 
+    EXPECT_TRUE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", &t)); 
+    EXPECT_EQ(t, 784111777); 
+    EXPECT_TRUE(parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", &t)); 
+    EXPECT_EQ(t, 784111777); 
+    EXPECT_TRUE(parseHttpDate("Sun Nov  6 08:49:37 1994", &t)); 
+    EXPECT_EQ(t, 784111777); 
+    EXPECT_FALSE(parseHttpDate("yesterday", &t)); 
+
+    EXPECT_EQ(getFileSuffix("/css/style.css"), ".css"); 
+    EXPECT_EQ(getFileSuffix("/a.dir/README"), ""); 
+}
+
+
+// 测试Response的编码与复用
+TEST(ResponseTest, EncodeAndReuse) {
+    HttpResponse response; 
+    response.setVersion("HTTP/1.1"); 
+    response.setStatus(HttpStatusCode::OK); 
+    response.addHeader("Content-Type", "text/plain"); 
+    response.addHeader("Content-Length", size_t(12)); 
+    response.setBody("Hello World!", 12); 
+    EXPECT_EQ(response.encode(), 
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 12\r\n"
+        "\r\n"
+        "Hello World!"); 
+
+    struct iovec vecs[8]; 
+    EXPECT_EQ(response.encode(vecs, 8), 4); 
+
+    response.clear(); 
+    response.setVersion("HTTP/1.0"); 
+    response.setStatus(HttpStatusCode::NotModified); 
+    response.addHeader("Content-Length", uint64_t(0)); 
+    response.addHeader("Content-Type", "text/html"); 
+    response.setHeader("content-length", "7"); 
+    EXPECT_EQ(response.encode(), 
+        "HTTP/1.0 304 Not Modified\r\n"
+        "Content-Type: text/html\r\n"
+        "content-length: 7\r\n"
+        "\r\n"); 
+
+    HeaderView date = getCachedHttpDate(); 
+    EXPECT_EQ(string(date.data, date.len).size(), strlen("Sun, 06 Nov 1994 08:49:37 GMT")); 
+}
@@ -29,11 +29,12 @@ using namespace std;
  * 5. HTTP1.1 GET/HEAD, 文件不存在, 404
  * 6. HTTP1.1 请求错误, 400 
  * 6. HTTP1.1 未实现方法, 501 (项目里只实现了GET与HEAD, 其余方法均响应501)
+ * 7. HTTP1.1 流水线: 一次写入多个请求, 响应按请求顺序返回
  */
 
 class Client {
 public:
-    Client(string ip, uint16_t port) :addr_(ip, port), sockfd(-1) {
+    Client(string ip, uint16_t port) :addr_(ip, port), sockfd(-1), has_date(false) {
         buffer = make_unique<char[]>(BUF_SIZE); 
         if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
             ADD_FAILURE() << "Client sockfd failed"; 
@@ -63,8 +64,43 @@ public:
         }
         buffer[n_read] = '\0'; 
         end = n_read;
+        // Date头部随时间变化, 检查其存在后移除, 以便与预期报文逐字节比较.
+        char* date = n_read > 0 ? strstr(buffer.get(), "\r\nDate: ") : nullptr; 
+        if (date) {
+            char* line_end = strstr(date + 2, "\r\n"); 
+            memmove(date, line_end, buffer.get() + end + 1 - line_end); 
+            end -= line_end - date; 
+            has_date = true; 
+        } else {
+            has_date = false; 
+        }
     }
 
+    // 读取直至对端关闭连接, 移除其中全部Date头部, 返回移除的个数.
+    int readUntilClose() {
+        if (sockfd == -1)  ADD_FAILURE() << "readUntilClose: invalid sockfd";
+        end = 0; 
+        int n_read; 
+        while ((n_read = ::read(sockfd, buffer.get() + end, BUF_SIZE - 1 - end)) > 0) {
+            end += n_read; 
+        }
+        if (n_read < 0) {
+            ADD_FAILURE() << "Client read failed"; 
+        }
+        buffer[end] = '\0'; 
+        int n_date = 0; 
+        char* date; 
+        while ((date = strstr(buffer.get(), "\r\nDate: ")) != nullptr) {
+            char* line_end = strstr(date + 2, "\r\n"); 
+            memmove(date, line_end, buffer.get() + end + 1 - line_end); 
+            end -= line_end - date; 
+            ++n_date; 
+        }
+        return n_date; 
+    }
+
+    bool hasDate() const { return has_date; }
+
     string getResponseAsString() {
         return buffer.get();
     }
@@ -79,6 +115,7 @@ private:
     unique_ptr<char[]> buffer; 
     int end; 
     int sockfd; 
+    bool has_date; 
 };
 
 
@@ -311,11 +348,13 @@ TEST(HttpServer, Test_11_GET_benchmark) {
     client.read(); 
     string resp = client.getResponseAsString();
     EXPECT_EQ(resp, expect_response) << resp; 
+    EXPECT_TRUE(client.hasDate()); 
 
     client.send(request, strlen(request)); 
     client.read(); 
     resp = client.getResponseAsString();
     EXPECT_EQ(resp, expect_response) << resp; 
+    EXPECT_TRUE(client.hasDate()); 
 }
 
 
@@ -656,6 +695,45 @@ TEST(HttpServer, Test_11_GET_501) {
     EXPECT_EQ(resp, expect_response) << request;
 }
 
+// 测试HTTP1.1流水线: 一次写入GET、HEAD、404、501与最后的Connection: close请求, 
+// 响应须按请求顺序依次返回, 且在最后一个响应之后关闭连接.
+TEST(HttpServer, Test_11_pipelined) {
+    Client client("localhost", 8080);
+    string version = "HTTP/1.1";
+    string request = 
+        "GET /benchmark HTTP/1.1\r\n\r\n"
+        "HEAD /benchmark HTTP/1.1\r\n\r\n"
+        + makeRequest("/ABD_NOT_EXIST.txt", HttpMethod::GET, version, true)
+        + "POST /test.txt HTTP/1.1\r\n\r\n"
+        + makeRequest("/benchmark", HttpMethod::GET, version, false); 
+    const char* benchmark_head = 
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 12\r\n"
+        "\r\n"; 
+    vector<char> expect_response; 
+    auto append = [&expect_response](const vector<char>& part) {
+        expect_response.insert(expect_response.end(), part.begin(), part.end()); 
+    }; 
+    append(vector<char>(benchmark_head, benchmark_head + strlen(benchmark_head))); 
+    append({ 'H', 'e', 'l', 'l', 'o', ' ', 'W', 'o', 'r', 'l', 'd', '!' }); 
+    append(vector<char>(benchmark_head, benchmark_head + strlen(benchmark_head))); 
+    append(makeReponse("/ABD_NOT_EXIST.txt", HttpMethod::GET, version, true)); 
+    append(makeReponse("/test.txt", HttpMethod::UNKNOWN, version, true)); 
+    const char* close_response = 
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 12\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "Hello World!"; 
+    append(vector<char>(close_response, close_response + strlen(close_response))); 
+
+    client.send(request.c_str(), request.length()); 
+    EXPECT_EQ(client.readUntilClose(), 5);   // 每个响应各有一个Date头部
+    EXPECT_EQ(client.getResponseAsBin(), expect_response) << client.getResponseAsString(); 
+}
+
 
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
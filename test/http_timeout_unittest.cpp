@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "config.h"
+#include "http_connection.h"
+#include "http_server.h"
+#include "inet_address.h"
+
+using namespace std;
+
+/* HttpConnection分阶段超时的单元测试
+ *
+ * 在单独线程中启动超时较短的HttpServer, 客户端模拟各类慢速连接:
+ * 1. 建立连接后不发送数据, 在首字节超时内被断开.
+ * 2. slowloris: 逐字节发送请求头部, 收到数据不延长头部期限, 在头部超时内被断开.
+ * 3. keep-alive: 间隔短于超时的请求均得到响应, 其后空闲时被断开.
+ * 4. 请求大文件而不读取响应, 响应发送速率低于下限时被断开.
+ * 并检查各阶段因超时断开的计数.
+ */
+
+static const uint16_t kPort = 9191;
+static const char* kRootPath = "/tmp";
+static const char* kBigFile = "/http_timeout_unittest.bin";
+static const size_t kBigFileBytes = 32 * 1024 * 1024;   // 超过FileCache单个文件上限, 以sendfile发送
+
+class HttpTimeoutEnvironment : public ::testing::Environment {
+public:
+    void SetUp() override {
+        FILE* file = ::fopen((string(kRootPath) + kBigFile).c_str(), "w");
+        ASSERT_NE(file, nullptr);
+        ::ftruncate(::fileno(file), kBigFileBytes);
+        ::fclose(file);
+        std::thread t(&HttpTimeoutEnvironment::runServer);
+        std::this_thread::sleep_for(chrono::milliseconds(500));  // 等待服务器启动
+        t.detach();
+    }
+
+    void TearDown() override {
+        ::unlink((string(kRootPath) + kBigFile).c_str());
+    }
+
+    static void runServer() {
+        Config config;
+        config.port = kPort;
+        config.num_thread = 1;
+        config.log_enable = false;
+        config.root_path_ = kRootPath;
+        config.first_byte_timeout_seconds_ = 1;
+        config.header_timeout_seconds_ = 2;
+        config.timeout_seconds_ = 2;
+        HttpServer server(config);
+        server.start();
+    }
+};
+
+static int connectServer(int rcvbuf = 0) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (rcvbuf > 0) {
+        ::setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    InetAddress addr("127.0.0.1", kPort);
+    EXPECT_EQ(::connect(sockfd, addr.getSockAddr(), addr.getAddrLen()), 0);
+    return sockfd;
+}
+
+static int64_t elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// 读取至对端关闭, 返回耗时(毫秒). 超过limit_ms仍未关闭时返回-1.
+static int64_t waitClosed(int sockfd, int limit_ms) {
+    auto start = chrono::steady_clock::now();
+    char buf[4096];
+    while (elapsedMs(start) < limit_ms) {
+        struct pollfd pfd = { sockfd, POLLIN, 0 };
+        if (::poll(&pfd, 1, 50) > 0 && ::read(sockfd, buf, sizeof(buf)) <= 0) {
+            return elapsedMs(start);
+        }
+    }
+    return -1;
+}
+
+// 发送请求并读取一个完整的响应(/benchmark), 返回是否成功.
+static bool request(int sockfd) {
+    const char req[] = "GET /benchmark HTTP/1.1\r\n\r\n";
+    if (::send(sockfd, req, sizeof(req) - 1, MSG_NOSIGNAL) < 0) {
+        return false;
+    }
+    string response;
+    char buf[4096];
+    while (response.find("Hello World!") == string::npos) {
+        struct pollfd pfd = { sockfd, POLLIN, 0 };
+        if (::poll(&pfd, 1, 1000) <= 0) {
+            return false;
+        }
+        ssize_t n = ::read(sockfd, buf, sizeof(buf));
+        if (n <= 0) {
+            return false;
+        }
+        response.append(buf, n);
+    }
+    return true;
+}
+
+TEST(HttpTimeoutTest, FirstByte) {
+    uint64_t before = HttpConnection::getEvictions(HttpConnection::kFirstByte);
+    int sockfd = connectServer();
+    int64_t elapsed = waitClosed(sockfd, 3000);
+    EXPECT_GE(elapsed, 0);
+    EXPECT_LE(elapsed, 1500);
+    EXPECT_EQ(HttpConnection::getEvictions(HttpConnection::kFirstByte), before + 1);
+    ::close(sockfd);
+}
+
+// 每100ms发送一个字节, 头部始终不完整: 自第一个字节起2秒内断开.
+TEST(HttpTimeoutTest, SlowlorisHeader) {
+    uint64_t before = HttpConnection::getEvictions(HttpConnection::kHeader);
+    int sockfd = connectServer();
+    const string header = "GET /benchmark HTTP/1.1\r\nX-Padding: " + string(200, 'a');
+    auto start = chrono::steady_clock::now();
+    size_t n_sent = 0;
+    bool closed = false;
+    char buf[64];
+    while (!closed && elapsedMs(start) < 5000 && n_sent < header.size()) {
+        ::send(sockfd, header.data() + n_sent, 1, MSG_NOSIGNAL);
+        ++n_sent;
+        std::this_thread::sleep_for(chrono::milliseconds(100));
+        closed = ::recv(sockfd, buf, sizeof(buf), MSG_DONTWAIT) == 0;
+    }
+    int64_t elapsed = elapsedMs(start);
+    EXPECT_TRUE(closed);
+    EXPECT_GE(elapsed, 900);
+    EXPECT_LE(elapsed, 2500);
+    EXPECT_GT(n_sent, 10u);
+    EXPECT_EQ(HttpConnection::getEvictions(HttpConnection::kHeader), before + 1);
+    ::close(sockfd);
+}
+
+// 请求间隔短于keep-alive超时时连接保持, 空闲后在超时内断开.
+TEST(HttpTimeoutTest, KeepAlive) {
+    uint64_t before = HttpConnection::getEvictions(HttpConnection::kKeepAlive);
+    int sockfd = connectServer();
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_TRUE(request(sockfd)) << "request " << i;
+        std::this_thread::sleep_for(chrono::milliseconds(400));
+    }
+    EXPECT_EQ(HttpConnection::getEvictions(HttpConnection::kKeepAlive), before);
+    int64_t elapsed = waitClosed(sockfd, 4000);
+    EXPECT_GE(elapsed, 0);
+    EXPECT_LE(elapsed, 2500);
+    EXPECT_EQ(HttpConnection::getEvictions(HttpConnection::kKeepAlive), before + 1);
+    ::close(sockfd);
+}
+
+// 请求大文件后不再读取: 第一个检查周期内内核发送缓冲区仍在填充, 发送停滞后的下一个周期断开.
+TEST(HttpTimeoutTest, SlowReader) {
+    uint64_t before = HttpConnection::getEvictions(HttpConnection::kSend);
+    int sockfd = connectServer(4096);
+    string req = string("GET ") + kBigFile + " HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(::send(sockfd, req.data(), req.size(), MSG_NOSIGNAL), static_cast<ssize_t>(req.size()));
+    auto start = chrono::steady_clock::now();
+    int limit_ms = (HttpConnection::kRateWindowSeconds * 2 + 3) * 1000;
+    while (HttpConnection::getEvictions(HttpConnection::kSend) == before && elapsedMs(start) < limit_ms) {
+        std::this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    EXPECT_EQ(HttpConnection::getEvictions(HttpConnection::kSend), before + 1);
+    EXPECT_GE(elapsedMs(start), (HttpConnection::kRateWindowSeconds - 1) * 1000);
+    ::close(sockfd);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    ::testing::AddGlobalTestEnvironment(new HttpTimeoutEnvironment);
+    return RUN_ALL_TESTS();
+}
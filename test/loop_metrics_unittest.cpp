@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "count_down_latch.h"
+#include "eventloop.h"
+#include "loop_metrics.h"
+
+using namespace std;
+
+/* Histogram与EventLoop循环指标(LoopMetrics)的单元测试
+ *
+ * 检查分桶的边界与相对误差、分位数估计, 以及EventLoop对回调耗时与任务批量的记录(回调计时默认关闭).
+ */
+
+// 小于16的值精确计数; 此后每个桶的上下界之比不超过1+1/16, 且相邻桶首尾相接.
+TEST(HistogramTest, BucketBoundaries) {
+    for (uint64_t v = 0; v < Histogram::kSubBuckets; ++v) {
+        EXPECT_EQ(Histogram::bucketIndex(v), v);
+        EXPECT_EQ(Histogram::bucketUpperBound(v), v);
+    }
+    uint64_t lower = Histogram::kSubBuckets;
+    for (size_t idx = Histogram::kSubBuckets; idx + 1 < Histogram::kNumBuckets; ++idx) {
+        uint64_t upper = Histogram::bucketUpperBound(idx);
+        ASSERT_EQ(Histogram::bucketIndex(lower), idx);
+        ASSERT_EQ(Histogram::bucketIndex(upper), idx);
+        ASSERT_LE(static_cast<double>(upper + 1) / lower, 1 + 1.0 / Histogram::kSubBuckets + 1e-9);
+        lower = upper + 1;
+    }
+    EXPECT_EQ(Histogram::bucketIndex(UINT64_MAX), Histogram::kNumBuckets - 1);
+}
+
+TEST(HistogramTest, Percentiles) {
+    Histogram histogram;
+    EXPECT_EQ(histogram.snapshot().percentile(99), 0u);
+    for (uint64_t v = 1; v <= 1000; ++v) {
+        histogram.record(v);
+    }
+    Histogram::Snapshot snap = histogram.snapshot();
+    EXPECT_EQ(snap.count, 1000u);
+    EXPECT_EQ(snap.max, 1000u);
+    EXPECT_DOUBLE_EQ(snap.mean(), 500.5);
+    // 估计值为所在桶的上界, 不低于真实值, 且相对误差不超过1/16.
+    EXPECT_GE(snap.percentile(50), 500u);
+    EXPECT_LE(snap.percentile(50), 500u * 17 / 16);
+    EXPECT_GE(snap.percentile(99), 990u);
+    EXPECT_LE(snap.percentile(99), 1000u);
+    EXPECT_EQ(snap.percentile(100), 1000u);
+}
+
+// 定时器回调计入timer类型, 其他线程加入的任务计入functor_batch; 读取在loop退出后进行.
+TEST(LoopMetricsTest, RecordsCallbacksAndTasks) {
+    EventLoop* loop = nullptr;
+    CountDownLatch loop_ready(1);
+    Histogram::Snapshot timer_us, functor_batch, wakeup_us, iteration_us;
+    thread io_thread([&]() {
+        EventLoop io_loop;
+        io_loop.setCallbackTiming(true);
+        loop = &io_loop;
+        loop_ready.countDown();
+        io_loop.runAfter(chrono::milliseconds(5), []() { this_thread::sleep_for(chrono::milliseconds(2)); });
+        io_loop.runAfter(chrono::milliseconds(50), [&io_loop]() { io_loop.quit(); });
+        io_loop.loop();
+        const LoopMetrics& metrics = io_loop.getMetrics();
+        timer_us = metrics.callback_us[LoopMetrics::kTimer].snapshot();
+        functor_batch = metrics.functor_batch.snapshot();
+        wakeup_us = metrics.callback_us[LoopMetrics::kWakeup].snapshot();
+        iteration_us = metrics.iteration_us.snapshot();
+    });
+    loop_ready.wait();
+    CountDownLatch done(3);
+    for (int i = 0; i < 3; ++i) {
+        loop->runInLoop([&done]() { done.countDown(); });
+    }
+    done.wait();
+    io_thread.join();
+
+    EXPECT_GE(timer_us.count, 2u);
+    EXPECT_GE(timer_us.max, 2000u);
+    EXPECT_GE(wakeup_us.count, 1u);
+    uint64_t n_tasks = 0;
+    for (size_t idx = 0; idx < functor_batch.buckets.size(); ++idx) {
+        n_tasks += functor_batch.buckets[idx] * Histogram::bucketUpperBound(idx);
+    }
+    EXPECT_EQ(n_tasks, 3u);
+    EXPECT_EQ(iteration_us.count, functor_batch.count);
+}
+
+// 未开启回调计时时只记录每轮循环的指标, 不记录回调与任务耗时.
+TEST(LoopMetricsTest, CallbackTimingOffByDefault) {
+    EventLoop loop;
+    loop.runAfter(chrono::milliseconds(5), [&loop]() { loop.addToQueueInLoop([]() {}); });
+    loop.runAfter(chrono::milliseconds(20), [&loop]() { loop.quit(); });
+    loop.loop();
+    const LoopMetrics& metrics = loop.getMetrics();
+    EXPECT_GE(metrics.iteration_us.snapshot().count, 2u);
+    EXPECT_GE(metrics.functor_batch.snapshot().count, 2u);
+    EXPECT_EQ(metrics.callback_us[LoopMetrics::kTimer].snapshot().count, 0u);
+    EXPECT_EQ(metrics.functor_us.snapshot().count, 0u);
+}
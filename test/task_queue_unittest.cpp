@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "count_down_latch.h"
+#include "eventloop.h"
+#include "task_queue.h"
+
+using namespace std;
+
+/* TaskQueue(EventLoop的无锁PendingFunctors队列)的单元测试
+ *
+ * 检查执行顺序、大小可调用对象的构造与析构、多生产者并发压入, 节点复用不再分配内存,
+ * 以及EventLoop在一批任务处理完之前只唤醒一次.
+ */
+
+// 统计本进程的operator new次数. delete不内联, 以免gcc在调用处将free与new误判为不匹配.
+static atomic<size_t> g_n_allocs(0);
+
+void* operator new(size_t size) {
+    ++g_n_allocs;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// 单个生产者按加入顺序执行; 执行期间加入的任务留待下一次runAll.
+TEST(TaskQueueTest, RunsInFifoOrder) {
+    TaskQueue queue;
+    vector<int> order;
+    for (int i = 0; i < 5; ++i) {
+        queue.push([&order, i]() { order.push_back(i); });
+    }
+    queue.push([&]() { queue.push([&order]() { order.push_back(100); }); });
+    EXPECT_EQ(queue.runAll(), 6u);
+    EXPECT_EQ(order, (vector<int>{ 0, 1, 2, 3, 4 }));
+    EXPECT_EQ(queue.runAll(), 1u);
+    EXPECT_EQ(order.back(), 100);
+    EXPECT_TRUE(queue.empty());
+}
+
+// 超过内联大小的可调用对象单独分配; 未执行的任务在队列析构时释放其捕获的对象.
+TEST(TaskQueueTest, LargeCallableAndDestruction) {
+    auto tracker = make_shared<int>(0);
+    array<char, TaskQueue::kInlineSize * 2> payload;
+    payload.fill('x');
+    {
+        TaskQueue queue;
+        queue.push([tracker, payload]() { *tracker += payload[0]; });
+        queue.push([tracker]() { *tracker += 1; });
+        EXPECT_EQ(tracker.use_count(), 3);
+        EXPECT_EQ(queue.runAll(), 2u);
+        EXPECT_EQ(*tracker, 'x' + 1);
+        EXPECT_EQ(tracker.use_count(), 1);
+
+        queue.push([tracker, payload]() { *tracker = 0; });
+        queue.push([tracker]() { *tracker = 0; });
+        EXPECT_EQ(tracker.use_count(), 3);
+    }
+    EXPECT_EQ(tracker.use_count(), 1);
+    EXPECT_EQ(*tracker, 'x' + 1);
+}
+
+// 多个生产者并发压入, 每个生产者的任务保持各自的加入顺序, 且无丢失.
+TEST(TaskQueueTest, ConcurrentProducers) {
+    const int kProducers = 4;
+    const int kTasksPerProducer = 20000;
+    TaskQueue queue;
+    vector<int> last(kProducers, -1);
+    int n_out_of_order = 0;
+    atomic<int> n_done(0);
+    vector<thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < kTasksPerProducer; ++i) {
+                queue.push([&, p, i]() {
+                    n_out_of_order += last[p] + 1 != i;
+                    last[p] = i;
+                });
+            }
+            ++n_done;
+        });
+    }
+    size_t n_run = 0;
+    while (n_done < kProducers) {
+        n_run += queue.runAll();
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    n_run += queue.runAll();
+    EXPECT_EQ(n_run, static_cast<size_t>(kProducers * kTasksPerProducer));
+    EXPECT_EQ(n_out_of_order, 0);
+}
+
+// 预分配的节点执行后归还复用, 稳定状态下push不再分配内存; 超出预分配数量的任务临时分配节点.
+TEST(TaskQueueTest, RecyclesNodes) {
+    TaskQueue queue;
+    int n_run = 0;
+    size_t allocs_before = g_n_allocs;
+    for (int round = 0; round < 100; ++round) {
+        for (uint32_t i = 0; i < TaskQueue::kSlabSize; ++i) {
+            queue.push([&n_run]() { ++n_run; });
+        }
+        queue.runAll();
+    }
+    EXPECT_EQ(g_n_allocs - allocs_before, 0u);
+    EXPECT_EQ(n_run, 100 * static_cast<int>(TaskQueue::kSlabSize));
+
+    allocs_before = g_n_allocs;
+    for (uint32_t i = 0; i < TaskQueue::kSlabSize + 10; ++i) {
+        queue.push([&n_run]() { ++n_run; });
+    }
+    EXPECT_EQ(g_n_allocs - allocs_before, 10u);
+    EXPECT_EQ(queue.runAll(), TaskQueue::kSlabSize + 10);
+}
+
+// 任务执行期间其他线程加入的100个任务只唤醒一次.
+TEST(TaskQueueTest, OneWakeupPerBatch) {
+    EventLoop* loop = nullptr;
+    EventLoop::TaskStats stats;
+    CountDownLatch loop_ready(1);
+    thread io_thread([&]() {
+        EventLoop io_loop;
+        loop = &io_loop;
+        loop_ready.countDown();
+        io_loop.loop();
+        stats = io_loop.getTaskStats();
+    });
+    loop_ready.wait();
+    EventLoop::TaskStats before = loop->getTaskStats();
+
+    CountDownLatch running(1);
+    CountDownLatch pushed(1);
+    loop->runInLoop([&]() {
+        running.countDown();
+        pushed.wait();           // 阻塞期间其他线程继续加入任务
+    });
+    running.wait();
+    atomic<int> n_run(0);
+    for (int i = 0; i < 100; ++i) {
+        loop->runInLoop([&]() { ++n_run; });
+    }
+    loop->runInLoop([&]() { loop->quit(); });
+    pushed.countDown();
+    io_thread.join();
+
+    EXPECT_EQ(n_run, 100);
+    EXPECT_EQ(stats.tasks_run - before.tasks_run, 102u);
+    EXPECT_EQ(stats.wakeups - before.wakeups, 2u);   // 第一个任务、以及阻塞期间的第一个任务
+}
@@ -23,7 +23,7 @@ void onConnection(const TcpConnection::TcpConnectionPtr& conn) {
     }
 }
 
-void onMessage(const TcpConnection::TcpConnectionPtr& conn, Buffer* buf, Timestamp receive_time) {
+void onMessage(const TcpConnection::TcpConnectionPtr& conn, Buffer* buf, MonoTimestamp receive_time) {
     printf("onMessage() : tid=%d received %zd bytes from connection [%s], at: %s\n",
         CurrentThread::getTid(),
         buf->readableBytes(), 
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "eventloop.h"
+#include "timer.h"
+
+using namespace std;
+
+/* 定时器微基准: 比较原先基于std::set的定时器队列与TimerManager的分层时间轮.
+ *
+ * - add:    加入N个到期时间在[1s, 120s)内随机分布的定时器(类似keep-alive超时)
+ * - cancel: 按随机顺序撤销全部定时器
+ * - expire: 加入N个在[10ms, 1010ms)内到期的定时器, 按1ms步长推进直至全部到期并执行回调.
+ *           时间轮在EventLoop中实际运行, 以LoopMetrics中定时器回调的总耗时计.
+ *
+ * 用法: timer_bench [num_timers]
+ */
+
+// 原TimerManager的数据结构: 每个定时器一次make_shared, 按(到期时间, 指针)存放于红黑树.
+class SetTimerQueue {
+public:
+    using Entry = pair<MonoTimestamp, shared_ptr<Timer>>;
+
+    weak_ptr<Timer> add(TimerCallback cb, MonoTimestamp when) {
+        auto timer = make_shared<Timer>(std::move(cb), when, Duration(0));
+        timers_.insert(Entry(when, timer));
+        return timer;
+    }
+
+    void cancel(const weak_ptr<Timer>& wk_timer) {
+        if (auto timer = wk_timer.lock()) {
+            timers_.erase(Entry(timer->getExpiration(), timer));
+        }
+    }
+
+    void expire(MonoTimestamp now) {
+        Entry sentry(now, shared_ptr<Timer>(reinterpret_cast<Timer*>(UINTPTR_MAX), [](Timer*) {}));
+        auto it = timers_.lower_bound(sentry);
+        vector<Entry> expired(timers_.begin(), it);
+        timers_.erase(timers_.begin(), it);
+        for (const auto& entry : expired) {
+            entry.second->run();
+        }
+    }
+
+    size_t size() const { return timers_.size(); }
+
+private:
+    set<Entry> timers_;
+};
+
+static double nsPerTimer(chrono::steady_clock::time_point start, size_t n) {
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(elapsed) / n;
+}
+
+static vector<MonoTimestamp> randomDeadlines(MonoTimestamp base, size_t n, int64_t min_us, int64_t max_us, mt19937_64& rng) {
+    uniform_int_distribution<int64_t> dist(min_us, max_us - 1);
+    vector<MonoTimestamp> deadlines(n);
+    for (auto& deadline : deadlines) {
+        deadline = base + Duration(dist(rng));
+    }
+    return deadlines;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    mt19937_64 rng(42);
+    vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    shuffle(order.begin(), order.end(), rng);
+    printf("timers: %zu\n", n);
+    printf("%-12s %14s %14s %14s\n", "queue", "add ns", "cancel ns", "expire ns");
+
+    size_t n_run = 0;
+    auto count = [&n_run]() { ++n_run; };
+
+    {
+        SetTimerQueue queue;
+        vector<MonoTimestamp> deadlines = randomDeadlines(MonoTimestamp::now(), n, 1000000, 120000000, rng);
+        vector<weak_ptr<Timer>> ids(n);
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = queue.add(count, deadlines[i]);
+        }
+        double add_ns = nsPerTimer(start, n);
+        start = chrono::steady_clock::now();
+        for (size_t i : order) {
+            queue.cancel(ids[i]);
+        }
+        double cancel_ns = nsPerTimer(start, n);
+
+        MonoTimestamp base = MonoTimestamp::now();
+        deadlines = randomDeadlines(base, n, 10000, 1010000, rng);
+        for (size_t i = 0; i < n; ++i) {
+            queue.add(count, deadlines[i]);
+        }
+        n_run = 0;
+        start = chrono::steady_clock::now();
+        for (int ms = 0; ms <= 1010; ++ms) {
+            queue.expire(base + chrono::milliseconds(ms));
+        }
+        double expire_ns = nsPerTimer(start, n);
+        printf("%-12s %14.1f %14.1f %14.1f\n", "std::set", add_ns, cancel_ns, expire_ns);
+        if (n_run != n || queue.size() != 0) {
+            fprintf(stderr, "std::set: %zu of %zu timers run\n", n_run, n);
+            return 1;
+        }
+    }
+
+    {
+        EventLoop loop;
+        loop.setCallbackTiming(true);   // 到期耗时取自定时器类回调的计时
+        vector<MonoTimestamp> deadlines = randomDeadlines(MonoTimestamp::now(), n, 1000000, 120000000, rng);
+        vector<TimerId> ids(n);
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = loop.runAt(deadlines[i], count);
+        }
+        double add_ns = nsPerTimer(start, n);
+        start = chrono::steady_clock::now();
+        for (size_t i : order) {
+            loop.removeTimer(ids[i]);
+        }
+        double cancel_ns = nsPerTimer(start, n);
+
+        deadlines = randomDeadlines(MonoTimestamp::now(), n, 10000, 1010000, rng);
+        for (size_t i = 0; i < n; ++i) {
+            loop.runAt(deadlines[i], count);
+        }
+        n_run = 0;
+        Histogram::Snapshot before = loop.getMetrics().callback_us[LoopMetrics::kTimer].snapshot();
+        loop.runAfter(chrono::milliseconds(1100), [&loop]() { loop.quit(); });
+        loop.loop();
+        Histogram::Snapshot after = loop.getMetrics().callback_us[LoopMetrics::kTimer].snapshot();
+        double expire_ns = (after.sum - before.sum) * 1000.0 / n;
+        printf("%-12s %14.1f %14.1f %14.1f\n", "timing wheel", add_ns, cancel_ns, expire_ns);
+        if (n_run != n) {
+            fprintf(stderr, "timing wheel: %zu of %zu timers run\n", n_run, n);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -7,11 +7,11 @@
 
 using namespace std;
 EventLoop* g_loop; 
-weak_ptr<Timer> wk_ptr_timer;
+TimerId timer_id;
 
 void cancelSelf() {
     cout << "cancelSelf()" << endl; 
-    g_loop->removeTimer(wk_ptr_timer); 
+    g_loop->removeTimer(timer_id); 
     g_loop->quit(); 
 }
 
@@ -28,6 +28,6 @@ int main() {
     loop.runAfter(Timestamp::secondsToDuration(3.5), bind(print, "once3.5", 0)); 
     loop.runEvery(Timestamp::secondsToDuration(2), bind(print, "every2", 0)); 
     loop.runEvery(Timestamp::secondsToDuration(3), bind(print, "every3", 0)); 
-    wk_ptr_timer = loop.runEvery(Timestamp::secondsToDuration(5), cancelSelf);
+    timer_id = loop.runEvery(Timestamp::secondsToDuration(5), cancelSelf);
     loop.loop(); 
 }
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "count_down_latch.h"
+#include "cycle_clock.h"
+#include "eventloop.h"
+#include "timing_wheel.h"
+
+using namespace std;
+
+/* TimerManager(分层时间轮)的单元测试
+ *
+ * 检查到期顺序与不提前触发、跨越第0层的定时器的降级, 到期批次内撤销其他定时器与自注销,
+ * 仅在最早到期时间提前时重设timerfd, 节点复用, 以及其他线程添加与撤销定时器(含加入时间轮之前的撤销).
+ * 到期时间为单调时间: 以墙上时间指定时按当前差值换算; 耗时统计的TSC时钟与CLOCK_MONOTONIC一致.
+ * 另检查断开超时连接的TimingWheel的惰性重排与各表项不同的到期时间.
+ */
+
+// 到期顺序与延时一致, 且不早于到期时间; 300ms以上的定时器位于第1层, 须经降级后触发.
+TEST(TimerTest, FiresInDeadlineOrder) {
+    EventLoop loop;
+    const vector<int> delays_ms = { 50, 3, 300, 20, 600, 1, 270, 257 };
+    vector<int> fired;
+    MonoTimestamp start = MonoTimestamp::now();
+    for (int delay : delays_ms) {
+        loop.runAfter(chrono::milliseconds(delay), [&, delay]() {
+            EXPECT_GE((MonoTimestamp::now() - start).count(), delay * 1000);
+            fired.push_back(delay);
+            if (fired.size() == delays_ms.size()) {
+                loop.quit();
+            }
+        });
+    }
+    loop.loop();
+    vector<int> expected = delays_ms;
+    sort(expected.begin(), expected.end());
+    EXPECT_EQ(fired, expected);
+    EXPECT_EQ(loop.getTimerStats().timers, 0u);
+}
+
+// 同一批到期的定时器中, 先执行者撤销后者; 周期性定时器在第2次回调中撤销自身.
+TEST(TimerTest, CancelWithinExpiredBatch) {
+    EventLoop loop;
+    TimerId victim;
+    TimerId periodic;
+    bool victim_run = false;
+    int periodic_runs = 0;
+    Timestamp when = Timestamp::now() + chrono::milliseconds(10);
+    loop.runAt(when, [&]() { loop.removeTimer(victim); });
+    victim = loop.runAt(when, [&]() { victim_run = true; });
+    periodic = loop.runEvery(chrono::milliseconds(5), [&]() {
+        if (++periodic_runs == 2) {
+            loop.removeTimer(periodic);
+            loop.removeTimer(periodic);   // 重复撤销无作用
+        }
+    });
+    loop.runAfter(chrono::milliseconds(40), [&]() { loop.quit(); });
+    loop.loop();
+    EXPECT_FALSE(victim_run);
+    EXPECT_EQ(periodic_runs, 2);
+    EXPECT_EQ(loop.getTimerStats().timers, 0u);
+}
+
+// timerfd推迟到poll之前重设, 每轮至多一次, 晚于当前最早到期时间的定时器不重设; 撤销后的节点被复用.
+TEST(TimerTest, RearmsOnlyWhenEarliestChanges) {
+    EventLoop loop;
+    uint64_t rearms = loop.getTimerStats().rearms;
+    vector<TimerId> ids;
+    for (int i = 0; i < 1000; ++i) {
+        ids.push_back(loop.runAfter(chrono::milliseconds(1000 + i), []() {}));
+    }
+    ids.push_back(loop.runAfter(chrono::milliseconds(500), []() {}));
+    ids.push_back(loop.runAfter(chrono::milliseconds(800), []() {}));
+    EXPECT_EQ(loop.getTimerStats().rearms - rearms, 0u);
+    // 第一轮poll之前以最早的10ms重设一次; 其回调中添加的更晚的定时器不重设.
+    loop.runAfter(chrono::milliseconds(10), [&]() {
+        EXPECT_EQ(loop.getTimerStats().rearms - rearms, 1u);
+        ids.push_back(loop.runAfter(chrono::milliseconds(900), []() {}));
+        loop.quit();
+    });
+    loop.loop();
+    EXPECT_EQ(loop.getTimerStats().rearms - rearms, 1u);
+    EXPECT_EQ(loop.getTimerStats().timers, 1003u);
+
+    for (TimerId id : ids) {
+        loop.removeTimer(id);
+    }
+    TimerManager::Stats stats = loop.getTimerStats();
+    EXPECT_EQ(stats.timers, 0u);
+    EXPECT_EQ(stats.free_nodes, 1004u);
+    for (int i = 0; i < 1000; ++i) {
+        loop.runAfter(chrono::seconds(60), []() {});
+    }
+    EXPECT_EQ(loop.getTimerStats().free_nodes, 4u);
+    loop.removeTimer(ids.front());   // 节点已复用, 旧TimerId不影响新定时器
+    EXPECT_EQ(loop.getTimerStats().timers, 1000u);
+}
+
+// 合并窗口内的定时器在同一次唤醒中执行, 且不早于各自的到期时间.
+TEST(TimerTest, SlackCoalescesWakeups) {
+    EventLoop loop;
+    loop.setTimerSlack(chrono::milliseconds(50));
+    uint64_t batches = loop.getTimerStats().batches;
+    MonoTimestamp start = MonoTimestamp::now();
+    int n_run = 0;
+    for (int i = 0; i < 20; ++i) {
+        loop.runAfter(chrono::milliseconds(60 + i * 2), [&, i]() {
+            EXPECT_GE((MonoTimestamp::now() - start).count(), (60 + i * 2) * 1000);
+            ++n_run;
+        });
+    }
+    loop.runAfter(chrono::milliseconds(250), [&]() { loop.quit(); });
+    loop.loop();
+    EXPECT_EQ(n_run, 20);
+    // 60~98ms跨越至多两个50ms窗口, 加上退出的定时器.
+    EXPECT_LE(loop.getTimerStats().batches - batches, 3u);
+}
+
+// poll超时模式: 不使用timerfd, 定时器按时触发; 其他线程添加的定时器缩短等待时间.
+TEST(TimerTest, PollTimeoutMode) {
+    EventLoop* loop = nullptr;
+    CountDownLatch loop_ready(1);
+    vector<int> fired;
+    uint64_t rearms = 0;
+    thread io_thread([&]() {
+        EventLoop io_loop;
+        io_loop.usePollTimeoutForTimers();
+        rearms = io_loop.getTimerStats().rearms;
+        io_loop.runEvery(chrono::milliseconds(5), [&]() {
+            if (fired.size() < 3) {
+                fired.push_back(5);
+            }
+        });
+        loop = &io_loop;
+        loop_ready.countDown();
+        io_loop.loop();
+        rearms = io_loop.getTimerStats().rearms - rearms;
+    });
+    loop_ready.wait();
+    MonoTimestamp start = MonoTimestamp::now();
+    int64_t elapsed_us = 0;
+    loop->runAfter(chrono::milliseconds(30), [&]() {
+        elapsed_us = (MonoTimestamp::now() - start).count();
+        loop->quit();
+    });
+    io_thread.join();
+    EXPECT_EQ(fired.size(), 3u);
+    EXPECT_GE(elapsed_us, 30 * 1000);
+    EXPECT_LT(elapsed_us, 200 * 1000);
+    EXPECT_EQ(rearms, 0u);
+}
+
+// 其他线程添加与撤销定时器.
+TEST(TimerTest, AddAndRemoveFromOtherThread) {
+    EventLoop* loop = nullptr;
+    CountDownLatch loop_ready(1);
+    int n_run = 0;
+    thread io_thread([&]() {
+        EventLoop io_loop;
+        loop = &io_loop;
+        loop_ready.countDown();
+        io_loop.loop();
+    });
+    loop_ready.wait();
+    TimerId canceled = loop->runAfter(chrono::milliseconds(20), [&]() { n_run += 100; });
+    loop->runAfter(chrono::milliseconds(10), [&]() { ++n_run; });
+    loop->removeTimer(canceled);
+    loop->runAfter(chrono::milliseconds(50), [&]() { loop->quit(); });
+    io_thread.join();
+    EXPECT_EQ(n_run, 1);
+}
+
+// 其他线程添加的定时器在加入时间轮之前即被所属线程撤销, 不应触发.
+TEST(TimerTest, RemoveBeforeCrossThreadAddRuns) {
+    EventLoop loop;
+    TimerId timer_id;
+    int n_run = 0;
+    thread other([&]() {
+        timer_id = loop.runAfter(chrono::milliseconds(10), [&]() { ++n_run; });
+    });
+    other.join();
+    loop.removeTimer(timer_id);   // 所属线程中直接执行, 添加任务尚在队列中
+    loop.runAfter(chrono::milliseconds(50), [&]() { loop.quit(); });
+    loop.loop();
+    EXPECT_EQ(n_run, 0);
+}
+
+// 单调时间的定时器在回调中本轮poll返回的时刻不早于到期时间; 墙上时间的定时器按调用时的差值换算.
+TEST(TimerTest, MonotonicDeadlines) {
+    EventLoop loop;
+    MonoTimestamp start = MonoTimestamp::now();
+    MonoTimestamp when = start + chrono::milliseconds(20);
+    int64_t wall_elapsed_us = 0;
+    loop.runAt(when, [&]() {
+        EXPECT_FALSE(loop.getPollReturnTime() < when);
+    });
+    loop.runAt(Timestamp::now() + chrono::milliseconds(30), [&]() {
+        wall_elapsed_us = (MonoTimestamp::now() - start).count();
+        loop.quit();
+    });
+    loop.loop();
+    EXPECT_GE(wall_elapsed_us, 30 * 1000);
+    EXPECT_LT(wall_elapsed_us, 200 * 1000);
+}
+
+// TSC换算的时间单调不减, 且与CLOCK_MONOTONIC的间隔一致(误差1%以内).
+TEST(CycleClockTest, TracksMonotonicClock) {
+    if (!CycleClock::enable()) {
+        GTEST_SKIP() << "invariant TSC unavailable";
+    }
+    EXPECT_GT(CycleClock::getCyclesPerMicro(), 0);
+    int64_t tsc_start = CycleClock::nowMicros();
+    MonoTimestamp mono_start = MonoTimestamp::now();
+    int64_t prev = tsc_start;
+    for (int i = 0; i < 100000; ++i) {
+        int64_t now = CycleClock::nowMicros();
+        ASSERT_GE(now, prev);
+        prev = now;
+    }
+    this_thread::sleep_for(chrono::milliseconds(100));
+    int64_t tsc_elapsed = CycleClock::nowMicros() - tsc_start;
+    int64_t mono_elapsed = (MonoTimestamp::now() - mono_start).count();
+    EXPECT_NEAR(static_cast<double>(tsc_elapsed), static_cast<double>(mono_elapsed), mono_elapsed * 0.01);
+}
+
+// 空闲连接时间轮: 持续活动的表项不超时, 无活动的在超时周期内回调, 移除或析构的表项不再回调.
+TEST(TimingWheelTest, LazyRebucketing) {
+    struct Session {
+        Session() : entry(this) {}
+        int timeouts = 0;
+        TimingWheel::Entry entry;
+    };
+    EventLoop loop;
+    TimingWheel wheel(&loop, 2, [](TimingWheel::Entry* entry) {
+        ++static_cast<Session*>(entry->getOwner())->timeouts;
+    });
+    Session active, idle, removed;
+    auto destroyed = make_unique<Session>();
+    for (Session* session : { &active, &idle, &removed, destroyed.get() }) {
+        wheel.insert(&session->entry);
+    }
+    wheel.remove(&removed.entry);
+    destroyed.reset();
+    EXPECT_EQ(wheel.size(), 2u);
+
+    TimerId touch_timer = loop.runEvery(chrono::milliseconds(300), [&]() { active.entry.touch(); });
+    loop.runAfter(chrono::milliseconds(3200), [&]() { loop.quit(); });
+    loop.loop();
+    loop.removeTimer(touch_timer);
+
+    EXPECT_EQ(active.timeouts, 0);
+    EXPECT_TRUE(active.entry.inWheel());
+    EXPECT_EQ(idle.timeouts, 1);
+    EXPECT_FALSE(idle.entry.inWheel());
+    EXPECT_EQ(removed.timeouts, 0);
+    EXPECT_EQ(wheel.size(), 1u);
+}
+
+// 各表项的到期时间不同: 提前到期时间立即生效, 延后到期时间在原槽到期时才重新放置.
+TEST(TimingWheelTest, PerEntryDeadlines) {
+    struct Session {
+        Session() : entry(this) {}
+        int timeouts = 0;
+        TimingWheel::Entry entry;
+    };
+    EventLoop loop;
+    TimingWheel wheel(&loop, 3, [](TimingWheel::Entry* entry) {
+        ++static_cast<Session*>(entry->getOwner())->timeouts;
+    });
+    Session short_lived, shortened, extended;
+    wheel.insert(&short_lived.entry, 1);
+    wheel.insert(&shortened.entry, 3);
+    wheel.insert(&shortened.entry, 1);
+    wheel.insert(&extended.entry, 1);
+    wheel.insert(&extended.entry, 3);
+    EXPECT_EQ(wheel.size(), 3u);
+
+    loop.runAfter(chrono::milliseconds(1500), [&]() {
+        EXPECT_EQ(short_lived.timeouts, 1);
+        EXPECT_EQ(shortened.timeouts, 1);
+        EXPECT_EQ(extended.timeouts, 0);
+        EXPECT_TRUE(extended.entry.inWheel());
+    });
+    loop.runAfter(chrono::milliseconds(3500), [&]() { loop.quit(); });
+    loop.loop();
+
+    EXPECT_EQ(extended.timeouts, 1);
+    EXPECT_EQ(wheel.size(), 0u);
+}
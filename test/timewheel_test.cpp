@@ -1,5 +1,6 @@
 #include <timing_wheel.h>
 
+#include <memory>
 #include <string>
 #include <unistd.h>
 #include <vector>
@@ -11,9 +12,16 @@
 
 using namespace std;
 
-void callback(Any& data) {
-    auto msg = any_cast<string>(&data); 
-    LOG_INFO << "callback: " << *msg;
+// 嵌入时间轮表项的被管理对象
+struct Session {
+    explicit Session(string m) : msg(std::move(m)), entry(this) {}
+    string msg;
+    TimingWheel::Entry entry;
+};
+
+void callback(TimingWheel::Entry* entry) {
+    auto session = static_cast<Session*>(entry->getOwner());
+    LOG_INFO << "callback: " << session->msg;
 }
 
 string makeMsg(int i) {
@@ -24,97 +32,110 @@ string makeMsg(int i) {
 // 测试定时事件触发
 void testOnTimer() {
     EventLoop main_loop;
-    EventLoopThread thread; 
-    EventLoop* loop = thread.startLoop(); 
-    int idle_seconds = 10; 
-    TimingWheel timing_wheel(loop, idle_seconds, callback); 
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    int idle_seconds = 10;
+    unique_ptr<TimingWheel> timing_wheel;
+    loop->runInLoop([&]() { timing_wheel = make_unique<TimingWheel>(loop, idle_seconds, callback); });
+    vector<unique_ptr<Session>> sessions;
     for (int i = 1; i <= 25; ++i) {
-        timing_wheel.insert(makeMsg(i));  
+        sessions.push_back(make_unique<Session>(makeMsg(i)));
+        Session* session = sessions.back().get();
+        loop->runInLoop([&, session]() { timing_wheel->insert(&session->entry); });
         if (i % 2 == 0) {
-            sleep(2); 
+            sleep(2);
         }
     }
     main_loop.loop();
 }
 
-// 测试移除定时器
+// 测试移除与更新
 void testRemoveTimer() {
     EventLoop main_loop;
-    EventLoopThread thread; 
-    EventLoop* loop = thread.startLoop(); 
-    int idle_seconds = 10; 
-    TimingWheel timing_wheel(loop, idle_seconds, callback); 
-
-    vector<TimingWheel::EntryWeakPtr> wk_ptrs;
-    // 插入6个
-    for (int i = 0; i < 6; ++i) {
-        wk_ptrs.push_back(timing_wheel.insert(makeMsg(i)));  
-    }
-    sleep(3); 
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    int idle_seconds = 10;
+    unique_ptr<TimingWheel> timing_wheel;
+    vector<unique_ptr<Session>> sessions;
+    loop->runInLoop([&]() {
+        timing_wheel = make_unique<TimingWheel>(loop, idle_seconds, callback);
+        // 插入6个
+        for (int i = 0; i < 6; ++i) {
+            sessions.push_back(make_unique<Session>(makeMsg(i)));
+            timing_wheel->insert(&sessions.back()->entry);
+        }
+    });
+    sleep(3);
     // 删除中间两个
-    for (int i = 2; i < 4; ++i) {
-        timing_wheel.remove(wk_ptrs[i]);  
-    }
-    sleep(3); 
+    loop->runInLoop([&]() {
+        for (int i = 2; i < 4; ++i) {
+            timing_wheel->remove(&sessions[i]->entry);
+        }
+    });
+    sleep(3);
     // 更新前2个
-    for (int i = 0; i < 2; ++i) {
-        timing_wheel.update(wk_ptrs[i]);  
-    }
+    loop->runInLoop([&]() {
+        for (int i = 0; i < 2; ++i) {
+            sessions[i]->entry.touch();
+        }
+    });
     main_loop.loop();
 }
 
 // 测试为不同EventLoop(不同线程)绑定TimerWheel
 void testBindTimerWheelWithEventLoop() {
     EventLoop main_loop;
-    EventLoopThreadPool loops_pool(&main_loop, ""); 
-    int loop_cnt = 3; 
+    EventLoopThreadPool loops_pool(&main_loop, "");
+    int loop_cnt = 3;
     loops_pool.setThreadNum(loop_cnt);
-    loops_pool.start(); 
+    int idle_seconds = 15;
+    // 时间轮仅限所属线程访问, 在IO线程中创建.
+    loops_pool.start([idle_seconds](EventLoop* loop) {
+        loop->setContext(make_unique<TimingWheel>(loop, idle_seconds, callback));
+    });
 
-    int idle_seconds = 15; 
     auto loops = loops_pool.getAllLoops();
-    for (auto& loop : loops) {
-        loop->setContext(make_unique<TimingWheel>(loop, idle_seconds, callback));  
-    }
-
-    vector<TimingWheel::EntryWeakPtr> entrys_update;
-    vector<TimingWheel::EntryWeakPtr> entrys_move;
-    // 每个EventLoop所在线程各插入3个定时器, 再分别移除其中一个, 更新其中一个.
+    vector<unique_ptr<Session>> sessions;
+    vector<Session*> sessions_remove;
+    vector<Session*> sessions_update;
+    // 每个EventLoop所在线程各插入3个, 再分别移除其中一个, 更新其中一个.
     for (auto& loop : loops) {
         for (int i = 0; i < 3; ++i) {
-            auto wheel = any_cast<unique_ptr<TimingWheel>>(loop->getMutableContext()); 
-            auto wkptr = (*wheel)->insert(makeMsg(i)); 
+            sessions.push_back(make_unique<Session>(makeMsg(i)));
+            Session* session = sessions.back().get();
+            loop->runInLoop([loop, session]() {
+                auto wheel = any_cast<unique_ptr<TimingWheel>>(loop->getMutableContext());
+                (*wheel)->insert(&session->entry);
+            });
             if (i == 1) {
-                entrys_move.push_back(wkptr); 
+                sessions_remove.push_back(session);
             } else if (i == 2) {
-                entrys_update.push_back(wkptr); 
+                sessions_update.push_back(session);
             }
         }
-        sleep(4); 
+        sleep(4);
     }
     // 各移除1个
-    for (auto entry : entrys_move) {
-        if (auto sptr = entry.lock()) {
-            sptr->owner_wheel_->remove(entry); 
-        }
+    for (size_t i = 0; i < loops.size(); ++i) {
+        Session* session = sessions_remove[i];
+        loops[i]->runInLoop([loop = loops[i], session]() {
+            auto wheel = any_cast<unique_ptr<TimingWheel>>(loop->getMutableContext());
+            (*wheel)->remove(&session->entry);
+        });
     }
-    sleep(1); 
+    sleep(1);
     // 各更新1个
-    for (auto entry : entrys_update) {
-        if (auto sptr = entry.lock()) {
-            sptr->owner_wheel_->update(entry); 
-        }
+    for (size_t i = 0; i < loops.size(); ++i) {
+        Session* session = sessions_update[i];
+        loops[i]->runInLoop([session]() { session->entry.touch(); });
     }
-    main_loop.loop(); 
+    main_loop.loop();
 }
 
 
 int main() {
-    Logger::setLogLevel(Logger::INFO); 
+    Logger::setLogLevel(Logger::INFO);
     // testOnTimer();
     // testRemoveTimer();
     testBindTimerWheelWithEventLoop();
 }
-
-
-